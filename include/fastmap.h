@@ -8,6 +8,9 @@
 #ifndef FASTMAP_H
 #define FASTMAP_H 1
 
+#include <stdint.h>
+#include <sys/types.h>
+
 /** Valid formats */
 typedef enum
 {
@@ -17,12 +20,61 @@ typedef enum
 	FASTMAP_BLOB
 } fastmap_format_t;
 
+/** Types of the fields of a typed key, see #fastmap_attr_setkeyschema() */
+typedef enum
+{
+	FASTMAP_KEY_U32 = 1,	/**< unsigned 32 bit integer */
+	FASTMAP_KEY_U64,	/**< unsigned 64 bit integer */
+	FASTMAP_KEY_I64,	/**< signed 64 bit integer */
+	FASTMAP_KEY_F64	/**< IEEE 754 double */
+} fastmap_keytype_t;
+
+/** Encodings of the keys of a #FASTMAP_ATOM map, see #fastmap_attr_setatomencoding() */
+typedef enum
+{
+	FASTMAP_ATOM_SORTED,	/**< keys stored whole in sorted leaf pages */
+	FASTMAP_ATOM_ELIASFANO,	/**< integer keys stored in partitioned Elias-Fano code */
+	FASTMAP_ATOM_ROARING	/**< 32 bit integer keys stored as an array, bitmap or runs per chunk of 2^16 keys */
+} fastmap_atomencoding_t;
+
+/** Operations combining two sets, see #fastmap_inhandle_combine() */
+typedef enum
+{
+	FASTMAP_SET_INTERSECTION = 1,	/**< keys in both sets */
+	FASTMAP_SET_UNION	/**< keys in either set */
+} fastmap_setop_t;
+
+#define FASTMAP_MAXKEYFIELDS 8 /* most fields a typed key may be composed of */
+
+/** One field of a typed key, in native form */
+typedef union fastmap_keyfield_t
+{
+	uint32_t u32;
+	uint64_t u64;
+	int64_t i64;
+	double f64;
+} fastmap_keyfield_t;
+
 /** Opaque structure used to specify the parameters of a new fastmap */
 struct fastmap_attr_t
 {
 	size_t records;
 	size_t ksize;
 	size_t vsize;
+	size_t inlinevsize;
+	size_t valuebytes;
+	size_t pagesize;
+	size_t sectionalign;
+	size_t restartinterval;
+	int variablekeys;
+	int truncateseparators;
+	size_t keyfields;
+	fastmap_keytype_t keyschema[FASTMAP_MAXKEYFIELDS];
+	fastmap_atomencoding_t atomencoding;
+	size_t valueblocksize;
+	size_t dictionarysize;
+	size_t dedupentries;
+	fastmap_keytype_t valueaggregate;
 	fastmap_format_t format;
 };
 
@@ -31,6 +83,26 @@ typedef struct fastmap_attr_t fastmap_attr_t;
 /** A callback function used to compare records */
 typedef int (*fastmap_cmpfunc)(const fastmap_attr_t *attr, const void *a, const void *b);
 
+#define FASTMAP_MAXINLINEVSIZE 254 /* largest #FASTMAP_BLOB value which may be stored in a leaf page */
+
+#define FASTMAP_MAXFRONTCODEDKSIZE 4096 /* largest key which may be stored in front-coded leaf pages */
+
+#define FASTMAP_MINPAGESIZE 512 /* smallest page size accepted by #fastmap_attr_setpagesize() */
+#define FASTMAP_MAXPAGESIZE (2 * 1024 * 1024) /* largest page size accepted by #fastmap_attr_setpagesize() */
+#define FASTMAP_HUGEPAGESIZE (2 * 1024 * 1024) /* section alignment suited to transparent huge pages */
+
+#define FASTMAP_MAXVALUEBLOCKSIZE (1024 * 1024) /* largest block of values accepted by #fastmap_attr_setvaluecompression() */
+#define FASTMAP_MAXDICTIONARYSIZE 65536 /* largest dictionary accepted by #fastmap_outhandle_setdictionary() */
+#define FASTMAP_DEFAULTCACHEBLOCKS 8 /* decompressed value blocks cached by a handle, see #fastmap_inhandle_setcacheblocks() */
+
+#define FASTMAP_DEFAULTPOOLFRAMES 1024 /* frames of a buffer pool until set otherwise, see #fastmap_inhandle_setpoolframes() */
+
+#define FASTMAP_MGETPARTITION 4096 /* fewest records given to each thread of #fastmap_inhandle_mget(), see #fastmap_inhandle_setthreads() */
+
+#define FASTMAP_MAXDEDUPENTRIES (1 << 24) /* largest table of values accepted by #fastmap_attr_setvaluededup() */
+
+#define FASTMAP_AGGREGATEFANOUT 16 /* aggregates combined into each aggregate of the level above, see #fastmap_attr_setvalueaggregate() */
+
 #define FASTMAP_MAXLEVELS 32 /* 32 levels allows for 10^64 records (assuming 8-byte keys and 8-byte pointers), plenty of space */
 
 typedef struct fastmap_handle_t
@@ -50,11 +122,24 @@ typedef struct fastmap_handle_t
 	size_t leafpagerecordsize;
 	size_t firstleafpageoffset;
 	size_t firstvalueoffset;
+	size_t valueblocks;
+	size_t valueblockoffset;
+	size_t aggregateoffset;
 	uint32_t pagesize;
 	int numlevels;
 	uint16_t flags;
 } fastmap_handle_t;
 
+/** Counts kept by a #fastmap_outhandle_t which deduplicates values, see #fastmap_outhandle_getdedupstats() */
+typedef struct fastmap_dedupstats_t
+{
+	size_t values;	/**< values looked up in the table */
+	size_t duplicates;	/**< values found, which were not written again */
+	size_t savedbytes;	/**< bytes of the value pages not written */
+	size_t evictions;	/**< values displaced from the table by another */
+	size_t tableentries;	/**< entries of the table */
+} fastmap_dedupstats_t;
+
 /** Opaque structure used in writing a fastmap */
 struct fastmap_outhandle_t
 {
@@ -62,10 +147,38 @@ struct fastmap_outhandle_t
 	struct {
 		size_t keys;
 		size_t currentoffset;
+		unsigned char *page;
+		size_t pagekeys;
+		size_t pageused;
 	} levelinfo[FASTMAP_MAXLEVELS];
 	size_t records;
 	size_t currentleafpageoffset;
 	size_t currentvalueoffset;
+	unsigned char *leafpage;
+	unsigned char *lastkey;
+	size_t lastksize;
+	uint64_t *atoms;
+	uint64_t lastatom;
+	size_t repeatedatoms;
+	unsigned char *directory;
+	size_t leafpageused;
+	size_t leafpageentries;
+	size_t leafpagerestarts;
+	size_t leafpageswritten;
+	unsigned char *valueblock;
+	size_t valueblockused;
+	size_t valueblockcapacity;
+	unsigned char *valueblockdirectory;
+	size_t valueblockdirectorycapacity;
+	unsigned char *compressed;
+	uint32_t *lztable;
+	size_t compressedvalueoffset;
+	void *deduptable;
+	unsigned char *dedupbuffer;
+	size_t dedupbuffersize;
+	size_t dedupblock;
+	fastmap_dedupstats_t dedupstats;
+	void *aggregates;
 	int fd;
 };
 
@@ -78,15 +191,93 @@ struct fastmap_inhandle_t
 	fastmap_cmpfunc cmp;
 	void *mmapaddr;
 	size_t mmaplen;
+	void *mapping;
+	size_t mappinglen;
+	int mapflags;
+	void *valuecache;
+	size_t cacheblocks;
+	size_t cachetick;
+	void *pool;
+	size_t threads;
+	const void *dictionary;
 	int fd;
 };
 
 typedef struct fastmap_inhandle_t fastmap_inhandle_t;
 
+/** Aggregates of the values of a range of records, see #fastmap_inhandle_aggregate().
+ * Values of #FASTMAP_KEY_U32 and #FASTMAP_KEY_U64 are summed into 'u64', wrapping around on
+ * overflow, #FASTMAP_KEY_I64 values into 'i64' and #FASTMAP_KEY_F64 values into 'f64', and
+ * their least and greatest values are held in the same member */
+typedef struct fastmap_aggregate_t
+{
+	uint64_t count;	/**< the number of values */
+	fastmap_keyfield_t sum;	/**< the sum of the values */
+	fastmap_keyfield_t min;	/**< the least value, if there is any */
+	fastmap_keyfield_t max;	/**< the greatest value, if there is any */
+} fastmap_aggregate_t;
+
+/** Counts kept by the buffer pool of a #fastmap_inhandle_t, see #fastmap_inhandle_getpoolstats() */
+typedef struct fastmap_poolstats_t
+{
+	size_t framesize;	/**< bytes of the map held by a frame */
+	size_t frames;	/**< frames the pool holds besides pinned frames */
+	size_t resident;	/**< frames holding a page of the map, besides pinned frames */
+	size_t pinned;	/**< frames read when the map was opened, and never evicted */
+	size_t hits;	/**< frames found in the pool */
+	size_t reads;	/**< frames read from the file */
+	size_t evictions;	/**< frames evicted to make room */
+} fastmap_poolstats_t;
+
+/** Size of a map name in a container, including the terminating NUL */
+#define FASTMAP_CONTAINER_NAMELEN	48
+
+/** Header at the front of a fastmap container file */
+typedef struct fastmap_container_header_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t nmaps;
+	uint64_t align;
+} fastmap_container_header_t;
+
+/** Entry of the container directory, which follows the header sorted by name */
+typedef struct fastmap_container_entry_t
+{
+	char name[FASTMAP_CONTAINER_NAMELEN];
+	uint64_t offset;
+	uint64_t len;
+} fastmap_container_entry_t;
+
+/** Opaque structure used to open maps packed in a container file */
+struct fastmap_container_t
+{
+	const fastmap_container_entry_t *directory;
+	size_t nmaps;
+	void *mmapaddr;
+	size_t mmaplen;
+	int fd;
+};
+
+typedef struct fastmap_container_t fastmap_container_t;
+
+/** Mapping policies for #fastmap_inhandle_initflags() */
+#define FASTMAP_MAP_POPULATE		0x0001	/**< fault in the whole map while opening it */
+#define FASTMAP_MAP_LOCKSEARCH		0x0002	/**< lock the header and search levels into memory */
+#define FASTMAP_MAP_HUGEPAGE		0x0004	/**< ask for the map to be backed by transparent huge pages */
+#define FASTMAP_MAP_LOADRAM		0x0008	/**< copy the whole map into anonymous memory, backed by huge pages where possible */
+#define FASTMAP_ADVISE_SEARCH_WILLNEED	0x0010	/**< start reading the search levels in while opening the map */
+#define FASTMAP_ADVISE_LEAF_RANDOM	0x0020	/**< disable readahead on the leaf pages */
+#define FASTMAP_ADVISE_LEAF_WILLNEED	0x0040	/**< start reading the leaf pages in while opening the map */
+#define FASTMAP_ADVISE_VALUE_RANDOM	0x0080	/**< disable readahead on the value pages */
+#define FASTMAP_ADVISE_VALUE_WILLNEED	0x0100	/**< start reading the value pages in while opening the map */
+#define FASTMAP_MAP_BUFFERPOOL		0x0200	/**< read pages into a buffer pool of the handle, rather than mapping the file */
+
 /** Generic structure for passing keys in and out of a #FASTMAP_ATOM formatted fastmap */
 typedef struct fastmap_atom_t
 {
 	void *key;	/**< address of the key data, the size of the key is specified by #fastmap_attr_setksize() */
+	size_t ksize;	/**< size of the key data, only used when the map has variable length keys */
 } fastmap_atom_t;
 
 /** Generic structure for passing keys and values in and out of a #FASTMAP_PAIR formatted fastmap */
@@ -94,6 +285,7 @@ typedef struct fastmap_pair_t
 {
 	void *key;	/**< address of the key data, the size of the key is specified by #fastmap_attr_setksize() */
 	void *value;	/**< address of the value data, the size of the value is taken to be equal to the size of the key */
+	size_t ksize;	/**< size of the key data, only used when the map has variable length keys */
 } fastmap_pair_t;
 
 /** Generic structure for passing keys and values in and out of a #FASTMAP_BLOCK formatted fastmap */
@@ -101,6 +293,7 @@ typedef struct fastmap_block_t
 {
 	void *key;	/**< address of the key data, the size of the key is specified by #fastmap_attr_setksize() */
 	void *value;	/**< address of the value data, the size of the value is specified by #fastmap_attr_setvsize() */
+	size_t ksize;	/**< size of the key data, only used when the map has variable length keys */
 } fastmap_block_t;
 
 /** Generic structure for passing keys and values in and out of a #FASTMAP_BLOB formatted fastmap */
@@ -109,6 +302,7 @@ typedef struct fastmap_blob_t
 	void *key;	/**< address of the key data, the size of the key is specified by #fastmap_attr_setksize() */
 	void *value;	/**< address of the value data */
 	size_t vsize;	/**< sie of the value data */
+	size_t ksize;	/**< size of the key data, only used when the map has variable length keys */
 } fastmap_blob_t;
 
 /** Union of all record structures. Type is specified by #fastmap_attr_settype() */
@@ -120,12 +314,56 @@ typedef union
 	fastmap_blob_t blob;
 } fastmap_record_t;
 
+/** A lookup completed by #fastmap_inhandle_complete() */
+typedef struct fastmap_completion_t
+{
+	fastmap_record_t *record;	/**< the record given to #fastmap_inhandle_submit() */
+	void *cookie;	/**< the cookie given to #fastmap_inhandle_submit() */
+	int rc;	/**< the result of the lookup, as returned by #fastmap_inhandle_get() */
+} fastmap_completion_t;
+
+/** A lookup started by #fastmap_inhandle_prefetch(), to be finished by #fastmap_inhandle_getprefetched() */
+typedef struct fastmap_prefetch_t
+{
+	size_t pageoffset;	/**< the leaf page which may hold the key */
+	int located;	/**< 1 if a leaf page may hold the key, 0 if none may, -1 if the lookup starts over */
+} fastmap_prefetch_t;
+
+/** A lookup context kept across lookups by #fastmap_finger_get(), see #fastmap_finger_init() */
+typedef struct fastmap_finger_t
+{
+	fastmap_inhandle_t *ihandle;	/**< the handle looked up through */
+	size_t child;	/**< the leaf page of the last lookup, SIZE_MAX if there is none */
+	size_t searchpage;	/**< the page of the lowest slotted search level leading to that leaf page */
+	size_t lookups;	/**< the lookups made */
+	size_t descents;	/**< the lookups which searched down from the root */
+	size_t gallops;	/**< the lookups which moved forward from the leaf page of the last */
+} fastmap_finger_t;
+
+/** A run of records read in order by #fastmap_cursor_next(), see #fastmap_cursor_init() */
+typedef struct fastmap_cursor_t
+{
+	fastmap_inhandle_t *ihandle;	/**< the handle read through */
+	size_t next;	/**< the index of the next record */
+	size_t end;	/**< the index after the last record */
+	size_t page;	/**< the leaf page of the last record read from packed leaf pages, SIZE_MAX if there is none */
+	size_t position;	/**< the offset within that page of the entry after it, if the page is front-coded */
+	unsigned char key[FASTMAP_MAXFRONTCODEDKSIZE];	/**< the last key decoded from a front-coded page */
+} fastmap_cursor_t;
+
+/** A callback function run over each partition of a map by #fastmap_inhandle_scan() */
+typedef int (*fastmap_scanfunc)(fastmap_cursor_t *cursor, size_t partition, void *arg);
+
 /** Status codes, range -13000 to -13199 */
 #define FASTMAP_OK			0
 #define FASTMAP_NOT_FOUND		-13199
 #define FASTMAP_EXPECTATION_FAILED	-13198
 #define FASTMAP_TOO_MANY_LEVELS		-13197
 #define FASTMAP_TOO_MANY_RECORDS	-13196
+#define FASTMAP_VALUES_TOO_LARGE	-13195
+#define FASTMAP_CORRUPT_VALUE		-13194
+#define FASTMAP_PENDING			-13193
+#define FASTMAP_CORRUPT_PAGE		-13192
 
 /** Initialize a fastmap attribute structure.
  * This function sets a #fastmap_attr_t to a sane default state.
@@ -184,6 +422,362 @@ int fastmap_attr_setvsize(fastmap_attr_t *attr, const size_t size);
  *   <li>EINVAL - An invalid parameter was specified</li>
  * </ul>
  */
+int fastmap_attr_getvsize(fastmap_attr_t *attr, size_t *size);
+
+/** Set the largest value size which will be stored inline in a leaf page
+ * This function has no effect unless the map format is #FASTMAP_BLOB. Values no larger than
+ * 'size' are stored alongside their key in the leaf page, so a lookup touches a single page.
+ * Larger values are stored in the value pages as usual. A size of 0 disables inline values.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] size The inline value size threshold, at most #FASTMAP_MAXINLINEVSIZE
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setinlinevsize(fastmap_attr_t *attr, const size_t size);
+
+/** Get the largest value size which will be stored inline in a leaf page
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] size The inline value size threshold
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getinlinevsize(fastmap_attr_t *attr, size_t *size);
+
+/** Set an upper bound on the total size of the values in the map
+ * This function has no effect unless the map format is #FASTMAP_BLOB. Values are located
+ * through offsets relative to the first value page, and the writer uses the bound to pick
+ * the narrowest offset which can address them: 4 bytes up to 4 GiB and 5 bytes up to 1 TiB.
+ * When no bound is given 5 byte offsets are used.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] nbytes The total size of all values, or 0 if unknown
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setvaluebytes(fastmap_attr_t *attr, const size_t nbytes);
+
+/** Get the upper bound on the total size of the values in the map
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] nbytes The total size of all values
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getvaluebytes(fastmap_attr_t *attr, size_t *nbytes);
+
+/** Set the logical page size of the map
+ * Pages are the unit of the map's search and leaf levels. Small pages give keys of a small
+ * map a shallow tree, large pages give large maps a high fanout. By default the block size
+ * of the filesystem holding the map is used.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] size The page size, a power of two between #FASTMAP_MINPAGESIZE and #FASTMAP_MAXPAGESIZE,
+ *                 or 0 to use the filesystem block size
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setpagesize(fastmap_attr_t *attr, const size_t size);
+
+/** Get the logical page size of the map
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] size The page size, 0 if the filesystem block size will be used
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getpagesize(fastmap_attr_t *attr, size_t *size);
+
+/** Set the alignment of the leaf and value sections of the map
+ * Aligning the sections to #FASTMAP_HUGEPAGESIZE lets the leaf and value pages be backed
+ * by huge pages when the map lives on tmpfs or hugetlbfs, which cuts TLB misses on random
+ * lookups. The map is also mapped at an address with this alignment when it is opened.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] align The section alignment, a power of two, or 0 to align sections to a page
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setsectionalign(fastmap_attr_t *attr, const size_t align);
+
+/** Get the alignment of the leaf and value sections of the map
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] align The section alignment
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getsectionalign(fastmap_attr_t *attr, size_t *align);
+
+/** Set the restart interval of front-coded leaf pages
+ * A non-zero interval front-codes the keys of each leaf page: a key stores only the bytes
+ * which differ from the key before it, except every 'interval' keys where a restart point
+ * stores the whole key. A lookup binary searches the restart points of the leaf page and
+ * then decodes a single run of keys. Keys sharing long prefixes shrink the map severalfold,
+ * and a smaller interval trades some of that back for shorter runs. Front coding requires
+ * keys of at most #FASTMAP_MAXFRONTCODEDKSIZE bytes.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] interval The number of keys between restart points, or 0 to store whole keys
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setrestartinterval(fastmap_attr_t *attr, const size_t interval);
+
+/** Get the restart interval of front-coded leaf pages
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] interval The number of keys between restart points, 0 if keys are not front-coded
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getrestartinterval(fastmap_attr_t *attr, size_t *interval);
+
+/** Enable variable length keys
+ * Keys of a map with variable length keys may have any size up to the key size set by
+ * #fastmap_attr_setksize(), which becomes a maximum. The size of each key is passed in the
+ * 'ksize' field of the record. Leaf and search pages hold a directory of key offsets and
+ * sizes, and keys compare byte-wise, a key collating before any longer key it is a prefix of.
+ * The comparison function set by #fastmap_inhandle_setcmpfunc() is not used by such maps.
+ * Variable length keys may not be used with the #FASTMAP_PAIR format, or with front coding.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] enable Non-zero to enable variable length keys
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setvariablekeys(fastmap_attr_t *attr, const int enable);
+
+/** Get whether keys have variable length
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] enable Non-zero if keys have variable length
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getvariablekeys(fastmap_attr_t *attr, int *enable);
+
+/** Enable truncated separator keys in the search levels
+ * Rather than a copy of the first key of each leaf page, the search levels then hold the
+ * shortest prefix of that key which still sorts after the last key of the page before it.
+ * Search pages hold a directory of separator offsets and sizes, so long keys with short
+ * distinguishing prefixes give a much higher fanout and fewer search levels. Lookups are
+ * unchanged, but separators compare byte-wise, so the map must be sorted in the byte-wise
+ * order of the default comparison function. Maps with variable length keys always truncate
+ * their separators.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] enable Non-zero to enable truncated separators
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_settruncateseparators(fastmap_attr_t *attr, const int enable);
+
+/** Get whether separator keys in the search levels are truncated
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] enable Non-zero if separators are truncated
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_gettruncateseparators(fastmap_attr_t *attr, int *enable);
+
+/** Declare the keys of the map to be tuples of typed fields
+ * Keys are then stored encoded field by field as big-endian bytes, with the sign of integers
+ * and floats adjusted so that the default byte-wise comparison orders keys as the tuples of
+ * their native values. No comparison function need be set by #fastmap_inhandle_setcmpfunc().
+ * The key size becomes the total size of the fields. Use #fastmap_encodekey() to build each
+ * key passed to the map, and #fastmap_decodekey() to read a key back. Float keys order -0.0
+ * and 0.0 as equal, and every NaN after positive infinity.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] types The type of each field, in order of significance
+ * @param[in] nfields The number of fields, at most #FASTMAP_MAXKEYFIELDS, or 0 for untyped keys
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setkeyschema(fastmap_attr_t *attr, const fastmap_keytype_t *types, const size_t nfields);
+
+/** Get the types of the fields of the keys of the map
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] types Filled with the type of each field, room for #FASTMAP_MAXKEYFIELDS is enough
+ * @param[out] nfields The number of fields, 0 if keys are untyped
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getkeyschema(fastmap_attr_t *attr, fastmap_keytype_t *types, size_t *nfields);
+
+/** Encode the fields of a typed key into the order preserving bytes stored in the map
+ * @param[in] attr A #fastmap_attr_t with a key schema, as set or returned by #fastmap_inhandle_getattr()
+ * @param[in] fields The native value of each field of the key
+ * @param[out] key A buffer of the key size, receiving the encoded key
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified, or the map has no key schema</li>
+ * </ul>
+ */
+int fastmap_encodekey(const fastmap_attr_t *attr, const fastmap_keyfield_t *fields, void *key);
+
+/** Decode a typed key read from a map into the native values of its fields
+ * @param[in] attr A #fastmap_attr_t with a key schema, as set or returned by #fastmap_inhandle_getattr()
+ * @param[in] key An encoded key
+ * @param[out] fields Receives the native value of each field of the key
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified, or the map has no key schema</li>
+ * </ul>
+ */
+int fastmap_decodekey(const fastmap_attr_t *attr, const void *key, fastmap_keyfield_t *fields);
+
+/** Set how the keys of a #FASTMAP_ATOM map are stored
+ * #FASTMAP_ATOM_ELIASFANO suits large sets of integer keys, as declared by a key schema of a
+ * single field. Keys are split into partitions of 256, each stored as the distances from its
+ * first key in Elias-Fano code, which takes a couple of bits more per key than the entropy of
+ * their gaps. A directory of the first key of each partition takes the place of the search
+ * levels. Keys must be put in ascending order. Lookups are unchanged, and
+ * #fastmap_inhandle_successor() finds the next key in the set.
+ * #FASTMAP_ATOM_ROARING suits dense sets of #FASTMAP_KEY_U32 keys. The key space is split into
+ * chunks of 2^16 keys, and the keys of each chunk are stored as a sorted array of their low
+ * 16 bits, a bitmap or a list of runs, whichever is smallest. A key put twice is stored once:
+ * it counts towards the records set with #fastmap_attr_setrecords() when writing, but the map
+ * written records only the keys it holds, as #fastmap_inhandle_getattr() reports.
+ * Two such sets may be intersected or united with #fastmap_inhandle_combine().
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] encoding The encoding of the keys
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setatomencoding(fastmap_attr_t *attr, const fastmap_atomencoding_t encoding);
+
+/** Get how the keys of a #FASTMAP_ATOM map are stored
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] encoding The encoding of the keys
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getatomencoding(fastmap_attr_t *attr, fastmap_atomencoding_t *encoding);
+
+/** Compress the value pages of a #FASTMAP_BLOB map
+ * Values are gathered into blocks of about 'blocksize' bytes, a value never being split
+ * between blocks, and each block is compressed with a fast LZ77 codec, or stored as it is
+ * when it does not compress. A directory of blocks follows the value pages. Reading a value
+ * decompresses its block into a small cache kept by the #fastmap_inhandle_t, see
+ * #fastmap_inhandle_setcacheblocks(), so a value read is valid until the next lookup, and a
+ * handle of a map with compressed values must not be shared between threads. Larger blocks
+ * compress better, but cost more to decompress on a cache miss. Values stored inline in
+ * the leaf pages are not compressed. A block size of 0 disables compression.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] blocksize The size of a block of values, at most #FASTMAP_MAXVALUEBLOCKSIZE
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setvaluecompression(fastmap_attr_t *attr, const size_t blocksize);
+
+/** Get the size of the blocks of compressed values
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] blocksize The size of a block of values, 0 if values are not compressed
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getvaluecompression(fastmap_attr_t *attr, size_t *blocksize);
+
+/** Build a dictionary for compressed values from sample values
+ * Segments of the samples are scored by how often the 8 byte sequences within them occur
+ * across all samples, and the best scoring segments are kept, skipping those whose sequences
+ * are already covered. The best segments are placed last, nearest the data they precede.
+ * @param[in] samples The sample values
+ * @param[in] sizes The size of each sample value
+ * @param[in] nsamples The number of samples
+ * @param[out] dictionary A buffer receiving the dictionary
+ * @param[in,out] size The size of the buffer, at most #FASTMAP_MAXDICTIONARYSIZE, replaced by the size of the dictionary
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ *   <li>ENOMEM - Out of memory</li>
+ * </ul>
+ */
+int fastmap_traindictionary(const void *samples[], const size_t sizes[], size_t nsamples, void *dictionary, size_t *size);
+
+/** Deduplicate the values of a #FASTMAP_BLOB map
+ * Each value written to the value pages is hashed into a table of 'entries' recently written
+ * values, rounded up to a power of two. A value equal to one in the table is not written
+ * again, its record points at the earlier copy instead. Values are then stored after their
+ * size, so that records may share them. A value is compared with the earlier copy before it
+ * is shared, so a hash collision only costs a copy. The table takes 24 bytes an entry, and a
+ * value displaces any other of the same slot. Values stored inline in the leaf pages are not
+ * deduplicated. A table of 0 entries disables deduplication.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] entries The entries of the table, at most #FASTMAP_MAXDEDUPENTRIES
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setvaluededup(fastmap_attr_t *attr, const size_t entries);
+
+/** Get the entries of the table deduplicating values
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] entries The entries of the table, 0 if values are not deduplicated
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getvaluededup(fastmap_attr_t *attr, size_t *entries);
+
+/** Keep aggregates of the numeric values of a #FASTMAP_BLOCK map
+ * The first bytes of each value hold a number of type 'type' in the byte order of the host,
+ * and the count, sum, least and greatest of these numbers are written for each leaf page into
+ * a section after the values. Above them the section holds levels of aggregates of up to
+ * #FASTMAP_AGGREGATEFANOUT aggregates each, up to one of the whole map, so that
+ * #fastmap_inhandle_aggregate() combines a few aggregates of each level and reads the records
+ * of at most two leaf pages, rather than every record of a range. Only maps whose leaf pages
+ * hold a fixed number of records keep aggregates, not maps with front coding or variable
+ * length keys. A type of 0 keeps no aggregates.
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[in] type The type of the numbers, or 0
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_setvalueaggregate(fastmap_attr_t *attr, const fastmap_keytype_t type);
+
+/** Get the type of the numeric values aggregated
+ * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
+ * @param[out] type The type of the numbers, 0 if values are not aggregated
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li>EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_attr_getvalueaggregate(fastmap_attr_t *attr, fastmap_keytype_t *type);
 
 /** Set the map format
  * @param[in] attr A #fastmap_attr_t returned by #fastmap_attr_init()
@@ -237,6 +831,7 @@ int fastmap_outhandle_init(fastmap_outhandle_t *ohandle, const fastmap_attr_t *a
  * Calling this function before fully writing all expected records to the handle
  * will result in an error, and will discard the underlying fastmap being written.
  * The handle must not be used again after this call, except in a call to #fastmap_outhandle_init()
+ * or #fastmap_outhandle_getdedupstats()
  * @param[in] ohandle A #fastmap_outhandle_t returned by #fastmap_outhandle_init()
  * @return A non-zero error value on failure and 0 on success. Some possible errors are:
  * <ul>
@@ -248,6 +843,36 @@ int fastmap_outhandle_init(fastmap_outhandle_t *ohandle, const fastmap_attr_t *a
  */
 int fastmap_outhandle_destroy(fastmap_outhandle_t *ohandle);
 
+/** Get the counts kept in deduplicating the values of a map
+ * The counts are kept once the handle is closed, so they may be read after #fastmap_outhandle_destroy()
+ * to report on the finished map.
+ * @param[in] ohandle A #fastmap_outhandle_t returned by #fastmap_outhandle_init()
+ * @param[out] stats The counts, all 0 if values are not deduplicated
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_outhandle_getdedupstats(fastmap_outhandle_t *ohandle, fastmap_dedupstats_t *stats);
+
+/** Set a dictionary shared by the blocks of compressed values
+ * Each block is compressed as if the dictionary preceded it, so text common to many values,
+ * such as the field names of structured values, compresses even in small blocks. The
+ * dictionary is copied by the handle, which writes it into the map, and need only remain
+ * valid until this function returns. It must be set before the first record is put, and
+ * only the size of the dictionary is kept in the attributes of the map.
+ * See #fastmap_traindictionary() to build one from samples.
+ * @param[in] ohandle A #fastmap_outhandle_t returned by #fastmap_outhandle_init() with compressed values
+ * @param[in] dictionary The dictionary, or NULL for none
+ * @param[in] size The size of the dictionary, at most #FASTMAP_MAXDICTIONARYSIZE
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, the map does not compress its values or records have been put</li>
+ *   <li> ENOMEM - Out of memory</li>
+ * </ul>
+ */
+int fastmap_outhandle_setdictionary(fastmap_outhandle_t *ohandle, const void *dictionary, const size_t size);
+
 /** Add an record into a fastmap.
  * This function stores key/value records in the map. It is required that keys added
  * by this function be added in sorted order.
@@ -257,6 +882,8 @@ int fastmap_outhandle_destroy(fastmap_outhandle_t *ohandle);
  * <ul>
  *   <li> EINVAL - An invalid parameter was specified</li>
  *   <li> #FASTMAP_TOO_MANY_ELEMENTS - This map already contains the maximum number of records it can hold</li>
+ *   <li> #FASTMAP_VALUES_TOO_LARGE - The value can not be addressed by the value offsets of this map,
+ *                see #fastmap_attr_setvaluebytes()</li>
  * </ul>
  */
 int fastmap_outhandle_put(fastmap_outhandle_t *ohandle, const fastmap_record_t *record);
@@ -281,6 +908,66 @@ int fastmap_outhandle_mput(fastmap_outhandle_t *ohandle, const fastmap_record_t
  */
 int fastmap_inhandle_init(fastmap_inhandle_t *ihandle, const char *pathname);
 
+/** Create a fastmap read handle with a mapping policy.
+ * This function behaves like #fastmap_inhandle_init(), and additionally applies a policy to
+ * the mapping of the map, trading time spent opening the map for lookup latency afterwards.
+ * The advice flags only affect the section they name, a policy may combine several flags.
+ *
+ * With #FASTMAP_MAP_BUFFERPOOL the file is not mapped. Pages are read with pread(2), bypassing
+ * the page cache with O_DIRECT where the file system allows it, into frames of a pool held by
+ * the handle, so that a map much larger than memory costs only the memory of the pool, and a
+ * lookup blocks only in reads it makes itself. The header and search levels, or the directory
+ * of a set of encoded atoms or of compressed values, are read and pinned when the map is
+ * opened. Other frames are evicted in CLOCK order, but never those used by the lookup in
+ * progress, so values found are valid until the next lookup with the same handle, and such a
+ * handle must not be shared between threads. The ADVISE_LEAF_WILLNEED and ADVISE_VALUE_WILLNEED
+ * flags fill the pool with leaf or value pages while opening the map, other flags are ignored,
+ * save #FASTMAP_MAP_LOADRAM which may not be combined with it. A read failing during a lookup
+ * fails the lookup with EIO. See #fastmap_inhandle_setpoolframes().
+ * @param[out] ihandle An allocated #fastmap_inhandle_t to be initialized
+ * @param[in] pathname The fastmap to open
+ * @param[in] flags A bitwise OR of FASTMAP_MAP_* and FASTMAP_ADVISE_* flags, or 0
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ *   <li> ENOMEM, EPERM - The search levels could not be locked into memory</li>
+ * </ul>
+ */
+int fastmap_inhandle_initflags(fastmap_inhandle_t *ihandle, const char *pathname, int flags);
+
+/** Create a fastmap read handle for a map stored inside another file.
+ * The map occupies 'len' bytes of 'fd' starting at 'offset', for instance a member of a bundle
+ * file or a memfd. The header is validated against 'len' before the range is mapped, and lookups
+ * then point straight into the mapping just as with #fastmap_inhandle_init(). The map is mapped
+ * at its section alignment only when 'offset' is a multiple of the system page size.
+ * The descriptor is not closed by #fastmap_inhandle_destroy(), and may be closed by the caller
+ * once this function returns. With #FASTMAP_MAP_BUFFERPOOL the handle reads through a duplicate
+ * of the descriptor, which it closes itself.
+ * @param[out] ihandle An allocated #fastmap_inhandle_t to be initialized
+ * @param[in] fd A readable file descriptor holding the map
+ * @param[in] offset The offset of the map within 'fd'
+ * @param[in] len The length of the map, or 0 to extend to the end of a regular file
+ * @param[in] flags A mapping policy, see #fastmap_inhandle_initflags()
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the range does not hold a valid map</li>
+ * </ul>
+ */
+int fastmap_inhandle_initfd(fastmap_inhandle_t *ihandle, int fd, off_t offset, size_t len, int flags);
+
+/** Create a fastmap read handle for a map already in memory.
+ * No copy of the map is made, lookups return pointers into the caller's buffer, which must
+ * stay valid and unchanged until #fastmap_inhandle_destroy() is called.
+ * @param[out] ihandle An allocated #fastmap_inhandle_t to be initialized
+ * @param[in] addr The address of the map
+ * @param[in] len The length of the map
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the buffer does not hold a valid map</li>
+ * </ul>
+ */
+int fastmap_inhandle_initmem(fastmap_inhandle_t *ihandle, const void *addr, size_t len);
+
 /** Close the underlying fastmap and release any allocated memory in the handle.
  * The handle must not be used again after this call, except in a call to #fastmap_inhandle_init()
  * @params[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
@@ -300,24 +987,400 @@ int fastmap_inhandle_destroy(fastmap_inhandle_t *ihandle);
  * <ul>
  *   <li> EINVAL - An invalid parameter was specified</li>
  *   <li> #FASTMAP_NOT_FOUND - The key was not found in the map</li>
+ *   <li> #FASTMAP_CORRUPT_VALUE - The value lies outside of the map, or the compressed block holding it could not be read into the cache</li>
  * </ul>
  */
 int fastmap_inhandle_get(fastmap_inhandle_t *ihandle, fastmap_record_t *record);
 
+/** Find the smallest key in a set no less than a given key
+ * Only maps of #FASTMAP_ATOM keys stored with an encoding other than #FASTMAP_ATOM_SORTED
+ * support successor queries.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] key The key to search from, encoded as stored in the map
+ * @param[out] successor A buffer of the key size, receiving the key found
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the map does not support successor queries</li>
+ *   <li> #FASTMAP_NOT_FOUND - No key in the map is as large as the key given</li>
+ * </ul>
+ */
+int fastmap_inhandle_successor(fastmap_inhandle_t *ihandle, const void *key, void *successor);
+
+/** Intersect or unite two sets stored with the #FASTMAP_ATOM_ROARING encoding
+ * The containers of each chunk are combined as bitmaps, a word at a time. The result is
+ * written to a new map with the attributes of the first set, or only counted. On failure no
+ * map is left at the path.
+ * @param[in] a A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] b A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] op The operation to apply
+ * @param[in] pathname The path of the map to write the result to, or NULL to only count it
+ * @param[out] nkeys The number of keys in the result, may be NULL
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or either map is not a #FASTMAP_ATOM_ROARING set</li>
+ *   <li> ENOMEM - Out of memory</li>
+ * </ul>
+ */
+int fastmap_inhandle_combine(fastmap_inhandle_t *a, fastmap_inhandle_t *b, fastmap_setop_t op, const char *pathname, size_t *nkeys);
+
+/** Set the number of decompressed value blocks cached by a handle
+ * Only maps with compressed values use the cache, which holds #FASTMAP_DEFAULTCACHEBLOCKS
+ * blocks until set otherwise. The least recently used block is replaced on a miss.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] nblocks The number of blocks to cache, at least 1
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_inhandle_setcacheblocks(fastmap_inhandle_t *ihandle, size_t nblocks);
+
+/** Get the dictionary shared by the blocks of compressed values
+ * The dictionary is stored within the map, and remains valid until the handle is destroyed.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[out] dictionary The dictionary, NULL if there is none
+ * @param[out] size The size of the dictionary
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_inhandle_getdictionary(fastmap_inhandle_t *ihandle, const void **dictionary, size_t *size);
+
+/** Set the number of frames of the buffer pool of a handle
+ * A handle opened with #FASTMAP_MAP_BUFFERPOOL holds #FASTMAP_DEFAULTPOOLFRAMES frames until
+ * set otherwise, each of the page size of the map or of the system, whichever is larger,
+ * besides the frames pinned when the map was opened. Setting the number of frames evicts every
+ * frame which is not pinned. A lookup needing more frames than the pool holds grows the pool.
+ * @param[in] ihandle A #fastmap_inhandle_t opened with #FASTMAP_MAP_BUFFERPOOL
+ * @param[in] nframes The number of frames, at least 1
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the handle has no buffer pool</li>
+ *   <li> ENOMEM - Out of memory</li>
+ * </ul>
+ */
+int fastmap_inhandle_setpoolframes(fastmap_inhandle_t *ihandle, size_t nframes);
+
+/** Get the counts kept by the buffer pool of a handle
+ * @param[in] ihandle A #fastmap_inhandle_t opened with #FASTMAP_MAP_BUFFERPOOL
+ * @param[out] stats The counts
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the handle has no buffer pool</li>
+ * </ul>
+ */
+int fastmap_inhandle_getpoolstats(const fastmap_inhandle_t *ihandle, fastmap_poolstats_t *stats);
+
+/** Start fetching the pages a lookup will need
+ * The search levels, which are read often enough to stay in memory, are searched for the leaf
+ * page which may hold the key, and that page is fetched without waiting for it: read
+ * asynchronously into a buffer pool, advised with MADV_WILLNEED in a mapped file, and its first
+ * cache lines prefetched. The located page is kept in 'token', from which
+ * #fastmap_inhandle_getprefetched() finishes the lookup without searching again, so that a caller
+ * who knows its next keys ahead of time can overlap their fetching with its own work. Values
+ * stored apart from the leaf pages are only known once the leaf page is searched, and are not
+ * fetched. For a set of encoded atoms the partition of the key is fetched, and the lookup is
+ * made again in full.
+ * @param[in] ihandle A #fastmap_inhandle_t
+ * @param[in] record The record whose key will be looked up
+ * @param[out] token The located leaf page
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_inhandle_prefetch(fastmap_inhandle_t *ihandle, const fastmap_record_t *record, fastmap_prefetch_t *token);
+
+/** Finish a lookup started by #fastmap_inhandle_prefetch()
+ * This function behaves like #fastmap_inhandle_get(), searching only the leaf page found by
+ * #fastmap_inhandle_prefetch() for the same key with the same handle.
+ * @param[in] ihandle A #fastmap_inhandle_t
+ * @param[in,out] record The record to look up
+ * @param[in] token The token filled by #fastmap_inhandle_prefetch()
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_NOT_FOUND - The key was not found in the map</li>
+ *   <li> EINVAL - An invalid parameter was specified, or the token names no leaf page of the map</li>
+ * </ul>
+ */
+int fastmap_inhandle_getprefetched(fastmap_inhandle_t *ihandle, fastmap_record_t *record, const fastmap_prefetch_t *token);
+
+/** Initialize a lookup context for keys looked up in roughly ascending order
+ * A finger remembers the leaf page of its last lookup. The next lookup searches that page again
+ * when the key still falls within it, and otherwise gallops forward over the separators of the
+ * lowest search level, so that a sorted or nearly sorted stream of keys costs little more than a
+ * scan of the leaf pages. Only a key before the page, or when the search levels are slotted a
+ * key past the search page after the one leading to it, is searched for down from the root. The
+ * finger holds no resources, and is valid for as long as the handle is.
+ * @param[out] finger The #fastmap_finger_t to initialize
+ * @param[in] ihandle A #fastmap_inhandle_t
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_finger_init(fastmap_finger_t *finger, fastmap_inhandle_t *ihandle);
+
+/** Look a record up through a finger
+ * This function behaves like #fastmap_inhandle_get() on the handle of the finger, starting its
+ * search from the leaf page of the last lookup made through the finger. A set of encoded atoms
+ * keeps no leaf pages, and is looked up from the root.
+ * @param[in,out] finger A #fastmap_finger_t
+ * @param[in,out] record The record to look up
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_NOT_FOUND - The key was not found in the map</li>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_finger_get(fastmap_finger_t *finger, fastmap_record_t *record);
+
+/** Look a record up without blocking
+ * The lookup is made at once if every page it needs is in the buffer pool of the handle, and
+ * returns just as #fastmap_inhandle_get() would. Otherwise the reads of the missing pages are
+ * started with POSIX asynchronous I/O, and the lookup is completed later by
+ * #fastmap_inhandle_complete(), which may take several rounds of reads as a lookup finds the
+ * pages it needs one after another. The record and its key must stay valid until then.
+ * @param[in] ihandle A #fastmap_inhandle_t opened with #FASTMAP_MAP_BUFFERPOOL
+ * @param[in,out] record The record to look up
+ * @param[in] cookie A pointer handed back with the completion of the lookup
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_PENDING - The lookup waits on reads, and will be completed by #fastmap_inhandle_complete()</li>
+ *   <li> #FASTMAP_NOT_FOUND - The key was not found in the map</li>
+ *   <li> EINVAL - An invalid parameter was specified, or the handle has no buffer pool</li>
+ *   <li> ENOMEM, EAGAIN - A read could not be started</li>
+ * </ul>
+ */
+int fastmap_inhandle_submit(fastmap_inhandle_t *ihandle, fastmap_record_t *record, void *cookie);
+
+/** Complete lookups submitted to a handle whose reads have finished
+ * Values of the completed records point into the buffer pool, and are valid until the next
+ * lookup with the same handle, by this function or any other. The frames of every lookup
+ * completed in one call stay resident together, so a pool smaller than 'ncompletions' lookups
+ * need grows to hold them.
+ * @param[in] ihandle A #fastmap_inhandle_t opened with #FASTMAP_MAP_BUFFERPOOL
+ * @param[out] completions The completed lookups
+ * @param[in] ncompletions The most lookups to complete
+ * @param[out] ncompleted The number of lookups completed
+ * @param[in] wait If non-zero, block until at least one lookup completes, unless none is pending
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the handle has no buffer pool</li>
+ * </ul>
+ */
+int fastmap_inhandle_complete(fastmap_inhandle_t *ihandle, fastmap_completion_t *completions, size_t ncompletions, size_t *ncompleted, int wait);
+
+/** Set the number of threads which look up a batch of records in #fastmap_inhandle_mget()
+ * A handle looks batches up on the calling thread alone until set otherwise. A batch is split
+ * among at most 'nthreads' threads, the calling one included, each given at least
+ * #FASTMAP_MGETPARTITION records. A handle with a buffer pool, or a map with compressed values,
+ * keeps state which its lookups change, and still looks batches up on the calling thread alone.
+ * Their values are kept in the value cache or the pool, which must be large enough to hold the
+ * values of a whole batch for them to stay valid until it returns.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] nthreads The number of threads, at least 1
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_inhandle_setthreads(fastmap_inhandle_t *ihandle, size_t nthreads);
+
 /** Locate multiple records at once from a fastmap.
  * This function behaved just like calling #fastmap_inhandle_get() multiple times.
  * Rathen than treating a missing key as an error, any input keys that were not 
- * found will be set to NULL.
+ * found will be set to NULL. Entries of 'records' which are NULL are skipped.
+ * The batch is split among the threads set by #fastmap_inhandle_setthreads(), and each record
+ * is filled in place, so the results keep the order of the input. A batch sorted by key is
+ * split into runs of keys which fall on different leaf pages, and each run is looked up
+ * through a #fastmap_finger_t.
  * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
  * @param[in,out] records An array of #fastmap_record_t object used in the search and result
  * @param[in] nrecords The size of the 'records' array
  * @return A non-zero error value on failure and 0 on success. Some possible errors are:
  * <ul>
  *  <li> EINVAL - An invalid parameter was specified</li>
+ *  <li> ENOMEM - Out of memory</li>
  * </ul>
  */
 int fastmap_inhandle_mget(fastmap_inhandle_t *ihandle, fastmap_record_t *records[], size_t nrecords);
 
+/** Find the position of a key among the keys of a fastmap
+ * The rank of a key is the number of keys of the map less than it, which is the index of its
+ * record when the map holds it, and the index its record would have otherwise. The search
+ * levels are searched as by #fastmap_inhandle_get(), and the leaf page found is searched for
+ * the position of the key within it.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] record The record whose key is ranked
+ * @param[out] rank The number of keys less than that of 'record'
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_NOT_FOUND - The key is not in the map, 'rank' is set all the same</li>
+ *   <li> #FASTMAP_CORRUPT_PAGE - The leaf page of the key could not be read</li>
+ *   <li> EINVAL - An invalid parameter was specified, or the map is a set of encoded atoms</li>
+ * </ul>
+ */
+int fastmap_inhandle_rank(fastmap_inhandle_t *ihandle, const fastmap_record_t *record, size_t *rank);
+
+/** Get the record at a position of a fastmap
+ * Record 'index' of a map whose leaf pages hold a fixed number of records is found from 'index'
+ * alone. Leaf pages which hold a varying number of records, those of front-coded maps and of
+ * maps with variable length keys, are bisected for the page holding it. The key and value of
+ * 'record' are pointed at those of the map, except for front-coded maps, whose key is decoded
+ * into the buffer the key of 'record' already points to, of #fastmap_attr_setksize() bytes.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] index The index of the record, from 0 for the record with the least key
+ * @param[out] record The record at 'index'
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_NOT_FOUND - 'index' is no less than the number of records of the map</li>
+ *   <li> #FASTMAP_CORRUPT_PAGE - The leaf page of the record could not be read</li>
+ *   <li> EINVAL - An invalid parameter was specified, or the map is a set of encoded atoms</li>
+ * </ul>
+ */
+int fastmap_inhandle_select(fastmap_inhandle_t *ihandle, size_t index, fastmap_record_t *record);
+
+/** Aggregate the numeric values of a key range of a fastmap
+ * The records whose keys are no less than that of 'first' and less than that of 'last' are
+ * ranked as by #fastmap_inhandle_rank(). The aggregates written for the leaf pages wholly
+ * within the range, and for the runs of #FASTMAP_AGGREGATEFANOUT such pages above them, are
+ * combined with the values of the records of the partly covered pages at either end.
+ * @param[in] ihandle A #fastmap_inhandle_t of a map written with #fastmap_attr_setvalueaggregate()
+ * @param[in] first The record whose key starts the range, or NULL to start with the first record
+ * @param[in] last The record whose key ends the range, or NULL to end after the last record
+ * @param[out] aggregate The aggregates of the values of the range
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_CORRUPT_PAGE - The aggregates of the map could not be read</li>
+ *   <li> EINVAL - An invalid parameter was specified, or the map keeps no aggregates</li>
+ * </ul>
+ */
+int fastmap_inhandle_aggregate(fastmap_inhandle_t *ihandle, const fastmap_record_t *first, const fastmap_record_t *last, fastmap_aggregate_t *aggregate);
+
+/** Estimate a quantile of the keys of a fastmap from its search levels
+ * The lowest search level holds the first key of every leaf page but the first, whose number
+ * of records is known, so that the key of the leaf page starting nearest to record 'q' times
+ * the number of records is found by reading a single search page, or a few page headers for
+ * maps with truncated separators or variable length keys. Its rank is exact to within half a
+ * leaf page for maps whose leaf pages hold a fixed number of records, and estimated as if the
+ * records were spread evenly over the leaf pages otherwise. The key is copied into the buffer
+ * the key of 'record' points to, of #fastmap_attr_setksize() bytes, and is the separator kept
+ * in the search level, which for truncated separators is a prefix of the key padded with zero
+ * bytes, or for variable length keys a prefix whose size is set in 'record'. The quantile
+ * nearest the first record is the first key of the map, read from the first leaf page.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] q The quantile, from 0 to 1
+ * @param[in,out] record The record whose key buffer receives the key
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_NOT_FOUND - The map holds no records</li>
+ *   <li> #FASTMAP_CORRUPT_PAGE - The search level could not be read</li>
+ *   <li> EINVAL - An invalid parameter was specified, or the map is a set of encoded atoms</li>
+ * </ul>
+ */
+int fastmap_inhandle_quantile(fastmap_inhandle_t *ihandle, double q, fastmap_record_t *record);
+
+/** Estimate the keys splitting a fastmap into ranges of about as many records each
+ * The keys are found as by #fastmap_inhandle_quantile() for each quantile i / 'nranges', and
+ * are repeated where the map has fewer leaf pages than ranges.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in,out] boundaries 'nranges' - 1 records whose key buffers receive the keys, in order
+ * @param[in] nranges The number of ranges
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_NOT_FOUND - The map holds no records</li>
+ *   <li> #FASTMAP_CORRUPT_PAGE - The search level could not be read</li>
+ *   <li> EINVAL - An invalid parameter was specified, or the map is a set of encoded atoms</li>
+ * </ul>
+ */
+int fastmap_inhandle_boundaries(fastmap_inhandle_t *ihandle, fastmap_record_t *boundaries, size_t nranges);
+
+/** Estimate the number of records of a key range of a fastmap from its search levels
+ * Each end of the range is searched for through the search levels only, as by a lookup which
+ * stops short of the leaf page, and is taken to lie in the middle of the leaf page found. For
+ * maps whose leaf pages hold a fixed number of records the estimate is off by no more than the
+ * records of a leaf page, otherwise the records are taken to be spread evenly over the pages.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] first The record whose key starts the range, or NULL to start with the first record
+ * @param[in] last The record whose key ends the range, or NULL to end after the last record
+ * @param[out] count The estimated number of records whose keys are no less than that of 'first'
+ *                   and less than that of 'last'
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the map is a set of encoded atoms</li>
+ * </ul>
+ */
+int fastmap_inhandle_estimate(fastmap_inhandle_t *ihandle, const fastmap_record_t *first, const fastmap_record_t *last, size_t *count);
+
+/** Initialize a cursor over a run of the records of a fastmap
+ * The cursor reads the records from index 'first' up to, but not including, index 'last' in
+ * order of their keys. Leaf pages holding a varying number of records are read on from the
+ * record before, rather than searched for each record. A cursor holds no resources, and is
+ * valid for as long as the handle is.
+ * @param[out] cursor The #fastmap_cursor_t to initialize
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] first The index of the first record
+ * @param[in] last The index after the last record, indexes past the last record of the map are taken to be its end
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the map is a set of encoded atoms</li>
+ * </ul>
+ */
+int fastmap_cursor_init(fastmap_cursor_t *cursor, fastmap_inhandle_t *ihandle, size_t first, size_t last);
+
+/** Read the next record of a cursor
+ * The record is filled as by #fastmap_inhandle_select(), except that the key of a front-coded
+ * map is decoded into the cursor, and stays valid until the next record is read.
+ * @param[in,out] cursor A #fastmap_cursor_t
+ * @param[out] record The next record
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> #FASTMAP_NOT_FOUND - The cursor has no records left</li>
+ *   <li> #FASTMAP_CORRUPT_PAGE - The leaf page of the record could not be read</li>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_cursor_next(fastmap_cursor_t *cursor, fastmap_record_t *record);
+
+/** Split a key range of a fastmap into partitions of about as many records each
+ * The records whose keys are no less than that of 'first' and less than that of 'last' are
+ * split evenly into 'ncursors' runs by their ranks, and each split is moved back to the start
+ * of its leaf page unless that leaves the partition before it empty, so that neighbouring
+ * partitions share at most a leaf page. Each cursor may be read on a thread of its own when the
+ * handle allows lookups on several threads, see #fastmap_inhandle_setthreads().
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] first The record whose key starts the range, or NULL to start with the first record
+ * @param[in] last The record whose key ends the range, or NULL to end after the last record
+ * @param[out] cursors The cursors of the partitions, in order of their keys
+ * @param[in] ncursors The number of partitions
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the map is a set of encoded atoms</li>
+ * </ul>
+ */
+int fastmap_inhandle_partition(fastmap_inhandle_t *ihandle, const fastmap_record_t *first, const fastmap_record_t *last, fastmap_cursor_t *cursors, size_t ncursors);
+
+/** Run a callback over the partitions of a key range of a fastmap
+ * The range is split as by #fastmap_inhandle_partition(), and 'func' is run once for the cursor
+ * of each partition, along with its number and 'arg'. The partitions are taken in turn by the
+ * threads set by #fastmap_inhandle_setthreads(), the calling one included, and a handle which
+ * keeps its lookups to the calling thread runs them all on it.
+ * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
+ * @param[in] first The record whose key starts the range, or NULL to start with the first record
+ * @param[in] last The record whose key ends the range, or NULL to end after the last record
+ * @param[in] npartitions The number of partitions
+ * @param[in] func The callback, whose non-zero result is returned for the first partition failing
+ * @param[in] arg An argument passed to 'func'
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the map is a set of encoded atoms</li>
+ *   <li> ENOMEM - Out of memory</li>
+ * </ul>
+ */
+int fastmap_inhandle_scan(fastmap_inhandle_t *ihandle, const fastmap_record_t *first, const fastmap_record_t *last, size_t npartitions, fastmap_scanfunc func, void *arg);
+
 /** Get the attributes of the fastmap
  * @param[in] ihandle A #fastmap_inhandle_t returned by #fastmap_inhandle_init()
  * @param[out] attr A #fastmap_attr_t to be configured with the current attr
@@ -341,4 +1404,71 @@ int fastmap_inhandle_getattr(fastmap_inhandle_t *ihandle, fastmap_attr_t *attr);
  */
 int fastmap_inhandle_setcmpfunc(fastmap_inhandle_t *ihandle, fastmap_cmpfunc cmp);
 
+/** Pack several fastmaps into a single container file.
+ * Each map is copied to an offset aligned to a system page, or to its section alignment if
+ * larger, and a directory sorted by name is written at the front of the container.
+ * @param[in] pathname The container to create
+ * @param[in] names The names under which the maps are stored, each shorter than #FASTMAP_CONTAINER_NAMELEN
+ * @param[in] pathnames The fastmaps to pack
+ * @param[in] nmaps The size of the 'names' and 'pathnames' arrays
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, a name is too long or repeated, or an input is not a valid map</li>
+ * </ul>
+ */
+int fastmap_container_create(const char *pathname, const char *names[], const char *pathnames[], size_t nmaps);
+
+/** Open a container file.
+ * The whole container is mapped once, maps inside it are then opened with #fastmap_container_get().
+ * To release the mapping, call #fastmap_container_destroy().
+ * @param[out] container An allocated #fastmap_container_t to be initialized
+ * @param[in] pathname The container to open
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified, or the file is not a valid container</li>
+ * </ul>
+ */
+int fastmap_container_init(fastmap_container_t *container, const char *pathname);
+
+/** Close a container file.
+ * Any #fastmap_inhandle_t opened from the container must be destroyed first.
+ * @param[in] container A #fastmap_container_t returned by #fastmap_container_init()
+ * @return A non-zero error value on failure and 0 on success
+ */
+int fastmap_container_destroy(fastmap_container_t *container);
+
+/** Open a map stored in a container.
+ * The read handle references a sub-range of the container's mapping, it opens no file
+ * and maps no memory of its own. It must be destroyed with #fastmap_inhandle_destroy()
+ * before the container is destroyed.
+ * @param[in] container A #fastmap_container_t returned by #fastmap_container_init()
+ * @param[in] name The name of the map
+ * @param[out] ihandle An allocated #fastmap_inhandle_t to be initialized
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ *   <li> #FASTMAP_NOT_FOUND - No map by that name is in the container</li>
+ * </ul>
+ */
+int fastmap_container_get(fastmap_container_t *container, const char *name, fastmap_inhandle_t *ihandle);
+
+/** Get the number of maps in a container
+ * @param[in] container A #fastmap_container_t returned by #fastmap_container_init()
+ * @param[out] nmaps The number of maps
+ * @return A non-zero error value on failure and 0 on success
+ */
+int fastmap_container_getcount(fastmap_container_t *container, size_t *nmaps);
+
+/** Get the name of a map in a container
+ * Names are returned in sorted order.
+ * @param[in] container A #fastmap_container_t returned by #fastmap_container_init()
+ * @param[in] index The index of the map, less than the count from #fastmap_container_getcount()
+ * @param[out] name The name of the map, valid until the container is destroyed
+ * @return A non-zero error value on failure and 0 on success. Some possible errors are:
+ * <ul>
+ *   <li> EINVAL - An invalid parameter was specified</li>
+ * </ul>
+ */
+int fastmap_container_getname(fastmap_container_t *container, size_t index, const char **name);
+
 #endif /* ! FASTMAP_H */
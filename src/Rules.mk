@@ -9,10 +9,14 @@ src_libfastmap_la_LDFLAGS = -avoid-version -lm
 
 bin_PROGRAMS += \
 	src/dumpfastmap \
+	src/packfastmap \
 	src/tofastmap
 
 src_dumpfastmap_SOURCES = src/dumpfastmap.c
 src_dumpfastmap_LDADD = src/libfastmap.la
 
+src_packfastmap_SOURCES = src/packfastmap.c
+src_packfastmap_LDADD = src/libfastmap.la
+
 src_tofastmap_SOURCES = src/tofastmap.c
 src_tofastmap_LDADD = src/libfastmap.la
@@ -2,6 +2,7 @@
 #include <fastmap_config.h>
 #endif
 
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
@@ -22,7 +23,10 @@ static void usage(FILE *out)
 	fprintf(out, "\n");
 	fprintf(out, "Mandatory arguments to long options are mandatory for short options too.\n");
 	fprintf(out, "\n");
-	fprintf(out, "  --help    display this help message\n");
+	fprintf(out, "  -Q, --quantiles=RANGES  write the keys splitting INPUT into RANGES ranges of\n");
+	fprintf(out, "                          about as many records, estimated from its search\n");
+	fprintf(out, "                          levels, rather than describing INPUT\n");
+	fprintf(out, "      --help              display this help message\n");
 	fprintf(out, "\n");
 	fprintf(out, "When INPUT is -, read standard input.\n");
 	fprintf(out, "Report bugs to " PACKAGE_BUGREPORT "\n");
@@ -31,27 +35,140 @@ static void usage(FILE *out)
 
 static int help;
 
+/* The size of the key of a record, which varies only with variable length keys */
+static size_t keysize(const fastmap_attr_t *attr, const fastmap_record_t *record)
+{
+	if (!attr->variablekeys)
+		return attr->ksize;
+
+	switch (attr->format)
+	{
+		case FASTMAP_PAIR:
+			return record->pair.ksize;
+		case FASTMAP_BLOCK:
+			return record->block.ksize;
+		case FASTMAP_BLOB:
+			return record->blob.ksize;
+		default:
+			return record->atom.ksize;
+	}
+}
+
+/* Write a key as its ':' separated fields when it has a key schema, otherwise as its printable bytes */
+static void putkey(const fastmap_attr_t *attr, const fastmap_record_t *record)
+{
+	fastmap_keyfield_t fields[FASTMAP_MAXKEYFIELDS];
+	const unsigned char *key = record->atom.key;
+	size_t i;
+
+	putchar('"');
+	if (attr->keyfields > 0 && fastmap_decodekey(attr, key, fields) == FASTMAP_OK)
+	{
+		for (i = 0; i < attr->keyfields; i++)
+		{
+			if (i > 0)
+				putchar(':');
+			switch (attr->keyschema[i])
+			{
+				case FASTMAP_KEY_I64:
+					fprintf(stdout, "%lld", (long long)fields[i].i64);
+					break;
+				case FASTMAP_KEY_F64:
+					fprintf(stdout, "%g", fields[i].f64);
+					break;
+				default:
+					fprintf(stdout, "%llu", (unsigned long long)fields[i].u64);
+					break;
+			}
+		}
+	}
+	else
+	{
+		for (i = 0; i < keysize(attr, record); i++)
+			putchar(isprint(key[i]) ? key[i] : '.');
+	}
+	putchar('"');
+}
+
+/* Write the keys splitting a map into 'nranges' ranges, and the records estimated to lie in each */
+static int dumpquantiles(fastmap_inhandle_t *ihandle, const fastmap_attr_t *attr, size_t nranges)
+{
+	fastmap_record_t *boundaries;
+	unsigned char *keys;
+	size_t i, count;
+	int rc;
+
+	boundaries = calloc(nranges, sizeof(*boundaries));
+	keys = calloc(nranges, attr->ksize);
+	if (boundaries == NULL || keys == NULL)
+	{
+		rc = ENOMEM;
+		goto fail;
+	}
+	for (i = 0; i < nranges; i++)
+		boundaries[i].atom.key = keys + (i * attr->ksize);
+
+	if ((rc = fastmap_inhandle_boundaries(ihandle, boundaries, nranges)) != FASTMAP_OK)
+		goto fail;
+
+	puts("{ \"quantiles\":");
+	puts("  [");
+	for (i = 0; i < nranges; i++)
+	{
+		if ((rc = fastmap_inhandle_estimate(ihandle, i > 0 ? &boundaries[i - 1] : NULL, i + 1 < nranges ? &boundaries[i] : NULL, &count)) != FASTMAP_OK)
+			goto fail;
+		fprintf(stdout, "    { \"range\": %zu, \"first\": ", i);
+		if (i > 0)
+			putkey(attr, &boundaries[i - 1]);
+		else
+			fputs("null", stdout);
+		fputs(", \"last\": ", stdout);
+		if (i + 1 < nranges)
+			putkey(attr, &boundaries[i]);
+		else
+			fputs("null", stdout);
+		fprintf(stdout, ", \"records\": %zu }%s\n", count, i + 1 < nranges ? "," : "");
+	}
+	puts("  ]");
+	puts("}");
+
+fail:
+	free(keys);
+	free(boundaries);
+	return rc;
+}
+
 int main(int argc, char *argv[])
 {
 	fastmap_attr_t attr;
 	fastmap_inhandle_t ihandle;
-	size_t currentoffset, currentpage, currentkey, offset;
+	size_t currentoffset, currentpage, currentkey, offset, quantiles = 0;
 	int opt, i;
 	char *pathname;
 
 	while (1)
 	{
 		static struct option longopts[] = {
+			{ "quantiles", required_argument, NULL, 'Q' },
 			{ "help", no_argument, &help, 1},
 			{ 0, 0, 0, 0}
 		};
 
 		int option_index;
-		if ((opt = getopt_long(argc, argv, "", longopts, &option_index)) == -1)
+		if ((opt = getopt_long(argc, argv, "Q:", longopts, &option_index)) == -1)
 			break;
 
 		switch (opt)
 		{
+			case 'Q':
+				quantiles = (size_t)(atol(optarg));
+				if (quantiles == 0)
+				{
+					fprintf(stderr, "dumpfastmap: invalid number of ranges '%s'\n", optarg);
+					fprintf(stderr, "Try 'dumpfastmap --help' for more information.\n");
+					exit(EXIT_FAILURE);
+				}
+				break;
 			default:
 				break;
 		}
@@ -74,11 +191,23 @@ int main(int argc, char *argv[])
 	fastmap_inhandle_init(&ihandle, pathname);
 	fastmap_inhandle_getattr(&ihandle, &attr);
 
+	if (quantiles > 0)
+	{
+		if (dumpquantiles(&ihandle, &attr, quantiles) != FASTMAP_OK)
+		{
+			fprintf(stderr, "dumpfastmap: cannot estimate the quantiles of '%s'\n", pathname);
+			exit(EXIT_FAILURE);
+		}
+		fastmap_inhandle_destroy(&ihandle);
+		exit(EXIT_SUCCESS);
+	}
+
 	puts("{ \"fastmap\":");
 	puts("  { \"handle\":");
 	puts("     {");
 	fprintf(stdout, "      \"numlevels\": %zu,\n", ihandle.handle.numlevels);
 	fprintf(stdout, "      \"pagesize\": %u,\n", ihandle.handle.pagesize);
+	fprintf(stdout, "      \"sectionalign\": %zu,\n", ihandle.handle.attr.sectionalign);
 	puts("      \"attr\":");
 	puts("        {");
 	fprintf(stdout, "        \"records\": %zu,\n", ihandle.handle.attr.records);
@@ -102,12 +231,51 @@ int main(int argc, char *argv[])
 				puts("        \"format\": \"block\",");
 			break;
 		case FASTMAP_BLOB:
-			puts("        \"format\": \"blob\",");
+			if (ihandle.handle.flags & 0x04)
+				puts("        \"format\": \"blob (inline)\",");
+			else
+				puts("        \"format\": \"blob\",");
 			break;
 		default:
 			puts("        \"format\": null,");
 			break;
 	}
+	if (ihandle.handle.attr.format == FASTMAP_BLOB)
+		fprintf(stdout, "        \"inlinevsize\": %zu,\n", ihandle.handle.attr.inlinevsize);
+	if (ihandle.handle.flags & 0x08)
+		fprintf(stdout, "        \"restartinterval\": %zu,\n", ihandle.handle.attr.restartinterval);
+	if (ihandle.handle.flags & 0x10)
+		puts("        \"variablekeys\": true,");
+	if (ihandle.handle.flags & 0x20)
+		puts("        \"truncateseparators\": true,");
+	if (ihandle.handle.flags & 0x40)
+		puts("        \"integerkeys\": true,");
+	if (ihandle.handle.flags & 0x80)
+		puts("        \"atomencoding\": \"eliasfano\",");
+	if (ihandle.handle.flags & 0x100)
+		puts("        \"atomencoding\": \"roaring\",");
+	if (ihandle.handle.flags & 0x200)
+	{
+		fprintf(stdout, "        \"valueblocksize\": %zu,\n", ihandle.handle.attr.valueblocksize);
+		fprintf(stdout, "        \"dictionarysize\": %zu,\n", ihandle.handle.attr.dictionarysize);
+	}
+	if (ihandle.handle.flags & 0x400)
+		puts("        \"sharedvalues\": true,");
+	if ((ihandle.handle.flags & 0x800) && ihandle.handle.attr.valueaggregate <= FASTMAP_KEY_F64)
+	{
+		const char *keytypes[] = { "bytes", "u32", "u64", "i64", "f64" };
+
+		fprintf(stdout, "        \"valueaggregate\": \"%s\",\n", keytypes[ihandle.handle.attr.valueaggregate]);
+	}
+	if (ihandle.handle.attr.keyfields > 0 && ihandle.handle.attr.keyfields <= FASTMAP_MAXKEYFIELDS)
+	{
+		const char *keytypes[] = { "bytes", "u32", "u64", "i64", "f64" };
+
+		fputs("        \"keyschema\": [", stdout);
+		for (i = 0; i < (int)ihandle.handle.attr.keyfields; i++)
+			fprintf(stdout, "%s\"%s\"", i ? ", " : "", keytypes[ihandle.handle.attr.keyschema[i] <= FASTMAP_KEY_F64 ? ihandle.handle.attr.keyschema[i] : 0]);
+		puts("],");
+	}
 	puts("        },");
 	fprintf(stdout, "      \"keyspersearchpage\": %zu,\n", ihandle.handle.keyspersearchpage);
 	fprintf(stdout, "      \"leafpages\": %zu,\n", ihandle.handle.leafpages);
@@ -116,6 +284,13 @@ int main(int argc, char *argv[])
 	fprintf(stdout, "      \"firstleafpageoffset\": %zu (%zu),\n", ihandle.handle.firstleafpageoffset, ihandle.handle.firstleafpageoffset / ihandle.handle.pagesize);
 	fprintf(stdout, "      \"valueptrsize\": %zu,\n", ihandle.handle.valueptrsize);
 	fprintf(stdout, "      \"firstvalueoffset\": %zu (%zu),\n", ihandle.handle.firstvalueoffset, ihandle.handle.firstvalueoffset / ihandle.handle.pagesize);
+	if (ihandle.handle.flags & 0x200)
+	{
+		fprintf(stdout, "      \"valueblocks\": %zu,\n", ihandle.handle.valueblocks);
+		fprintf(stdout, "      \"valueblockoffset\": %zu,\n", ihandle.handle.valueblockoffset);
+	}
+	if (ihandle.handle.flags & 0x800)
+		fprintf(stdout, "      \"aggregateoffset\": %zu (%zu),\n", ihandle.handle.aggregateoffset, ihandle.handle.aggregateoffset / ihandle.handle.pagesize);
 	puts("      \"perlevel\": [");
 	for (i = ihandle.handle.numlevels; i > 0; i--)
 	{
@@ -131,6 +306,20 @@ int main(int argc, char *argv[])
 		fprintf(stdout, "      [%d, %d]: [\n", i, currentoffset);
 		for (currentpage = 0; currentpage < ihandle.handle.perlevel[i - 1].pages; currentpage++)
 		{
+			if (ihandle.handle.flags & 0x20)
+			{
+				/* slotted search pages start with the index of their first key and their key count */
+				uint64_t firstkey;
+				uint32_t keys;
+
+				memcpy(&firstkey, (char*)ihandle.mmapaddr + currentoffset, sizeof(firstkey));
+				memcpy(&keys, (char*)ihandle.mmapaddr + currentoffset + 8, sizeof(keys));
+				fprintf(stdout, "          { [%zu, %zu]: {\"firstkey\": %llu, \"keys\": %u} },\n",
+					currentpage, currentoffset, (unsigned long long)firstkey, keys);
+				currentoffset += ihandle.handle.pagesize;
+				continue;
+			}
+
 			offset = currentoffset;
 			fprintf(stdout, "          { [%zu, %zu]: [\n", currentpage, currentoffset);
 			for (currentkey = 0; currentkey < ihandle.handle.keyspersearchpage; currentkey++)
@@ -161,6 +350,51 @@ int main(int argc, char *argv[])
 	currentoffset = ihandle.handle.firstleafpageoffset;
 	for (currentpage = 0; currentpage < ihandle.handle.leafpages; currentpage++)
 	{
+		if (ihandle.handle.flags & 0x180)
+		{
+			/* encoded atoms have a directory of partitions, each with its first key as a big-endian integer and the offset of its code */
+			unsigned char firstkey[8];
+			uint64_t partitionoffset, key = 0;
+
+			memcpy(firstkey, (char*)ihandle.mmapaddr + currentoffset, sizeof(firstkey));
+			memcpy(&partitionoffset, (char*)ihandle.mmapaddr + currentoffset + 8, sizeof(partitionoffset));
+			for (currentkey = 0; currentkey < sizeof(firstkey); currentkey++)
+				key = (key << 8) | firstkey[currentkey];
+			if (ihandle.handle.flags & 0x100)
+			{
+				/* roaring containers start with their cardinality and type */
+				const char *types[] = { "unknown", "array", "bitmap", "runs" };
+				uint32_t cardinality;
+				uint16_t type;
+
+				memcpy(&cardinality, (char*)ihandle.mmapaddr + ihandle.handle.firstvalueoffset + partitionoffset, sizeof(cardinality));
+				memcpy(&type, (char*)ihandle.mmapaddr + ihandle.handle.firstvalueoffset + partitionoffset + 4, sizeof(type));
+				fprintf(stdout, "      { [%zu, %zu]: {\"firstkey\": %llu, \"offset\": %llu, \"type\": \"%s\", \"cardinality\": %u} },\n",
+					currentpage, currentoffset, (unsigned long long)key, (unsigned long long)partitionoffset, types[type <= 3 ? type : 0], cardinality);
+				currentoffset += ihandle.handle.leafpagerecordsize;
+				continue;
+			}
+			fprintf(stdout, "      { [%zu, %zu]: {\"firstkey\": %llu, \"offset\": %llu} },\n",
+				currentpage, currentoffset, (unsigned long long)key, (unsigned long long)partitionoffset);
+			currentoffset += ihandle.handle.leafpagerecordsize;
+			continue;
+		}
+
+		if (ihandle.handle.flags & 0x18)
+		{
+			/* front-coded pages and pages of variable length keys start with their first record number, entry and restart point counts */
+			uint64_t firstrecord;
+			uint32_t entries, restarts;
+
+			memcpy(&firstrecord, (char*)ihandle.mmapaddr + currentoffset, sizeof(firstrecord));
+			memcpy(&entries, (char*)ihandle.mmapaddr + currentoffset + 8, sizeof(entries));
+			memcpy(&restarts, (char*)ihandle.mmapaddr + currentoffset + 12, sizeof(restarts));
+			fprintf(stdout, "      { [%zu, %zu]: {\"firstrecord\": %llu, \"entries\": %u, \"restarts\": %u} },\n",
+				currentpage, currentoffset, (unsigned long long)firstrecord, entries, restarts);
+			currentoffset += ihandle.handle.pagesize;
+			continue;
+		}
+
 		offset = currentoffset;
 		fprintf(stdout, "      { [%zu, %zu]: [\n", currentpage, currentoffset);
 		for (currentkey = 0; currentkey < ihandle.handle.recordsperleafpage; currentkey++)
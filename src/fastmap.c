@@ -2,9 +2,13 @@
 #include <fastmap_config.h>
 #endif
 
+#include <aio.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -13,12 +17,200 @@
 
 #include <fastmap.h>
 
-#define ALIGN_TO_PAGE_OFFSET(v,p) ((v + (p - 1)) & ~(p - 1))
+#define ALIGN_TO_PAGE_OFFSET(v,p) (((v) + ((size_t)(p) - 1)) & ~((size_t)(p) - 1))
+
+#define FASTMAP_MAGIC	0x464D4150	/* "FMAP" */
+#define FASTMAP_VERSION	1
 
 #define FASTMAP_INVALID_MAP	0x01
 #define FASTMAP_INLINE_BLOCK	0x02
+#define FASTMAP_INLINE_BLOB	0x04
+#define FASTMAP_FRONT_CODED	0x08
+#define FASTMAP_VARIABLE_KEYS	0x10
+#define FASTMAP_TRUNCATED_SEPARATORS	0x20	/* slotted search pages holding the shortest separator of each leaf page */
+#define FASTMAP_INTEGER_KEYS	0x40	/* keys of a single typed field, which compare as big-endian unsigned integers */
+#define FASTMAP_ELIAS_FANO	0x80	/* atoms in Elias-Fano coded partitions instead of leaf pages */
+#define FASTMAP_ROARING	0x100	/* 32 bit atoms in containers of a chunk of the key space each */
+#define FASTMAP_COMPRESSED_VALUES	0x200	/* values in LZ compressed blocks, located by a directory after the blocks */
+#define FASTMAP_SHARED_VALUES	0x400	/* values stored after their size, which records may share */
+#define FASTMAP_AGGREGATES	0x800	/* aggregates of numeric values per leaf page and per run of pages, in a section after the values */
+
+/* atoms stored in a layout of their own, rather than leaf pages and search levels */
+#define FASTMAP_ENCODED_ATOMS	(FASTMAP_ELIAS_FANO | FASTMAP_ROARING)
+
+/* bytes at the start of a page prefetched into the cache by #fastmap_inhandle_prefetch(), in lines of FASTMAP_CACHELINE */
+#define FASTMAP_CACHELINE	64
+#define FASTMAP_PREFETCHBYTES	256
+
+/* keys per partition of an Elias-Fano coded set */
+#define FASTMAP_EFPARTITION	256
+
+/* keys spanned by a chunk of a roaring set, and the words of a bitmap of them */
+#define FASTMAP_ROARINGCHUNK	65536
+#define FASTMAP_ROARINGWORDS	(FASTMAP_ROARINGCHUNK / 64)
+
+/* a roaring container holds the low 16 bits of the keys of its chunk in one of these forms */
+#define FASTMAP_ROARING_ARRAY	1	/* sorted 16 bit values */
+#define FASTMAP_ROARING_BITMAP	2	/* one bit per key of the chunk, in 64 bit little-endian words */
+#define FASTMAP_ROARING_RUNS	3	/* pairs of 16 bit values, the first and last key of each run */
+
+/* Header of a roaring container, each container is padded to a multiple of 8 bytes */
+struct _roaringcontainer
+{
+	uint32_t cardinality;
+	uint16_t type;
+	uint16_t runs;
+};
+
+/* Directory entry of a partition of encoded atoms, the first key is stored as
+ * a big-endian integer so that the directory can be searched as integer keys */
+struct _atompartition
+{
+	unsigned char firstkey[8];
+	uint64_t offset;
+};
+
+/* Directory entry of a block of compressed values. 'start' is the offset of its first value
+ * in the uncompressed value pages, which is what value pointers hold, and 'offset' that of its
+ * compressed bytes from the first value page. A block which did not compress is stored as it is,
+ * with 'size' equal to 'rawsize' */
+struct _valueblock
+{
+	uint64_t start;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t rawsize;
+};
+
+/* Entry of the table of values written, by which a value equal to one written before is shared.
+ * 'offset' is that of the value in the uncompressed value pages, an entry of size 0 is empty */
+struct _dedupentry
+{
+	uint64_t hash;
+	uint64_t offset;
+	uint64_t vsize;
+};
+
+/* LZ77 codec of value blocks: sequences of a token, literals, and a back reference of at least
+ * 'FASTMAP_LZMINMATCH' bytes found through a hash table of 2^'FASTMAP_LZHASHBITS' positions */
+#define FASTMAP_LZHASHBITS	14
+#define FASTMAP_LZMINMATCH	4
+#define FASTMAP_LZMAXOFFSET	65535
+
+/* dictionary training scores segments by the frequency of the k-grams within them */
+#define FASTMAP_TRAINKGRAM	8
+#define FASTMAP_TRAINSEGMENT	64
+#define FASTMAP_TRAINHASHBITS	16
+
+/* leaf pages which hold a variable number of records */
+#define FASTMAP_PACKED_LEAVES	(FASTMAP_FRONT_CODED | FASTMAP_VARIABLE_KEYS)
+
+/* leaf slot tag marking a #FASTMAP_BLOB value stored in the value pages */
+#define FASTMAP_SPILLED_VALUE	0xFF
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#define IS_POWER_OF_TWO(v) ((v) != 0 && ((v) & ((v) - 1)) == 0)
+
+/* value offsets are stored relative to the first value page, in the narrowest width that fits */
+#define FASTMAP_NARROW_VALUEPTR	4
+#define FASTMAP_DEFAULT_VALUEPTR	5
+#define FASTMAP_WIDE_VALUEPTR	8
 
 static int fastmap_cmpfunc_memcmp(const fastmap_attr_t *attr, const void *a, const void *b);
+static int _finishpackedleaves(fastmap_outhandle_t *ohandle);
+static int _flusheliasfano(fastmap_outhandle_t *ohandle);
+static int _flushroaring(fastmap_outhandle_t *ohandle);
+static int _writeroaringdirectory(fastmap_outhandle_t *ohandle);
+static void _finishsearchlevels(fastmap_outhandle_t *ohandle);
+
+static void _putvalueptr(unsigned char *p, size_t v, size_t width)
+{
+	size_t i;
+
+	for (i = 0; i < width; i++, v >>= 8)
+		p[i] = (unsigned char)(v & 0xFF);
+}
+
+static size_t _getvalueptr(const unsigned char *p, size_t width)
+{
+	size_t v = 0;
+
+	while (width-- > 0)
+		v = (v << 8) | p[width];
+
+	return v;
+}
+
+/* front-coded leaf pages begin with this header, and end with the offsets of their
+ * restart points, stored as 32 bit integers backwards from the end of the page.
+ * Leaf pages of variable length keys begin with it too, followed by their slots */
+struct _leafpageheader
+{
+	uint64_t firstrecord;
+	uint32_t entries;
+	uint32_t restarts;
+};
+
+/* search pages of variable length keys begin with the index of their first key within the
+ * level, so a child is found without assuming a fixed number of keys per page */
+struct _searchpageheader
+{
+	uint64_t firstkey;
+	uint32_t keys;
+	uint32_t unused;
+};
+
+/* a slot locates a variable length key, and what follows it, within its page */
+struct _keyslot
+{
+	uint32_t offset;
+	uint32_t ksize;
+};
+
+#define FASTMAP_RESTARTSIZE	sizeof(uint32_t)
+
+static size_t _putvarint(unsigned char *p, size_t v)
+{
+	size_t n = 0;
+
+	while (v >= 0x80)
+	{
+		p[n++] = (unsigned char)(v | 0x80);
+		v >>= 7;
+	}
+	p[n++] = (unsigned char)v;
+
+	return n;
+}
+
+static size_t _getvarint(const unsigned char **p)
+{
+	size_t v = 0;
+	int shift = 0;
+
+	while (**p & 0x80)
+	{
+		v |= (size_t)(*(*p)++ & 0x7F) << shift;
+		shift += 7;
+	}
+	v |= (size_t)(*(*p)++) << shift;
+
+	return v;
+}
+
+static size_t _varintsize(size_t v)
+{
+	size_t n = 1;
+
+	while (v >= 0x80)
+	{
+		v >>= 7;
+		n++;
+	}
+
+	return n;
+}
 
 int fastmap_attr_init(fastmap_attr_t *attr)
 {
@@ -70,412 +262,4146 @@ int fastmap_attr_getvsize(fastmap_attr_t *attr, size_t *size)
 	return FASTMAP_OK;
 }
 
-int fastmap_attr_setformat(fastmap_attr_t *attr, const fastmap_format_t format)
+int fastmap_attr_setinlinevsize(fastmap_attr_t *attr, const size_t size)
 {
-	attr->format = format;
+	if (size > FASTMAP_MAXINLINEVSIZE)
+		return EINVAL;
+
+	attr->inlinevsize = size;
 	return FASTMAP_OK;
 }
 
-int fastmap_attr_getformat(fastmap_attr_t *attr, fastmap_format_t *format)
+int fastmap_attr_getinlinevsize(fastmap_attr_t *attr, size_t *size)
 {
-	*format = attr->format;
+	*size = attr->inlinevsize;
 	return FASTMAP_OK;
 }
 
-int fastmap_outhandle_init(fastmap_outhandle_t *ohandle, const fastmap_attr_t *attr, const char *pathname)
+int fastmap_attr_setvaluebytes(fastmap_attr_t *attr, const size_t nbytes)
 {
-	struct stat st;
-	int rc = FASTMAP_OK;
+	attr->valuebytes = nbytes;
+	return FASTMAP_OK;
+}
 
-	if (ohandle == NULL || attr == NULL)
+int fastmap_attr_getvaluebytes(fastmap_attr_t *attr, size_t *nbytes)
+{
+	*nbytes = attr->valuebytes;
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_setpagesize(fastmap_attr_t *attr, const size_t size)
+{
+	if (size != 0 && (!IS_POWER_OF_TWO(size) || size < FASTMAP_MINPAGESIZE || size > FASTMAP_MAXPAGESIZE))
 		return EINVAL;
 
-	memset(ohandle, 0, sizeof(*ohandle));
-	memcpy(&ohandle->handle.attr, attr, sizeof(*attr));
-	ohandle->fd = -1;
+	attr->pagesize = size;
+	return FASTMAP_OK;
+}
 
-	ohandle->fd = open(pathname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-	if (ohandle->fd == -1)
-	{
-		rc = errno;
-		goto fail;
-	}
+int fastmap_attr_getpagesize(fastmap_attr_t *attr, size_t *size)
+{
+	*size = attr->pagesize;
+	return FASTMAP_OK;
+}
 
-	if (fstat(ohandle->fd, &st) == -1)
-	{
-		rc = errno;
-		goto fail;
-	}
+int fastmap_attr_setsectionalign(fastmap_attr_t *attr, const size_t align)
+{
+	if (align != 0 && !IS_POWER_OF_TWO(align))
+		return EINVAL;
 
-	ohandle->handle.valueptrsize = sizeof(ohandle->currentvalueoffset);
-	ohandle->handle.pagesize = (uint32_t)st.st_blksize;
+	attr->sectionalign = align;
+	return FASTMAP_OK;
+}
 
-	/* TODO: want to change logic on key eval, no multiple restriction, inline blocks (key + val) * n should fit > 95% of a page, or go non-inline */
-#define IS_MULTIPLE(x,y) (x == ((x / y) * y))
+int fastmap_attr_getsectionalign(fastmap_attr_t *attr, size_t *align)
+{
+	*align = attr->sectionalign;
+	return FASTMAP_OK;
+}
 
-	if (!IS_MULTIPLE(ohandle->handle.pagesize, ohandle->handle.attr.ksize))
-	{
-		rc = EINVAL;
-		goto fail;
-	}
+int fastmap_attr_setrestartinterval(fastmap_attr_t *attr, const size_t interval)
+{
+	if (interval > UINT32_MAX)
+		return EINVAL;
 
-	switch (ohandle->handle.attr.format)
-	{
-	case FASTMAP_ATOM:
-		ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize;
-		break;
-	case FASTMAP_PAIR:
-		ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize * 2;
-		break;
-	case FASTMAP_BLOCK:
-		if (IS_MULTIPLE(ohandle->handle.pagesize, ohandle->handle.attr.ksize + ohandle->handle.attr.vsize))
-		{
-			ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize + ohandle->handle.attr.vsize;
-			ohandle->handle.flags |= FASTMAP_INLINE_BLOCK;
-		}
-		else
-		{
-			ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize;
-		}
-		break;
-	case FASTMAP_BLOB:
-		ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize + ohandle->handle.valueptrsize;
-		break;
-	default:
-		rc = EINVAL;
-		goto fail;
-	}
+	attr->restartinterval = interval;
+	return FASTMAP_OK;
+}
 
-#undef IS_MULTIPLE
+int fastmap_attr_getrestartinterval(fastmap_attr_t *attr, size_t *interval)
+{
+	*interval = attr->restartinterval;
+	return FASTMAP_OK;
+}
 
-	ohandle->handle.recordsperleafpage = ohandle->handle.pagesize / ohandle->handle.leafpagerecordsize;
-	ohandle->handle.leafpages = (size_t)ceil((double)ohandle->handle.attr.records / (double)ohandle->handle.recordsperleafpage);
-	ohandle->handle.keyspersearchpage = ohandle->handle.pagesize / ohandle->handle.attr.ksize;
+int fastmap_attr_setvariablekeys(fastmap_attr_t *attr, const int enable)
+{
+	attr->variablekeys = enable ? 1 : 0;
+	return FASTMAP_OK;
+}
 
-	ohandle->handle.numlevels = 0;
-	{
-		size_t firstleafpageoffset = ohandle->handle.pagesize;
-		size_t pagesperlevel = ohandle->handle.leafpages;
-		int i;
+int fastmap_attr_getvariablekeys(fastmap_attr_t *attr, int *enable)
+{
+	*enable = attr->variablekeys;
+	return FASTMAP_OK;
+}
 
-		while (pagesperlevel > 1)
-		{
-			pagesperlevel = (size_t)ceil((double)pagesperlevel / (double)ohandle->handle.keyspersearchpage);
-			ohandle->handle.perlevel[ohandle->handle.numlevels++].pages = pagesperlevel;
-			firstleafpageoffset += pagesperlevel * ohandle->handle.pagesize;
-			if (ohandle->handle.numlevels > FASTMAP_MAXLEVELS)
-			{
-				rc = FASTMAP_TOO_MANY_LEVELS;
-				goto fail;
-			}
-		}
+int fastmap_attr_settruncateseparators(fastmap_attr_t *attr, const int enable)
+{
+	attr->truncateseparators = enable ? 1 : 0;
+	return FASTMAP_OK;
+}
 
-		ohandle->handle.firstleafpageoffset = firstleafpageoffset + ohandle->handle.pagesize;
+int fastmap_attr_gettruncateseparators(fastmap_attr_t *attr, int *enable)
+{
+	*enable = attr->truncateseparators;
+	return FASTMAP_OK;
+}
 
-		for (i = 0; i < ohandle->handle.numlevels; i++)
-		{
-			firstleafpageoffset -= ohandle->handle.perlevel[i].pages * ohandle->handle.pagesize;
-			ohandle->handle.perlevel[i].firstoffset = firstleafpageoffset;
-			ohandle->levelinfo[i].currentoffset = firstleafpageoffset;
-		}
+/* Size of an encoded key field, 0 for an unknown type */
+static size_t _keyfieldsize(fastmap_keytype_t type)
+{
+	switch (type)
+	{
+	case FASTMAP_KEY_U32:
+		return sizeof(uint32_t);
+	case FASTMAP_KEY_U64:
+	case FASTMAP_KEY_I64:
+	case FASTMAP_KEY_F64:
+		return sizeof(uint64_t);
+	default:
+		return 0;
 	}
+}
 
-	ohandle->currentleafpageoffset = ohandle->handle.firstleafpageoffset;
+int fastmap_attr_setkeyschema(fastmap_attr_t *attr, const fastmap_keytype_t *types, const size_t nfields)
+{
+	size_t i, ksize = 0;
 
-	if (ohandle->handle.attr.format == FASTMAP_BLOB || (ohandle->handle.attr.format == FASTMAP_BLOCK && !(ohandle->handle.flags & FASTMAP_INLINE_BLOCK)))
+	if (nfields > FASTMAP_MAXKEYFIELDS || (nfields > 0 && types == NULL))
+		return EINVAL;
+
+	for (i = 0; i < nfields; i++)
 	{
-		ohandle->handle.firstvalueoffset = ohandle->handle.firstleafpageoffset + (ohandle->handle.pagesize * ohandle->handle.leafpages);
-		ohandle->currentvalueoffset = ohandle->handle.firstvalueoffset;
+		if (_keyfieldsize(types[i]) == 0)
+			return EINVAL;
+		ksize += _keyfieldsize(types[i]);
 	}
 
-	ohandle->handle.flags |= FASTMAP_INVALID_MAP;
-	write(ohandle->fd, &(ohandle->handle), sizeof(ohandle->handle));
-	lseek(ohandle->fd, ohandle->handle.pagesize, SEEK_SET);
-
-	goto success;
-fail:
-	if (ohandle->fd != -1 && close(ohandle->fd) == -1)
-		rc = errno;
-success:
-	return rc;
+	memset(attr->keyschema, 0, sizeof(attr->keyschema));
+	if (nfields > 0)
+	{
+		memcpy(attr->keyschema, types, nfields * sizeof(types[0]));
+		attr->ksize = ksize;
+	}
+	attr->keyfields = nfields;
+	return FASTMAP_OK;
 }
 
-int fastmap_outhandle_destroy(fastmap_outhandle_t *ohandle)
+/* Check that a key schema, if any, describes keys of the key size */
+static int _validkeyschema(const fastmap_attr_t *attr)
 {
-	int rc = FASTMAP_OK;
+	size_t i, ksize = 0;
 
-	if (ohandle == NULL || ohandle->fd == -1)
-		return EINVAL;
+	if (attr->keyfields == 0)
+		return 1;
+	if (attr->keyfields > FASTMAP_MAXKEYFIELDS || attr->variablekeys)
+		return 0;
 
-	if (!(ohandle->handle.flags & FASTMAP_INVALID_MAP))
+	for (i = 0; i < attr->keyfields; i++)
 	{
-		rc = EINVAL;
-		goto success;
+		if (_keyfieldsize(attr->keyschema[i]) == 0)
+			return 0;
+		ksize += _keyfieldsize(attr->keyschema[i]);
 	}
 
-	if (ohandle->records != ohandle->handle.attr.records)
+	return ksize == attr->ksize;
+}
+
+int fastmap_attr_getkeyschema(fastmap_attr_t *attr, fastmap_keytype_t *types, size_t *nfields)
+{
+	memcpy(types, attr->keyschema, attr->keyfields * sizeof(types[0]));
+	*nfields = attr->keyfields;
+	return FASTMAP_OK;
+}
+
+static void _putbigendian(unsigned char *p, uint64_t v, size_t width)
+{
+	while (width-- > 0)
 	{
-		rc = FASTMAP_EXPECTATION_FAILED;
-		goto success;
+		p[width] = (unsigned char)(v & 0xFF);
+		v >>= 8;
 	}
+}
 
-	ohandle->handle.flags &= ~FASTMAP_INVALID_MAP;
-	lseek(ohandle->fd, 0L, SEEK_SET);
-	write(ohandle->fd , &(ohandle->handle), sizeof(ohandle->handle));
-	close(ohandle->fd);
-	ohandle->fd = -1;
-success:
-	return rc;
+static uint64_t _getbigendian(const unsigned char *p, size_t width)
+{
+	uint64_t v = 0;
+	size_t i;
+
+	for (i = 0; i < width; i++)
+		v = (v << 8) | p[i];
+	return v;
 }
 
-static void _updatesearchpagelevels(fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+/* Read a 64 bit little-endian word, as the words of a bitmap are stored */
+static uint64_t _getlittleendian(const unsigned char *p)
 {
-	int i;
+	uint64_t v = 0;
+	size_t i;
 
-	for (i = 0; i < ohandle->handle.numlevels; i++)
+	for (i = sizeof(v); i-- > 0;)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+/* Read a key of a map with integer keys, the constant widths letting the reads compile to single loads */
+static uint64_t _integerkey(const unsigned char *p, size_t ksize)
+{
+	if (ksize == sizeof(uint64_t))
+		return _getbigendian(p, sizeof(uint64_t));
+
+	return _getbigendian(p, sizeof(uint32_t));
+}
+
+#define FASTMAP_SIGNBIT	((uint64_t)1 << 63)
+
+int fastmap_encodekey(const fastmap_attr_t *attr, const fastmap_keyfield_t *fields, void *key)
+{
+	unsigned char *p = key;
+	uint64_t bits;
+	double f;
+	size_t i;
+
+	if (attr == NULL || fields == NULL || key == NULL || attr->keyfields == 0 || attr->keyfields > FASTMAP_MAXKEYFIELDS)
+		return EINVAL;
+
+	for (i = 0; i < attr->keyfields; i++)
 	{
-		if (ohandle->levelinfo[i].keys % ohandle->handle.keyspersearchpage == 0)
+		switch (attr->keyschema[i])
 		{
-			ohandle->levelinfo[i].currentoffset = ALIGN_TO_PAGE_OFFSET(ohandle->levelinfo[i].currentoffset, ohandle->handle.pagesize);
+		case FASTMAP_KEY_U32:
+			bits = fields[i].u32;
+			break;
+		case FASTMAP_KEY_U64:
+			bits = fields[i].u64;
+			break;
+		case FASTMAP_KEY_I64:
+			/* offsetting by the sign bit puts negative values below positive ones */
+			bits = (uint64_t)fields[i].i64 ^ FASTMAP_SIGNBIT;
+			break;
+		case FASTMAP_KEY_F64:
+			/* positive floats order as their bits once the sign is set, negative floats as their inverted bits,
+			 * after folding -0.0 into 0.0 and every NaN into one which sorts last */
+			f = fields[i].f64;
+			if (f == 0.0)
+				f = 0.0;
+			memcpy(&bits, &f, sizeof(bits));
+			if (f != f)
+				bits = UINT64_C(0x7FF8000000000000);
+			bits = (bits & FASTMAP_SIGNBIT) ? ~bits : bits | FASTMAP_SIGNBIT;
+			break;
+		default:
+			return EINVAL;
 		}
-	
-		lseek(ohandle->fd, ohandle->levelinfo[i].currentoffset, SEEK_SET);
-		write(ohandle->fd, record->atom.key, ohandle->handle.attr.ksize);
-		ohandle->handle.perlevel[i].lastoffset = ohandle->levelinfo[i].currentoffset;
-		ohandle->levelinfo[i].currentoffset += ohandle->handle.attr.ksize;
-		ohandle->levelinfo[i].keys++;
 
-		if ((ohandle->levelinfo[i].keys < ohandle->handle.keyspersearchpage) || (ohandle->levelinfo[i].keys % ohandle->handle.keyspersearchpage != 1))
-			break;
+		_putbigendian(p, bits, _keyfieldsize(attr->keyschema[i]));
+		p += _keyfieldsize(attr->keyschema[i]);
 	}
+
+	return FASTMAP_OK;
 }
 
-int fastmap_outhandle_put(fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+int fastmap_decodekey(const fastmap_attr_t *attr, const void *key, fastmap_keyfield_t *fields)
 {
-	if ((ohandle->records + 1) > ohandle->handle.attr.records)
-		return FASTMAP_TOO_MANY_RECORDS;
+	const unsigned char *p = key;
+	uint64_t bits;
+	size_t i;
 
-	if ((ohandle->records % ohandle->handle.recordsperleafpage) == 0)
+	if (attr == NULL || fields == NULL || key == NULL || attr->keyfields == 0 || attr->keyfields > FASTMAP_MAXKEYFIELDS)
+		return EINVAL;
+
+	for (i = 0; i < attr->keyfields; i++)
 	{
-		ohandle->currentleafpageoffset = ALIGN_TO_PAGE_OFFSET(ohandle->currentleafpageoffset, ohandle->handle.pagesize);
-	}
+		if (_keyfieldsize(attr->keyschema[i]) == 0)
+			return EINVAL;
 
-	lseek(ohandle->fd, ohandle->currentleafpageoffset, SEEK_SET);
-	write(ohandle->fd, record->atom.key, ohandle->handle.attr.ksize);
-	ohandle->currentleafpageoffset += ohandle->handle.attr.ksize;
+		bits = _getbigendian(p, _keyfieldsize(attr->keyschema[i]));
+		p += _keyfieldsize(attr->keyschema[i]);
 
-	switch (ohandle->handle.attr.format)
+		switch (attr->keyschema[i])
+		{
+		case FASTMAP_KEY_U32:
+			fields[i].u32 = (uint32_t)bits;
+			break;
+		case FASTMAP_KEY_U64:
+			fields[i].u64 = bits;
+			break;
+		case FASTMAP_KEY_I64:
+			fields[i].i64 = (int64_t)(bits ^ FASTMAP_SIGNBIT);
+			break;
+		default:
+			bits = (bits & FASTMAP_SIGNBIT) ? bits & ~FASTMAP_SIGNBIT : ~bits;
+			memcpy(&fields[i].f64, &bits, sizeof(bits));
+			break;
+		}
+	}
+
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_setatomencoding(fastmap_attr_t *attr, const fastmap_atomencoding_t encoding)
+{
+	if (encoding != FASTMAP_ATOM_SORTED && encoding != FASTMAP_ATOM_ELIASFANO && encoding != FASTMAP_ATOM_ROARING)
+		return EINVAL;
+
+	attr->atomencoding = encoding;
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_getatomencoding(fastmap_attr_t *attr, fastmap_atomencoding_t *encoding)
+{
+	*encoding = attr->atomencoding;
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_setvaluecompression(fastmap_attr_t *attr, const size_t blocksize)
+{
+	if (blocksize > FASTMAP_MAXVALUEBLOCKSIZE)
+		return EINVAL;
+
+	attr->valueblocksize = blocksize;
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_getvaluecompression(fastmap_attr_t *attr, size_t *blocksize)
+{
+	*blocksize = attr->valueblocksize;
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_setvaluededup(fastmap_attr_t *attr, const size_t entries)
+{
+	if (entries > FASTMAP_MAXDEDUPENTRIES)
+		return EINVAL;
+
+	attr->dedupentries = entries;
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_getvaluededup(fastmap_attr_t *attr, size_t *entries)
+{
+	*entries = attr->dedupentries;
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_setvalueaggregate(fastmap_attr_t *attr, const fastmap_keytype_t type)
+{
+	if (attr == NULL || (type != 0 && _keyfieldsize(type) == 0))
+		return EINVAL;
+
+	attr->valueaggregate = type;
+	return FASTMAP_OK;
+}
+
+int fastmap_attr_getvalueaggregate(fastmap_attr_t *attr, fastmap_keytype_t *type)
+{
+	if (attr == NULL || type == NULL)
+		return EINVAL;
+
+	*type = attr->valueaggregate;
+	return FASTMAP_OK;
+}
+
+/* Aggregates are only kept of #FASTMAP_BLOCK values holding a number */
+static int _validvalueaggregate(const fastmap_attr_t *attr)
+{
+	return attr->valueaggregate == 0 ||
+		(attr->format == FASTMAP_BLOCK && _keyfieldsize(attr->valueaggregate) != 0 && attr->vsize >= _keyfieldsize(attr->valueaggregate));
+}
+
+/* Read the number at the start of a value, widening 32 bit numbers */
+static fastmap_keyfield_t _aggregatevalue(fastmap_keytype_t type, const void *value)
+{
+	fastmap_keyfield_t field;
+	uint32_t u32;
+
+	if (type == FASTMAP_KEY_U32)
 	{
-	case FASTMAP_PAIR:
-		write(ohandle->fd, record->pair.value, ohandle->handle.attr.ksize);
-		ohandle->currentleafpageoffset += ohandle->handle.attr.ksize;
+		memcpy(&u32, value, sizeof(u32));
+		field.u64 = u32;
+	}
+	else
+	{
+		memcpy(&field, value, sizeof(field.u64));
+	}
+	return field;
+}
+
+/* Add the aggregates of 'b' to 'a' */
+static void _aggregatecombine(fastmap_keytype_t type, fastmap_aggregate_t *a, const fastmap_aggregate_t *b)
+{
+	if (b->count == 0)
+		return;
+	if (a->count == 0)
+	{
+		*a = *b;
+		return;
+	}
+
+	a->count += b->count;
+	switch (type)
+	{
+	case FASTMAP_KEY_I64:
+		a->sum.i64 = (int64_t)((uint64_t)a->sum.i64 + (uint64_t)b->sum.i64);
+		a->min.i64 = MIN(a->min.i64, b->min.i64);
+		a->max.i64 = MAX(a->max.i64, b->max.i64);
 		break;
-	case FASTMAP_BLOB:
-		write(ohandle->fd, &(ohandle->currentvalueoffset), sizeof(ohandle->currentvalueoffset));
-		ohandle->currentleafpageoffset += sizeof(ohandle->currentvalueoffset);
-		lseek(ohandle->fd, ohandle->currentvalueoffset, SEEK_SET);
-		write(ohandle->fd, &(record->blob.vsize), sizeof(record->blob.vsize));
-		write(ohandle->fd, record->blob.value, record->blob.vsize);
-		ohandle->currentvalueoffset += sizeof(record->blob.vsize) + record->blob.vsize;
+	case FASTMAP_KEY_F64:
+		a->sum.f64 += b->sum.f64;
+		a->min.f64 = MIN(a->min.f64, b->min.f64);
+		a->max.f64 = MAX(a->max.f64, b->max.f64);
 		break;
-	case FASTMAP_BLOCK:
-		if (ohandle->handle.flags & FASTMAP_INLINE_BLOCK)
-		{
-			write(ohandle->fd, record->block.value, ohandle->handle.attr.vsize);
-			ohandle->currentleafpageoffset += ohandle->handle.attr.vsize;
-		}
-		else
-		{
-			lseek(ohandle->fd, ohandle->currentvalueoffset, SEEK_SET);
-			write(ohandle->fd, record->block.value, ohandle->handle.attr.vsize);
-			ohandle->currentvalueoffset += ohandle->handle.attr.vsize;
-		}
-	case FASTMAP_ATOM:
+	default:
+		a->sum.u64 += b->sum.u64;
+		a->min.u64 = MIN(a->min.u64, b->min.u64);
+		a->max.u64 = MAX(a->max.u64, b->max.u64);
 		break;
 	}
+}
 
-	ohandle->records++;
+/* Add the number at the start of a value to 'aggregate' */
+static void _aggregateadd(fastmap_keytype_t type, fastmap_aggregate_t *aggregate, const void *value)
+{
+	fastmap_aggregate_t single;
+
+	single.count = 1;
+	single.sum = single.min = single.max = _aggregatevalue(type, value);
+	_aggregatecombine(type, aggregate, &single);
+}
+
+/* Aggregates of level 'level' of the aggregate section, the leaf pages being level 0 */
+static size_t _aggregatelevelsize(size_t leafpages, int level)
+{
+	size_t n = leafpages;
+
+	while (level-- > 0)
+		n = (n + FASTMAP_AGGREGATEFANOUT - 1) / FASTMAP_AGGREGATEFANOUT;
+	return n;
+}
+
+/* Write the aggregates of the leaf pages after the values, followed by each level above them up to a single aggregate */
+static int _writeaggregates(fastmap_outhandle_t *ohandle)
+{
+	const fastmap_keytype_t type = ohandle->handle.attr.valueaggregate;
+	fastmap_aggregate_t *aggregates = ohandle->aggregates, *above;
+	size_t n = ohandle->handle.leafpages, offset, i;
+
+	offset = MAX(ohandle->currentvalueoffset, ohandle->handle.firstleafpageoffset + (ohandle->handle.leafpages * ohandle->handle.pagesize));
+	ohandle->handle.aggregateoffset = ALIGN_TO_PAGE_OFFSET(offset, ohandle->handle.pagesize);
 
+	for (offset = ohandle->handle.aggregateoffset; ; )
 	{
-		if ((ohandle->records > ohandle->handle.recordsperleafpage) && (ohandle->records % ohandle->handle.recordsperleafpage == 1))
-			_updatesearchpagelevels(ohandle, record);
+		if (pwrite(ohandle->fd, aggregates, n * sizeof(*aggregates), (off_t)offset) != (ssize_t)(n * sizeof(*aggregates)))
+			return errno ? errno : EIO;
+		offset += n * sizeof(*aggregates);
+		if (n <= 1)
+			break;
+
+		/* each level is combined in place into the one above it */
+		above = aggregates;
+		for (i = 0; i < n; i++)
+		{
+			if (i % FASTMAP_AGGREGATEFANOUT == 0)
+				above[i / FASTMAP_AGGREGATEFANOUT] = aggregates[i];
+			else
+				_aggregatecombine(type, &above[i / FASTMAP_AGGREGATEFANOUT], &aggregates[i]);
+		}
+		n = (n + FASTMAP_AGGREGATEFANOUT - 1) / FASTMAP_AGGREGATEFANOUT;
 	}
 
 	return FASTMAP_OK;
 }
 
-int fastmap_inhandle_init(fastmap_inhandle_t *ihandle, const char *pathname)
+static uint32_t _kgramhash(const unsigned char *p)
 {
-	struct stat st;
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> (64 - FASTMAP_TRAINHASHBITS));
+}
+
+/* Sum the counts of the k-grams within a segment */
+static uint64_t _segmentscore(const uint32_t *counts, const unsigned char *p, size_t size)
+{
+	uint64_t score = 0;
+	size_t i;
+
+	for (i = 0; i + FASTMAP_TRAINKGRAM <= size; i++)
+		score += counts[_kgramhash(p + i)];
+
+	return score;
+}
+
+struct _trainsegment
+{
+	const unsigned char *p;
+	size_t size;
+	uint64_t score;
+};
+
+static int _trainsegment_cmp(const void *a, const void *b)
+{
+	const struct _trainsegment *x = a, *y = b;
+
+	if (x->score != y->score)
+		return x->score < y->score ? 1 : -1;
+	return (x->p > y->p) - (x->p < y->p);
+}
+
+int fastmap_traindictionary(const void *samples[], const size_t sizes[], size_t nsamples, void *dictionary, size_t *size)
+{
+	struct _trainsegment *segments = NULL;
+	uint32_t *counts = NULL;
+	unsigned char *out = dictionary;
+	const unsigned char *p;
+	size_t capacity, nsegments = 0, used = 0, i, j, n;
+	uint64_t score;
 	int rc = FASTMAP_OK;
 
-	if (ihandle == NULL)
+	if (samples == NULL || sizes == NULL || dictionary == NULL || size == NULL || *size > FASTMAP_MAXDICTIONARYSIZE)
 		return EINVAL;
+	capacity = *size;
 
-	memset(ihandle, 0, sizeof(*ihandle));
-
-	ihandle->fd = open(pathname, O_RDONLY);
-	if (ihandle->fd == -1)
+	counts = calloc((size_t)1 << FASTMAP_TRAINHASHBITS, sizeof(uint32_t));
+	if (counts == NULL)
 	{
-		rc = errno;
+		rc = ENOMEM;
 		goto fail;
 	}
 
-	if (fstat(ihandle->fd, &st) == -1)
+	/* candidate segments overlap by half, so a common run of text is whole in at least one of them */
+	for (i = 0; i < nsamples; i++)
 	{
-		rc = errno;
-		goto fail;
+		p = samples[i];
+		for (j = 0; j + FASTMAP_TRAINKGRAM <= sizes[i]; j++)
+			counts[_kgramhash(p + j)]++;
+		for (j = 0; j + FASTMAP_TRAINKGRAM <= sizes[i]; j += FASTMAP_TRAINSEGMENT / 2)
+			nsegments++;
 	}
 
-	if (sizeof(st.st_size) > sizeof(size_t) && st.st_size > SIZE_MAX)
+	segments = malloc(MAX(nsegments, 1) * sizeof(*segments));
+	if (segments == NULL)
 	{
 		rc = ENOMEM;
 		goto fail;
 	}
 
-	ihandle->mmaplen = (size_t)st.st_size;
-	ihandle->mmapaddr = mmap(NULL, ihandle->mmaplen, PROT_READ, MAP_SHARED, ihandle->fd, 0);
-	if (ihandle->mmapaddr == MAP_FAILED)
+	for (i = 0, n = 0; i < nsamples; i++)
 	{
-		rc = errno;
-		goto fail;
+		for (j = 0; j + FASTMAP_TRAINKGRAM <= sizes[i]; j += FASTMAP_TRAINSEGMENT / 2, n++)
+		{
+			segments[n].p = (const unsigned char*)samples[i] + j;
+			segments[n].size = MIN(FASTMAP_TRAINSEGMENT, sizes[i] - j);
+			segments[n].score = _segmentscore(counts, segments[n].p, segments[n].size);
+		}
 	}
-	/* TODO: assert version and magic */
-	memcpy(&ihandle->handle, ihandle->mmapaddr, sizeof(ihandle->handle));
+	qsort(segments, nsegments, sizeof(*segments), _trainsegment_cmp);
 
-	fastmap_inhandle_setcmpfunc(ihandle, fastmap_cmpfunc_memcmp);
+	/* a segment is kept while its k-grams not yet covered are, on average, shared with another sample,
+	 * and the best segments go last, where back references from the data are shortest */
+	for (i = 0; i < nsegments && used < capacity; i++)
+	{
+		score = _segmentscore(counts, segments[i].p, segments[i].size);
+		if (score < 2 * (uint64_t)(segments[i].size - FASTMAP_TRAINKGRAM + 1))
+			continue;
+
+		n = MIN(segments[i].size, capacity - used);
+		memcpy(out + capacity - used - n, segments[i].p, n);
+		used += n;
+		for (j = 0; j + FASTMAP_TRAINKGRAM <= segments[i].size; j++)
+			counts[_kgramhash(segments[i].p + j)] = 0;
+	}
+
+	memmove(out, out + capacity - used, used);
+	*size = used;
 
-	goto success;
 fail:
-	if (close(ihandle->fd) == -1 && errno != EBADF)
-		rc = errno;
-success:
+	free(segments);
+	free(counts);
 	return rc;
 }
 
-int fastmap_inhandle_destroy(fastmap_inhandle_t *ihandle)
+static uint32_t _lzhash(const unsigned char *p)
 {
-	if (ihandle == NULL || ihandle->fd == -1)
-		return EINVAL;
+	uint32_t v;
 
-	if (ihandle->mmapaddr)
-	{
-		munmap(ihandle->mmapaddr, ihandle->mmaplen);
-		ihandle->mmapaddr = NULL;
-	}
+	memcpy(&v, p, sizeof(v));
+	return (v * 2654435761U) >> (32 - FASTMAP_LZHASHBITS);
+}
 
-	close(ihandle->fd);
-	ihandle->fd = -1;
-	return FASTMAP_OK;
+/* Size of the extra bytes of a length which does not fit the 4 bits of a token */
+static size_t _lzlengthsize(size_t n)
+{
+	return (n < 15) ? 0 : (n - 15) / 255 + 1;
 }
 
-static int fastmap_cmpfunc_memcmp(const fastmap_attr_t *attr, const void *a, const void *b)
+static size_t _lzputlength(unsigned char *p, size_t n)
 {
-	return memcmp(a, b, attr->ksize);
+	size_t i = 0;
+
+	if (n < 15)
+		return 0;
+	for (n -= 15; n >= 255; n -= 255)
+		p[i++] = 255;
+	p[i++] = (unsigned char)n;
+
+	return i;
 }
 
-int fastmap_inhandle_getattr(fastmap_inhandle_t *ihandle, fastmap_attr_t *attr)
+static int _lzgetlength(const unsigned char *src, size_t size, size_t *ip, size_t *n)
 {
-	memcpy(attr, &(ihandle->handle.attr), sizeof(*attr));
-	return FASTMAP_OK;
+	unsigned char b;
+
+	do
+	{
+		if (*ip >= size)
+			return 0;
+		b = src[(*ip)++];
+		*n += b;
+	}
+	while (b == 255);
+
+	return 1;
 }
 
-int fastmap_inhandle_setcmpfunc(fastmap_inhandle_t *ihandle, fastmap_cmpfunc cmp)
+/* Emit a sequence of 'lit' literals followed, unless it is the last, by a reference of 'offset' and 'match' bytes */
+static size_t _lzputsequence(unsigned char *dst, const unsigned char *literals, size_t lit, size_t offset, size_t match, int last)
 {
-	ihandle->cmp = cmp;
-	return FASTMAP_OK;
+	size_t n = 1;
+
+	dst[0] = (unsigned char)((MIN(lit, 15) << 4) | (last ? 0 : MIN(match - FASTMAP_LZMINMATCH, 15)));
+	n += _lzputlength(dst + n, lit);
+	memcpy(dst + n, literals, lit);
+	n += lit;
+	if (last)
+		return n;
+
+	dst[n++] = (unsigned char)(offset & 0xFF);
+	dst[n++] = (unsigned char)(offset >> 8);
+	n += _lzputlength(dst + n, match - FASTMAP_LZMINMATCH);
+	return n;
 }
 
-static int _leafpage_get(fastmap_inhandle_t *ihandle, fastmap_record_t *record, size_t offset, size_t recordindex)
+/* Compress window[start, end) into 'dst', references reaching back into window[0, start), which holds
+ * the dictionary. Returns the compressed size, or 0 if it would not be smaller than 'capacity' */
+static size_t _lzcompress(const unsigned char *window, size_t start, size_t end, unsigned char *dst, size_t capacity, uint32_t *table)
 {
-	size_t currentkey;
+	size_t p, anchor, candidate, len, need, op = 0;
+	uint32_t h;
 
-	for (currentkey = 0; currentkey < ihandle->handle.recordsperleafpage; currentkey++)
-	{
-/* TODO: _get() does a lot of comparisons. Can this be converted from a linear scan of the page to a binary search? will it conflict with non-multiple inline blocks? */
-		int ord = ihandle->cmp(&ihandle->handle.attr, record->atom.key, (char*)ihandle->mmapaddr + offset);
+	memset(table, 0, ((size_t)1 << FASTMAP_LZHASHBITS) * sizeof(uint32_t));
+	for (p = (start > FASTMAP_LZMAXOFFSET) ? start - FASTMAP_LZMAXOFFSET : 0; p + FASTMAP_LZMINMATCH <= start; p++)
+		table[_lzhash(window + p)] = (uint32_t)(p + 1);
 
-		if (ord > 0)
+	for (p = anchor = start; p + FASTMAP_LZMINMATCH <= end; )
+	{
+		h = _lzhash(window + p);
+		candidate = table[h];
+		table[h] = (uint32_t)(p + 1);
+		if (candidate == 0 || p - (candidate - 1) > FASTMAP_LZMAXOFFSET || memcmp(window + candidate - 1, window + p, FASTMAP_LZMINMATCH) != 0)
 		{
-			offset += ihandle->handle.leafpagerecordsize;
+			/* skip ahead faster the longer nothing matches, so incompressible blocks cost little */
+			p += 1 + ((p - anchor) >> 6);
 			continue;
 		}
-		else if (ord == 0)
+
+		candidate--;
+		for (len = FASTMAP_LZMINMATCH; p + len < end && window[candidate + len] == window[p + len]; len++)
+			;
+
+		need = 1 + _lzlengthsize(p - anchor) + (p - anchor) + 2 + _lzlengthsize(len - FASTMAP_LZMINMATCH);
+		if (op + need >= capacity)
+			return 0;
+		op += _lzputsequence(dst + op, window + anchor, p - anchor, p - candidate, len, 0);
+		p += len;
+		anchor = p;
+	}
+
+	need = 1 + _lzlengthsize(end - anchor) + (end - anchor);
+	if (op + need >= capacity)
+		return 0;
+	op += _lzputsequence(dst + op, window + anchor, end - anchor, 0, 0, 1);
+
+	return op;
+}
+
+/* Decompress 'src' into exactly 'rawsize' bytes at 'dst', references reaching back before 'dst'
+ * into the dictionary. Returns zero if the input is malformed */
+static int _lzdecompress(const unsigned char *src, size_t size, const unsigned char *dictionary, size_t dictionarysize, unsigned char *dst, size_t rawsize)
+{
+	size_t ip = 0, op = 0, lit, match, offset, n, i;
+	unsigned token;
+
+	while (ip < size)
+	{
+		token = src[ip++];
+		lit = token >> 4;
+		if (lit == 15 && !_lzgetlength(src, size, &ip, &lit))
+			return 0;
+		if (lit > size - ip || lit > rawsize - op)
+			return 0;
+		memcpy(dst + op, src + ip, lit);
+		ip += lit;
+		op += lit;
+		if (ip == size)
+			break;
+
+		if (size - ip < 2)
+			return 0;
+		offset = (size_t)src[ip] | ((size_t)src[ip + 1] << 8);
+		ip += 2;
+		match = token & 15;
+		if (match == 15 && !_lzgetlength(src, size, &ip, &match))
+			return 0;
+		match += FASTMAP_LZMINMATCH;
+		if (offset == 0 || offset > op + dictionarysize || match > rawsize - op)
+			return 0;
+
+		if (offset > op)
 		{
-			recordindex += currentkey;
-			switch (ihandle->handle.attr.format)
-			{
-			case FASTMAP_PAIR:
-				record->pair.value = (void*)((char*)ihandle->mmapaddr + offset + ihandle->handle.attr.ksize);
-				break;
-			case FASTMAP_BLOCK:
-				if (ihandle->handle.flags & FASTMAP_INLINE_BLOCK)
-					record->block.value = (void*)((char*)ihandle->mmapaddr + offset + ihandle->handle.attr.ksize);
-				else
-					record->block.value = (void*)((char*)ihandle->mmapaddr + ihandle->handle.firstvalueoffset + (recordindex * ihandle->handle.attr.vsize));
-				break;
-			case FASTMAP_BLOB:
-				memcpy(&offset, (char*)ihandle->mmapaddr + offset + ihandle->handle.attr.ksize, sizeof(offset));
-				memcpy(&(record->blob.vsize), (char*)ihandle->mmapaddr + offset, sizeof(record->blob.vsize));
-				record->blob.value = (void*)((char*)ihandle->mmapaddr + offset + sizeof(record->blob.vsize));
-			case FASTMAP_ATOM:
-				break;
-			}
-			return FASTMAP_OK;
+			n = MIN(match, offset - op);
+			memcpy(dst + op, dictionary + dictionarysize - (offset - op), n);
+			op += n;
+			match -= n;
+		}
+		if (offset >= match)
+		{
+			memcpy(dst + op, dst + op - offset, match);
 		}
 		else
 		{
-			break;
+			/* a reference overlapping its own output repeats the last 'offset' bytes */
+			for (i = 0; i < match; i++)
+				dst[op + i] = dst[op + i - offset];
 		}
+		op += match;
 	}
 
-	return FASTMAP_NOT_FOUND;
+	return op == rawsize;
 }
 
-int fastmap_inhandle_get(fastmap_inhandle_t *ihandle, fastmap_record_t *record)
+int fastmap_attr_setformat(fastmap_attr_t *attr, const fastmap_format_t format)
 {
-	size_t recordindex;
-	size_t offset;
-	size_t currentpage, currentkey;
-	int currentlevel, ord;
+	attr->format = format;
+	return FASTMAP_OK;
+}
 
-	if (ihandle->handle.numlevels == 0)
+int fastmap_attr_getformat(fastmap_attr_t *attr, fastmap_format_t *format)
+{
+	*format = attr->format;
+	return FASTMAP_OK;
+}
+
+/* Number of search page levels needed above the leaf pages of a map */
+static int _searchlevels(size_t records, size_t recordsperleafpage, size_t keyspersearchpage)
+{
+	size_t pagesperlevel = (records + recordsperleafpage - 1) / recordsperleafpage;
+	int levels = 0;
+
+	/* every page but the first of a level contributes a key to the level above */
+	while (pagesperlevel > 1)
 	{
-		offset = ihandle->handle.firstleafpageoffset;
+		pagesperlevel = (pagesperlevel - 1 + keyspersearchpage - 1) / keyspersearchpage;
+		levels++;
 	}
-	else
-	{
-		currentlevel = ihandle->handle.numlevels;
-		offset = ihandle->handle.perlevel[currentlevel - 1].firstoffset;
-		currentpage = 0;
-		while (currentlevel > 0)
-		{
-			while (currentpage < ihandle->handle.perlevel[currentlevel - 1].pages)
-			{
-				for (currentkey = 0; currentkey < ihandle->handle.keyspersearchpage; currentkey++)
-				{
-					ord = ihandle->cmp(&ihandle->handle.attr, record->atom.key, (char*)ihandle->mmapaddr + offset);
 
-					if (ord > 0 && offset != ihandle->handle.perlevel[currentlevel - 1].lastoffset)
-					{
-						offset += ihandle->handle.attr.ksize;
-						continue;
-					}
-					else
-					{
-						currentpage = (currentpage * ihandle->handle.keyspersearchpage) + currentkey;
+	return levels;
+}
 
-						if (ord >= 0)
-						{
-							currentpage++;
-						}
+/* Release the buffers in which packed leaf pages and variable length search pages are built */
+static void _freepagebuffers(fastmap_outhandle_t *ohandle)
+{
+	int i;
 
-						if (currentlevel == 1)
-						{
-							offset = ihandle->handle.firstleafpageoffset;
-						}
-						else
-						{
+	free(ohandle->leafpage);
+	free(ohandle->lastkey);
+	free(ohandle->atoms);
+	free(ohandle->directory);
+	free(ohandle->valueblock);
+	free(ohandle->valueblockdirectory);
+	free(ohandle->compressed);
+	free(ohandle->lztable);
+	free(ohandle->deduptable);
+	free(ohandle->dedupbuffer);
+	free(ohandle->aggregates);
+	ohandle->leafpage = NULL;
+	ohandle->lastkey = NULL;
+	ohandle->atoms = NULL;
+	ohandle->directory = NULL;
+	ohandle->valueblock = NULL;
+	ohandle->valueblockdirectory = NULL;
+	ohandle->compressed = NULL;
+	ohandle->lztable = NULL;
+	ohandle->deduptable = NULL;
+	ohandle->dedupbuffer = NULL;
+	ohandle->aggregates = NULL;
+
+	for (i = 0; i < FASTMAP_MAXLEVELS; i++)
+	{
+		free(ohandle->levelinfo[i].page);
+		ohandle->levelinfo[i].page = NULL;
+	}
+}
+
+/* Size of the key of a record in a map with variable length keys */
+static size_t _recordksize(fastmap_format_t format, const fastmap_record_t *record)
+{
+	switch (format)
+	{
+	case FASTMAP_PAIR:
+		return record->pair.ksize;
+	case FASTMAP_BLOCK:
+		return record->block.ksize;
+	case FASTMAP_BLOB:
+		return record->blob.ksize;
+	default:
+		return record->atom.ksize;
+	}
+}
+
+/* Point the key of a record at 'key', of 'ksize' bytes */
+static void _setrecordkey(fastmap_format_t format, fastmap_record_t *record, const void *key, size_t ksize)
+{
+	switch (format)
+	{
+	case FASTMAP_PAIR:
+		record->pair.key = (void*)key;
+		record->pair.ksize = ksize;
+		break;
+	case FASTMAP_BLOCK:
+		record->block.key = (void*)key;
+		record->block.ksize = ksize;
+		break;
+	case FASTMAP_BLOB:
+		record->blob.key = (void*)key;
+		record->blob.ksize = ksize;
+		break;
+	default:
+		record->atom.key = (void*)key;
+		record->atom.ksize = ksize;
+		break;
+	}
+}
+
+/* Compressed values are only supported by #FASTMAP_BLOB maps */
+static int _validvaluecompression(const fastmap_attr_t *attr)
+{
+	if (attr->valueblocksize == 0)
+		return 1;
+
+	return attr->format == FASTMAP_BLOB && attr->valueblocksize <= FASTMAP_MAXVALUEBLOCKSIZE;
+}
+
+/* Deduplicated values are only supported by #FASTMAP_BLOB maps */
+static int _validvaluededup(const fastmap_attr_t *attr)
+{
+	return attr->dedupentries == 0 || (attr->format == FASTMAP_BLOB && attr->dedupentries <= FASTMAP_MAXDEDUPENTRIES);
+}
+
+/* Set up the table of values written, of a power of two entries, and the buffer in which earlier values are read back */
+static int _initvaluededup(fastmap_outhandle_t *ohandle, const fastmap_attr_t *attr)
+{
+	size_t entries = 1;
+
+	while (entries < attr->dedupentries)
+		entries <<= 1;
+
+	ohandle->handle.flags |= FASTMAP_SHARED_VALUES;
+	ohandle->dedupstats.tableentries = entries;
+	ohandle->dedupbuffersize = 4096;
+	ohandle->deduptable = calloc(entries, sizeof(struct _dedupentry));
+	ohandle->dedupbuffer = malloc(ohandle->dedupbuffersize);
+	if (ohandle->deduptable == NULL || ohandle->dedupbuffer == NULL)
+		return ENOMEM;
+	return FASTMAP_OK;
+}
+
+/* Set up the buffer in which values are gathered into a block. A dictionary, if one is set, is
+ * copied in ahead of the block so that the compressor finds references into it as into the block */
+static int _initvalueblocks(fastmap_outhandle_t *ohandle, const fastmap_attr_t *attr)
+{
+	ohandle->handle.flags |= FASTMAP_COMPRESSED_VALUES;
+	ohandle->handle.attr.dictionarysize = 0;
+	ohandle->valueblockcapacity = attr->valueblocksize;
+	ohandle->compressedvalueoffset = ohandle->handle.firstvalueoffset;
+
+	ohandle->valueblock = malloc(ohandle->valueblockcapacity);
+	ohandle->compressed = malloc(ohandle->valueblockcapacity);
+	ohandle->lztable = malloc(((size_t)1 << FASTMAP_LZHASHBITS) * sizeof(uint32_t));
+	if (ohandle->valueblock == NULL || ohandle->compressed == NULL || ohandle->lztable == NULL)
+		return ENOMEM;
+	return FASTMAP_OK;
+}
+
+/* Stamp the header of a map being written, which stays marked invalid until the map is complete */
+static void _writeheader(fastmap_outhandle_t *ohandle)
+{
+	ohandle->handle.magic = FASTMAP_MAGIC;
+	ohandle->handle.version = FASTMAP_VERSION;
+	ohandle->handle.flags |= FASTMAP_INVALID_MAP;
+	lseek(ohandle->fd, 0L, SEEK_SET);
+	write(ohandle->fd, &(ohandle->handle), sizeof(ohandle->handle));
+}
+
+/* Lay out a map of encoded atoms: the header, a directory of partitions, then the partitions.
+ * A roaring set has one partition per chunk holding keys, which is only known once it is written,
+ * so its directory is kept in memory and written after the partitions */
+static int _initencodedatoms(fastmap_outhandle_t *ohandle)
+{
+	const int roaring = (ohandle->handle.attr.atomencoding == FASTMAP_ATOM_ROARING);
+	const size_t partitions = roaring ? MIN(ohandle->handle.attr.records, FASTMAP_ROARINGCHUNK) :
+		(ohandle->handle.attr.records + FASTMAP_EFPARTITION - 1) / FASTMAP_EFPARTITION;
+
+	if (ohandle->handle.attr.format != FASTMAP_ATOM || ohandle->handle.attr.keyfields != 1 || ohandle->handle.attr.variablekeys ||
+		ohandle->handle.attr.restartinterval > 0 || ohandle->handle.attr.truncateseparators ||
+		(roaring && ohandle->handle.attr.keyschema[0] != FASTMAP_KEY_U32))
+		return EINVAL;
+
+	if (roaring)
+	{
+		ohandle->handle.leafpagerecordsize = sizeof(struct _atompartition);
+		ohandle->handle.recordsperleafpage = FASTMAP_ROARINGCHUNK;
+		ohandle->handle.leafpages = 0;
+		ohandle->handle.numlevels = 0;
+		ohandle->handle.firstvalueoffset = ALIGN_TO_PAGE_OFFSET(ALIGN_TO_PAGE_OFFSET(sizeof(ohandle->handle), ohandle->handle.pagesize), ohandle->handle.attr.sectionalign);
+		ohandle->handle.firstleafpageoffset = ohandle->handle.firstvalueoffset;
+		ohandle->currentvalueoffset = ohandle->handle.firstvalueoffset;
+		ohandle->handle.flags |= FASTMAP_ROARING;
+
+		/* no container is larger than a bitmap */
+		ohandle->atoms = calloc(FASTMAP_ROARINGCHUNK, sizeof(uint64_t));
+		ohandle->leafpage = calloc(1, sizeof(struct _roaringcontainer) + FASTMAP_ROARINGCHUNK / 8);
+		ohandle->directory = calloc(MAX(partitions, 1), sizeof(struct _atompartition));
+		if (ohandle->atoms == NULL || ohandle->leafpage == NULL || ohandle->directory == NULL)
+			return ENOMEM;
+
+		return FASTMAP_OK;
+	}
+
+	ohandle->handle.leafpagerecordsize = sizeof(struct _atompartition);
+	ohandle->handle.recordsperleafpage = FASTMAP_EFPARTITION;
+	ohandle->handle.leafpages = partitions;
+	ohandle->handle.numlevels = 0;
+	ohandle->handle.firstleafpageoffset = ALIGN_TO_PAGE_OFFSET(ALIGN_TO_PAGE_OFFSET(sizeof(ohandle->handle), ohandle->handle.pagesize), ohandle->handle.attr.sectionalign);
+	ohandle->handle.firstvalueoffset = ALIGN_TO_PAGE_OFFSET(ohandle->handle.firstleafpageoffset + (partitions * sizeof(struct _atompartition)), ohandle->handle.pagesize);
+	ohandle->currentvalueoffset = ohandle->handle.firstvalueoffset;
+	ohandle->handle.flags |= FASTMAP_ELIAS_FANO;
+
+	/* a partition takes at most a whole key per key, and less than three bits per key of unary code */
+	ohandle->atoms = calloc(FASTMAP_EFPARTITION, sizeof(uint64_t));
+	ohandle->leafpage = calloc(1, 1 + FASTMAP_EFPARTITION * sizeof(uint64_t) + (FASTMAP_EFPARTITION * 3 / 64 + 1) * sizeof(uint64_t));
+	if (ohandle->atoms == NULL || ohandle->leafpage == NULL)
+		return ENOMEM;
+
+	return FASTMAP_OK;
+}
+
+int fastmap_outhandle_init(fastmap_outhandle_t *ohandle, const fastmap_attr_t *attr, const char *pathname)
+{
+	struct stat st;
+	int rc = FASTMAP_OK;
+
+	if (ohandle == NULL || attr == NULL)
+		return EINVAL;
+
+	memset(ohandle, 0, sizeof(*ohandle));
+	memcpy(&ohandle->handle.attr, attr, sizeof(*attr));
+	ohandle->fd = -1;
+
+	if (!_validkeyschema(attr) || !_validvaluecompression(attr) || !_validvaluededup(attr) || !_validvalueaggregate(attr))
+		return EINVAL;
+
+	/* read access lets a front-coded map move its value pages down once the leaf pages are written,
+	 * and a map of deduplicated values compare values with those already written */
+	ohandle->fd = open(pathname, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (ohandle->fd == -1)
+	{
+		rc = errno;
+		goto fail;
+	}
+
+	if (fstat(ohandle->fd, &st) == -1)
+	{
+		rc = errno;
+		goto fail;
+	}
+
+	if (ohandle->handle.attr.valuebytes == 0)
+		ohandle->handle.valueptrsize = FASTMAP_DEFAULT_VALUEPTR;
+	else if ((uint64_t)ohandle->handle.attr.valuebytes <= 0xFFFFFFFFULL)
+		ohandle->handle.valueptrsize = FASTMAP_NARROW_VALUEPTR;
+	else if ((uint64_t)ohandle->handle.attr.valuebytes <= 0xFFFFFFFFFFULL)
+		ohandle->handle.valueptrsize = FASTMAP_DEFAULT_VALUEPTR;
+	else
+		ohandle->handle.valueptrsize = FASTMAP_WIDE_VALUEPTR;
+
+	if (ohandle->handle.attr.pagesize == 0)
+		ohandle->handle.pagesize = (uint32_t)st.st_blksize;
+	else
+		ohandle->handle.pagesize = (uint32_t)ohandle->handle.attr.pagesize;
+
+	if (!IS_POWER_OF_TWO(ohandle->handle.pagesize) || (ohandle->handle.attr.sectionalign != 0 && !IS_POWER_OF_TWO(ohandle->handle.attr.sectionalign)))
+	{
+		rc = EINVAL;
+		goto fail;
+	}
+
+	if (ohandle->handle.attr.sectionalign < ohandle->handle.pagesize)
+		ohandle->handle.attr.sectionalign = ohandle->handle.pagesize;
+
+	/* records need not divide the page, any slack at the end of a page is left unused,
+	 * but a search page must hold at least two keys for the levels to converge */
+	if (ohandle->handle.attr.ksize == 0 || ohandle->handle.pagesize / ohandle->handle.attr.ksize < 2)
+	{
+		rc = EINVAL;
+		goto fail;
+	}
+
+	ohandle->handle.keyspersearchpage = ohandle->handle.pagesize / ohandle->handle.attr.ksize;
+
+	if (ohandle->handle.attr.atomencoding != FASTMAP_ATOM_SORTED)
+	{
+		if ((rc = _initencodedatoms(ohandle)) != FASTMAP_OK)
+			goto fail;
+		_writeheader(ohandle);
+		goto success;
+	}
+
+	switch (ohandle->handle.attr.format)
+	{
+	case FASTMAP_ATOM:
+		ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize;
+		break;
+	case FASTMAP_PAIR:
+		ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize * 2;
+		break;
+	case FASTMAP_BLOCK:
+		/* an inline block lowers the leaf fanout, but saves touching a value page on every lookup,
+		 * so inline unless the extra search levels cost more page touches than the value page */
+		if (ohandle->handle.attr.ksize + ohandle->handle.attr.vsize <= ohandle->handle.pagesize &&
+			_searchlevels(ohandle->handle.attr.records, ohandle->handle.pagesize / (ohandle->handle.attr.ksize + ohandle->handle.attr.vsize), ohandle->handle.keyspersearchpage) <=
+			_searchlevels(ohandle->handle.attr.records, ohandle->handle.pagesize / ohandle->handle.attr.ksize, ohandle->handle.keyspersearchpage) + 1)
+		{
+			ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize + ohandle->handle.attr.vsize;
+			ohandle->handle.flags |= FASTMAP_INLINE_BLOCK;
+		}
+		else
+		{
+			ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize;
+		}
+		break;
+	case FASTMAP_BLOB:
+		if (ohandle->handle.attr.inlinevsize > FASTMAP_MAXINLINEVSIZE)
+		{
+			rc = EINVAL;
+			goto fail;
+		}
+
+		if (ohandle->handle.attr.inlinevsize > 0)
+		{
+			/* key, a one byte size tag, then either the inline value or a value pointer */
+			ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize + 1 + MAX(ohandle->handle.attr.inlinevsize, ohandle->handle.valueptrsize);
+			ohandle->handle.flags |= FASTMAP_INLINE_BLOB;
+		}
+		else
+		{
+			/* values are stored back to back, a value's size is the distance to the next value
+			 * pointer, so each leaf page ends with a pointer past its last value */
+			ohandle->handle.leafpagerecordsize = ohandle->handle.attr.ksize + ohandle->handle.valueptrsize;
+		}
+		break;
+	default:
+		rc = EINVAL;
+		goto fail;
+	}
+
+	if (ohandle->handle.attr.format == FASTMAP_BLOB && !(ohandle->handle.flags & FASTMAP_INLINE_BLOB))
+		ohandle->handle.recordsperleafpage = (ohandle->handle.pagesize - ohandle->handle.valueptrsize) / ohandle->handle.leafpagerecordsize;
+	else
+		ohandle->handle.recordsperleafpage = ohandle->handle.pagesize / ohandle->handle.leafpagerecordsize;
+
+	if (ohandle->handle.attr.variablekeys)
+	{
+		/* size the map for pages of the longest keys, and hand back the pages which prove
+		 * unnecessary once it is written, as with front coding */
+		if (ohandle->handle.attr.format == FASTMAP_PAIR || ohandle->handle.attr.restartinterval > 0 || ohandle->handle.attr.ksize > UINT32_MAX ||
+			ohandle->handle.pagesize < sizeof(struct _leafpageheader) + sizeof(struct _keyslot) + ohandle->handle.leafpagerecordsize)
+		{
+			rc = EINVAL;
+			goto fail;
+		}
+
+		ohandle->handle.recordsperleafpage = (ohandle->handle.pagesize - sizeof(struct _leafpageheader)) / (sizeof(struct _keyslot) + ohandle->handle.leafpagerecordsize);
+		ohandle->handle.flags |= FASTMAP_VARIABLE_KEYS;
+
+		ohandle->leafpage = calloc(1, ohandle->handle.pagesize);
+		if (ohandle->leafpage == NULL)
+		{
+			rc = ENOMEM;
+			goto fail;
+		}
+	}
+	else if (ohandle->handle.attr.restartinterval > 0)
+	{
+		/* a key can share nothing with the one before it, so size the map for pages of whole keys,
+		 * each with a restart point, and hand back the pages which prove unnecessary once it is written */
+		size_t maxentrysize = 2 * _varintsize(ohandle->handle.attr.ksize) + ohandle->handle.leafpagerecordsize + FASTMAP_RESTARTSIZE;
+
+		if (ohandle->handle.attr.ksize > FASTMAP_MAXFRONTCODEDKSIZE || ohandle->handle.pagesize < sizeof(struct _leafpageheader) + maxentrysize)
+		{
+			rc = EINVAL;
+			goto fail;
+		}
+
+		ohandle->handle.recordsperleafpage = (ohandle->handle.pagesize - sizeof(struct _leafpageheader)) / maxentrysize;
+		ohandle->handle.flags |= FASTMAP_FRONT_CODED;
+
+		ohandle->leafpage = calloc(1, ohandle->handle.pagesize);
+		ohandle->lastkey = calloc(1, ohandle->handle.attr.ksize);
+		if (ohandle->leafpage == NULL || ohandle->lastkey == NULL)
+		{
+			rc = ENOMEM;
+			goto fail;
+		}
+	}
+
+	if (ohandle->handle.attr.truncateseparators || (ohandle->handle.flags & FASTMAP_VARIABLE_KEYS))
+	{
+		/* a separator is never longer than a key, so size the search levels for whole keys */
+		if (ohandle->handle.attr.ksize > UINT32_MAX ||
+			ohandle->handle.pagesize < sizeof(struct _searchpageheader) + 2 * (sizeof(struct _keyslot) + ohandle->handle.attr.ksize))
+		{
+			rc = EINVAL;
+			goto fail;
+		}
+
+		ohandle->handle.keyspersearchpage = (ohandle->handle.pagesize - sizeof(struct _searchpageheader)) / (sizeof(struct _keyslot) + ohandle->handle.attr.ksize);
+		ohandle->handle.flags |= FASTMAP_TRUNCATED_SEPARATORS;
+
+		ohandle->lastkey = ohandle->lastkey ? ohandle->lastkey : calloc(1, ohandle->handle.attr.ksize);
+		if (ohandle->lastkey == NULL)
+		{
+			rc = ENOMEM;
+			goto fail;
+		}
+	}
+
+	/* every encoding of a single typed field orders as the unsigned integer its bytes spell */
+	if (ohandle->handle.attr.keyfields == 1 && !(ohandle->handle.flags & (FASTMAP_PACKED_LEAVES | FASTMAP_TRUNCATED_SEPARATORS)))
+		ohandle->handle.flags |= FASTMAP_INTEGER_KEYS;
+
+	if (ohandle->handle.recordsperleafpage == 0)
+	{
+		rc = EINVAL;
+		goto fail;
+	}
+
+	ohandle->handle.leafpages = (size_t)ceil((double)ohandle->handle.attr.records / (double)ohandle->handle.recordsperleafpage);
+
+	ohandle->handle.numlevels = 0;
+	{
+		/* the header fills as many pages as it needs */
+		size_t firstleafpageoffset = ALIGN_TO_PAGE_OFFSET(sizeof(ohandle->handle), ohandle->handle.pagesize);
+		size_t pagesperlevel = ohandle->handle.leafpages;
+		int i;
+
+		while (pagesperlevel > 1)
+		{
+			if (ohandle->handle.numlevels == FASTMAP_MAXLEVELS)
+			{
+				rc = FASTMAP_TOO_MANY_LEVELS;
+				goto fail;
+			}
+			pagesperlevel = (size_t)ceil((double)(pagesperlevel - 1) / (double)ohandle->handle.keyspersearchpage);
+			ohandle->handle.perlevel[ohandle->handle.numlevels++].pages = pagesperlevel;
+			firstleafpageoffset += pagesperlevel * ohandle->handle.pagesize;
+		}
+
+		ohandle->handle.firstleafpageoffset = ALIGN_TO_PAGE_OFFSET(firstleafpageoffset + ohandle->handle.pagesize, ohandle->handle.attr.sectionalign);
+
+		for (i = 0; i < ohandle->handle.numlevels; i++)
+		{
+			firstleafpageoffset -= ohandle->handle.perlevel[i].pages * ohandle->handle.pagesize;
+			ohandle->handle.perlevel[i].firstoffset = firstleafpageoffset;
+			ohandle->levelinfo[i].currentoffset = firstleafpageoffset;
+		}
+	}
+
+	ohandle->currentleafpageoffset = ohandle->handle.firstleafpageoffset;
+
+	if (ohandle->handle.flags & FASTMAP_TRUNCATED_SEPARATORS)
+	{
+		int i;
+
+		for (i = 0; i < ohandle->handle.numlevels; i++)
+		{
+			if ((ohandle->levelinfo[i].page = calloc(1, ohandle->handle.pagesize)) == NULL)
+			{
+				rc = ENOMEM;
+				goto fail;
+			}
+		}
+	}
+
+	if (ohandle->handle.attr.format == FASTMAP_BLOB || (ohandle->handle.attr.format == FASTMAP_BLOCK && !(ohandle->handle.flags & FASTMAP_INLINE_BLOCK)))
+	{
+		ohandle->handle.firstvalueoffset = ALIGN_TO_PAGE_OFFSET(ohandle->handle.firstleafpageoffset + (ohandle->handle.pagesize * ohandle->handle.leafpages), ohandle->handle.attr.sectionalign);
+		ohandle->currentvalueoffset = ohandle->handle.firstvalueoffset;
+	}
+
+	if (attr->valueblocksize > 0)
+	{
+		if ((rc = _initvalueblocks(ohandle, attr)) != FASTMAP_OK)
+			goto fail;
+	}
+	else
+	{
+		ohandle->handle.attr.dictionarysize = 0;
+	}
+
+	if (attr->dedupentries > 0 && (rc = _initvaluededup(ohandle, attr)) != FASTMAP_OK)
+		goto fail;
+
+	/* aggregates follow the records of fixed size leaf pages */
+	if (attr->valueaggregate != 0)
+	{
+		if (ohandle->handle.flags & FASTMAP_PACKED_LEAVES)
+		{
+			rc = EINVAL;
+			goto fail;
+		}
+		if ((ohandle->aggregates = calloc(MAX(ohandle->handle.leafpages, 1), sizeof(fastmap_aggregate_t))) == NULL)
+		{
+			rc = ENOMEM;
+			goto fail;
+		}
+		ohandle->handle.flags |= FASTMAP_AGGREGATES;
+	}
+
+	_writeheader(ohandle);
+
+	goto success;
+fail:
+	if (ohandle->fd != -1 && close(ohandle->fd) == -1)
+		rc = errno;
+	_freepagebuffers(ohandle);
+success:
+	return rc;
+}
+
+/* Compress the block of values being gathered and write it out, noting it in the directory of blocks */
+static int _flushvalueblock(fastmap_outhandle_t *ohandle)
+{
+	const size_t dictionarysize = ohandle->handle.attr.dictionarysize;
+	struct _valueblock block;
+	const unsigned char *data;
+	unsigned char *directory;
+	size_t capacity;
+
+	if (ohandle->valueblockused == 0)
+		return FASTMAP_OK;
+
+	if (ohandle->handle.valueblocks == ohandle->valueblockdirectorycapacity)
+	{
+		capacity = MAX(2 * ohandle->valueblockdirectorycapacity, 64);
+		if ((directory = realloc(ohandle->valueblockdirectory, capacity * sizeof(block))) == NULL)
+			return ENOMEM;
+		ohandle->valueblockdirectory = directory;
+		ohandle->valueblockdirectorycapacity = capacity;
+	}
+
+	block.start = (ohandle->currentvalueoffset - ohandle->handle.firstvalueoffset) - ohandle->valueblockused;
+	block.rawsize = ohandle->valueblockused;
+	block.size = _lzcompress(ohandle->valueblock, dictionarysize, dictionarysize + ohandle->valueblockused, ohandle->compressed, ohandle->valueblockused, ohandle->lztable);
+	data = ohandle->compressed;
+	if (block.size == 0)
+	{
+		block.size = block.rawsize;
+		data = ohandle->valueblock + dictionarysize;
+	}
+	block.offset = ohandle->compressedvalueoffset - ohandle->handle.firstvalueoffset;
+
+	if (pwrite(ohandle->fd, data, (size_t)block.size, (off_t)ohandle->compressedvalueoffset) != (ssize_t)block.size)
+		return errno ? errno : EIO;
+
+	memcpy(ohandle->valueblockdirectory + (ohandle->handle.valueblocks * sizeof(block)), &block, sizeof(block));
+	ohandle->handle.valueblocks++;
+	ohandle->compressedvalueoffset += (size_t)block.size;
+	ohandle->valueblockused = 0;
+	return FASTMAP_OK;
+}
+
+/* Append a value, after its size if 'prefix' is not NULL, to the value pages. Value pointers
+ * locate values in the uncompressed value pages, whether or not they are compressed */
+static int _putvalue(fastmap_outhandle_t *ohandle, const void *prefix, size_t prefixsize, const void *value, size_t vsize)
+{
+	const size_t dictionarysize = ohandle->handle.attr.dictionarysize;
+	unsigned char *buffer;
+	size_t size = prefixsize + vsize;
+	int rc;
+
+	if (!(ohandle->handle.flags & FASTMAP_COMPRESSED_VALUES))
+	{
+		lseek(ohandle->fd, ohandle->currentvalueoffset, SEEK_SET);
+		if (prefixsize > 0)
+			write(ohandle->fd, prefix, prefixsize);
+		write(ohandle->fd, value, vsize);
+		ohandle->currentvalueoffset += size;
+		return FASTMAP_OK;
+	}
+
+	/* a value is never split between blocks, so a single value may make a block of its own larger than the block size */
+	if (ohandle->valueblockused > 0 && ohandle->valueblockused + size > ohandle->handle.attr.valueblocksize && (rc = _flushvalueblock(ohandle)) != FASTMAP_OK)
+		return rc;
+
+	if (size > ohandle->valueblockcapacity)
+	{
+		if ((buffer = realloc(ohandle->valueblock, dictionarysize + size)) == NULL)
+			return ENOMEM;
+		ohandle->valueblock = buffer;
+		if ((buffer = realloc(ohandle->compressed, size)) == NULL)
+			return ENOMEM;
+		ohandle->compressed = buffer;
+		ohandle->valueblockcapacity = size;
+	}
+
+	buffer = ohandle->valueblock + dictionarysize + ohandle->valueblockused;
+	if (prefixsize > 0)
+		memcpy(buffer, prefix, prefixsize);
+	if (vsize > 0)
+		memcpy(buffer + prefixsize, value, vsize);
+	ohandle->valueblockused += size;
+	ohandle->currentvalueoffset += size;
+	return FASTMAP_OK;
+}
+
+static uint64_t _valuehash(const unsigned char *p, size_t size)
+{
+	uint64_t h = (uint64_t)size * 0x9E3779B97F4A7C15ULL, v;
+	size_t i;
+
+	for (i = 0; i < size; i += sizeof(v))
+	{
+		v = 0;
+		memcpy(&v, p + i, MIN(sizeof(v), size - i));
+		h = (h ^ v) * 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 32;
+	}
+
+	return h;
+}
+
+/* Make room for 'size' bytes in the buffer in which earlier values are read back */
+static int _growdedupbuffer(fastmap_outhandle_t *ohandle, size_t size)
+{
+	unsigned char *buffer;
+
+	if (size <= ohandle->dedupbuffersize)
+		return 1;
+	if ((buffer = realloc(ohandle->dedupbuffer, size)) == NULL)
+		return 0;
+	ohandle->dedupbuffer = buffer;
+	ohandle->dedupbuffersize = size;
+	ohandle->dedupblock = 0;
+	return 1;
+}
+
+/* Compare a value with the one written at 'offset' in the uncompressed value pages. A value in a
+ * block already compressed is compared in its decompressed block, the last of which is kept */
+static int _samevalue(fastmap_outhandle_t *ohandle, size_t offset, const unsigned char *value, size_t vsize)
+{
+	const size_t dictionarysize = ohandle->handle.attr.dictionarysize;
+	size_t blockstart, lo, hi, mid, n, done;
+	struct _valueblock block;
+
+	offset += ohandle->handle.valueptrsize;
+	if (!(ohandle->handle.flags & FASTMAP_COMPRESSED_VALUES))
+	{
+		for (done = 0; done < vsize; done += n)
+		{
+			n = MIN(ohandle->dedupbuffersize, vsize - done);
+			if (pread(ohandle->fd, ohandle->dedupbuffer, n, (off_t)(ohandle->handle.firstvalueoffset + offset + done)) != (ssize_t)n ||
+				memcmp(ohandle->dedupbuffer, value + done, n) != 0)
+				return 0;
+		}
+		return 1;
+	}
+
+	blockstart = (ohandle->currentvalueoffset - ohandle->handle.firstvalueoffset) - ohandle->valueblockused;
+	if (offset >= blockstart)
+		return memcmp(ohandle->valueblock + dictionarysize + (offset - blockstart), value, vsize) == 0;
+
+	lo = 0;
+	hi = ohandle->handle.valueblocks;
+	while (hi - lo > 1)
+	{
+		mid = lo + (hi - lo) / 2;
+		memcpy(&block, ohandle->valueblockdirectory + (mid * sizeof(block)), sizeof(block));
+		if (block.start <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	memcpy(&block, ohandle->valueblockdirectory + (lo * sizeof(block)), sizeof(block));
+
+	if (ohandle->dedupblock != lo + 1)
+	{
+		if (!_growdedupbuffer(ohandle, (size_t)(block.rawsize + block.size)))
+			return 0;
+
+		/* the compressed bytes are read after room for the decompressed block */
+		if (pread(ohandle->fd, ohandle->dedupbuffer + block.rawsize, (size_t)block.size, (off_t)(ohandle->handle.firstvalueoffset + block.offset)) != (ssize_t)block.size)
+			return 0;
+		if (block.size == block.rawsize)
+			memcpy(ohandle->dedupbuffer, ohandle->dedupbuffer + block.rawsize, (size_t)block.size);
+		else if (!_lzdecompress(ohandle->dedupbuffer + block.rawsize, (size_t)block.size, ohandle->valueblock, dictionarysize, ohandle->dedupbuffer, (size_t)block.rawsize))
+			return 0;
+		ohandle->dedupblock = lo + 1;
+	}
+
+	return memcmp(ohandle->dedupbuffer + (offset - block.start), value, vsize) == 0;
+}
+
+/* Find the offset at which to point a record at its value. A value equal to one in the table of
+ * values written is shared, and 1 returned. Otherwise the value is entered in the table at the
+ * offset it is about to be written to, and 0 returned */
+static int _dedupvalue(fastmap_outhandle_t *ohandle, const void *value, size_t vsize, size_t *offset)
+{
+	struct _dedupentry *entry;
+	uint64_t hash;
+
+	*offset = ohandle->currentvalueoffset - ohandle->handle.firstvalueoffset;
+	if (!(ohandle->handle.flags & FASTMAP_SHARED_VALUES) || vsize == 0)
+		return 0;
+
+	hash = _valuehash(value, vsize);
+	entry = (struct _dedupentry*)ohandle->deduptable + (hash & (ohandle->dedupstats.tableentries - 1));
+	ohandle->dedupstats.values++;
+
+	if (entry->vsize == vsize && entry->hash == hash && _samevalue(ohandle, (size_t)entry->offset, value, vsize))
+	{
+		*offset = (size_t)entry->offset;
+		ohandle->dedupstats.duplicates++;
+		ohandle->dedupstats.savedbytes += ohandle->handle.valueptrsize + vsize;
+		return 1;
+	}
+
+	if (entry->vsize > 0)
+		ohandle->dedupstats.evictions++;
+	entry->hash = hash;
+	entry->offset = *offset;
+	entry->vsize = vsize;
+	return 0;
+}
+
+/* Write out the last block of values, then the directory of blocks, then the dictionary.
+ * From here on the value pages end where these do, rather than where the uncompressed values would */
+static int _finishvalueblocks(fastmap_outhandle_t *ohandle)
+{
+	const size_t dictionarysize = ohandle->handle.attr.dictionarysize;
+	size_t directorysize;
+	int rc;
+
+	if ((rc = _flushvalueblock(ohandle)) != FASTMAP_OK)
+		return rc;
+
+	directorysize = ohandle->handle.valueblocks * sizeof(struct _valueblock);
+
+	ohandle->handle.valueblockoffset = ohandle->compressedvalueoffset - ohandle->handle.firstvalueoffset;
+	if ((directorysize > 0 && pwrite(ohandle->fd, ohandle->valueblockdirectory, directorysize, (off_t)ohandle->compressedvalueoffset) != (ssize_t)directorysize) ||
+		(dictionarysize > 0 && pwrite(ohandle->fd, ohandle->valueblock, dictionarysize, (off_t)(ohandle->compressedvalueoffset + directorysize)) != (ssize_t)dictionarysize))
+		return errno ? errno : EIO;
+
+	ohandle->currentvalueoffset = ohandle->compressedvalueoffset + directorysize + dictionarysize;
+	if (ftruncate(ohandle->fd, (off_t)ohandle->currentvalueoffset) == -1)
+		return errno;
+	return FASTMAP_OK;
+}
+
+/* Close out the current leaf page of a #FASTMAP_BLOB map by storing the end of its last value */
+static void _writevaluetrailer(fastmap_outhandle_t *ohandle)
+{
+	unsigned char valueptr[FASTMAP_WIDE_VALUEPTR];
+	size_t page;
+
+	if (ohandle->handle.flags & FASTMAP_INLINE_BLOB)
+		return;
+
+	page = (ohandle->records - 1) / ohandle->handle.recordsperleafpage;
+	_putvalueptr(valueptr, ohandle->currentvalueoffset - ohandle->handle.firstvalueoffset, ohandle->handle.valueptrsize);
+	lseek(ohandle->fd, ohandle->handle.firstleafpageoffset + (page * ohandle->handle.pagesize) + (ohandle->handle.recordsperleafpage * ohandle->handle.leafpagerecordsize), SEEK_SET);
+	write(ohandle->fd, valueptr, ohandle->handle.valueptrsize);
+}
+
+int fastmap_outhandle_destroy(fastmap_outhandle_t *ohandle)
+{
+	int rc = FASTMAP_OK;
+
+	if (ohandle == NULL || ohandle->fd == -1)
+		return EINVAL;
+
+	if (!(ohandle->handle.flags & FASTMAP_INVALID_MAP))
+	{
+		rc = EINVAL;
+		goto success;
+	}
+
+	if (ohandle->records != ohandle->handle.attr.records)
+	{
+		rc = FASTMAP_EXPECTATION_FAILED;
+		goto success;
+	}
+
+	if (ohandle->handle.flags & FASTMAP_PACKED_LEAVES)
+	{
+		if ((ohandle->handle.flags & FASTMAP_COMPRESSED_VALUES) && (rc = _finishvalueblocks(ohandle)) != FASTMAP_OK)
+			goto success;
+		if ((rc = _finishpackedleaves(ohandle)) != FASTMAP_OK)
+			goto success;
+	}
+	else if (ohandle->handle.flags & FASTMAP_ELIAS_FANO)
+	{
+		if (ohandle->leafpageentries > 0 && (rc = _flusheliasfano(ohandle)) != FASTMAP_OK)
+			goto success;
+	}
+	else if (ohandle->handle.flags & FASTMAP_ROARING)
+	{
+		if ((ohandle->leafpageentries > 0 && (rc = _flushroaring(ohandle)) != FASTMAP_OK) || (rc = _writeroaringdirectory(ohandle)) != FASTMAP_OK)
+			goto success;
+		/* the map records the keys it holds */
+		ohandle->handle.attr.records -= ohandle->repeatedatoms;
+	}
+	else
+	{
+		if (ohandle->handle.attr.format == FASTMAP_BLOB && ohandle->records > 0)
+			_writevaluetrailer(ohandle);
+		if ((ohandle->handle.flags & FASTMAP_COMPRESSED_VALUES) && (rc = _finishvalueblocks(ohandle)) != FASTMAP_OK)
+			goto success;
+		if (ohandle->handle.flags & FASTMAP_TRUNCATED_SEPARATORS)
+			_finishsearchlevels(ohandle);
+		if ((ohandle->handle.flags & FASTMAP_AGGREGATES) && ohandle->records > 0 && (rc = _writeaggregates(ohandle)) != FASTMAP_OK)
+			goto success;
+	}
+
+	ohandle->handle.flags &= ~FASTMAP_INVALID_MAP;
+	lseek(ohandle->fd, 0L, SEEK_SET);
+	write(ohandle->fd , &(ohandle->handle), sizeof(ohandle->handle));
+	close(ohandle->fd);
+	ohandle->fd = -1;
+	_freepagebuffers(ohandle);
+success:
+	return rc;
+}
+
+int fastmap_outhandle_getdedupstats(fastmap_outhandle_t *ohandle, fastmap_dedupstats_t *stats)
+{
+	if (ohandle == NULL || stats == NULL)
+		return EINVAL;
+
+	memcpy(stats, &ohandle->dedupstats, sizeof(*stats));
+	return FASTMAP_OK;
+}
+
+int fastmap_outhandle_setdictionary(fastmap_outhandle_t *ohandle, const void *dictionary, const size_t size)
+{
+	unsigned char *buffer;
+
+	if (ohandle == NULL || !(ohandle->handle.flags & FASTMAP_INVALID_MAP) || !(ohandle->handle.flags & FASTMAP_COMPRESSED_VALUES) ||
+		ohandle->records > 0 || size > FASTMAP_MAXDICTIONARYSIZE || (dictionary == NULL && size > 0))
+		return EINVAL;
+
+	/* the dictionary is kept ahead of the block of values being gathered, and written after the directory of blocks */
+	if ((buffer = realloc(ohandle->valueblock, size + ohandle->valueblockcapacity)) == NULL)
+		return ENOMEM;
+	if (size > 0)
+		memcpy(buffer, dictionary, size);
+	ohandle->valueblock = buffer;
+	ohandle->handle.attr.dictionarysize = size;
+	return FASTMAP_OK;
+}
+
+/* Write out the variable length search page being filled at a level, and start the next one */
+static void _flushsearchpage(fastmap_outhandle_t *ohandle, int level)
+{
+	struct _searchpageheader header;
+
+	header.firstkey = ohandle->levelinfo[level].keys - ohandle->levelinfo[level].pagekeys;
+	header.keys = (uint32_t)ohandle->levelinfo[level].pagekeys;
+	header.unused = 0;
+	memcpy(ohandle->levelinfo[level].page, &header, sizeof(header));
+
+	lseek(ohandle->fd, ohandle->levelinfo[level].currentoffset, SEEK_SET);
+	write(ohandle->fd, ohandle->levelinfo[level].page, ohandle->handle.pagesize);
+	ohandle->levelinfo[level].currentoffset += ohandle->handle.pagesize;
+
+	memset(ohandle->levelinfo[level].page, 0, ohandle->handle.pagesize);
+	ohandle->levelinfo[level].pagekeys = 0;
+	ohandle->levelinfo[level].pageused = 0;
+}
+
+/* Add a variable length key to a search level, returns non-zero when the key begins a page
+ * other than the first of the level, and so must also be added to the level above */
+static int _putsearchkey(fastmap_outhandle_t *ohandle, int level, const void *key, size_t ksize)
+{
+	struct _keyslot slot;
+	int newpage = 0;
+
+	if (ohandle->levelinfo[level].pagekeys > 0 &&
+		sizeof(struct _searchpageheader) + (ohandle->levelinfo[level].pagekeys + 1) * sizeof(slot) + ohandle->levelinfo[level].pageused + ksize > ohandle->handle.pagesize)
+	{
+		_flushsearchpage(ohandle, level);
+		newpage = 1;
+	}
+
+	/* keys fill the page from its end, their slots from its start */
+	ohandle->levelinfo[level].pageused += ksize;
+	slot.offset = (uint32_t)(ohandle->handle.pagesize - ohandle->levelinfo[level].pageused);
+	slot.ksize = (uint32_t)ksize;
+	memcpy(ohandle->levelinfo[level].page + slot.offset, key, ksize);
+	memcpy(ohandle->levelinfo[level].page + sizeof(struct _searchpageheader) + (ohandle->levelinfo[level].pagekeys * sizeof(slot)), &slot, sizeof(slot));
+	ohandle->levelinfo[level].pagekeys++;
+	ohandle->levelinfo[level].keys++;
+
+	return newpage;
+}
+
+static void _updatesearchpagelevels(fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+{
+	const unsigned char *key = record->atom.key;
+	size_t ksize, separatorsize;
+	int i;
+
+	if (ohandle->handle.flags & FASTMAP_TRUNCATED_SEPARATORS)
+	{
+		/* the shortest prefix of the key which sorts after the last key of the page before it
+		 * divides the two pages as well as the whole key, and divides the levels above too */
+		ksize = (ohandle->handle.flags & FASTMAP_VARIABLE_KEYS) ? _recordksize(ohandle->handle.attr.format, record) : ohandle->handle.attr.ksize;
+		for (separatorsize = 0; separatorsize < ksize && separatorsize < ohandle->lastksize && key[separatorsize] == ohandle->lastkey[separatorsize]; separatorsize++)
+			;
+		separatorsize = MIN(separatorsize + 1, ksize);
+
+		for (i = 0; i < ohandle->handle.numlevels; i++)
+		{
+			if (!_putsearchkey(ohandle, i, key, separatorsize))
+				break;
+		}
+		return;
+	}
+
+	for (i = 0; i < ohandle->handle.numlevels; i++)
+	{
+		if (ohandle->levelinfo[i].keys % ohandle->handle.keyspersearchpage == 0)
+		{
+			ohandle->levelinfo[i].currentoffset = ALIGN_TO_PAGE_OFFSET(ohandle->levelinfo[i].currentoffset, ohandle->handle.pagesize);
+		}
+	
+		lseek(ohandle->fd, ohandle->levelinfo[i].currentoffset, SEEK_SET);
+		write(ohandle->fd, record->atom.key, ohandle->handle.attr.ksize);
+		ohandle->handle.perlevel[i].lastoffset = ohandle->levelinfo[i].currentoffset;
+		ohandle->levelinfo[i].currentoffset += ohandle->handle.attr.ksize;
+		ohandle->levelinfo[i].keys++;
+
+		if ((ohandle->levelinfo[i].keys < ohandle->handle.keyspersearchpage) || (ohandle->levelinfo[i].keys % ohandle->handle.keyspersearchpage != 1))
+			break;
+	}
+}
+
+/* Write out the front-coded leaf page being filled, and start the next one */
+static void _flushleafpage(fastmap_outhandle_t *ohandle)
+{
+	struct _leafpageheader header;
+
+	header.firstrecord = ohandle->records - ohandle->leafpageentries;
+	header.entries = (uint32_t)ohandle->leafpageentries;
+	header.restarts = (uint32_t)ohandle->leafpagerestarts;
+	memcpy(ohandle->leafpage, &header, sizeof(header));
+
+	lseek(ohandle->fd, ohandle->currentleafpageoffset, SEEK_SET);
+	write(ohandle->fd, ohandle->leafpage, ohandle->handle.pagesize);
+	ohandle->currentleafpageoffset += ohandle->handle.pagesize;
+	ohandle->leafpageswritten++;
+
+	memset(ohandle->leafpage, 0, ohandle->handle.pagesize);
+	ohandle->leafpageused = 0;
+	ohandle->leafpageentries = 0;
+	ohandle->leafpagerestarts = 0;
+}
+
+/* Size of the part of a packed leaf entry which follows the key */
+static size_t _entrypayloadsize(const fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+{
+	switch (ohandle->handle.attr.format)
+	{
+	case FASTMAP_PAIR:
+		return ohandle->handle.attr.ksize;
+	case FASTMAP_BLOCK:
+		return (ohandle->handle.flags & FASTMAP_INLINE_BLOCK) ? ohandle->handle.attr.vsize : 0;
+	case FASTMAP_BLOB:
+		if (!(ohandle->handle.flags & FASTMAP_INLINE_BLOB))
+			return ohandle->handle.valueptrsize;
+		if (record->blob.vsize <= ohandle->handle.attr.inlinevsize)
+			return 1 + record->blob.vsize;
+		return 1 + ohandle->handle.valueptrsize;
+	default:
+		return 0;
+	}
+}
+
+/* Store the part of a packed leaf entry which follows the key, writing out-of-line values to the value pages */
+static int _putentrypayload(fastmap_outhandle_t *ohandle, unsigned char *p, const fastmap_record_t *record)
+{
+	switch (ohandle->handle.attr.format)
+	{
+	case FASTMAP_PAIR:
+		memcpy(p, record->pair.value, ohandle->handle.attr.ksize);
+		break;
+	case FASTMAP_BLOCK:
+		if (ohandle->handle.flags & FASTMAP_INLINE_BLOCK)
+		{
+			memcpy(p, record->block.value, ohandle->handle.attr.vsize);
+		}
+		else
+		{
+			lseek(ohandle->fd, ohandle->currentvalueoffset, SEEK_SET);
+			write(ohandle->fd, record->block.value, ohandle->handle.attr.vsize);
+			ohandle->currentvalueoffset += ohandle->handle.attr.vsize;
+		}
+		break;
+	case FASTMAP_BLOB:
+		if (ohandle->handle.flags & FASTMAP_INLINE_BLOB)
+		{
+			if (record->blob.vsize <= ohandle->handle.attr.inlinevsize)
+			{
+				*p++ = (unsigned char)record->blob.vsize;
+				memcpy(p, record->blob.value, record->blob.vsize);
+				break;
+			}
+			*p++ = FASTMAP_SPILLED_VALUE;
+		}
+
+		/* entries have no fixed stride to find the next value pointer, so values carry their size */
+		{
+			unsigned char vsize[FASTMAP_WIDE_VALUEPTR];
+			size_t offset;
+
+			if (_dedupvalue(ohandle, record->blob.value, record->blob.vsize, &offset))
+			{
+				_putvalueptr(p, offset, ohandle->handle.valueptrsize);
+				break;
+			}
+
+			_putvalueptr(p, offset, ohandle->handle.valueptrsize);
+			_putvalueptr(vsize, record->blob.vsize, ohandle->handle.valueptrsize);
+			return _putvalue(ohandle, vsize, ohandle->handle.valueptrsize, record->blob.value, record->blob.vsize);
+		}
+	case FASTMAP_ATOM:
+		break;
+	}
+
+	return FASTMAP_OK;
+}
+
+static int _frontcodedput(fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+{
+	const unsigned char *key = record->atom.key;
+	const size_t ksize = ohandle->handle.attr.ksize;
+	size_t shared = 0, entrysize, restartsize, payloadsize;
+	unsigned char *p;
+	int rc;
+
+	payloadsize = _entrypayloadsize(ohandle, record);
+
+	for (;;)
+	{
+		if (ohandle->leafpageentries % ohandle->handle.attr.restartinterval == 0)
+		{
+			shared = 0;
+			restartsize = FASTMAP_RESTARTSIZE;
+		}
+		else
+		{
+			for (shared = 0; shared < ksize && key[shared] == ohandle->lastkey[shared]; shared++)
+				;
+			restartsize = 0;
+		}
+
+		entrysize = _varintsize(shared) + _varintsize(ksize - shared) + (ksize - shared) + payloadsize;
+		if (sizeof(struct _leafpageheader) + ohandle->leafpageused + entrysize + (ohandle->leafpagerestarts * FASTMAP_RESTARTSIZE) + restartsize <= ohandle->handle.pagesize)
+			break;
+
+		_flushleafpage(ohandle);
+	}
+
+	/* the first key of every page but the first is a separator in the search levels */
+	if (ohandle->leafpageentries == 0 && ohandle->records > 0)
+		_updatesearchpagelevels(ohandle, record);
+
+	p = ohandle->leafpage + sizeof(struct _leafpageheader) + ohandle->leafpageused;
+	if (restartsize)
+	{
+		uint32_t restart = (uint32_t)(p - ohandle->leafpage);
+
+		ohandle->leafpagerestarts++;
+		memcpy(ohandle->leafpage + ohandle->handle.pagesize - (ohandle->leafpagerestarts * FASTMAP_RESTARTSIZE), &restart, sizeof(restart));
+	}
+
+	p += _putvarint(p, shared);
+	p += _putvarint(p, ksize - shared);
+	memcpy(p, key + shared, ksize - shared);
+	p += ksize - shared;
+
+	if ((rc = _putentrypayload(ohandle, p, record)) != FASTMAP_OK)
+		return rc;
+
+	memcpy(ohandle->lastkey, key, ksize);
+	ohandle->lastksize = ksize;
+	ohandle->leafpageused += entrysize;
+	ohandle->leafpageentries++;
+	ohandle->records++;
+
+	return FASTMAP_OK;
+}
+
+static int _variableput(fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+{
+	const size_t ksize = _recordksize(ohandle->handle.attr.format, record);
+	struct _keyslot slot;
+	size_t entrysize;
+	int rc;
+
+	if (ksize > ohandle->handle.attr.ksize)
+		return EINVAL;
+
+	entrysize = ksize + _entrypayloadsize(ohandle, record);
+	if (ohandle->leafpageentries > 0 &&
+		sizeof(struct _leafpageheader) + (ohandle->leafpageentries + 1) * sizeof(slot) + ohandle->leafpageused + entrysize > ohandle->handle.pagesize)
+		_flushleafpage(ohandle);
+
+	/* the first key of every page but the first is a separator in the search levels */
+	if (ohandle->leafpageentries == 0 && ohandle->records > 0)
+		_updatesearchpagelevels(ohandle, record);
+
+	ohandle->leafpageused += entrysize;
+	slot.offset = (uint32_t)(ohandle->handle.pagesize - ohandle->leafpageused);
+	slot.ksize = (uint32_t)ksize;
+	memcpy(ohandle->leafpage + slot.offset, record->atom.key, ksize);
+	if ((rc = _putentrypayload(ohandle, ohandle->leafpage + slot.offset + ksize, record)) != FASTMAP_OK)
+		return rc;
+	memcpy(ohandle->leafpage + sizeof(struct _leafpageheader) + (ohandle->leafpageentries * sizeof(slot)), &slot, sizeof(slot));
+
+	memcpy(ohandle->lastkey, record->atom.key, ksize);
+	ohandle->lastksize = ksize;
+	ohandle->leafpageentries++;
+	ohandle->records++;
+
+	return FASTMAP_OK;
+}
+
+/* Write out the search pages still being filled, and drop the search levels the map did not need */
+static void _finishsearchlevels(fastmap_outhandle_t *ohandle)
+{
+	int i;
+
+	for (i = 0; i < ohandle->handle.numlevels; i++)
+	{
+		if ((ohandle->handle.flags & FASTMAP_TRUNCATED_SEPARATORS) && ohandle->levelinfo[i].pagekeys > 0)
+			_flushsearchpage(ohandle, i);
+	}
+
+	for (i = 0; i < ohandle->handle.numlevels && ohandle->levelinfo[i].keys > 0; i++)
+		ohandle->handle.perlevel[i].pages = ALIGN_TO_PAGE_OFFSET(ohandle->levelinfo[i].currentoffset - ohandle->handle.perlevel[i].firstoffset, ohandle->handle.pagesize) / ohandle->handle.pagesize;
+	ohandle->handle.numlevels = i;
+}
+
+/* Store the low 'width' bits of 'v' at bit 'bit' of a zeroed buffer, least significant bits first */
+static void _putbits(unsigned char *p, size_t bit, unsigned width, uint64_t v)
+{
+	unsigned n;
+
+	if (width < 64)
+		v &= ((uint64_t)1 << width) - 1;
+
+	p += bit >> 3;
+	bit &= 7;
+	for (n = 0; n < width; n += 8 - (unsigned)bit, bit = 0)
+		*p++ |= (unsigned char)((v >> n) << bit);
+}
+
+static uint64_t _getbits(const unsigned char *p, size_t bit, unsigned width)
+{
+	uint64_t v = 0;
+	unsigned n;
+
+	p += bit >> 3;
+	bit &= 7;
+	for (n = 0; n < width; n += 8 - (unsigned)bit, bit = 0)
+		v |= (uint64_t)(*p++ >> bit) << n;
+
+	return (width < 64) ? v & (((uint64_t)1 << width) - 1) : v;
+}
+
+/* Write out the buffered keys of an Elias-Fano partition. The first key goes whole into the
+ * directory, the distance of each other key from it is split into 'l' low bits, packed one
+ * after the other, and high bits, stored in unary as one set bit per key in a bit vector */
+static int _flusheliasfano(fastmap_outhandle_t *ohandle)
+{
+	const size_t m = ohandle->leafpageentries;
+	const uint64_t *atoms = ohandle->atoms;
+	struct _atompartition entry;
+	uint64_t range, d;
+	size_t i, lowerbytes, upperwords, size;
+	unsigned char *upper;
+	unsigned l = 0;
+
+	range = atoms[m - 1] - atoms[0];
+	while (m > 1 && (range / (m - 1)) >> (l + 1) != 0)
+		l++;
+
+	lowerbytes = ((m - 1) * l + 7) / 8;
+	upperwords = ((range >> l) + m - 1 + 63) / 64;
+	size = 1 + lowerbytes + upperwords * sizeof(uint64_t);
+
+	memset(ohandle->leafpage, 0, size);
+	ohandle->leafpage[0] = (unsigned char)l;
+	upper = ohandle->leafpage + 1 + lowerbytes;
+	for (i = 1; i < m; i++)
+	{
+		d = atoms[i] - atoms[0];
+		_putbits(ohandle->leafpage + 1, (i - 1) * l, l, d);
+		_putbits(upper, (d >> l) + i - 1, 1, 1);
+	}
+
+	_putbigendian(entry.firstkey, atoms[0], sizeof(entry.firstkey));
+	entry.offset = ohandle->currentvalueoffset - ohandle->handle.firstvalueoffset;
+	if (pwrite(ohandle->fd, &entry, sizeof(entry), (off_t)(ohandle->handle.firstleafpageoffset + ohandle->leafpageswritten * sizeof(entry))) != (ssize_t)sizeof(entry) ||
+		pwrite(ohandle->fd, ohandle->leafpage, size, (off_t)ohandle->currentvalueoffset) != (ssize_t)size)
+		return errno ? errno : EIO;
+
+	ohandle->currentvalueoffset += size;
+	ohandle->leafpageswritten++;
+	ohandle->leafpageentries = 0;
+	return FASTMAP_OK;
+}
+
+static int _eliasfanoput(fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+{
+	const uint64_t key = _integerkey(record->atom.key, ohandle->handle.attr.ksize);
+	int rc;
+
+	/* distances are taken from the first key of a partition, so keys may never go down */
+	if (ohandle->records > 0 && key < ohandle->lastatom)
+		return EINVAL;
+
+	if (ohandle->leafpageentries == FASTMAP_EFPARTITION && (rc = _flusheliasfano(ohandle)) != FASTMAP_OK)
+		return rc;
+
+	ohandle->atoms[ohandle->leafpageentries++] = key;
+	ohandle->lastatom = key;
+	ohandle->records++;
+	return FASTMAP_OK;
+}
+
+/* Write out the buffered keys of a chunk of a roaring set, as whichever container is smallest:
+ * two bytes per key for an array, four per run for runs, or a bitmap of the whole chunk */
+static int _flushroaring(fastmap_outhandle_t *ohandle)
+{
+	const size_t n = ohandle->leafpageentries;
+	const uint64_t *atoms = ohandle->atoms;
+	unsigned char *payload = ohandle->leafpage + sizeof(struct _roaringcontainer);
+	struct _roaringcontainer container;
+	struct _atompartition entry;
+	size_t i, j, runs = 1, size;
+	uint16_t v[2];
+
+	for (i = 1; i < n; i++)
+	{
+		if (atoms[i] != atoms[i - 1] + 1)
+			runs++;
+	}
+
+	container.cardinality = (uint32_t)n;
+	container.runs = 0;
+	if (n * sizeof(uint16_t) <= runs * 2 * sizeof(uint16_t) && n * sizeof(uint16_t) <= FASTMAP_ROARINGCHUNK / 8)
+	{
+		container.type = FASTMAP_ROARING_ARRAY;
+		size = n * sizeof(uint16_t);
+		for (i = 0; i < n; i++)
+		{
+			v[0] = (uint16_t)(atoms[i] & 0xFFFF);
+			memcpy(payload + (i * sizeof(uint16_t)), v, sizeof(uint16_t));
+		}
+	}
+	else if (runs * 2 * sizeof(uint16_t) <= FASTMAP_ROARINGCHUNK / 8)
+	{
+		container.type = FASTMAP_ROARING_RUNS;
+		container.runs = (uint16_t)runs;
+		size = runs * 2 * sizeof(uint16_t);
+		for (i = 0, j = 0; i < n; j++)
+		{
+			v[0] = (uint16_t)(atoms[i] & 0xFFFF);
+			while (i + 1 < n && atoms[i + 1] == atoms[i] + 1)
+				i++;
+			v[1] = (uint16_t)(atoms[i++] & 0xFFFF);
+			memcpy(payload + (j * sizeof(v)), v, sizeof(v));
+		}
+	}
+	else
+	{
+		/* bits are set a byte at a time, which lays them out as little-endian words */
+		container.type = FASTMAP_ROARING_BITMAP;
+		size = FASTMAP_ROARINGCHUNK / 8;
+		memset(payload, 0, size);
+		for (i = 0; i < n; i++)
+			payload[(atoms[i] & 0xFFFF) >> 3] |= (unsigned char)(1 << (atoms[i] & 7));
+	}
+
+	memcpy(ohandle->leafpage, &container, sizeof(container));
+	size += sizeof(container);
+	memset(ohandle->leafpage + size, 0, ((size + 7) & ~(size_t)7) - size);
+	size = (size + 7) & ~(size_t)7;
+
+	if (pwrite(ohandle->fd, ohandle->leafpage, size, (off_t)ohandle->currentvalueoffset) != (ssize_t)size)
+		return errno ? errno : EIO;
+
+	_putbigendian(entry.firstkey, atoms[0] & ~(uint64_t)0xFFFF, sizeof(entry.firstkey));
+	entry.offset = ohandle->currentvalueoffset - ohandle->handle.firstvalueoffset;
+	memcpy(ohandle->directory + (ohandle->leafpageswritten * sizeof(entry)), &entry, sizeof(entry));
+
+	ohandle->currentvalueoffset += size;
+	ohandle->leafpageswritten++;
+	ohandle->leafpageentries = 0;
+	return FASTMAP_OK;
+}
+
+/* Write the directory of a roaring set on the page after its last container */
+static int _writeroaringdirectory(fastmap_outhandle_t *ohandle)
+{
+	const size_t size = ohandle->leafpageswritten * sizeof(struct _atompartition);
+
+	ohandle->handle.firstleafpageoffset = ALIGN_TO_PAGE_OFFSET(ohandle->currentvalueoffset, ohandle->handle.pagesize);
+	ohandle->handle.leafpages = ohandle->leafpageswritten;
+	if (size > 0 && pwrite(ohandle->fd, ohandle->directory, size, (off_t)ohandle->handle.firstleafpageoffset) != (ssize_t)size)
+		return errno ? errno : EIO;
+
+	return FASTMAP_OK;
+}
+
+static int _roaringput(fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+{
+	const uint64_t key = _integerkey(record->atom.key, ohandle->handle.attr.ksize);
+	int rc;
+
+	/* a set holds each key once, so a repeated key is counted against the records expected but not stored again */
+	if (ohandle->records > 0 && key <= ohandle->lastatom)
+	{
+		if (key < ohandle->lastatom)
+			return EINVAL;
+		ohandle->records++;
+		ohandle->repeatedatoms++;
+		return FASTMAP_OK;
+	}
+
+	if (ohandle->leafpageentries > 0 && (key >> 16) != (ohandle->atoms[0] >> 16) && (rc = _flushroaring(ohandle)) != FASTMAP_OK)
+		return rc;
+
+	ohandle->atoms[ohandle->leafpageentries++] = key;
+	ohandle->lastatom = key;
+	ohandle->records++;
+	return FASTMAP_OK;
+}
+
+/* Once a map with packed leaf pages is written, drop the search levels and leaf pages it did not need,
+ * and move its value pages down to follow the leaf pages it did */
+static int _finishpackedleaves(fastmap_outhandle_t *ohandle)
+{
+	size_t firstvalueoffset, valuebytes, done;
+	char *buffer;
+	ssize_t n;
+
+	if (ohandle->leafpageentries > 0)
+		_flushleafpage(ohandle);
+
+	ohandle->handle.leafpages = ohandle->leafpageswritten;
+	_finishsearchlevels(ohandle);
+
+	if (ohandle->handle.firstvalueoffset == 0)
+		return FASTMAP_OK;
+
+	firstvalueoffset = ALIGN_TO_PAGE_OFFSET(ohandle->handle.firstleafpageoffset + (ohandle->handle.pagesize * ohandle->handle.leafpages), ohandle->handle.attr.sectionalign);
+	valuebytes = ohandle->currentvalueoffset - ohandle->handle.firstvalueoffset;
+	if (firstvalueoffset == ohandle->handle.firstvalueoffset)
+		return FASTMAP_OK;
+
+	buffer = malloc(FASTMAP_HUGEPAGESIZE);
+	if (buffer == NULL)
+		return ENOMEM;
+
+	/* the destination lies below the source, so a forward copy never overwrites unread values */
+	for (done = 0; done < valuebytes; done += (size_t)n)
+	{
+		n = pread(ohandle->fd, buffer, MIN(valuebytes - done, FASTMAP_HUGEPAGESIZE), (off_t)(ohandle->handle.firstvalueoffset + done));
+		if (n <= 0 || pwrite(ohandle->fd, buffer, (size_t)n, (off_t)(firstvalueoffset + done)) != n)
+		{
+			free(buffer);
+			return n < 0 ? errno : EIO;
+		}
+	}
+	free(buffer);
+
+	ohandle->handle.firstvalueoffset = firstvalueoffset;
+	ohandle->currentvalueoffset = firstvalueoffset + valuebytes;
+	if (ftruncate(ohandle->fd, (off_t)ohandle->currentvalueoffset) == -1)
+		return errno;
+
+	return FASTMAP_OK;
+}
+
+int fastmap_outhandle_put(fastmap_outhandle_t *ohandle, const fastmap_record_t *record)
+{
+	unsigned char valueptr[FASTMAP_WIDE_VALUEPTR];
+	size_t offset;
+	int rc, shared;
+
+	if ((ohandle->records + 1) > ohandle->handle.attr.records)
+		return FASTMAP_TOO_MANY_RECORDS;
+
+	if (ohandle->handle.flags & FASTMAP_ELIAS_FANO)
+		return _eliasfanoput(ohandle, record);
+	if (ohandle->handle.flags & FASTMAP_ROARING)
+		return _roaringput(ohandle, record);
+
+	if (ohandle->handle.attr.format == FASTMAP_BLOB && ohandle->handle.valueptrsize < sizeof(size_t))
+	{
+		size_t limit = ((size_t)1 << (ohandle->handle.valueptrsize * 8)) - 1;
+
+		if (record->blob.vsize > limit - ohandle->handle.valueptrsize || (ohandle->currentvalueoffset - ohandle->handle.firstvalueoffset) > limit - ohandle->handle.valueptrsize - record->blob.vsize)
+			return FASTMAP_VALUES_TOO_LARGE;
+	}
+
+	if (ohandle->handle.flags & FASTMAP_VARIABLE_KEYS)
+		return _variableput(ohandle, record);
+	if (ohandle->handle.flags & FASTMAP_FRONT_CODED)
+		return _frontcodedput(ohandle, record);
+
+	if ((ohandle->records % ohandle->handle.recordsperleafpage) == 0)
+	{
+		if (ohandle->handle.attr.format == FASTMAP_BLOB && ohandle->records > 0)
+			_writevaluetrailer(ohandle);
+
+		ohandle->currentleafpageoffset = ALIGN_TO_PAGE_OFFSET(ohandle->currentleafpageoffset, ohandle->handle.pagesize);
+	}
+
+	lseek(ohandle->fd, ohandle->currentleafpageoffset, SEEK_SET);
+	write(ohandle->fd, record->atom.key, ohandle->handle.attr.ksize);
+	ohandle->currentleafpageoffset += ohandle->handle.attr.ksize;
+
+	switch (ohandle->handle.attr.format)
+	{
+	case FASTMAP_PAIR:
+		write(ohandle->fd, record->pair.value, ohandle->handle.attr.ksize);
+		ohandle->currentleafpageoffset += ohandle->handle.attr.ksize;
+		break;
+	case FASTMAP_BLOB:
+		if (ohandle->handle.flags & FASTMAP_INLINE_BLOB)
+		{
+			unsigned char tag;
+
+			ohandle->currentleafpageoffset += ohandle->handle.leafpagerecordsize - ohandle->handle.attr.ksize;
+			if (record->blob.vsize <= ohandle->handle.attr.inlinevsize)
+			{
+				tag = (unsigned char)record->blob.vsize;
+				write(ohandle->fd, &tag, sizeof(tag));
+				write(ohandle->fd, record->blob.value, record->blob.vsize);
+				break;
+			}
+
+			tag = FASTMAP_SPILLED_VALUE;
+			write(ohandle->fd, &tag, sizeof(tag));
+		}
+		else
+		{
+			ohandle->currentleafpageoffset += ohandle->handle.valueptrsize;
+		}
+		shared = _dedupvalue(ohandle, record->blob.value, record->blob.vsize, &offset);
+		_putvalueptr(valueptr, offset, ohandle->handle.valueptrsize);
+		write(ohandle->fd, valueptr, ohandle->handle.valueptrsize);
+		if (shared)
+			break;
+		if (ohandle->handle.flags & (FASTMAP_INLINE_BLOB | FASTMAP_SHARED_VALUES))
+		{
+			/* the next leaf slot may hold an inline value, or point at a shared value, so values carry their size */
+			_putvalueptr(valueptr, record->blob.vsize, ohandle->handle.valueptrsize);
+			rc = _putvalue(ohandle, valueptr, ohandle->handle.valueptrsize, record->blob.value, record->blob.vsize);
+		}
+		else
+		{
+			rc = _putvalue(ohandle, NULL, 0, record->blob.value, record->blob.vsize);
+		}
+		if (rc != FASTMAP_OK)
+			return rc;
+		break;
+	case FASTMAP_BLOCK:
+		if (ohandle->handle.flags & FASTMAP_INLINE_BLOCK)
+		{
+			write(ohandle->fd, record->block.value, ohandle->handle.attr.vsize);
+			ohandle->currentleafpageoffset += ohandle->handle.attr.vsize;
+		}
+		else
+		{
+			lseek(ohandle->fd, ohandle->currentvalueoffset, SEEK_SET);
+			write(ohandle->fd, record->block.value, ohandle->handle.attr.vsize);
+			ohandle->currentvalueoffset += ohandle->handle.attr.vsize;
+		}
+		if (ohandle->handle.flags & FASTMAP_AGGREGATES)
+			_aggregateadd(ohandle->handle.attr.valueaggregate, (fastmap_aggregate_t*)ohandle->aggregates + (ohandle->records / ohandle->handle.recordsperleafpage), record->block.value);
+	case FASTMAP_ATOM:
+		break;
+	}
+
+	ohandle->records++;
+
+	{
+		if ((ohandle->records > ohandle->handle.recordsperleafpage) && (ohandle->records % ohandle->handle.recordsperleafpage == 1))
+			_updatesearchpagelevels(ohandle, record);
+	}
+
+	if (ohandle->handle.flags & FASTMAP_TRUNCATED_SEPARATORS)
+	{
+		memcpy(ohandle->lastkey, record->atom.key, ohandle->handle.attr.ksize);
+		ohandle->lastksize = ohandle->handle.attr.ksize;
+	}
+
+	return FASTMAP_OK;
+}
+
+/* Map part of a fastmap file at an address aligned like its sections, so that huge page
+ * backed files can be mapped with huge pages. Without a file, map anonymous memory */
+static void *_mmapaligned(size_t len, int fd, off_t offset, size_t align, int flags)
+{
+	size_t systempagesize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t maplen = ALIGN_TO_PAGE_OFFSET(len, systempagesize);
+	int prot = (fd == -1) ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	char *reserved, *aligned;
+
+	flags |= (fd == -1) ? (MAP_PRIVATE | MAP_ANONYMOUS) : MAP_SHARED;
+
+	if (align <= systempagesize)
+		return mmap(NULL, len, prot, flags, fd, offset);
+
+	/* reserve enough address space to find an aligned start, then trim the excess */
+	reserved = mmap(NULL, maplen + align, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reserved == MAP_FAILED)
+		return MAP_FAILED;
+
+	aligned = (char*)ALIGN_TO_PAGE_OFFSET((uintptr_t)reserved, align);
+	if (mmap(aligned, len, prot, flags | MAP_FIXED, fd, offset) == MAP_FAILED)
+	{
+		int err = errno;
+
+		munmap(reserved, maplen + align);
+		errno = err;
+		return MAP_FAILED;
+	}
+
+	if (aligned > reserved)
+		munmap(reserved, aligned - reserved);
+	if (reserved + align > aligned)
+		munmap(aligned + maplen, (reserved + align) - aligned);
+
+	return aligned;
+}
+
+/* Copy part of a fastmap file into anonymous memory */
+static void *_loadaligned(size_t len, int fd, off_t offset, size_t align)
+{
+	char *addr;
+	size_t done = 0;
+	ssize_t n;
+
+	addr = _mmapaligned(len, -1, 0, MAX(align, FASTMAP_HUGEPAGESIZE), 0);
+	if (addr == MAP_FAILED)
+		return MAP_FAILED;
+
+#ifdef MADV_HUGEPAGE
+	madvise(addr, len, MADV_HUGEPAGE);
+#endif
+
+	while (done < len)
+	{
+		n = pread(fd, addr + done, len - done, offset + (off_t)done);
+		if (n <= 0)
+		{
+			int err = (n == 0) ? EINVAL : errno;
+
+			munmap(addr, len);
+			errno = err;
+			return MAP_FAILED;
+		}
+		done += (size_t)n;
+	}
+
+	mprotect(addr, len, PROT_READ);
+	return addr;
+}
+
+/* Check that a header describes a complete map which fits in 'len' bytes,
+ * so that no lookup can stray outside of the map */
+static int _validatehandle(const fastmap_handle_t *handle, size_t len)
+{
+	size_t leafend;
+	int i;
+
+	if (len < sizeof(*handle) || handle->magic != FASTMAP_MAGIC || handle->version != FASTMAP_VERSION)
+		return EINVAL;
+
+	if (handle->flags & FASTMAP_INVALID_MAP)
+		return EINVAL;
+
+	if (!IS_POWER_OF_TWO(handle->pagesize) || handle->attr.ksize == 0 || handle->attr.ksize > handle->pagesize)
+		return EINVAL;
+
+	if ((handle->flags & FASTMAP_VARIABLE_KEYS) && !(handle->flags & FASTMAP_TRUNCATED_SEPARATORS))
+		return EINVAL;
+
+	if (handle->flags & FASTMAP_TRUNCATED_SEPARATORS)
+	{
+		if (handle->keyspersearchpage != (handle->pagesize - sizeof(struct _searchpageheader)) / (sizeof(struct _keyslot) + handle->attr.ksize))
+			return EINVAL;
+	}
+	else if (handle->keyspersearchpage != handle->pagesize / handle->attr.ksize)
+	{
+		return EINVAL;
+	}
+
+	if (!_validkeyschema(&handle->attr))
+		return EINVAL;
+
+	if ((handle->flags & FASTMAP_INTEGER_KEYS) &&
+		(handle->attr.keyfields != 1 || (handle->flags & (FASTMAP_PACKED_LEAVES | FASTMAP_TRUNCATED_SEPARATORS))))
+		return EINVAL;
+
+	if ((handle->flags & FASTMAP_SHARED_VALUES) && handle->attr.format != FASTMAP_BLOB)
+		return EINVAL;
+
+	/* the blocks of compressed values are checked as they are read, their directory and the dictionary here */
+	if ((handle->flags & FASTMAP_COMPRESSED_VALUES) &&
+		(handle->attr.format != FASTMAP_BLOB || handle->attr.valueblocksize == 0 || handle->attr.valueblocksize > FASTMAP_MAXVALUEBLOCKSIZE ||
+		handle->attr.dictionarysize > FASTMAP_MAXDICTIONARYSIZE || handle->firstvalueoffset == 0 || handle->firstvalueoffset > len ||
+		handle->valueblockoffset > len - handle->firstvalueoffset ||
+		handle->valueblocks > (len - handle->firstvalueoffset - handle->valueblockoffset) / sizeof(struct _valueblock) ||
+		handle->attr.dictionarysize > len - handle->firstvalueoffset - handle->valueblockoffset - (handle->valueblocks * sizeof(struct _valueblock))))
+		return EINVAL;
+
+	/* encoded atoms keep only a directory of partitions, whose bounds are checked as they are read */
+	if (handle->flags & FASTMAP_ENCODED_ATOMS)
+	{
+		const int roaring = (handle->flags & FASTMAP_ROARING) != 0;
+
+		if (handle->attr.format != FASTMAP_ATOM || handle->attr.keyfields != 1 || handle->numlevels != 0 ||
+			(handle->flags & (FASTMAP_PACKED_LEAVES | FASTMAP_TRUNCATED_SEPARATORS | FASTMAP_INTEGER_KEYS)) ||
+			(handle->flags & FASTMAP_ENCODED_ATOMS) == FASTMAP_ENCODED_ATOMS || handle->leafpagerecordsize != sizeof(struct _atompartition) ||
+			handle->recordsperleafpage != (roaring ? FASTMAP_ROARINGCHUNK : FASTMAP_EFPARTITION) ||
+			(roaring && (handle->attr.keyschema[0] != FASTMAP_KEY_U32 || handle->leafpages > MIN(handle->attr.records, FASTMAP_ROARINGCHUNK))) ||
+			(!roaring && handle->leafpages != (handle->attr.records + FASTMAP_EFPARTITION - 1) / FASTMAP_EFPARTITION))
+			return EINVAL;
+
+		/* the directory of a roaring set follows its containers, as their number is only known once they are written */
+		if (roaring)
+		{
+			if (handle->firstvalueoffset < sizeof(*handle) || handle->firstleafpageoffset < handle->firstvalueoffset || handle->firstleafpageoffset > len ||
+				handle->leafpages > (len - handle->firstleafpageoffset) / sizeof(struct _atompartition))
+				return EINVAL;
+		}
+		else if (handle->firstleafpageoffset < sizeof(*handle) || handle->firstvalueoffset < handle->firstleafpageoffset ||
+			handle->leafpages > (handle->firstvalueoffset - handle->firstleafpageoffset) / sizeof(struct _atompartition) ||
+			(handle->leafpages > 0 && handle->firstvalueoffset >= len))
+		{
+			return EINVAL;
+		}
+		return FASTMAP_OK;
+	}
+
+	if (handle->numlevels < 0 || handle->numlevels > FASTMAP_MAXLEVELS)
+		return EINVAL;
+
+	if (handle->valueptrsize != FASTMAP_NARROW_VALUEPTR && handle->valueptrsize != FASTMAP_DEFAULT_VALUEPTR && handle->valueptrsize != FASTMAP_WIDE_VALUEPTR)
+		return EINVAL;
+
+	if (handle->recordsperleafpage == 0 || handle->leafpagerecordsize == 0 ||
+		handle->recordsperleafpage * handle->leafpagerecordsize > handle->pagesize)
+		return EINVAL;
+
+	/* packed pages hold at least 'recordsperleafpage' records, often many more */
+	if (handle->flags & FASTMAP_PACKED_LEAVES)
+	{
+		if (((handle->flags & FASTMAP_FRONT_CODED) && (handle->attr.restartinterval == 0 || handle->attr.ksize > FASTMAP_MAXFRONTCODEDKSIZE)) ||
+			handle->leafpages > (handle->attr.records + handle->recordsperleafpage - 1) / handle->recordsperleafpage ||
+			(handle->attr.records > 0 && handle->leafpages == 0))
+			return EINVAL;
+	}
+	else if (handle->leafpages != (handle->attr.records + handle->recordsperleafpage - 1) / handle->recordsperleafpage)
+	{
+		return EINVAL;
+	}
+
+	for (i = 0; i < handle->numlevels; i++)
+	{
+		if (handle->perlevel[i].firstoffset < sizeof(*handle) || handle->perlevel[i].firstoffset > handle->firstleafpageoffset ||
+			handle->perlevel[i].pages > (handle->firstleafpageoffset - handle->perlevel[i].firstoffset) / handle->pagesize)
+			return EINVAL;
+	}
+
+	/* the last leaf page may be cut short after its last record */
+	leafend = handle->firstleafpageoffset;
+	if (handle->leafpages > 0)
+	{
+		if (handle->firstleafpageoffset > len || handle->leafpages - 1 > (len - handle->firstleafpageoffset) / handle->pagesize)
+			return EINVAL;
+		leafend += (handle->leafpages - 1) * handle->pagesize;
+		if (handle->flags & FASTMAP_PACKED_LEAVES)
+			leafend += handle->pagesize;
+		else if (handle->attr.format == FASTMAP_BLOB && !(handle->flags & FASTMAP_INLINE_BLOB))
+			leafend += handle->recordsperleafpage * handle->leafpagerecordsize + handle->valueptrsize;
+		else
+			leafend += (handle->attr.records - (handle->leafpages - 1) * handle->recordsperleafpage) * handle->leafpagerecordsize;
+		if (leafend > len)
+			return EINVAL;
+	}
+
+	if (handle->firstvalueoffset != 0 && handle->firstvalueoffset < leafend)
+		return EINVAL;
+
+	switch (handle->attr.format)
+	{
+	case FASTMAP_ATOM:
+	case FASTMAP_PAIR:
+		break;
+	case FASTMAP_BLOCK:
+		if (!(handle->flags & FASTMAP_INLINE_BLOCK) && handle->attr.records > 0 &&
+			(handle->firstvalueoffset == 0 || handle->firstvalueoffset > len || handle->attr.vsize > (len - handle->firstvalueoffset) / handle->attr.records))
+			return EINVAL;
+		break;
+	case FASTMAP_BLOB:
+		if (handle->firstvalueoffset == 0 || handle->firstvalueoffset > len)
+			return EINVAL;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	return FASTMAP_OK;
+}
+
+/* Advise the kernel about the use of the map between two offsets */
+static void _advise(fastmap_inhandle_t *ihandle, size_t start, size_t end, int advice)
+{
+	uintptr_t systempagesize = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t first, last;
+
+	if (end > ihandle->mmaplen)
+		end = ihandle->mmaplen;
+	if (start >= end)
+		return;
+
+	first = ((uintptr_t)ihandle->mmapaddr + start) & ~(systempagesize - 1);
+	last = (uintptr_t)ihandle->mmapaddr + end;
+	madvise((void*)first, last - first, advice);
+}
+
+static int _applymappolicy(fastmap_inhandle_t *ihandle, int flags)
+{
+	size_t leafend = ihandle->handle.firstvalueoffset ? ihandle->handle.firstvalueoffset : ihandle->mmaplen;
+
+#ifdef MADV_HUGEPAGE
+	if (flags & FASTMAP_MAP_HUGEPAGE)
+		_advise(ihandle, 0, ihandle->mmaplen, MADV_HUGEPAGE);
+#endif
+
+	if (flags & FASTMAP_ADVISE_SEARCH_WILLNEED)
+		_advise(ihandle, 0, ihandle->handle.firstleafpageoffset, MADV_WILLNEED);
+	if (flags & FASTMAP_ADVISE_LEAF_RANDOM)
+		_advise(ihandle, ihandle->handle.firstleafpageoffset, leafend, MADV_RANDOM);
+	if (flags & FASTMAP_ADVISE_LEAF_WILLNEED)
+		_advise(ihandle, ihandle->handle.firstleafpageoffset, leafend, MADV_WILLNEED);
+	if (ihandle->handle.firstvalueoffset && (flags & FASTMAP_ADVISE_VALUE_RANDOM))
+		_advise(ihandle, ihandle->handle.firstvalueoffset, ihandle->mmaplen, MADV_RANDOM);
+	if (ihandle->handle.firstvalueoffset && (flags & FASTMAP_ADVISE_VALUE_WILLNEED))
+		_advise(ihandle, ihandle->handle.firstvalueoffset, ihandle->mmaplen, MADV_WILLNEED);
+
+	if ((flags & FASTMAP_MAP_LOCKSEARCH) && mlock(ihandle->mmapaddr, MIN(ihandle->handle.firstleafpageoffset, ihandle->mmaplen)) == -1)
+		return errno;
+
+	return FASTMAP_OK;
+}
+
+/* A frame of a buffer pool which is neither resident nor pinned, is being read asynchronously, or is pinned */
+#define FASTMAP_FRAMEABSENT	0
+#define FASTMAP_FRAMEREADING	(UINT32_MAX - 1)
+#define FASTMAP_FRAMEPINNED	UINT32_MAX
+
+/* A resident frame of a buffer pool, swept by the CLOCK hand */
+struct _poolslot
+{
+	size_t frame;
+	size_t epoch;
+	int referenced;
+};
+
+/* A frame being read asynchronously, into a buffer of its own so that no lookup sees it half read */
+struct _poolio
+{
+	struct aiocb cb;
+	size_t frame;
+	void *buffer;
+};
+
+/* A lookup submitted to a handle, waiting on the read of 'frame' until it is 'ready' to be
+ * retried, or to complete with 'rc' if the read failed */
+struct _asynclookup
+{
+	fastmap_record_t *record;
+	void *cookie;
+	size_t frame;
+	int ready;
+	int rc;
+};
+
+/* The buffer pool of a handle opened with #FASTMAP_MAP_BUFFERPOOL. The handle keeps a flat
+ * address range for the map, an anonymous mapping into which frames are read and from which
+ * they are evicted, so lookups address pages just as they do in a mapped file once they have
+ * made them resident. 'frames' holds for each frame of the map its slot plus one, or
+ * FASTMAP_FRAMEABSENT, FASTMAP_FRAMEREADING or FASTMAP_FRAMEPINNED. A lookup moves the pool on
+ * to a new epoch, and frames used in the current epoch are not evicted. A lookup which must not
+ * block sets 'nonblocking', starting the reads of the frames it misses rather than making them,
+ * and noting the first of them in 'missing' */
+struct _bufferpool
+{
+	int fd;
+	off_t offset;
+	size_t len;
+	size_t framesize;
+	uint32_t *frames;
+	struct _poolslot *slots;
+	size_t capacity;
+	size_t used;
+	size_t hand;
+	size_t epoch;
+	int error;
+	int nonblocking;
+	size_t missing;
+	struct _poolio **io;
+	size_t nio;
+	size_t iocapacity;
+	struct _asynclookup *lookups;
+	size_t nlookups;
+	size_t lookupcapacity;
+	fastmap_poolstats_t stats;
+};
+
+static void _freebufferpool(fastmap_inhandle_t *ihandle)
+{
+	struct _bufferpool *pool = ihandle->pool;
+	const struct aiocb *cb;
+	size_t i;
+
+	if (pool == NULL)
+		return;
+
+	/* reads in flight write to their buffers until they are known to be done */
+	for (i = 0; i < pool->nio; i++)
+	{
+		cb = &pool->io[i]->cb;
+		aio_cancel(pool->fd, &pool->io[i]->cb);
+		while (aio_error(cb) == EINPROGRESS)
+			aio_suspend(&cb, 1, NULL);
+		aio_return(&pool->io[i]->cb);
+		free(pool->io[i]->buffer);
+		free(pool->io[i]);
+	}
+
+	free(pool->io);
+	free(pool->lookups);
+	free(pool->frames);
+	free(pool->slots);
+	free(pool);
+	ihandle->pool = NULL;
+}
+
+/* pread(2) which falls back to buffered reads when a file opened with O_DIRECT is on a file system refusing them */
+static ssize_t _directpread(int fd, void *buffer, size_t size, off_t offset)
+{
+	ssize_t n = pread(fd, buffer, size, offset);
+
+#ifdef O_DIRECT
+	if (n == -1 && errno == EINVAL && (fcntl(fd, F_GETFL) & O_DIRECT))
+	{
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+		n = pread(fd, buffer, size, offset);
+	}
+#endif
+	return n;
+}
+
+/* Read a frame of the map into its place in the address range of the handle. A whole frame is
+ * read, so that direct reads keep to aligned sizes, which ends early at the end of the file */
+static int _poolread(struct _bufferpool *pool, unsigned char *base, size_t frame)
+{
+	const size_t start = frame * pool->framesize;
+	const size_t need = MIN(pool->framesize, pool->len - start);
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < need)
+	{
+		n = _directpread(pool->fd, base + start + done, pool->framesize - done, pool->offset + (off_t)(start + done));
+		if (n <= 0)
+			return (n == 0) ? EIO : errno;
+		done += (size_t)n;
+	}
+
+	pool->stats.reads++;
+	return FASTMAP_OK;
+}
+
+/* Find a slot for a frame, a free one or else that of the first frame the CLOCK hand finds
+ * unreferenced and unused in this epoch. A pool full of frames used in this epoch grows */
+static int _poolslot(struct _bufferpool *pool, unsigned char *base, size_t *slot)
+{
+	struct _poolslot *slots, *victim;
+	size_t sweep;
+
+	if (pool->used < pool->capacity)
+	{
+		*slot = pool->used++;
+		return FASTMAP_OK;
+	}
+
+	for (sweep = 0; sweep < 2 * pool->capacity; sweep++)
+	{
+		victim = &pool->slots[pool->hand];
+		*slot = pool->hand;
+		pool->hand = (pool->hand + 1) % pool->capacity;
+		if (victim->epoch == pool->epoch)
+			continue;
+		if (victim->referenced)
+		{
+			victim->referenced = 0;
+			continue;
+		}
+
+		madvise(base + (victim->frame * pool->framesize), pool->framesize, MADV_DONTNEED);
+		pool->frames[victim->frame] = FASTMAP_FRAMEABSENT;
+		pool->stats.evictions++;
+		pool->stats.resident--;
+		return FASTMAP_OK;
+	}
+
+	if ((slots = realloc(pool->slots, 2 * pool->capacity * sizeof(*slots))) == NULL)
+		return ENOMEM;
+	pool->slots = slots;
+	pool->capacity *= 2;
+	pool->stats.frames = pool->capacity;
+	*slot = pool->used++;
+	return FASTMAP_OK;
+}
+
+/* Start reading a frame asynchronously, unless it is already being read */
+static int _poolsubmitread(struct _bufferpool *pool, size_t frame)
+{
+	const size_t start = frame * pool->framesize;
+	struct _poolio **io, *read;
+
+	if (pool->frames[frame] == FASTMAP_FRAMEREADING)
+		return FASTMAP_OK;
+
+	if (pool->nio == pool->iocapacity)
+	{
+		if ((io = realloc(pool->io, (pool->iocapacity ? 2 * pool->iocapacity : 16) * sizeof(*io))) == NULL)
+			return ENOMEM;
+		pool->io = io;
+		pool->iocapacity = pool->iocapacity ? 2 * pool->iocapacity : 16;
+	}
+
+	if ((read = calloc(1, sizeof(*read))) == NULL)
+		return ENOMEM;
+	if (posix_memalign(&read->buffer, (size_t)sysconf(_SC_PAGESIZE), pool->framesize) != 0)
+	{
+		free(read);
+		return ENOMEM;
+	}
+
+	read->frame = frame;
+	read->cb.aio_fildes = pool->fd;
+	read->cb.aio_offset = pool->offset + (off_t)start;
+	read->cb.aio_buf = read->buffer;
+	read->cb.aio_nbytes = pool->framesize;
+	read->cb.aio_sigevent.sigev_notify = SIGEV_NONE;
+	if (aio_read(&read->cb) == -1)
+	{
+		int rc = errno;
+
+		free(read->buffer);
+		free(read);
+		return rc;
+	}
+
+	pool->io[pool->nio++] = read;
+	pool->frames[frame] = FASTMAP_FRAMEREADING;
+	return FASTMAP_OK;
+}
+
+/* Make the frame of a finished read resident, and let the lookups waiting on it go on. A read
+ * which failed, or fell short, is made again synchronously, which also falls back from O_DIRECT */
+static int _poolinstall(struct _bufferpool *pool, unsigned char *base, size_t index)
+{
+	struct _poolio *read = pool->io[index];
+	const size_t frame = read->frame;
+	const size_t start = frame * pool->framesize;
+	ssize_t n = aio_return(&read->cb);
+	size_t slot, i;
+	int rc = FASTMAP_OK;
+
+	pool->io[index] = pool->io[--pool->nio];
+	pool->frames[frame] = FASTMAP_FRAMEABSENT;
+
+	if (n >= 0 && (size_t)n >= MIN(pool->framesize, pool->len - start))
+	{
+		memcpy(base + start, read->buffer, (size_t)n);
+		pool->stats.reads++;
+	}
+	else
+	{
+		rc = _poolread(pool, base, frame);
+	}
+	free(read->buffer);
+	free(read);
+
+	if (rc == FASTMAP_OK && (rc = _poolslot(pool, base, &slot)) != FASTMAP_OK)
+		madvise(base + start, pool->framesize, MADV_DONTNEED);
+	if (rc == FASTMAP_OK)
+	{
+		pool->slots[slot].frame = frame;
+		pool->slots[slot].epoch = pool->epoch;
+		pool->slots[slot].referenced = 1;
+		pool->frames[frame] = (uint32_t)(slot + 1);
+		pool->stats.resident++;
+	}
+
+	for (i = 0; i < pool->nlookups; i++)
+	{
+		if (!pool->lookups[i].ready && pool->lookups[i].frame == frame)
+		{
+			pool->lookups[i].ready = 1;
+			pool->lookups[i].rc = rc;
+		}
+	}
+
+	return rc;
+}
+
+/* Make resident the frames of up to 'limit' finished reads, waiting for one to finish if 'wait'
+ * is set and none has. Frames made resident belong to the current epoch, so the limit bounds
+ * how far the pool grows past its frames. Returns the number of frames made resident */
+static size_t _poolharvest(struct _bufferpool *pool, unsigned char *base, int wait, size_t limit)
+{
+	const struct aiocb **cbs;
+	size_t i, harvested = 0;
+
+	for (;;)
+	{
+		for (i = 0; i < pool->nio && harvested < limit; )
+		{
+			if (aio_error(&pool->io[i]->cb) == EINPROGRESS)
+			{
+				i++;
+				continue;
+			}
+			_poolinstall(pool, base, i);
+			harvested++;
+		}
+
+		if (harvested > 0 || !wait || pool->nio == 0)
+			return harvested;
+		if ((cbs = malloc(pool->nio * sizeof(*cbs))) == NULL)
+			return harvested;
+		for (i = 0; i < pool->nio; i++)
+			cbs[i] = &pool->io[i]->cb;
+		aio_suspend(cbs, (int)pool->nio, NULL);
+		free(cbs);
+	}
+}
+
+/* Wait for the read of a frame which is being read asynchronously */
+static int _poolawait(struct _bufferpool *pool, unsigned char *base, size_t frame)
+{
+	const struct aiocb *cb;
+	size_t i;
+
+	for (i = 0; i < pool->nio && pool->io[i]->frame != frame; i++)
+		;
+	if (i == pool->nio)
+		return EIO;
+
+	cb = &pool->io[i]->cb;
+	while (aio_error(cb) == EINPROGRESS)
+		aio_suspend(&cb, 1, NULL);
+	return _poolinstall(pool, base, i);
+}
+
+/* Make the frames holding 'size' bytes of the map from 'offset' resident, pinning them if 'pin'
+ * is set. A failed read leaves its frame absent and is noted in the pool, to fail the lookup */
+static int _poolload(struct _bufferpool *pool, unsigned char *base, size_t offset, size_t size, int pin)
+{
+	size_t frame, last, slot;
+	int rc;
+
+	if (size == 0 || offset >= pool->len)
+		return FASTMAP_OK;
+
+	last = (MIN(offset + size, pool->len) - 1) / pool->framesize;
+	for (frame = offset / pool->framesize; frame <= last; frame++)
+	{
+		if (pool->frames[frame] == FASTMAP_FRAMEPINNED)
+			continue;
+
+		/* a lookup which must not block reads on from the zeroes of a missing frame, and is retried once it arrives */
+		if (pool->nonblocking && (pool->frames[frame] == FASTMAP_FRAMEABSENT || pool->frames[frame] == FASTMAP_FRAMEREADING))
+		{
+			if ((rc = _poolsubmitread(pool, frame)) != FASTMAP_OK)
+				goto fail;
+			if (pool->missing == SIZE_MAX)
+				pool->missing = frame;
+			pool->error = FASTMAP_PENDING;
+			continue;
+		}
+		if (pool->frames[frame] == FASTMAP_FRAMEREADING && (rc = _poolawait(pool, base, frame)) != FASTMAP_OK)
+			goto fail;
+
+		if (pool->frames[frame] != FASTMAP_FRAMEABSENT)
+		{
+			slot = pool->frames[frame] - 1;
+			if (pin)
+			{
+				/* a pinned frame leaves the clock, the frame last in the clock taking its slot */
+				pool->slots[slot] = pool->slots[--pool->used];
+				if (slot < pool->used)
+					pool->frames[pool->slots[slot].frame] = (uint32_t)(slot + 1);
+				pool->hand = 0;
+				pool->frames[frame] = FASTMAP_FRAMEPINNED;
+				pool->stats.resident--;
+				pool->stats.pinned++;
+				continue;
+			}
+			pool->slots[slot].referenced = 1;
+			pool->slots[slot].epoch = pool->epoch;
+			pool->stats.hits++;
+			continue;
+		}
+
+		/* the frame is read before it takes a slot, so that a failed read leaves no slot to undo */
+		if ((rc = _poolread(pool, base, frame)) != FASTMAP_OK)
+			goto fail;
+		if (pin)
+		{
+			pool->frames[frame] = FASTMAP_FRAMEPINNED;
+			pool->stats.pinned++;
+			continue;
+		}
+		if ((rc = _poolslot(pool, base, &slot)) != FASTMAP_OK)
+		{
+			madvise(base + (frame * pool->framesize), pool->framesize, MADV_DONTNEED);
+			goto fail;
+		}
+		pool->slots[slot].frame = frame;
+		pool->slots[slot].epoch = pool->epoch;
+		pool->slots[slot].referenced = 1;
+		pool->frames[frame] = (uint32_t)(slot + 1);
+		pool->stats.resident++;
+	}
+
+	return FASTMAP_OK;
+fail:
+	pool->error = rc;
+	return rc;
+}
+
+/* Address of 'size' bytes of the map from 'offset', read into the buffer pool first if the handle has one */
+static const unsigned char *_mapped(const fastmap_inhandle_t *ihandle, size_t offset, size_t size)
+{
+	if (ihandle->pool != NULL)
+		_poolload(ihandle->pool, ihandle->mmapaddr, offset, size, 0);
+	return (const unsigned char*)ihandle->mmapaddr + offset;
+}
+
+/* Start a lookup, after which the frames used by the lookup before it may be evicted */
+static void _poolbegin(const fastmap_inhandle_t *ihandle)
+{
+	struct _bufferpool *pool = ihandle->pool;
+
+	if (pool == NULL)
+		return;
+	pool->epoch++;
+	pool->error = FASTMAP_OK;
+}
+
+/* The error of the lookup in progress, which fails if any of its reads failed */
+static int _poolerror(const fastmap_inhandle_t *ihandle, int rc)
+{
+	const struct _bufferpool *pool = ihandle->pool;
+
+	return (pool != NULL && pool->error != FASTMAP_OK) ? pool->error : rc;
+}
+
+/* Pin the parts of the map every lookup reads: the header and search levels, the directory of
+ * a set of encoded atoms, and the directory and dictionary of compressed values. Then fill the
+ * pool with the sections asked for by the flags, as far as it holds them */
+static int _poolpin(fastmap_inhandle_t *ihandle, int flags)
+{
+	struct _bufferpool *pool = ihandle->pool;
+	unsigned char *base = ihandle->mmapaddr;
+	const fastmap_handle_t *handle = &ihandle->handle;
+	size_t leafend = handle->firstvalueoffset ? handle->firstvalueoffset : pool->len;
+	size_t offset;
+	int rc;
+
+	if (handle->flags & FASTMAP_ENCODED_ATOMS)
+		rc = _poolload(pool, base, handle->firstleafpageoffset, handle->leafpages * sizeof(struct _atompartition), 1);
+	else
+		rc = _poolload(pool, base, 0, handle->firstleafpageoffset, 1);
+	if (rc == FASTMAP_OK && (handle->flags & FASTMAP_COMPRESSED_VALUES))
+		rc = _poolload(pool, base, handle->firstvalueoffset + handle->valueblockoffset,
+			(handle->valueblocks * sizeof(struct _valueblock)) + handle->attr.dictionarysize, 1);
+	if (rc != FASTMAP_OK)
+		return rc;
+
+	pool->epoch++;
+	if (!(handle->flags & FASTMAP_ENCODED_ATOMS) && (flags & FASTMAP_ADVISE_LEAF_WILLNEED))
+	{
+		for (offset = handle->firstleafpageoffset; offset < leafend && pool->used < pool->capacity; offset += pool->framesize)
+			_poolload(pool, base, offset, 1, 0);
+	}
+	if (handle->firstvalueoffset && (flags & FASTMAP_ADVISE_VALUE_WILLNEED))
+	{
+		for (offset = handle->firstvalueoffset; offset < pool->len && pool->used < pool->capacity; offset += pool->framesize)
+			_poolload(pool, base, offset, 1, 0);
+	}
+
+	return pool->error;
+}
+
+/* Read the header of a map into 'handle', through a buffer aligned for direct reads */
+static int _readheader(int fd, off_t offset, fastmap_handle_t *handle)
+{
+	const size_t systempagesize = (size_t)sysconf(_SC_PAGESIZE);
+	const size_t size = ALIGN_TO_PAGE_OFFSET(sizeof(*handle), systempagesize);
+	void *buffer;
+	int rc = FASTMAP_OK;
+
+	if (posix_memalign(&buffer, systempagesize, size) != 0)
+		return ENOMEM;
+	if (_directpread(fd, buffer, size, offset) < (ssize_t)sizeof(*handle))
+		rc = EINVAL;
+	else
+		memcpy(handle, buffer, sizeof(*handle));
+	free(buffer);
+	return rc;
+}
+
+/* Point a handle at the dictionary of its compressed values, which is stored after their directory of blocks */
+static void _locatedictionary(fastmap_inhandle_t *ihandle)
+{
+	const fastmap_handle_t *handle = &ihandle->handle;
+
+	ihandle->dictionary = NULL;
+	if ((handle->flags & FASTMAP_COMPRESSED_VALUES) && handle->attr.dictionarysize > 0)
+		ihandle->dictionary = (char*)ihandle->mmapaddr + handle->firstvalueoffset + handle->valueblockoffset + (handle->valueblocks * sizeof(struct _valueblock));
+}
+
+/* Set up the buffer pool of a handle over 'len' bytes of 'fd' from 'offset', in frames of a page
+ * of the map or of the system, whichever is larger, so that a page is read and evicted whole */
+static int _inhandle_pool(fastmap_inhandle_t *ihandle, int fd, off_t offset, size_t len, int flags)
+{
+	const size_t systempagesize = (size_t)sysconf(_SC_PAGESIZE);
+	struct _bufferpool *pool;
+	size_t frames;
+
+	if ((pool = calloc(1, sizeof(*pool))) == NULL)
+		return ENOMEM;
+	ihandle->pool = pool;
+
+	pool->fd = fd;
+	pool->offset = offset;
+	pool->len = len;
+	pool->framesize = MAX(systempagesize, (size_t)ihandle->handle.pagesize);
+	pool->capacity = FASTMAP_DEFAULTPOOLFRAMES;
+	pool->stats.framesize = pool->framesize;
+	pool->stats.frames = pool->capacity;
+	frames = (len + pool->framesize - 1) / pool->framesize;
+	if (frames >= FASTMAP_FRAMEREADING)
+		return EFBIG;
+
+	pool->frames = calloc(frames, sizeof(uint32_t));
+	pool->slots = calloc(pool->capacity, sizeof(struct _poolslot));
+	if (pool->frames == NULL || pool->slots == NULL)
+		return ENOMEM;
+
+	ihandle->mappinglen = frames * pool->framesize;
+	ihandle->mapping = _mmapaligned(ihandle->mappinglen, -1, 0, pool->framesize, MAP_NORESERVE);
+	if (ihandle->mapping == MAP_FAILED)
+	{
+		ihandle->mapping = NULL;
+		return errno;
+	}
+	ihandle->mmapaddr = ihandle->mapping;
+	ihandle->mmaplen = len;
+	ihandle->mapflags = flags;
+
+	return _poolpin(ihandle, flags);
+}
+
+/* Map 'len' bytes of 'fd' starting at 'offset', after validating the header found there */
+static int _inhandle_map(fastmap_inhandle_t *ihandle, int fd, off_t offset, size_t len, int flags)
+{
+	size_t systempagesize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t delta = (size_t)offset & (systempagesize - 1);
+	int mmapflags = 0;
+	int rc;
+
+	if (offset < 0)
+		return EINVAL;
+	if ((flags & FASTMAP_MAP_BUFFERPOOL) && (flags & FASTMAP_MAP_LOADRAM))
+		return EINVAL;
+
+	if (flags & FASTMAP_MAP_BUFFERPOOL)
+	{
+		if ((rc = _readheader(fd, offset, &ihandle->handle)) != FASTMAP_OK)
+			return rc;
+	}
+	else if (pread(fd, &ihandle->handle, sizeof(ihandle->handle), offset) != sizeof(ihandle->handle))
+		return EINVAL;
+
+	if ((rc = _validatehandle(&ihandle->handle, len)) != FASTMAP_OK)
+		return rc;
+
+	if (flags & FASTMAP_MAP_BUFFERPOOL)
+	{
+		if ((rc = _inhandle_pool(ihandle, fd, offset, len, flags)) != FASTMAP_OK)
+		{
+			if (ihandle->mapping)
+				munmap(ihandle->mapping, ihandle->mappinglen);
+			ihandle->mapping = NULL;
+			ihandle->mmapaddr = NULL;
+			_freebufferpool(ihandle);
+			return rc;
+		}
+		_locatedictionary(ihandle);
+		fastmap_inhandle_setcmpfunc(ihandle, fastmap_cmpfunc_memcmp);
+		return FASTMAP_OK;
+	}
+
+#ifdef MAP_POPULATE
+	if (flags & FASTMAP_MAP_POPULATE)
+		mmapflags |= MAP_POPULATE;
+#endif
+
+	if (flags & FASTMAP_MAP_LOADRAM)
+	{
+		ihandle->mappinglen = len;
+		ihandle->mapping = _loadaligned(len, fd, offset, ihandle->handle.attr.sectionalign);
+	}
+	else
+	{
+		/* mappings start on a system page, a map at an unaligned offset loses its section alignment */
+		ihandle->mappinglen = len + delta;
+		ihandle->mapping = _mmapaligned(ihandle->mappinglen, fd, offset - (off_t)delta, delta ? 0 : ihandle->handle.attr.sectionalign, mmapflags);
+	}
+	if (ihandle->mapping == MAP_FAILED)
+	{
+		ihandle->mapping = NULL;
+		return errno;
+	}
+
+	ihandle->mmapaddr = (flags & FASTMAP_MAP_LOADRAM) ? ihandle->mapping : (char*)ihandle->mapping + delta;
+	ihandle->mmaplen = len;
+	ihandle->mapflags = flags;
+	if ((rc = _applymappolicy(ihandle, flags)) != FASTMAP_OK)
+	{
+		munmap(ihandle->mapping, ihandle->mappinglen);
+		ihandle->mapping = NULL;
+		ihandle->mmapaddr = NULL;
+		return rc;
+	}
+
+	_locatedictionary(ihandle);
+	fastmap_inhandle_setcmpfunc(ihandle, fastmap_cmpfunc_memcmp);
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_init(fastmap_inhandle_t *ihandle, const char *pathname)
+{
+	return fastmap_inhandle_initflags(ihandle, pathname, 0);
+}
+
+int fastmap_inhandle_initflags(fastmap_inhandle_t *ihandle, const char *pathname, int flags)
+{
+	struct stat st;
+	int rc = FASTMAP_OK;
+
+	if (ihandle == NULL)
+		return EINVAL;
+
+	memset(ihandle, 0, sizeof(*ihandle));
+
+	/* a buffer pool reads around the page cache where the file system allows it */
+#ifdef O_DIRECT
+	if (flags & FASTMAP_MAP_BUFFERPOOL)
+		ihandle->fd = open(pathname, O_RDONLY | O_DIRECT);
+	else
+#endif
+		ihandle->fd = open(pathname, O_RDONLY);
+	if (ihandle->fd == -1 && errno == EINVAL)
+		ihandle->fd = open(pathname, O_RDONLY);
+	if (ihandle->fd == -1)
+	{
+		rc = errno;
+		goto fail;
+	}
+
+	if (fstat(ihandle->fd, &st) == -1)
+	{
+		rc = errno;
+		goto fail;
+	}
+
+	if (sizeof(st.st_size) > sizeof(size_t) && st.st_size > SIZE_MAX)
+	{
+		rc = ENOMEM;
+		goto fail;
+	}
+
+	if ((rc = _inhandle_map(ihandle, ihandle->fd, 0, (size_t)st.st_size, flags)) != FASTMAP_OK)
+		goto fail;
+
+	goto success;
+fail:
+	if (ihandle->fd != -1 && close(ihandle->fd) == -1)
+		rc = errno;
+	ihandle->fd = -1;
+success:
+	return rc;
+}
+
+int fastmap_inhandle_initfd(fastmap_inhandle_t *ihandle, int fd, off_t offset, size_t len, int flags)
+{
+	struct stat st;
+	int rc;
+
+	if (ihandle == NULL || fd < 0 || offset < 0)
+		return EINVAL;
+
+	memset(ihandle, 0, sizeof(*ihandle));
+	ihandle->fd = -1;
+
+	if (fstat(fd, &st) == -1)
+		return errno;
+
+	/* a map in a regular file must lie within it, other files (memfd, devices) are taken on trust */
+	if (S_ISREG(st.st_mode))
+	{
+		if (offset > st.st_size)
+			return EINVAL;
+		if (len == 0)
+			len = (size_t)(st.st_size - offset);
+		else if ((uint64_t)len > (uint64_t)(st.st_size - offset))
+			return EINVAL;
+	}
+	else if (len == 0)
+	{
+		return EINVAL;
+	}
+
+	/* a buffer pool reads from the file for as long as the handle lives, through a descriptor of its own */
+	if (flags & FASTMAP_MAP_BUFFERPOOL)
+	{
+		if ((fd = dup(fd)) == -1)
+			return errno;
+		ihandle->fd = fd;
+	}
+
+	if ((rc = _inhandle_map(ihandle, fd, offset, len, flags)) != FASTMAP_OK)
+	{
+		if (ihandle->fd != -1)
+			close(ihandle->fd);
+		ihandle->fd = -1;
+		return rc;
+	}
+
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_initmem(fastmap_inhandle_t *ihandle, const void *addr, size_t len)
+{
+	int rc;
+
+	if (ihandle == NULL || addr == NULL)
+		return EINVAL;
+
+	memset(ihandle, 0, sizeof(*ihandle));
+	ihandle->fd = -1;
+
+	if (len < sizeof(ihandle->handle))
+		return EINVAL;
+
+	memcpy(&ihandle->handle, addr, sizeof(ihandle->handle));
+	if ((rc = _validatehandle(&ihandle->handle, len)) != FASTMAP_OK)
+		return rc;
+
+	/* the caller owns the memory, lookups point straight into it */
+	ihandle->mmapaddr = (void*)addr;
+	ihandle->mmaplen = len;
+
+	_locatedictionary(ihandle);
+	fastmap_inhandle_setcmpfunc(ihandle, fastmap_cmpfunc_memcmp);
+	return FASTMAP_OK;
+}
+
+/* A block of values decompressed into the cache of a handle */
+struct _cachedblock
+{
+	size_t block;
+	size_t lastuse;
+	size_t capacity;
+	unsigned char *data;
+};
+
+static void _freevaluecache(fastmap_inhandle_t *ihandle)
+{
+	struct _cachedblock *cache = ihandle->valuecache;
+	size_t i;
+
+	if (cache == NULL)
+		return;
+
+	for (i = 0; i < ihandle->cacheblocks; i++)
+		free(cache[i].data);
+	free(cache);
+	ihandle->valuecache = NULL;
+}
+
+int fastmap_inhandle_setcacheblocks(fastmap_inhandle_t *ihandle, size_t nblocks)
+{
+	if (ihandle == NULL || nblocks == 0)
+		return EINVAL;
+
+	_freevaluecache(ihandle);
+	ihandle->cacheblocks = nblocks;
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_setpoolframes(fastmap_inhandle_t *ihandle, size_t nframes)
+{
+	struct _bufferpool *pool;
+	struct _poolslot *slots;
+	size_t i;
+
+	if (ihandle == NULL || ihandle->pool == NULL || nframes == 0)
+		return EINVAL;
+	pool = ihandle->pool;
+
+	/* the pool starts over empty, its pinned frames staying resident */
+	for (i = 0; i < pool->used; i++)
+	{
+		madvise((unsigned char*)ihandle->mmapaddr + (pool->slots[i].frame * pool->framesize), pool->framesize, MADV_DONTNEED);
+		pool->frames[pool->slots[i].frame] = FASTMAP_FRAMEABSENT;
+	}
+	pool->used = 0;
+	pool->hand = 0;
+	pool->stats.resident = 0;
+
+	if ((slots = realloc(pool->slots, nframes * sizeof(*slots))) == NULL)
+		return ENOMEM;
+	pool->slots = slots;
+	pool->capacity = nframes;
+	pool->stats.frames = nframes;
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_getpoolstats(const fastmap_inhandle_t *ihandle, fastmap_poolstats_t *stats)
+{
+	if (ihandle == NULL || ihandle->pool == NULL || stats == NULL)
+		return EINVAL;
+
+	memcpy(stats, &((const struct _bufferpool*)ihandle->pool)->stats, sizeof(*stats));
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_destroy(fastmap_inhandle_t *ihandle)
+{
+	if (ihandle == NULL || ihandle->mmapaddr == NULL)
+		return EINVAL;
+
+	_freevaluecache(ihandle);
+	_freebufferpool(ihandle);
+
+	if (ihandle->mapping)
+	{
+		munmap(ihandle->mapping, ihandle->mappinglen);
+		ihandle->mapping = NULL;
+	}
+	ihandle->mmapaddr = NULL;
+	ihandle->dictionary = NULL;
+
+	if (ihandle->fd != -1)
+		close(ihandle->fd);
+	ihandle->fd = -1;
+	return FASTMAP_OK;
+}
+
+static int fastmap_cmpfunc_memcmp(const fastmap_attr_t *attr, const void *a, const void *b)
+{
+	return memcmp(a, b, attr->ksize);
+}
+
+int fastmap_inhandle_getattr(fastmap_inhandle_t *ihandle, fastmap_attr_t *attr)
+{
+	memcpy(attr, &(ihandle->handle.attr), sizeof(*attr));
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_getdictionary(fastmap_inhandle_t *ihandle, const void **dictionary, size_t *size)
+{
+	if (ihandle == NULL || dictionary == NULL || size == NULL)
+		return EINVAL;
+
+	*dictionary = ihandle->dictionary;
+	*size = ihandle->dictionary ? ihandle->handle.attr.dictionarysize : 0;
+	return FASTMAP_OK;
+}
+
+/* Decompress block 'index' of the values into the cache of the handle, unless it is already there,
+ * replacing the least recently used block. Returns NULL if the block can not be decompressed */
+static const unsigned char *_cachedvalueblock(fastmap_inhandle_t *ihandle, size_t index, const struct _valueblock *block)
+{
+	struct _cachedblock *cache = ihandle->valuecache, *victim;
+	const unsigned char *compressed;
+	unsigned char *data;
+	size_t i;
+
+	if (cache == NULL)
+	{
+		if (ihandle->cacheblocks == 0)
+			ihandle->cacheblocks = FASTMAP_DEFAULTCACHEBLOCKS;
+		if ((cache = calloc(ihandle->cacheblocks, sizeof(*cache))) == NULL)
+			return NULL;
+		for (i = 0; i < ihandle->cacheblocks; i++)
+			cache[i].block = SIZE_MAX;
+		ihandle->valuecache = cache;
+	}
+
+	victim = cache;
+	for (i = 0; i < ihandle->cacheblocks; i++)
+	{
+		if (cache[i].block == index)
+		{
+			cache[i].lastuse = ++ihandle->cachetick;
+			return cache[i].data;
+		}
+		if (cache[i].lastuse < victim->lastuse)
+			victim = &cache[i];
+	}
+
+	if (victim->capacity < block->rawsize)
+	{
+		if ((data = realloc(victim->data, (size_t)block->rawsize)) == NULL)
+			return NULL;
+		victim->data = data;
+		victim->capacity = (size_t)block->rawsize;
+	}
+
+	/* a block whose frames could not be read is not decompressed, lest it be cached from zeroes */
+	victim->block = SIZE_MAX;
+	compressed = _mapped(ihandle, ihandle->handle.firstvalueoffset + block->offset, (size_t)block->size);
+	if (_poolerror(ihandle, FASTMAP_OK) != FASTMAP_OK)
+		return NULL;
+	if (!_lzdecompress(compressed, (size_t)block->size, ihandle->dictionary, ihandle->handle.attr.dictionarysize, victim->data, (size_t)block->rawsize))
+		return NULL;
+
+	victim->block = index;
+	victim->lastuse = ++ihandle->cachetick;
+	return victim->data;
+}
+
+/* Address of 'size' bytes of the value pages from 'start', as held by a value pointer. Compressed values
+ * are found in the directory of blocks and decompressed, returns NULL if they can not be read or
+ * lie outside of the map */
+static const unsigned char *_valueat(fastmap_inhandle_t *ihandle, size_t start, size_t size)
+{
+	const unsigned char *base = (unsigned char*)ihandle->mmapaddr + ihandle->handle.firstvalueoffset;
+	const unsigned char *data;
+	struct _valueblock block;
+	size_t lo = 0, hi, mid;
+
+	if (!(ihandle->handle.flags & FASTMAP_COMPRESSED_VALUES))
+	{
+		if (start > ihandle->mmaplen - ihandle->handle.firstvalueoffset || size > ihandle->mmaplen - ihandle->handle.firstvalueoffset - start)
+			return NULL;
+		return _mapped(ihandle, ihandle->handle.firstvalueoffset + start, size);
+	}
+	if (size == 0)
+		return base;
+
+	hi = ihandle->handle.valueblocks;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		memcpy(&block, base + ihandle->handle.valueblockoffset + (mid * sizeof(block)), sizeof(block));
+		if (block.start <= start)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return NULL;
+
+	memcpy(&block, base + ihandle->handle.valueblockoffset + ((lo - 1) * sizeof(block)), sizeof(block));
+	if (size > block.rawsize || start - block.start > block.rawsize - size ||
+		block.offset > ihandle->handle.valueblockoffset || block.size > ihandle->handle.valueblockoffset - block.offset)
+		return NULL;
+
+	/* a block which did not compress is read in place */
+	if (block.size == block.rawsize)
+		return _mapped(ihandle, ihandle->handle.firstvalueoffset + block.offset + (start - block.start), size);
+
+	if ((data = _cachedvalueblock(ihandle, lo - 1, &block)) == NULL)
+		return NULL;
+	return data + (start - block.start);
+}
+
+/* Point a #FASTMAP_BLOB record at a value stored after its size, from 'start' in the value pages.
+ * Returns #FASTMAP_CORRUPT_VALUE, leaving the value NULL, if the value can not be read */
+static int _sizedvalue(fastmap_inhandle_t *ihandle, fastmap_record_t *record, size_t start)
+{
+	const unsigned char *p = _valueat(ihandle, start, ihandle->handle.valueptrsize);
+
+	record->blob.vsize = 0;
+	record->blob.value = NULL;
+	if (p == NULL)
+		return FASTMAP_CORRUPT_VALUE;
+
+	record->blob.vsize = _getvalueptr(p, ihandle->handle.valueptrsize);
+	record->blob.value = (void*)_valueat(ihandle, start + ihandle->handle.valueptrsize, record->blob.vsize);
+	return (record->blob.value == NULL) ? FASTMAP_CORRUPT_VALUE : FASTMAP_OK;
+}
+
+int fastmap_inhandle_setcmpfunc(fastmap_inhandle_t *ihandle, fastmap_cmpfunc cmp)
+{
+	ihandle->cmp = cmp;
+	return FASTMAP_OK;
+}
+
+/* Point a record at the value of the record in slot 'slot' of the fixed size leaf page at 'pageoffset',
+ * which is record 'recordindex' of the map. Returns #FASTMAP_CORRUPT_VALUE if the value can not be read */
+static int _leafrecordvalue(fastmap_inhandle_t *ihandle, fastmap_record_t *record, size_t pageoffset, size_t slot, size_t recordindex)
+{
+	size_t offset = pageoffset + (slot * ihandle->handle.leafpagerecordsize);
+
+	switch (ihandle->handle.attr.format)
+	{
+	case FASTMAP_PAIR:
+		record->pair.value = (void*)((char*)ihandle->mmapaddr + offset + ihandle->handle.attr.ksize);
+		break;
+	case FASTMAP_BLOCK:
+		if (ihandle->handle.flags & FASTMAP_INLINE_BLOCK)
+			record->block.value = (void*)((char*)ihandle->mmapaddr + offset + ihandle->handle.attr.ksize);
+		else
+			record->block.value = (void*)_mapped(ihandle, ihandle->handle.firstvalueoffset + (recordindex * ihandle->handle.attr.vsize), ihandle->handle.attr.vsize);
+		break;
+	case FASTMAP_BLOB:
+		offset += ihandle->handle.attr.ksize;
+		if (ihandle->handle.flags & FASTMAP_INLINE_BLOB)
+		{
+			unsigned char tag = *((unsigned char*)ihandle->mmapaddr + offset);
+
+			offset++;
+			if (tag != FASTMAP_SPILLED_VALUE)
+			{
+				record->blob.vsize = tag;
+				record->blob.value = (void*)((char*)ihandle->mmapaddr + offset);
+				break;
+			}
+
+			return _sizedvalue(ihandle, record, _getvalueptr((unsigned char*)ihandle->mmapaddr + offset, ihandle->handle.valueptrsize));
+		}
+		else if (ihandle->handle.flags & FASTMAP_SHARED_VALUES)
+		{
+			return _sizedvalue(ihandle, record, _getvalueptr((unsigned char*)ihandle->mmapaddr + offset, ihandle->handle.valueptrsize));
+		}
+		else
+		{
+			size_t start, end;
+
+			start = _getvalueptr((unsigned char*)ihandle->mmapaddr + offset, ihandle->handle.valueptrsize);
+			if (slot + 1 < ihandle->handle.recordsperleafpage && recordindex + 1 < ihandle->handle.attr.records)
+				end = _getvalueptr((unsigned char*)ihandle->mmapaddr + offset + ihandle->handle.leafpagerecordsize, ihandle->handle.valueptrsize);
+			else
+				end = _getvalueptr((unsigned char*)ihandle->mmapaddr + pageoffset + (ihandle->handle.recordsperleafpage * ihandle->handle.leafpagerecordsize), ihandle->handle.valueptrsize);
+
+			/* the values of a page follow one another, so a value ending before it starts is corrupt */
+			record->blob.vsize = 0;
+			record->blob.value = NULL;
+			if (end < start)
+				return FASTMAP_CORRUPT_VALUE;
+			record->blob.vsize = end - start;
+			record->blob.value = (void*)_valueat(ihandle, start, end - start);
+			if (record->blob.value == NULL)
+				return FASTMAP_CORRUPT_VALUE;
+		}
+		break;
+	case FASTMAP_ATOM:
+		break;
+	}
+
+	return FASTMAP_OK;
+}
+
+static int _leafpage_get(fastmap_inhandle_t *ihandle, fastmap_record_t *record, size_t offset, size_t recordindex)
+{
+	const size_t pageoffset = offset;
+	size_t currentkey;
+
+	_mapped(ihandle, pageoffset, ihandle->handle.pagesize);
+
+	/* records are packed from the start of the page, the last page may be partially filled */
+	for (currentkey = 0; currentkey < ihandle->handle.recordsperleafpage && recordindex + currentkey < ihandle->handle.attr.records; currentkey++)
+	{
+/* TODO: _get() does a lot of comparisons. Can this be converted from a linear scan of the page to a binary search? */
+		int ord = ihandle->cmp(&ihandle->handle.attr, record->atom.key, (char*)ihandle->mmapaddr + offset);
+
+		if (ord > 0)
+		{
+			offset += ihandle->handle.leafpagerecordsize;
+			continue;
+		}
+		else if (ord == 0)
+		{
+			return _leafrecordvalue(ihandle, record, pageoffset, currentkey, recordindex + currentkey);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return FASTMAP_NOT_FOUND;
+}
+
+/* Point 'record' at the value of a packed leaf entry, returns the size of the entry's value part */
+static size_t _entryvalue(fastmap_inhandle_t *ihandle, const unsigned char *p, fastmap_record_t *record, size_t recordindex)
+{
+	size_t size = 0;
+
+	switch (ihandle->handle.attr.format)
+	{
+	case FASTMAP_PAIR:
+		if (record)
+			record->pair.value = (void*)p;
+		size = ihandle->handle.attr.ksize;
+		break;
+	case FASTMAP_BLOCK:
+		if (ihandle->handle.flags & FASTMAP_INLINE_BLOCK)
+		{
+			if (record)
+				record->block.value = (void*)p;
+			size = ihandle->handle.attr.vsize;
+		}
+		else if (record)
+		{
+			record->block.value = (void*)_mapped(ihandle, ihandle->handle.firstvalueoffset + (recordindex * ihandle->handle.attr.vsize), ihandle->handle.attr.vsize);
+		}
+		break;
+	case FASTMAP_BLOB:
+		if (ihandle->handle.flags & FASTMAP_INLINE_BLOB)
+		{
+			if (*p != FASTMAP_SPILLED_VALUE)
+			{
+				if (record)
+				{
+					record->blob.vsize = *p;
+					record->blob.value = (void*)(p + 1);
+				}
+				size = 1 + *p;
+				break;
+			}
+			p++;
+			size = 1;
+		}
+		if (record)
+			_sizedvalue(ihandle, record, _getvalueptr(p, ihandle->handle.valueptrsize));
+		size += ihandle->handle.valueptrsize;
+		break;
+	case FASTMAP_ATOM:
+		break;
+	}
+
+	return size;
+}
+
+static int _frontcodedleafpage_get(fastmap_inhandle_t *ihandle, fastmap_record_t *record, size_t offset)
+{
+	const unsigned char *page = _mapped(ihandle, offset, ihandle->handle.pagesize);
+	const size_t ksize = ihandle->handle.attr.ksize;
+	unsigned char key[FASTMAP_MAXFRONTCODEDKSIZE];
+	struct _leafpageheader header;
+	const unsigned char *p;
+	size_t lo, hi, mid, entry, last, shared, unshared;
+	uint32_t restart;
+	int ord;
+
+	memcpy(&header, page, sizeof(header));
+	if (header.restarts == 0 || header.restarts > (ihandle->handle.pagesize - sizeof(header)) / FASTMAP_RESTARTSIZE)
+		return FASTMAP_NOT_FOUND;
+
+	/* find the last restart point whose key is no greater than the one sought */
+	lo = 0;
+	hi = header.restarts;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		memcpy(&restart, page + ihandle->handle.pagesize - ((mid + 1) * FASTMAP_RESTARTSIZE), sizeof(restart));
+		p = page + restart;
+		_getvarint(&p);
+		_getvarint(&p);
+		if (ihandle->cmp(&ihandle->handle.attr, record->atom.key, p) >= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == 0)
+		return FASTMAP_NOT_FOUND;
+
+	/* then decode the run of keys which follows it */
+	memcpy(&restart, page + ihandle->handle.pagesize - (lo * FASTMAP_RESTARTSIZE), sizeof(restart));
+	p = page + restart;
+	entry = (lo - 1) * ihandle->handle.attr.restartinterval;
+	last = MIN(entry + ihandle->handle.attr.restartinterval, header.entries);
+	for (; entry < last; entry++)
+	{
+		shared = _getvarint(&p);
+		unshared = _getvarint(&p);
+		if (shared + unshared != ksize)
+			return FASTMAP_NOT_FOUND;
+		memcpy(key + shared, p, unshared);
+		p += unshared;
+
+		ord = ihandle->cmp(&ihandle->handle.attr, record->atom.key, key);
+		if (ord == 0)
+		{
+			_entryvalue(ihandle, p, record, (size_t)header.firstrecord + entry);
+			return FASTMAP_OK;
+		}
+		else if (ord < 0)
+		{
+			break;
+		}
+
+		p += _entryvalue(ihandle, p, NULL, 0);
+	}
+
+	return FASTMAP_NOT_FOUND;
+}
+
+/* Count the keys no greater than 'key' among 'n' sorted integer keys 'stride' bytes apart.
+ * Guess the position of the key from the first and last keys, gallop out from the guess until
+ * the key is bracketed, then bisect the bracket. Near uniform keys are found in a probe or two,
+ * and no distribution costs more than about twice a plain binary search */
+static size_t _interpolationrank(const unsigned char *base, size_t n, size_t stride, size_t ksize, uint64_t key)
+{
+	uint64_t first, last;
+	size_t lo, hi, mid, step;
+
+	if (n == 0 || key < (first = _integerkey(base, ksize)))
+		return 0;
+	if (key >= (last = _integerkey(base + ((n - 1) * stride), ksize)))
+		return n;
+
+	/* from here on the key at 'lo' is no greater than the one sought, and the key at 'hi' is greater */
+	lo = 0;
+	hi = n - 1;
+	mid = (size_t)((double)(key - first) / (double)(last - first) * (double)(n - 1));
+	mid = MIN(MAX(mid, lo + 1), hi - 1);
+	if (mid > lo && mid < hi)
+	{
+		if (_integerkey(base + (mid * stride), ksize) <= key)
+		{
+			lo = mid;
+			for (step = 1; lo + step < hi && _integerkey(base + ((lo + step) * stride), ksize) <= key; step *= 2)
+				lo += step;
+			hi = MIN(lo + step, hi);
+		}
+		else
+		{
+			hi = mid;
+			for (step = 1; hi - lo > step && _integerkey(base + ((hi - step) * stride), ksize) > key; step *= 2)
+				hi -= step;
+			lo = (hi - lo > step) ? hi - step : lo;
+		}
+	}
+
+	while (hi - lo > 1)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (_integerkey(base + (mid * stride), ksize) <= key)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return hi;
+}
+
+/* Find the leaf page which may hold a key of a map with integer keys, comparing whole keys natively
+ * rather than byte by byte, returns the number of leaf pages if no page may */
+static size_t _integerkeys_search(const fastmap_inhandle_t *ihandle, uint64_t key)
+{
+	const size_t ksize = ihandle->handle.attr.ksize;
+	const unsigned char *page;
+	size_t child = 0, levelkeys, n;
+	int level;
+
+	/* every search page but the last of a level is full, so the keys of a page follow from its number */
+	for (level = ihandle->handle.numlevels - 1; level >= 0; level--)
+	{
+		levelkeys = ((ihandle->handle.perlevel[level].lastoffset - ihandle->handle.perlevel[level].firstoffset) / ihandle->handle.pagesize) * ihandle->handle.keyspersearchpage +
+			((ihandle->handle.perlevel[level].lastoffset - ihandle->handle.perlevel[level].firstoffset) % ihandle->handle.pagesize) / ksize + 1;
+		if (child >= ihandle->handle.perlevel[level].pages || child * ihandle->handle.keyspersearchpage >= levelkeys)
+			return ihandle->handle.leafpages;
+
+		page = (unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[level].firstoffset + (child * ihandle->handle.pagesize);
+		n = MIN(ihandle->handle.keyspersearchpage, levelkeys - (child * ihandle->handle.keyspersearchpage));
+		child = (child * ihandle->handle.keyspersearchpage) + _interpolationrank(page, n, ksize, ksize, key);
+	}
+
+	return MIN(child, ihandle->handle.leafpages);
+}
+
+/* Look up a key in the leaf page at 'pageoffset' of a map with integer keys */
+static int _integerkeys_leafget(fastmap_inhandle_t *ihandle, fastmap_record_t *record, size_t pageoffset)
+{
+	const size_t ksize = ihandle->handle.attr.ksize;
+	const uint64_t key = _integerkey(record->atom.key, ksize);
+	const size_t child = (pageoffset - ihandle->handle.firstleafpageoffset) / ihandle->handle.pagesize;
+	size_t n, rank;
+
+	n = MIN(ihandle->handle.recordsperleafpage, ihandle->handle.attr.records - (child * ihandle->handle.recordsperleafpage));
+	rank = _interpolationrank(_mapped(ihandle, pageoffset, ihandle->handle.pagesize), n, ihandle->handle.leafpagerecordsize, ksize, key);
+	if (rank == 0 || _integerkey((unsigned char*)ihandle->mmapaddr + pageoffset + ((rank - 1) * ihandle->handle.leafpagerecordsize), ksize) != key)
+		return FASTMAP_NOT_FOUND;
+
+	return _leafrecordvalue(ihandle, record, pageoffset, rank - 1, (child * ihandle->handle.recordsperleafpage) + rank - 1);
+}
+
+/* Find the smallest key no less than 'key' in partition 'partition' of an Elias-Fano coded set,
+ * returns zero if every key of the partition is less */
+static int _eliasfano_partitionbound(const fastmap_inhandle_t *ihandle, size_t partition, uint64_t key, uint64_t *found)
+{
+	const struct _atompartition *directory = (const struct _atompartition*)((char*)ihandle->mmapaddr + ihandle->handle.firstleafpageoffset);
+	const size_t datalen = ihandle->mmaplen - ihandle->handle.firstvalueoffset;
+	const size_t m = MIN(FASTMAP_EFPARTITION, ihandle->handle.attr.records - (partition * FASTMAP_EFPARTITION));
+	const unsigned char *p, *upper;
+	uint64_t first, d, word, high, v;
+	size_t start, end, lowerbytes, words, w, i, bit;
+	unsigned l;
+
+	memcpy(&start, &directory[partition].offset, sizeof(start));
+	if (partition + 1 < ihandle->handle.leafpages)
+		memcpy(&end, &directory[partition + 1].offset, sizeof(end));
+	else
+		end = datalen;
+	if (start >= end || end > datalen)
+		return 0;
+
+	first = _integerkey(directory[partition].firstkey, sizeof(directory[partition].firstkey));
+	if (key <= first)
+	{
+		*found = first;
+		return 1;
+	}
+
+	p = _mapped(ihandle, ihandle->handle.firstvalueoffset + start, end - start);
+	l = p[0];
+	lowerbytes = ((m - 1) * l + 7) / 8;
+	if (l > 63 || 1 + lowerbytes > end - start)
+		return 0;
+	upper = p + 1 + lowerbytes;
+	words = (end - start - 1 - lowerbytes) / sizeof(uint64_t);
+
+	/* the i'th set bit of the high bits lies at the high part of the i'th distance plus i,
+	 * so walk the set bits until the high part reaches that of the key, then check the low bits */
+	d = key - first;
+	for (i = 0, w = 0; w < words && i < m - 1; w++)
+	{
+		word = _getlittleendian(upper + (w * sizeof(word)));
+		while (word != 0 && i < m - 1)
+		{
+			bit = (w * 64) + (size_t)__builtin_ctzll(word);
+			word &= word - 1;
+			high = bit - i;
+			if (high >= (d >> l))
+			{
+				v = (high << l) | _getbits(p + 1, i * l, l);
+				if (v >= d)
+				{
+					*found = first + v;
+					return 1;
+				}
+			}
+			i++;
+		}
+	}
+
+	return 0;
+}
+
+/* Find the smallest key no less than 'key' in an Elias-Fano coded set */
+static int _eliasfano_lowerbound(const fastmap_inhandle_t *ihandle, uint64_t key, uint64_t *found)
+{
+	const unsigned char *directory = (unsigned char*)ihandle->mmapaddr + ihandle->handle.firstleafpageoffset;
+	size_t partition;
+
+	if (ihandle->handle.leafpages == 0)
+		return FASTMAP_NOT_FOUND;
+
+	/* the directory of first keys stands in for the search levels */
+	partition = _interpolationrank(directory, ihandle->handle.leafpages, sizeof(struct _atompartition), sizeof(((struct _atompartition*)0)->firstkey), key);
+	if (partition > 0 && _eliasfano_partitionbound(ihandle, partition - 1, key, found))
+		return FASTMAP_OK;
+
+	if (partition < ihandle->handle.leafpages)
+	{
+		*found = _integerkey(directory + (partition * sizeof(struct _atompartition)), sizeof(((struct _atompartition*)0)->firstkey));
+		return FASTMAP_OK;
+	}
+
+	return FASTMAP_NOT_FOUND;
+}
+
+/* Locate the container of partition 'partition' of a roaring set, and read its header,
+ * returns NULL if the container does not lie within the map */
+static const unsigned char *_roaringcontainer(const fastmap_inhandle_t *ihandle, size_t partition, struct _roaringcontainer *container)
+{
+	const struct _atompartition *directory = (const struct _atompartition*)((char*)ihandle->mmapaddr + ihandle->handle.firstleafpageoffset);
+	const size_t datalen = ihandle->handle.firstleafpageoffset - ihandle->handle.firstvalueoffset;
+	const unsigned char *p;
+	size_t offset, size;
+
+	memcpy(&offset, &directory[partition].offset, sizeof(offset));
+	if (offset > datalen || datalen - offset < sizeof(*container))
+		return NULL;
+
+	p = _mapped(ihandle, ihandle->handle.firstvalueoffset + offset, sizeof(*container));
+	memcpy(container, p, sizeof(*container));
+	switch (container->type)
+	{
+	case FASTMAP_ROARING_ARRAY:
+		size = container->cardinality * sizeof(uint16_t);
+		break;
+	case FASTMAP_ROARING_BITMAP:
+		size = FASTMAP_ROARINGCHUNK / 8;
+		break;
+	case FASTMAP_ROARING_RUNS:
+		size = container->runs * 2 * sizeof(uint16_t);
+		break;
+	default:
+		return NULL;
+	}
+	if (container->cardinality == 0 || container->cardinality > FASTMAP_ROARINGCHUNK || size > datalen - offset - sizeof(*container))
+		return NULL;
+
+	return _mapped(ihandle, ihandle->handle.firstvalueoffset + offset + sizeof(*container), size);
+}
+
+/* Find the smallest value no less than 'low' in a roaring container,
+ * returns zero if every value of the container is less */
+static int _roaringcontainerbound(const struct _roaringcontainer *container, const unsigned char *payload, uint32_t low, uint32_t *found)
+{
+	size_t lo = 0, hi, mid, w;
+	uint16_t v[2];
+	uint64_t word;
+
+	switch (container->type)
+	{
+	case FASTMAP_ROARING_ARRAY:
+		hi = container->cardinality;
+		while (lo < hi)
+		{
+			mid = lo + (hi - lo) / 2;
+			memcpy(v, payload + (mid * sizeof(uint16_t)), sizeof(uint16_t));
+			if (v[0] < low)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == container->cardinality)
+			return 0;
+		memcpy(v, payload + (lo * sizeof(uint16_t)), sizeof(uint16_t));
+		*found = v[0];
+		return 1;
+	case FASTMAP_ROARING_BITMAP:
+		w = low / 64;
+		word = _getlittleendian(payload + (w * sizeof(word))) & (~(uint64_t)0 << (low % 64));
+		while (word == 0)
+		{
+			if (++w == FASTMAP_ROARINGWORDS)
+				return 0;
+			word = _getlittleendian(payload + (w * sizeof(word)));
+		}
+		*found = (uint32_t)((w * 64) + (size_t)__builtin_ctzll(word));
+		return 1;
+	default:
+		/* the last run starting no later than the value either holds it, or the next run starts after it */
+		hi = container->runs;
+		while (lo < hi)
+		{
+			mid = lo + (hi - lo) / 2;
+			memcpy(v, payload + (mid * sizeof(v)), sizeof(v));
+			if (v[0] <= low)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo > 0)
+		{
+			memcpy(v, payload + ((lo - 1) * sizeof(v)), sizeof(v));
+			if (low <= v[1])
+			{
+				*found = low;
+				return 1;
+			}
+		}
+		if (lo == container->runs)
+			return 0;
+		memcpy(v, payload + (lo * sizeof(v)), sizeof(v));
+		*found = v[0];
+		return 1;
+	}
+}
+
+/* Find the smallest key no less than 'key' in a roaring set */
+static int _roaring_lowerbound(const fastmap_inhandle_t *ihandle, uint64_t key, uint64_t *found)
+{
+	const unsigned char *directory = (unsigned char*)ihandle->mmapaddr + ihandle->handle.firstleafpageoffset;
+	struct _roaringcontainer container;
+	const unsigned char *payload;
+	uint64_t chunk;
+	uint32_t low;
+	size_t partition;
+
+	if (ihandle->handle.leafpages == 0)
+		return FASTMAP_NOT_FOUND;
+
+	/* the directory holds the first key of the chunk of each container */
+	partition = _interpolationrank(directory, ihandle->handle.leafpages, sizeof(struct _atompartition), sizeof(((struct _atompartition*)0)->firstkey), key);
+	if (partition > 0)
+	{
+		chunk = _integerkey(directory + ((partition - 1) * sizeof(struct _atompartition)), sizeof(((struct _atompartition*)0)->firstkey));
+		if ((chunk >> 16) == (key >> 16) && (payload = _roaringcontainer(ihandle, partition - 1, &container)) != NULL &&
+			_roaringcontainerbound(&container, payload, (uint32_t)(key & 0xFFFF), &low))
+		{
+			*found = chunk | low;
+			return FASTMAP_OK;
+		}
+	}
+
+	for (; partition < ihandle->handle.leafpages; partition++)
+	{
+		chunk = _integerkey(directory + (partition * sizeof(struct _atompartition)), sizeof(((struct _atompartition*)0)->firstkey));
+		if ((payload = _roaringcontainer(ihandle, partition, &container)) != NULL && _roaringcontainerbound(&container, payload, 0, &low))
+		{
+			*found = chunk | low;
+			return FASTMAP_OK;
+		}
+	}
+
+	return FASTMAP_NOT_FOUND;
+}
+
+/* Find the smallest key no less than 'key' in a set of encoded atoms */
+static int _encodedatoms_lowerbound(const fastmap_inhandle_t *ihandle, uint64_t key, uint64_t *found)
+{
+	if (ihandle->handle.flags & FASTMAP_ROARING)
+		return _roaring_lowerbound(ihandle, key, found);
+	return _eliasfano_lowerbound(ihandle, key, found);
+}
+
+/* Compare variable length keys byte-wise, shorter keys collating before longer ones */
+static int _cmpvariable(const void *a, size_t asize, const void *b, size_t bsize)
+{
+	int ord = memcmp(a, b, MIN(asize, bsize));
+
+	if (ord != 0)
+		return ord;
+	return (asize > bsize) - (asize < bsize);
+}
+
+/* Find the leaf page which may hold a key by way of slotted search pages, and the page of the
+ * lowest search level leading to it into 'searchpage' unless it is NULL, returns the number of
+ * leaf pages if no page can hold it */
+static size_t _slottedsearch(const fastmap_inhandle_t *ihandle, const void *key, size_t ksize, size_t *searchpage)
+{
+	const size_t maxslots = ihandle->handle.pagesize / sizeof(struct _keyslot);
+	struct _searchpageheader searchheader;
+	struct _keyslot slot;
+	const unsigned char *page;
+	size_t child = 0, lo, hi, mid;
+	int level;
+
+	/* each search page counts the separators no greater than the key, offset by its first separator */
+	for (level = ihandle->handle.numlevels - 1; level >= 0; level--)
+	{
+		if (child >= ihandle->handle.perlevel[level].pages)
+			return ihandle->handle.leafpages;
+		if (level == 0 && searchpage != NULL)
+			*searchpage = child;
+
+		page = (unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[level].firstoffset + (child * ihandle->handle.pagesize);
+		memcpy(&searchheader, page, sizeof(searchheader));
+		if (searchheader.keys > maxslots)
+			return ihandle->handle.leafpages;
+
+		lo = 0;
+		hi = searchheader.keys;
+		while (lo < hi)
+		{
+			mid = lo + (hi - lo) / 2;
+			memcpy(&slot, page + sizeof(searchheader) + (mid * sizeof(slot)), sizeof(slot));
+			if (_cmpvariable(key, ksize, page + slot.offset, slot.ksize) >= 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		child = (size_t)searchheader.firstkey + lo;
+	}
+
+	return MIN(child, ihandle->handle.leafpages);
+}
+
+/* Look up a key in the slotted leaf page at 'pageoffset' of a map with variable length keys */
+static int _variablekeys_leafget(fastmap_inhandle_t *ihandle, fastmap_record_t *record, size_t pageoffset)
+{
+	const size_t ksize = _recordksize(ihandle->handle.attr.format, record);
+	const size_t maxslots = ihandle->handle.pagesize / sizeof(struct _keyslot);
+	struct _leafpageheader leafheader;
+	struct _keyslot slot;
+	const unsigned char *page;
+	size_t lo, hi, mid;
+	int ord;
+
+	page = _mapped(ihandle, pageoffset, ihandle->handle.pagesize);
+	memcpy(&leafheader, page, sizeof(leafheader));
+	if (leafheader.entries > maxslots)
+		return FASTMAP_NOT_FOUND;
+
+	lo = 0;
+	hi = leafheader.entries;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		memcpy(&slot, page + sizeof(leafheader) + (mid * sizeof(slot)), sizeof(slot));
+		ord = _cmpvariable(record->atom.key, ksize, page + slot.offset, slot.ksize);
+		if (ord == 0)
+		{
+			_entryvalue(ihandle, page + slot.offset + slot.ksize, record, (size_t)leafheader.firstrecord + mid);
+			return FASTMAP_OK;
+		}
+		else if (ord < 0)
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+
+	return FASTMAP_NOT_FOUND;
+}
+
+/* Find the leaf page which may hold the key of 'record', returns FASTMAP_NOT_FOUND if none may.
+ * Only the search levels are read, which a buffer pool keeps pinned. The page of the lowest
+ * slotted search level leading to the leaf page is put to 'searchpage' unless it is NULL */
+static int _leaflocate(const fastmap_inhandle_t *ihandle, const fastmap_record_t *record, size_t *pageoffset, size_t *searchpage)
+{
+	size_t offset;
+	size_t currentpage, currentkey;
+	int currentlevel, ord;
+
+	if (ihandle->handle.leafpages == 0)
+		return FASTMAP_NOT_FOUND;
+
+	if (ihandle->handle.flags & (FASTMAP_VARIABLE_KEYS | FASTMAP_TRUNCATED_SEPARATORS))
+	{
+		currentpage = _slottedsearch(ihandle, record->atom.key, (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS) ?
+			_recordksize(ihandle->handle.attr.format, record) : ihandle->handle.attr.ksize, searchpage);
+		if (currentpage >= ihandle->handle.leafpages)
+			return FASTMAP_NOT_FOUND;
+		offset = ihandle->handle.firstleafpageoffset + (currentpage * ihandle->handle.pagesize);
+	}
+	else if ((ihandle->handle.flags & FASTMAP_INTEGER_KEYS) && ihandle->cmp == fastmap_cmpfunc_memcmp)
+	{
+		currentpage = _integerkeys_search(ihandle, _integerkey(record->atom.key, ihandle->handle.attr.ksize));
+		if (currentpage >= ihandle->handle.leafpages)
+			return FASTMAP_NOT_FOUND;
+		offset = ihandle->handle.firstleafpageoffset + (currentpage * ihandle->handle.pagesize);
+	}
+	else if (ihandle->handle.numlevels == 0)
+	{
+		offset = ihandle->handle.firstleafpageoffset;
+	}
+	else
+	{
+		currentlevel = ihandle->handle.numlevels;
+		offset = ihandle->handle.perlevel[currentlevel - 1].firstoffset;
+		currentpage = 0;
+		while (currentlevel > 0)
+		{
+			while (currentpage < ihandle->handle.perlevel[currentlevel - 1].pages)
+			{
+				for (currentkey = 0; currentkey < ihandle->handle.keyspersearchpage; currentkey++)
+				{
+					ord = ihandle->cmp(&ihandle->handle.attr, record->atom.key, (char*)ihandle->mmapaddr + offset);
+
+					if (ord > 0 && offset != ihandle->handle.perlevel[currentlevel - 1].lastoffset)
+					{
+						offset += ihandle->handle.attr.ksize;
+						continue;
+					}
+					else
+					{
+						currentpage = (currentpage * ihandle->handle.keyspersearchpage) + currentkey;
+
+						if (ord >= 0)
+						{
+							currentpage++;
+						}
+
+						if (currentlevel == 1)
+						{
+							offset = ihandle->handle.firstleafpageoffset;
+						}
+						else
+						{
 							offset = ihandle->handle.perlevel[currentlevel - 2].firstoffset;
 						}
 						offset += currentpage * ihandle->handle.pagesize;
@@ -485,12 +4411,1734 @@ int fastmap_inhandle_get(fastmap_inhandle_t *ihandle, fastmap_record_t *record)
 				offset = ALIGN_TO_PAGE_OFFSET(offset, ihandle->handle.pagesize);
 				currentpage++;
 			}
-NEXT_LEVEL:
-			currentlevel--;
+NEXT_LEVEL:
+			currentlevel--;
+		}
+	}
+
+	*pageoffset = offset;
+	return FASTMAP_OK;
+}
+
+/* Look up the key of 'record' in the leaf page at 'pageoffset' */
+static int _leafsearch(fastmap_inhandle_t *ihandle, fastmap_record_t *record, size_t pageoffset)
+{
+	if (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS)
+		return _variablekeys_leafget(ihandle, record, pageoffset);
+	if ((ihandle->handle.flags & FASTMAP_INTEGER_KEYS) && ihandle->cmp == fastmap_cmpfunc_memcmp)
+		return _integerkeys_leafget(ihandle, record, pageoffset);
+	if (ihandle->handle.flags & FASTMAP_FRONT_CODED)
+		return _frontcodedleafpage_get(ihandle, record, pageoffset);
+
+	return _leafpage_get(ihandle, record, pageoffset, ((pageoffset - ihandle->handle.firstleafpageoffset) / ihandle->handle.pagesize) * ihandle->handle.recordsperleafpage);
+}
+
+static int _inhandle_get(fastmap_inhandle_t *ihandle, fastmap_record_t *record)
+{
+	size_t pageoffset;
+	int rc;
+
+	if (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS)
+	{
+		uint64_t key = _integerkey(record->atom.key, ihandle->handle.attr.ksize), found;
+
+		return (_encodedatoms_lowerbound(ihandle, key, &found) == FASTMAP_OK && found == key) ? FASTMAP_OK : FASTMAP_NOT_FOUND;
+	}
+
+	if ((rc = _leaflocate(ihandle, record, &pageoffset, NULL)) != FASTMAP_OK)
+		return rc;
+	return _leafsearch(ihandle, record, pageoffset);
+}
+
+/* Finish a lookup which returned 'rc', failing it if any read of the buffer pool failed */
+static int _finishlookup(const fastmap_inhandle_t *ihandle, const fastmap_record_t *record, int rc)
+{
+	rc = _poolerror(ihandle, rc);
+
+	/* a blob value read from the value pages is only known to be readable once its pointers are checked
+	 * against the map, and its block decompressed if it is compressed */
+	if (rc == FASTMAP_OK && ihandle->handle.attr.format == FASTMAP_BLOB && record->blob.value == NULL)
+		return FASTMAP_CORRUPT_VALUE;
+	return rc;
+}
+
+static int _inhandle_lookup(fastmap_inhandle_t *ihandle, fastmap_record_t *record)
+{
+	return _finishlookup(ihandle, record, _inhandle_get(ihandle, record));
+}
+
+int fastmap_inhandle_get(fastmap_inhandle_t *ihandle, fastmap_record_t *record)
+{
+	_poolbegin(ihandle);
+	return _inhandle_lookup(ihandle, record);
+}
+
+/* Try a lookup without blocking, starting the reads of the frames it misses */
+static int _trylookup(fastmap_inhandle_t *ihandle, fastmap_record_t *record)
+{
+	struct _bufferpool *pool = ihandle->pool;
+	int rc;
+
+	pool->error = FASTMAP_OK;
+	pool->nonblocking = 1;
+	pool->missing = SIZE_MAX;
+	rc = _inhandle_lookup(ihandle, record);
+	pool->nonblocking = 0;
+	return rc;
+}
+
+int fastmap_inhandle_submit(fastmap_inhandle_t *ihandle, fastmap_record_t *record, void *cookie)
+{
+	struct _bufferpool *pool;
+	struct _asynclookup *lookups;
+	int rc;
+
+	if (ihandle == NULL || ihandle->pool == NULL || record == NULL)
+		return EINVAL;
+	pool = ihandle->pool;
+
+	if (pool->nlookups == pool->lookupcapacity)
+	{
+		if ((lookups = realloc(pool->lookups, (pool->lookupcapacity ? 2 * pool->lookupcapacity : 64) * sizeof(*lookups))) == NULL)
+			return ENOMEM;
+		pool->lookups = lookups;
+		pool->lookupcapacity = pool->lookupcapacity ? 2 * pool->lookupcapacity : 64;
+	}
+
+	_poolbegin(ihandle);
+	if ((rc = _trylookup(ihandle, record)) != FASTMAP_PENDING)
+		return rc;
+
+	pool->lookups[pool->nlookups].record = record;
+	pool->lookups[pool->nlookups].cookie = cookie;
+	pool->lookups[pool->nlookups].frame = pool->missing;
+	pool->lookups[pool->nlookups].ready = 0;
+	pool->lookups[pool->nlookups].rc = FASTMAP_OK;
+	pool->nlookups++;
+	return FASTMAP_PENDING;
+}
+
+int fastmap_inhandle_complete(fastmap_inhandle_t *ihandle, fastmap_completion_t *completions, size_t ncompletions, size_t *ncompleted, int wait)
+{
+	struct _bufferpool *pool;
+	struct _asynclookup *lookup;
+	size_t i;
+	int rc;
+
+	if (ihandle == NULL || ihandle->pool == NULL || completions == NULL || ncompleted == NULL)
+		return EINVAL;
+	pool = ihandle->pool;
+
+	/* lookups completed in one call share an epoch, so none evicts the values of another */
+	*ncompleted = 0;
+	_poolbegin(ihandle);
+	while (ncompletions > 0 && pool->nlookups > 0)
+	{
+		_poolharvest(pool, ihandle->mmapaddr, 0, ncompletions);
+		for (i = 0; i < pool->nlookups && *ncompleted < ncompletions; )
+		{
+			lookup = &pool->lookups[i];
+			if (!lookup->ready)
+			{
+				i++;
+				continue;
+			}
+
+			rc = lookup->rc;
+			if (rc == FASTMAP_OK && (rc = _trylookup(ihandle, lookup->record)) == FASTMAP_PENDING)
+			{
+				lookup->frame = pool->missing;
+				lookup->ready = 0;
+				i++;
+				continue;
+			}
+
+			completions[*ncompleted].record = lookup->record;
+			completions[*ncompleted].cookie = lookup->cookie;
+			completions[*ncompleted].rc = rc;
+			(*ncompleted)++;
+			pool->lookups[i] = pool->lookups[--pool->nlookups];
+		}
+
+		if (*ncompleted > 0 || !wait || _poolharvest(pool, ihandle->mmapaddr, 1, ncompletions) == 0)
+			break;
+	}
+
+	pool->error = FASTMAP_OK;
+	return FASTMAP_OK;
+}
+
+/* Start fetching 'size' bytes of the map from 'offset'. A buffer pool reads their frames
+ * asynchronously, a mapped file is advised that its pages will be needed, and the first cache
+ * lines are prefetched, where every search of a page starts */
+static void _prefetch(fastmap_inhandle_t *ihandle, size_t offset, size_t size)
+{
+	struct _bufferpool *pool = ihandle->pool;
+	const unsigned char *p = (const unsigned char*)ihandle->mmapaddr + offset;
+	size_t systempagesize, start, frame, i;
+
+	if (offset >= ihandle->mmaplen || size == 0)
+		return;
+	size = MIN(size, ihandle->mmaplen - offset);
+
+	if (pool != NULL)
+	{
+		for (frame = offset / pool->framesize; frame <= (offset + size - 1) / pool->framesize; frame++)
+		{
+			if (pool->frames[frame] == FASTMAP_FRAMEABSENT && _poolsubmitread(pool, frame) != FASTMAP_OK)
+				break;
+		}
+		return;
+	}
+
+	/* a map read into memory, or populated when it was mapped, has no pages left to read in */
+	if (ihandle->mapping != NULL && !(ihandle->mapflags & (FASTMAP_MAP_LOADRAM | FASTMAP_MAP_POPULATE)))
+	{
+		systempagesize = (size_t)sysconf(_SC_PAGESIZE);
+		start = (uintptr_t)p & ~(systempagesize - 1);
+		madvise((void*)start, ((uintptr_t)p + size) - start, MADV_WILLNEED);
+	}
+	for (i = 0; i < MIN(size, FASTMAP_PREFETCHBYTES); i += FASTMAP_CACHELINE)
+		__builtin_prefetch(p + i);
+}
+
+int fastmap_inhandle_prefetch(fastmap_inhandle_t *ihandle, const fastmap_record_t *record, fastmap_prefetch_t *token)
+{
+	const struct _atompartition *directory;
+	size_t partition, offset;
+
+	if (ihandle == NULL || record == NULL || token == NULL)
+		return EINVAL;
+
+	/* a set of encoded atoms is searched again from its directory, its partition being fetched meanwhile */
+	if (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS)
+	{
+		token->located = -1;
+		directory = (const struct _atompartition*)((char*)ihandle->mmapaddr + ihandle->handle.firstleafpageoffset);
+		partition = _interpolationrank((const unsigned char*)directory, ihandle->handle.leafpages, sizeof(*directory), sizeof(directory->firstkey),
+			_integerkey(record->atom.key, ihandle->handle.attr.ksize));
+		if (partition == 0)
+			return FASTMAP_OK;
+		memcpy(&offset, &directory[partition - 1].offset, sizeof(offset));
+		_prefetch(ihandle, ihandle->handle.firstvalueoffset + offset, FASTMAP_PREFETCHBYTES);
+		return FASTMAP_OK;
+	}
+
+	token->located = (_leaflocate(ihandle, record, &token->pageoffset, NULL) == FASTMAP_OK);
+	if (token->located)
+		_prefetch(ihandle, token->pageoffset, ihandle->handle.pagesize);
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_getprefetched(fastmap_inhandle_t *ihandle, fastmap_record_t *record, const fastmap_prefetch_t *token)
+{
+	if (ihandle == NULL || record == NULL || token == NULL)
+		return EINVAL;
+
+	if (token->located < 0)
+		return fastmap_inhandle_get(ihandle, record);
+	if (token->located == 0)
+		return FASTMAP_NOT_FOUND;
+
+	/* the token names a leaf page of this map, or it comes from another */
+	if (token->pageoffset < ihandle->handle.firstleafpageoffset || (token->pageoffset - ihandle->handle.firstleafpageoffset) % ihandle->handle.pagesize != 0 ||
+		(token->pageoffset - ihandle->handle.firstleafpageoffset) / ihandle->handle.pagesize >= ihandle->handle.leafpages)
+		return EINVAL;
+
+	_poolbegin(ihandle);
+	return _finishlookup(ihandle, record, _leafsearch(ihandle, record, token->pageoffset));
+}
+
+int fastmap_finger_init(fastmap_finger_t *finger, fastmap_inhandle_t *ihandle)
+{
+	if (finger == NULL || ihandle == NULL)
+		return EINVAL;
+
+	memset(finger, 0, sizeof(*finger));
+	finger->ihandle = ihandle;
+	finger->child = SIZE_MAX;
+	return FASTMAP_OK;
+}
+
+/* Separator 'j' of the lowest search level of fixed size keys, which is the first key of leaf page j + 1 */
+static const void *_fixedseparator(const fastmap_inhandle_t *ihandle, size_t j)
+{
+	return (const unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[0].firstoffset +
+		((j / ihandle->handle.keyspersearchpage) * ihandle->handle.pagesize) + ((j % ihandle->handle.keyspersearchpage) * ihandle->handle.attr.ksize);
+}
+
+/* Move a finger over search levels of fixed size keys on to the leaf page of a key, from the
+ * page it is on when the key is no less than the first key of that page, galloping over the
+ * separators of the lowest search level. Returns zero if the key lies before the page */
+static int _fixedfinger(fastmap_finger_t *finger, const void *key)
+{
+	const fastmap_inhandle_t *ihandle = finger->ihandle;
+	const fastmap_attr_t *attr = &ihandle->handle.attr;
+	const size_t span = ihandle->handle.perlevel[0].lastoffset - ihandle->handle.perlevel[0].firstoffset;
+	const size_t separators = (span / ihandle->handle.pagesize) * ihandle->handle.keyspersearchpage + (span % ihandle->handle.pagesize) / attr->ksize + 1;
+	size_t lo = finger->child, hi, mid, step = 1;
+
+	if (lo > 0 && ihandle->cmp(attr, key, _fixedseparator(ihandle, lo - 1)) < 0)
+		return 0;
+
+	/* the separators before 'lo' are no greater than the key, find the first which is greater */
+	hi = lo;
+	while (hi < separators && ihandle->cmp(attr, key, _fixedseparator(ihandle, hi)) >= 0)
+	{
+		lo = hi + 1;
+		hi = lo + step - 1;
+		step *= 2;
+	}
+	hi = MIN(hi, separators);
+	if (hi > finger->child)
+		finger->gallops++;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (ihandle->cmp(attr, key, _fixedseparator(ihandle, mid)) >= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	finger->child = lo;
+	return 1;
+}
+
+/* Compare a key with separator 'j' of page 'searchpage' of the lowest slotted search level */
+static int _slottedcmp(const fastmap_inhandle_t *ihandle, size_t searchpage, size_t j, const void *key, size_t ksize)
+{
+	const unsigned char *page = (const unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[0].firstoffset + (searchpage * ihandle->handle.pagesize);
+	struct _keyslot slot;
+
+	memcpy(&slot, page + sizeof(struct _searchpageheader) + (j * sizeof(slot)), sizeof(slot));
+	return _cmpvariable(key, ksize, page + slot.offset, slot.ksize);
+}
+
+/* Move a finger over slotted search levels on to the leaf page of a key, within the page of the
+ * lowest search level it is on or the one after. Returns zero if the key lies outside them */
+static int _slottedfinger(fastmap_finger_t *finger, const void *key, size_t ksize)
+{
+	const fastmap_inhandle_t *ihandle = finger->ihandle;
+	const size_t maxslots = ihandle->handle.pagesize / sizeof(struct _keyslot);
+	struct _searchpageheader searchheader, previousheader;
+	size_t searchpage = finger->searchpage, lo, hi, mid;
+
+	memcpy(&searchheader, (const unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[0].firstoffset + (searchpage * ihandle->handle.pagesize), sizeof(searchheader));
+
+	/* the separators are numbered across the level, and the one before the page of the finger bounds it from below */
+	if (finger->child > searchheader.firstkey && finger->child - searchheader.firstkey <= searchheader.keys)
+	{
+		if (_slottedcmp(ihandle, searchpage, finger->child - searchheader.firstkey - 1, key, ksize) < 0)
+			return 0;
+	}
+	else if (finger->child == searchheader.firstkey && searchpage > 0)
+	{
+		memcpy(&previousheader, (const unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[0].firstoffset + ((searchpage - 1) * ihandle->handle.pagesize), sizeof(previousheader));
+		if (previousheader.keys == 0 || previousheader.keys > maxslots || _slottedcmp(ihandle, searchpage - 1, previousheader.keys - 1, key, ksize) < 0)
+			return 0;
+	}
+	else if (finger->child != 0)
+	{
+		return 0;
+	}
+
+	/* a key past the last separator of the page moves on to the next */
+	if (searchheader.keys > 0 && _slottedcmp(ihandle, searchpage, searchheader.keys - 1, key, ksize) >= 0)
+	{
+		if (searchpage + 1 >= ihandle->handle.perlevel[0].pages)
+		{
+			lo = searchheader.keys;
+			goto located;
+		}
+		searchpage++;
+		memcpy(&searchheader, (const unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[0].firstoffset + (searchpage * ihandle->handle.pagesize), sizeof(searchheader));
+		if (searchheader.keys == 0 || searchheader.keys > maxslots || _slottedcmp(ihandle, searchpage, searchheader.keys - 1, key, ksize) >= 0)
+			return 0;
+	}
+
+	lo = 0;
+	hi = searchheader.keys;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (_slottedcmp(ihandle, searchpage, mid, key, ksize) >= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+located:
+	if ((size_t)searchheader.firstkey + lo != finger->child)
+		finger->gallops++;
+	finger->child = (size_t)searchheader.firstkey + lo;
+	finger->searchpage = searchpage;
+	return 1;
+}
+
+int fastmap_finger_get(fastmap_finger_t *finger, fastmap_record_t *record)
+{
+	fastmap_inhandle_t *ihandle;
+	size_t pageoffset;
+	int moved = 0, rc;
+
+	if (finger == NULL || finger->ihandle == NULL || record == NULL)
+		return EINVAL;
+	ihandle = finger->ihandle;
+	finger->lookups++;
+
+	if (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS)
+		return fastmap_inhandle_get(ihandle, record);
+	if (ihandle->handle.leafpages == 0)
+		return FASTMAP_NOT_FOUND;
+
+	/* a map without search levels has a single leaf page */
+	if (ihandle->handle.numlevels == 0)
+	{
+		finger->child = 0;
+		moved = 1;
+	}
+	else if (finger->child != SIZE_MAX && (ihandle->handle.flags & (FASTMAP_VARIABLE_KEYS | FASTMAP_TRUNCATED_SEPARATORS)))
+	{
+		moved = _slottedfinger(finger, record->atom.key, (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS) ?
+			_recordksize(ihandle->handle.attr.format, record) : ihandle->handle.attr.ksize);
+	}
+	else if (finger->child != SIZE_MAX)
+	{
+		moved = _fixedfinger(finger, record->atom.key);
+	}
+
+	if (moved)
+	{
+		if (finger->child >= ihandle->handle.leafpages)
+			return FASTMAP_NOT_FOUND;
+		pageoffset = ihandle->handle.firstleafpageoffset + (finger->child * ihandle->handle.pagesize);
+	}
+	else
+	{
+		finger->descents++;
+		finger->child = SIZE_MAX;
+		if ((rc = _leaflocate(ihandle, record, &pageoffset, &finger->searchpage)) != FASTMAP_OK)
+			return rc;
+		finger->child = (pageoffset - ihandle->handle.firstleafpageoffset) / ihandle->handle.pagesize;
+	}
+
+	_poolbegin(ihandle);
+	return _finishlookup(ihandle, record, _leafsearch(ihandle, record, pageoffset));
+}
+
+int fastmap_inhandle_setthreads(fastmap_inhandle_t *ihandle, size_t nthreads)
+{
+	if (ihandle == NULL || nthreads == 0)
+		return EINVAL;
+
+	ihandle->threads = nthreads;
+	return FASTMAP_OK;
+}
+
+/* Add the numbers of the values of records 'first' up to 'last' to 'aggregate' */
+static int _aggregaterecords(fastmap_inhandle_t *ihandle, size_t first, size_t last, fastmap_aggregate_t *aggregate)
+{
+	fastmap_record_t record;
+	int rc;
+
+	for (; first < last; first++)
+	{
+		if ((rc = fastmap_inhandle_select(ihandle, first, &record)) != FASTMAP_OK)
+			return rc;
+		_aggregateadd(ihandle->handle.attr.valueaggregate, aggregate, record.block.value);
+	}
+
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_aggregate(fastmap_inhandle_t *ihandle, const fastmap_record_t *first, const fastmap_record_t *last, fastmap_aggregate_t *aggregate)
+{
+	fastmap_aggregate_t node;
+	size_t begin = 0, end, lo, hi, rpp, n, offset, size = 0, i;
+	int level, rc;
+
+	if (ihandle == NULL || aggregate == NULL || !(ihandle->handle.flags & FASTMAP_AGGREGATES))
+		return EINVAL;
+
+	memset(aggregate, 0, sizeof(*aggregate));
+	end = ihandle->handle.attr.records;
+	if (first != NULL && (rc = fastmap_inhandle_rank(ihandle, first, &begin)) != FASTMAP_OK && rc != FASTMAP_NOT_FOUND)
+		return rc;
+	if (last != NULL && (rc = fastmap_inhandle_rank(ihandle, last, &end)) != FASTMAP_OK && rc != FASTMAP_NOT_FOUND)
+		return rc;
+	if (end <= begin)
+		return FASTMAP_OK;
+
+	for (level = 0; (n = _aggregatelevelsize(ihandle->handle.leafpages, level)) > 1; level++)
+		size += n;
+	size += n;
+	if (ihandle->handle.aggregateoffset == 0 || ihandle->handle.aggregateoffset + (size * sizeof(node)) > ihandle->mmaplen)
+		return FASTMAP_CORRUPT_PAGE;
+
+	/* the leaf pages wholly within the range, the last page of the map being whole however many records it holds */
+	rpp = ihandle->handle.recordsperleafpage;
+	lo = (begin + rpp - 1) / rpp;
+	hi = (end == ihandle->handle.attr.records) ? ihandle->handle.leafpages : end / rpp;
+	if (lo >= hi)
+		return _aggregaterecords(ihandle, begin, end, aggregate);
+	if ((rc = _aggregaterecords(ihandle, begin, lo * rpp, aggregate)) != FASTMAP_OK || (rc = _aggregaterecords(ihandle, MIN(hi * rpp, end), end, aggregate)) != FASTMAP_OK)
+		return rc;
+
+	/* take the aggregates at the edges of the run which do not make up a whole aggregate of the
+	 * level above, and climb with the rest, until the run is shorter than an aggregate above */
+	_poolbegin(ihandle);
+	for (level = 0, offset = ihandle->handle.aggregateoffset; lo < hi; level++)
+	{
+		n = _aggregatelevelsize(ihandle->handle.leafpages, level);
+		if (hi - lo >= FASTMAP_AGGREGATEFANOUT && n > 1)
+		{
+			for (; lo % FASTMAP_AGGREGATEFANOUT != 0; lo++)
+			{
+				memcpy(&node, _mapped(ihandle, offset + (lo * sizeof(node)), sizeof(node)), sizeof(node));
+				_aggregatecombine(ihandle->handle.attr.valueaggregate, aggregate, &node);
+			}
+			for (; hi % FASTMAP_AGGREGATEFANOUT != 0 && hi != n; hi--)
+			{
+				memcpy(&node, _mapped(ihandle, offset + ((hi - 1) * sizeof(node)), sizeof(node)), sizeof(node));
+				_aggregatecombine(ihandle->handle.attr.valueaggregate, aggregate, &node);
+			}
+			lo /= FASTMAP_AGGREGATEFANOUT;
+			hi = (hi + FASTMAP_AGGREGATEFANOUT - 1) / FASTMAP_AGGREGATEFANOUT;
+			offset += n * sizeof(node);
+			continue;
+		}
+
+		for (i = lo; i < hi; i++)
+		{
+			memcpy(&node, _mapped(ihandle, offset + (i * sizeof(node)), sizeof(node)), sizeof(node));
+			_aggregatecombine(ihandle->handle.attr.valueaggregate, aggregate, &node);
+		}
+		break;
+	}
+
+	return _poolerror(ihandle, FASTMAP_OK);
+}
+
+/* Whether lookups may be made through the handle on several threads at once. The value cache of
+ * compressed maps and the buffer pool change with every lookup, and are kept to the calling thread */
+static int _threadsafe(const fastmap_inhandle_t *ihandle)
+{
+	return ihandle->threads > 1 && ihandle->pool == NULL && !(ihandle->handle.flags & FASTMAP_COMPRESSED_VALUES);
+}
+
+/* A run of the records of #fastmap_inhandle_mget() looked up by one thread */
+struct _mgetpartition
+{
+	fastmap_inhandle_t *ihandle;
+	fastmap_record_t **records;
+	size_t nrecords;
+	int sorted;
+	int rc;
+	pthread_t thread;
+	int started;
+};
+
+/* Compare the keys of two records in the order of the map */
+static int _recordcmp(const fastmap_inhandle_t *ihandle, const fastmap_record_t *a, const fastmap_record_t *b)
+{
+	if (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS)
+		return _cmpvariable(a->atom.key, _recordksize(ihandle->handle.attr.format, a), b->atom.key, _recordksize(ihandle->handle.attr.format, b));
+	return ihandle->cmp(&ihandle->handle.attr, a->atom.key, b->atom.key);
+}
+
+/* The leaf page which may hold the key of 'record', or the number of leaf pages if none may */
+static size_t _recordleaf(const fastmap_inhandle_t *ihandle, const fastmap_record_t *record)
+{
+	size_t pageoffset;
+
+	if ((ihandle->handle.flags & FASTMAP_ENCODED_ATOMS) || _leaflocate(ihandle, record, &pageoffset, NULL) != FASTMAP_OK)
+		return ihandle->handle.leafpages;
+	return (pageoffset - ihandle->handle.firstleafpageoffset) / ihandle->handle.pagesize;
+}
+
+/* Look up a partition of the records, through a finger when they are sorted, keeping the first error
+ * other than a missing key in the partition */
+static void *_mgetpartition(void *arg)
+{
+	struct _mgetpartition *partition = arg;
+	fastmap_finger_t finger;
+	size_t i;
+	int rc;
+
+	partition->rc = FASTMAP_OK;
+	fastmap_finger_init(&finger, partition->ihandle);
+	for (i = 0; i < partition->nrecords; i++)
+	{
+		if (partition->records[i] == NULL)
+			continue;
+
+		rc = partition->sorted ? fastmap_finger_get(&finger, partition->records[i]) : fastmap_inhandle_get(partition->ihandle, partition->records[i]);
+		if (rc == FASTMAP_NOT_FOUND)
+			partition->records[i] = NULL;
+		else if (rc != FASTMAP_OK && partition->rc == FASTMAP_OK)
+			partition->rc = rc;
+	}
+
+	return NULL;
+}
+
+int fastmap_inhandle_mget(fastmap_inhandle_t *ihandle, fastmap_record_t *records[], size_t nrecords)
+{
+	struct _mgetpartition single, *partitions = NULL;
+	size_t npartitions = 1, previous, first, last, lo, hi, mid, leaf, i;
+	int sorted = 1, rc = FASTMAP_OK;
+
+	if (ihandle == NULL || (records == NULL && nrecords > 0))
+		return EINVAL;
+
+	/* records left NULL are skipped */
+	for (i = 0, previous = SIZE_MAX; i < nrecords && sorted; i++)
+	{
+		if (records[i] == NULL)
+			continue;
+		if (previous != SIZE_MAX && _recordcmp(ihandle, records[previous], records[i]) > 0)
+			sorted = 0;
+		previous = i;
+	}
+
+	if (_threadsafe(ihandle))
+		npartitions = MIN(ihandle->threads, nrecords / FASTMAP_MGETPARTITION);
+
+	if (npartitions <= 1)
+	{
+		single.ihandle = ihandle;
+		single.records = records;
+		single.nrecords = nrecords;
+		single.sorted = sorted;
+		_mgetpartition(&single);
+		return single.rc;
+	}
+
+	if ((partitions = calloc(npartitions, sizeof(*partitions))) == NULL)
+		return ENOMEM;
+
+	/* a sorted batch is split where its keys leave a leaf page, so that no two threads search the same page */
+	for (i = 0, first = 0; i < npartitions; i++)
+	{
+		last = (i + 1 == npartitions) ? nrecords : MAX(first, (nrecords / npartitions) * (i + 1));
+		if (sorted && last > 0 && last < nrecords && records[last - 1] != NULL)
+		{
+			leaf = _recordleaf(ihandle, records[last - 1]);
+			lo = last;
+			hi = nrecords;
+			while (lo < hi)
+			{
+				mid = lo + (hi - lo) / 2;
+				if (records[mid] == NULL || _recordleaf(ihandle, records[mid]) == leaf)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			last = lo;
+		}
+
+		partitions[i].ihandle = ihandle;
+		partitions[i].records = records + first;
+		partitions[i].nrecords = last - first;
+		partitions[i].sorted = sorted;
+		first = last;
+	}
+
+	/* the calling thread takes the first partition, and any a thread could not be started for */
+	for (i = 1; i < npartitions; i++)
+		partitions[i].started = (partitions[i].nrecords > 0 && pthread_create(&partitions[i].thread, NULL, _mgetpartition, &partitions[i]) == 0);
+	for (i = 0; i < npartitions; i++)
+	{
+		if (!partitions[i].started)
+			_mgetpartition(&partitions[i]);
+	}
+	for (i = 1; i < npartitions; i++)
+	{
+		if (partitions[i].started)
+			pthread_join(partitions[i].thread, NULL);
+	}
+
+	for (i = 0; i < npartitions; i++)
+	{
+		if (partitions[i].rc != FASTMAP_OK)
+		{
+			rc = partitions[i].rc;
+			break;
+		}
+	}
+
+	free(partitions);
+	return rc;
+}
+
+/* Count the keys less than that of 'record' in the leaf page at 'pageoffset' into 'rank',
+ * returns FASTMAP_OK if the page holds the key and FASTMAP_NOT_FOUND if it does not */
+static int _leafrank(fastmap_inhandle_t *ihandle, const fastmap_record_t *record, size_t pageoffset, size_t *rank)
+{
+	const unsigned char *page = _mapped(ihandle, pageoffset, ihandle->handle.pagesize);
+	const size_t child = (pageoffset - ihandle->handle.firstleafpageoffset) / ihandle->handle.pagesize;
+	const size_t ksize = ihandle->handle.attr.ksize;
+	unsigned char key[FASTMAP_MAXFRONTCODEDKSIZE];
+	struct _leafpageheader header;
+	struct _keyslot slot;
+	const unsigned char *p;
+	size_t n, lo, hi, mid, entry, last, shared, unshared;
+	uint32_t restart;
+	int ord;
+
+	if (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS)
+	{
+		memcpy(&header, page, sizeof(header));
+		if (header.entries > ihandle->handle.pagesize / sizeof(slot))
+			return FASTMAP_CORRUPT_PAGE;
+
+		/* find the first slot whose key is no less than the one sought */
+		lo = 0;
+		hi = header.entries;
+		while (lo < hi)
+		{
+			mid = lo + (hi - lo) / 2;
+			memcpy(&slot, page + sizeof(header) + (mid * sizeof(slot)), sizeof(slot));
+			if (_cmpvariable(record->atom.key, _recordksize(ihandle->handle.attr.format, record), page + slot.offset, slot.ksize) > 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		*rank = (size_t)header.firstrecord + lo;
+		if (lo == header.entries)
+			return FASTMAP_NOT_FOUND;
+		memcpy(&slot, page + sizeof(header) + (lo * sizeof(slot)), sizeof(slot));
+		return _cmpvariable(record->atom.key, _recordksize(ihandle->handle.attr.format, record), page + slot.offset, slot.ksize) == 0 ? FASTMAP_OK : FASTMAP_NOT_FOUND;
+	}
+
+	if (ihandle->handle.flags & FASTMAP_FRONT_CODED)
+	{
+		memcpy(&header, page, sizeof(header));
+		*rank = (size_t)header.firstrecord;
+		if (header.restarts == 0 || header.restarts > (ihandle->handle.pagesize - sizeof(header)) / FASTMAP_RESTARTSIZE)
+			return FASTMAP_CORRUPT_PAGE;
+
+		/* find the last restart point whose key is less than the one sought, then count along the run which follows it */
+		lo = 0;
+		hi = header.restarts;
+		while (lo < hi)
+		{
+			mid = lo + (hi - lo) / 2;
+			memcpy(&restart, page + ihandle->handle.pagesize - ((mid + 1) * FASTMAP_RESTARTSIZE), sizeof(restart));
+			p = page + restart;
+			_getvarint(&p);
+			_getvarint(&p);
+			if (ihandle->cmp(&ihandle->handle.attr, record->atom.key, p) > 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == 0)
+		{
+			memcpy(&restart, page + ihandle->handle.pagesize - FASTMAP_RESTARTSIZE, sizeof(restart));
+			p = page + restart;
+			_getvarint(&p);
+			_getvarint(&p);
+			return ihandle->cmp(&ihandle->handle.attr, record->atom.key, p) == 0 ? FASTMAP_OK : FASTMAP_NOT_FOUND;
+		}
+
+		memcpy(&restart, page + ihandle->handle.pagesize - (lo * FASTMAP_RESTARTSIZE), sizeof(restart));
+		p = page + restart;
+		entry = (lo - 1) * ihandle->handle.attr.restartinterval;
+		last = header.entries;
+		for (ord = 1; entry < last; entry++)
+		{
+			shared = _getvarint(&p);
+			unshared = _getvarint(&p);
+			if (shared + unshared != ksize)
+				return FASTMAP_CORRUPT_PAGE;
+			memcpy(key + shared, p, unshared);
+			p += unshared;
+
+			if ((ord = ihandle->cmp(&ihandle->handle.attr, record->atom.key, key)) <= 0)
+				break;
+			p += _entryvalue(ihandle, p, NULL, 0);
+		}
+
+		*rank = (size_t)header.firstrecord + entry;
+		return ord == 0 ? FASTMAP_OK : FASTMAP_NOT_FOUND;
+	}
+
+	/* the records of fixed size leaf pages follow from the number of the page */
+	n = MIN(ihandle->handle.recordsperleafpage, ihandle->handle.attr.records - (child * ihandle->handle.recordsperleafpage));
+	if ((ihandle->handle.flags & FASTMAP_INTEGER_KEYS) && ihandle->cmp == fastmap_cmpfunc_memcmp)
+	{
+		lo = _interpolationrank(page, n, ihandle->handle.leafpagerecordsize, ksize, _integerkey(record->atom.key, ksize));
+		ord = (lo > 0 && _integerkey(page + ((lo - 1) * ihandle->handle.leafpagerecordsize), ksize) == _integerkey(record->atom.key, ksize)) ? 0 : 1;
+		*rank = (child * ihandle->handle.recordsperleafpage) + lo - (ord == 0);
+		return ord == 0 ? FASTMAP_OK : FASTMAP_NOT_FOUND;
+	}
+
+	lo = 0;
+	hi = n;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (ihandle->cmp(&ihandle->handle.attr, record->atom.key, page + (mid * ihandle->handle.leafpagerecordsize)) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	*rank = (child * ihandle->handle.recordsperleafpage) + lo;
+	return (lo < n && ihandle->cmp(&ihandle->handle.attr, record->atom.key, page + (lo * ihandle->handle.leafpagerecordsize)) == 0) ? FASTMAP_OK : FASTMAP_NOT_FOUND;
+}
+
+int fastmap_inhandle_rank(fastmap_inhandle_t *ihandle, const fastmap_record_t *record, size_t *rank)
+{
+	size_t pageoffset;
+	int rc;
+
+	if (ihandle == NULL || record == NULL || rank == NULL || (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS))
+		return EINVAL;
+
+	/* a key no leaf page may hold is greater than every key of the map */
+	*rank = ihandle->handle.attr.records;
+	if (ihandle->handle.leafpages == 0)
+		return FASTMAP_NOT_FOUND;
+
+	_poolbegin(ihandle);
+	if ((rc = _leaflocate(ihandle, record, &pageoffset, NULL)) != FASTMAP_OK)
+		return _poolerror(ihandle, rc);
+	return _poolerror(ihandle, _leafrank(ihandle, record, pageoffset, rank));
+}
+
+/* Find the packed leaf page holding record 'index' by bisecting the first records of the pages */
+static size_t _packedleaf(fastmap_inhandle_t *ihandle, size_t index)
+{
+	struct _leafpageheader header;
+	size_t lo = 0, hi = ihandle->handle.leafpages, mid;
+
+	while (hi - lo > 1)
+	{
+		mid = lo + (hi - lo) / 2;
+		memcpy(&header, _mapped(ihandle, ihandle->handle.firstleafpageoffset + (mid * ihandle->handle.pagesize), sizeof(header)), sizeof(header));
+		if (header.firstrecord <= index)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Decode the key of entry 'entry' of a front-coded leaf page into 'key', from the key before it
+ * when 'position' is the offset of the entry within the page and from its restart point when it
+ * is 0. Returns the offset of the value of the entry, or 0 if the page is corrupt */
+static size_t _frontcodedentry(fastmap_inhandle_t *ihandle, const unsigned char *page, const struct _leafpageheader *header, size_t entry, size_t position, unsigned char *key)
+{
+	const size_t ksize = ihandle->handle.attr.ksize;
+	const unsigned char *p;
+	size_t first, shared, unshared;
+	uint32_t restart;
+
+	if (entry >= header->entries || entry / ihandle->handle.attr.restartinterval >= header->restarts)
+		return 0;
+
+	if (position != 0)
+	{
+		p = page + position;
+		first = entry;
+	}
+	else
+	{
+		memcpy(&restart, page + ihandle->handle.pagesize - (((entry / ihandle->handle.attr.restartinterval) + 1) * FASTMAP_RESTARTSIZE), sizeof(restart));
+		p = page + restart;
+		first = (entry / ihandle->handle.attr.restartinterval) * ihandle->handle.attr.restartinterval;
+	}
+
+	for (;; first++)
+	{
+		shared = _getvarint(&p);
+		unshared = _getvarint(&p);
+		if (shared + unshared != ksize || (size_t)(p - page) + unshared > ihandle->handle.pagesize)
+			return 0;
+		memcpy(key + shared, p, unshared);
+		p += unshared;
+		if (first == entry)
+			break;
+		p += _entryvalue(ihandle, p, NULL, 0);
+	}
+
+	return (size_t)(p - page);
+}
+
+/* Point 'record' at record 'index' of a map, which is entry 'index' less the first record of the
+ * packed leaf page 'child'. A front-coded key is decoded into 'key', continuing from 'position'
+ * as by _frontcodedentry(), and the offset of the entry after it is put back to 'position' */
+static int _packedrecord(fastmap_inhandle_t *ihandle, size_t child, size_t index, fastmap_record_t *record, unsigned char *key, size_t *position)
+{
+	const size_t pageoffset = ihandle->handle.firstleafpageoffset + (child * ihandle->handle.pagesize);
+	const unsigned char *page = _mapped(ihandle, pageoffset, ihandle->handle.pagesize);
+	struct _leafpageheader header;
+	struct _keyslot slot;
+	size_t entry, offset;
+
+	memcpy(&header, page, sizeof(header));
+	if (index < header.firstrecord || index - header.firstrecord >= header.entries)
+		return FASTMAP_CORRUPT_PAGE;
+	entry = index - header.firstrecord;
+
+	if (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS)
+	{
+		if (header.entries > ihandle->handle.pagesize / sizeof(slot))
+			return FASTMAP_CORRUPT_PAGE;
+		memcpy(&slot, page + sizeof(header) + (entry * sizeof(slot)), sizeof(slot));
+		_setrecordkey(ihandle->handle.attr.format, record, page + slot.offset, slot.ksize);
+		_entryvalue(ihandle, page + slot.offset + slot.ksize, record, index);
+		return FASTMAP_OK;
+	}
+
+	if ((offset = _frontcodedentry(ihandle, page, &header, entry, *position, key)) == 0)
+		return FASTMAP_CORRUPT_PAGE;
+	_setrecordkey(ihandle->handle.attr.format, record, key, ihandle->handle.attr.ksize);
+	*position = offset + _entryvalue(ihandle, page + offset, record, index);
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_select(fastmap_inhandle_t *ihandle, size_t index, fastmap_record_t *record)
+{
+	const size_t ksize = ihandle ? ihandle->handle.attr.ksize : 0;
+	const unsigned char *page;
+	size_t pageoffset, position = 0;
+	int rc;
+
+	if (ihandle == NULL || record == NULL || (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS))
+		return EINVAL;
+	if ((ihandle->handle.flags & FASTMAP_FRONT_CODED) && record->atom.key == NULL)
+		return EINVAL;
+	if (index >= ihandle->handle.attr.records)
+		return FASTMAP_NOT_FOUND;
+
+	_poolbegin(ihandle);
+	if (!(ihandle->handle.flags & FASTMAP_PACKED_LEAVES))
+	{
+		pageoffset = ihandle->handle.firstleafpageoffset + ((index / ihandle->handle.recordsperleafpage) * ihandle->handle.pagesize);
+		page = _mapped(ihandle, pageoffset, ihandle->handle.pagesize);
+		_setrecordkey(ihandle->handle.attr.format, record, page + ((index % ihandle->handle.recordsperleafpage) * ihandle->handle.leafpagerecordsize), ksize);
+		return _finishlookup(ihandle, record, _leafrecordvalue(ihandle, record, pageoffset, index % ihandle->handle.recordsperleafpage, index));
+	}
+
+	/* packed leaf pages hold a varying number of records, and are found by the first record of each.
+	 * A front-coded key is decoded into the key of the record */
+	rc = _packedrecord(ihandle, _packedleaf(ihandle, index), index, record, record->atom.key, &position);
+	return _finishlookup(ihandle, record, rc);
+}
+
+int fastmap_cursor_init(fastmap_cursor_t *cursor, fastmap_inhandle_t *ihandle, size_t first, size_t last)
+{
+	if (cursor == NULL || ihandle == NULL || first > last || (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS))
+		return EINVAL;
+
+	cursor->ihandle = ihandle;
+	cursor->next = MIN(first, ihandle->handle.attr.records);
+	cursor->end = MIN(last, ihandle->handle.attr.records);
+	cursor->page = SIZE_MAX;
+	cursor->position = 0;
+	return FASTMAP_OK;
+}
+
+int fastmap_cursor_next(fastmap_cursor_t *cursor, fastmap_record_t *record)
+{
+	fastmap_inhandle_t *ihandle;
+	struct _leafpageheader header;
+	size_t child;
+	int rc;
+
+	if (cursor == NULL || cursor->ihandle == NULL || record == NULL)
+		return EINVAL;
+	if (cursor->next >= cursor->end)
+		return FASTMAP_NOT_FOUND;
+	ihandle = cursor->ihandle;
+
+	if (!(ihandle->handle.flags & FASTMAP_PACKED_LEAVES))
+	{
+		if ((rc = fastmap_inhandle_select(ihandle, cursor->next, record)) == FASTMAP_OK)
+			cursor->next++;
+		return rc;
+	}
+
+	/* the records of packed leaf pages are read on from the last, moving to the next page once it runs out */
+	_poolbegin(ihandle);
+	child = cursor->page;
+	if (child != SIZE_MAX)
+	{
+		memcpy(&header, _mapped(ihandle, ihandle->handle.firstleafpageoffset + (child * ihandle->handle.pagesize), sizeof(header)), sizeof(header));
+		if (cursor->next < header.firstrecord || cursor->next - header.firstrecord >= header.entries)
+		{
+			child = (child + 1 < ihandle->handle.leafpages) ? child + 1 : SIZE_MAX;
+			cursor->position = 0;
+		}
+	}
+	if (child == SIZE_MAX)
+	{
+		child = _packedleaf(ihandle, cursor->next);
+		cursor->position = 0;
+	}
+
+	cursor->page = child;
+	if ((rc = _finishlookup(ihandle, record, _packedrecord(ihandle, child, cursor->next, record, cursor->key, &cursor->position))) != FASTMAP_OK)
+	{
+		cursor->page = SIZE_MAX;
+		return rc;
+	}
+	cursor->next++;
+	return FASTMAP_OK;
+}
+
+/* The index of the first record of the leaf page holding record 'index' */
+static size_t _leafstart(fastmap_inhandle_t *ihandle, size_t index)
+{
+	struct _leafpageheader header;
+
+	if (!(ihandle->handle.flags & FASTMAP_PACKED_LEAVES))
+		return index - (index % ihandle->handle.recordsperleafpage);
+
+	memcpy(&header, _mapped(ihandle, ihandle->handle.firstleafpageoffset + (_packedleaf(ihandle, index) * ihandle->handle.pagesize), sizeof(header)), sizeof(header));
+	return MIN((size_t)header.firstrecord, index);
+}
+
+int fastmap_inhandle_partition(fastmap_inhandle_t *ihandle, const fastmap_record_t *first, const fastmap_record_t *last, fastmap_cursor_t *cursors, size_t ncursors)
+{
+	size_t begin = 0, end, boundary, previous, i;
+	int rc;
+
+	if (ihandle == NULL || cursors == NULL || ncursors == 0 || (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS))
+		return EINVAL;
+
+	end = ihandle->handle.attr.records;
+	if (first != NULL && (rc = fastmap_inhandle_rank(ihandle, first, &begin)) != FASTMAP_OK && rc != FASTMAP_NOT_FOUND)
+		return rc;
+	if (last != NULL && (rc = fastmap_inhandle_rank(ihandle, last, &end)) != FASTMAP_OK && rc != FASTMAP_NOT_FOUND)
+		return rc;
+	end = MAX(begin, end);
+
+	/* split the records evenly, moving each split back to the start of its leaf page unless that
+	 * would empty the partition before it, so that partitions share no more than their edge pages */
+	_poolbegin(ihandle);
+	for (i = 0, previous = begin; i < ncursors; i++)
+	{
+		if (i + 1 == ncursors)
+		{
+			boundary = end;
+		}
+		else
+		{
+			boundary = begin + (size_t)(((double)(end - begin) * (double)(i + 1)) / (double)ncursors);
+			if (boundary < end && _leafstart(ihandle, boundary) > previous)
+				boundary = _leafstart(ihandle, boundary);
+			boundary = MAX(boundary, previous);
+		}
+
+		fastmap_cursor_init(&cursors[i], ihandle, previous, boundary);
+		previous = boundary;
+	}
+
+	return _poolerror(ihandle, FASTMAP_OK);
+}
+
+/* The partitions of #fastmap_inhandle_scan(), taken in turn by each of its threads */
+struct _scan
+{
+	fastmap_cursor_t *cursors;
+	int *rcs;
+	size_t npartitions;
+	size_t next;
+	pthread_mutex_t lock;
+	fastmap_scanfunc func;
+	void *arg;
+};
+
+static void *_scanpartitions(void *arg)
+{
+	struct _scan *scan = arg;
+	size_t i;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&scan->lock);
+		i = scan->next++;
+		pthread_mutex_unlock(&scan->lock);
+		if (i >= scan->npartitions)
+			break;
+
+		scan->rcs[i] = scan->func(&scan->cursors[i], i, scan->arg);
+	}
+
+	return NULL;
+}
+
+int fastmap_inhandle_scan(fastmap_inhandle_t *ihandle, const fastmap_record_t *first, const fastmap_record_t *last, size_t npartitions, fastmap_scanfunc func, void *arg)
+{
+	struct _scan scan;
+	pthread_t *threads = NULL;
+	size_t nthreads = 0, i;
+	int rc;
+
+	if (ihandle == NULL || npartitions == 0 || func == NULL)
+		return EINVAL;
+
+	memset(&scan, 0, sizeof(scan));
+	if ((scan.cursors = calloc(npartitions, sizeof(*scan.cursors))) == NULL || (scan.rcs = calloc(npartitions, sizeof(*scan.rcs))) == NULL)
+	{
+		rc = ENOMEM;
+		goto fail;
+	}
+	if ((rc = fastmap_inhandle_partition(ihandle, first, last, scan.cursors, npartitions)) != FASTMAP_OK)
+		goto fail;
+
+	scan.npartitions = npartitions;
+	scan.func = func;
+	scan.arg = arg;
+	if ((rc = pthread_mutex_init(&scan.lock, NULL)) != 0)
+		goto fail;
+
+	/* the calling thread takes partitions too, and alone does so for handles whose lookups are kept to it */
+	if (_threadsafe(ihandle) && (threads = calloc(MIN(ihandle->threads, npartitions), sizeof(*threads))) != NULL)
+	{
+		while (nthreads + 1 < MIN(ihandle->threads, npartitions) && pthread_create(&threads[nthreads], NULL, _scanpartitions, &scan) == 0)
+			nthreads++;
+	}
+	_scanpartitions(&scan);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	pthread_mutex_destroy(&scan.lock);
+
+	for (i = 0, rc = FASTMAP_OK; i < npartitions && rc == FASTMAP_OK; i++)
+		rc = scan.rcs[i];
+
+fail:
+	free(threads);
+	free(scan.rcs);
+	free(scan.cursors);
+	return rc;
+}
+
+/* The estimated index of the first record of leaf page 'page'. Fixed size leaf pages hold a known
+ * number of records, packed leaf pages only count theirs in their headers, which are not read,
+ * so their records are taken to be spread evenly over them */
+static size_t _leafrankestimate(const fastmap_inhandle_t *ihandle, size_t page)
+{
+	if (!(ihandle->handle.flags & FASTMAP_PACKED_LEAVES))
+		return MIN(page * ihandle->handle.recordsperleafpage, ihandle->handle.attr.records);
+	return (size_t)(((double)ihandle->handle.attr.records * (double)page) / (double)ihandle->handle.leafpages);
+}
+
+/* The leaf page whose first record is nearest to record 'rank', going by #_leafrankestimate() */
+static size_t _leafnearest(const fastmap_inhandle_t *ihandle, size_t rank)
+{
+	size_t page;
+
+	if (!(ihandle->handle.flags & FASTMAP_PACKED_LEAVES))
+		page = (rank + (ihandle->handle.recordsperleafpage / 2)) / ihandle->handle.recordsperleafpage;
+	else
+		page = (size_t)((((double)rank * (double)ihandle->handle.leafpages) / (double)ihandle->handle.attr.records) + 0.5);
+
+	return MIN(page, ihandle->handle.leafpages - 1);
+}
+
+/* Estimate the rank of the key of 'record' from the search levels alone, as the middle of the
+ * leaf page which may hold it */
+static int _rankestimate(const fastmap_inhandle_t *ihandle, const fastmap_record_t *record, size_t *rank)
+{
+	size_t pageoffset, page;
+	int rc;
+
+	/* a key no leaf page may hold is greater than every key of the map */
+	*rank = ihandle->handle.attr.records;
+	if ((rc = _leaflocate(ihandle, record, &pageoffset, NULL)) != FASTMAP_OK)
+		return (rc == FASTMAP_NOT_FOUND) ? FASTMAP_OK : rc;
+
+	page = (pageoffset - ihandle->handle.firstleafpageoffset) / ihandle->handle.pagesize;
+	*rank = (_leafrankestimate(ihandle, page) + _leafrankestimate(ihandle, page + 1)) / 2;
+	return FASTMAP_OK;
+}
+
+/* Copy the first key of leaf page 'page' into the key of 'record', which is separator page - 1
+ * of the lowest search level. A truncated separator is the shortest prefix of that key which
+ * divides the pages, and is padded with zero bytes to the size of fixed size keys, which sorts it
+ * between the same keys. The first key of the map precedes every separator, and is selected */
+static int _leafseparator(fastmap_inhandle_t *ihandle, size_t page, fastmap_record_t *record)
+{
+	const size_t maxslots = ihandle->handle.pagesize / sizeof(struct _keyslot);
+	struct _searchpageheader searchheader;
+	struct _keyslot slot;
+	fastmap_record_t first;
+	const unsigned char *searchpage;
+	size_t lo, hi, mid;
+	int rc;
+
+	if (page == 0)
+	{
+		first = *record;
+		if ((rc = fastmap_inhandle_select(ihandle, 0, &first)) != FASTMAP_OK)
+			return rc;
+		if (first.atom.key != record->atom.key)
+			memcpy(record->atom.key, first.atom.key, (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS) ? _recordksize(ihandle->handle.attr.format, &first) : ihandle->handle.attr.ksize);
+		if (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS)
+			_setrecordkey(ihandle->handle.attr.format, record, record->atom.key, _recordksize(ihandle->handle.attr.format, &first));
+		return FASTMAP_OK;
+	}
+
+	if (!(ihandle->handle.flags & (FASTMAP_VARIABLE_KEYS | FASTMAP_TRUNCATED_SEPARATORS)))
+	{
+		memcpy(record->atom.key, _fixedseparator(ihandle, page - 1), ihandle->handle.attr.ksize);
+		return FASTMAP_OK;
+	}
+
+	/* the separators are numbered across the level, find the page whose first is the last no greater */
+	lo = 0;
+	hi = ihandle->handle.perlevel[0].pages;
+	while (hi - lo > 1)
+	{
+		mid = lo + (hi - lo) / 2;
+		memcpy(&searchheader, (const unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[0].firstoffset + (mid * ihandle->handle.pagesize), sizeof(searchheader));
+		if (searchheader.firstkey <= page - 1)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	searchpage = (const unsigned char*)ihandle->mmapaddr + ihandle->handle.perlevel[0].firstoffset + (lo * ihandle->handle.pagesize);
+	memcpy(&searchheader, searchpage, sizeof(searchheader));
+	if (searchheader.keys > maxslots || page - 1 < searchheader.firstkey || page - 1 - searchheader.firstkey >= searchheader.keys)
+		return FASTMAP_CORRUPT_PAGE;
+	memcpy(&slot, searchpage + sizeof(searchheader) + ((page - 1 - searchheader.firstkey) * sizeof(slot)), sizeof(slot));
+	if (slot.offset > ihandle->handle.pagesize || slot.ksize > ihandle->handle.pagesize - slot.offset || slot.ksize > ihandle->handle.attr.ksize)
+		return FASTMAP_CORRUPT_PAGE;
+
+	memcpy(record->atom.key, searchpage + slot.offset, slot.ksize);
+	if (ihandle->handle.flags & FASTMAP_VARIABLE_KEYS)
+		_setrecordkey(ihandle->handle.attr.format, record, record->atom.key, slot.ksize);
+	else
+		memset((unsigned char*)record->atom.key + slot.ksize, 0, ihandle->handle.attr.ksize - slot.ksize);
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_quantile(fastmap_inhandle_t *ihandle, double q, fastmap_record_t *record)
+{
+	if (ihandle == NULL || record == NULL || !(q >= 0.0 && q <= 1.0) || (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS))
+		return EINVAL;
+	if (ihandle->handle.leafpages == 0)
+		return FASTMAP_NOT_FOUND;
+
+	_poolbegin(ihandle);
+	return _poolerror(ihandle, _leafseparator(ihandle, _leafnearest(ihandle, (size_t)(q * (double)ihandle->handle.attr.records)), record));
+}
+
+int fastmap_inhandle_boundaries(fastmap_inhandle_t *ihandle, fastmap_record_t *boundaries, size_t nranges)
+{
+	size_t i;
+	int rc = FASTMAP_OK;
+
+	if (ihandle == NULL || boundaries == NULL || nranges == 0 || (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS))
+		return EINVAL;
+	if (ihandle->handle.leafpages == 0)
+		return FASTMAP_NOT_FOUND;
+
+	_poolbegin(ihandle);
+	for (i = 1; i < nranges && rc == FASTMAP_OK; i++)
+		rc = _leafseparator(ihandle, _leafnearest(ihandle, (size_t)(((double)ihandle->handle.attr.records * (double)i) / (double)nranges)), &boundaries[i - 1]);
+
+	return _poolerror(ihandle, rc);
+}
+
+int fastmap_inhandle_estimate(fastmap_inhandle_t *ihandle, const fastmap_record_t *first, const fastmap_record_t *last, size_t *count)
+{
+	size_t begin = 0, end;
+	int rc;
+
+	if (ihandle == NULL || count == NULL || (ihandle->handle.flags & FASTMAP_ENCODED_ATOMS))
+		return EINVAL;
+
+	*count = 0;
+	end = ihandle->handle.attr.records;
+	if (ihandle->handle.leafpages == 0)
+		return FASTMAP_OK;
+
+	_poolbegin(ihandle);
+	if (first != NULL && (rc = _rankestimate(ihandle, first, &begin)) != FASTMAP_OK)
+		return _poolerror(ihandle, rc);
+	if (last != NULL && (rc = _rankestimate(ihandle, last, &end)) != FASTMAP_OK)
+		return _poolerror(ihandle, rc);
+
+	*count = (end > begin) ? end - begin : 0;
+	return _poolerror(ihandle, FASTMAP_OK);
+}
+
+int fastmap_inhandle_successor(fastmap_inhandle_t *ihandle, const void *key, void *successor)
+{
+	uint64_t found;
+	int rc;
+
+	if (ihandle == NULL || key == NULL || successor == NULL || !(ihandle->handle.flags & FASTMAP_ENCODED_ATOMS))
+		return EINVAL;
+
+	_poolbegin(ihandle);
+	if ((rc = _poolerror(ihandle, _encodedatoms_lowerbound(ihandle, _integerkey(key, ihandle->handle.attr.ksize), &found))) != FASTMAP_OK)
+		return rc;
+
+	_putbigendian(successor, found, ihandle->handle.attr.ksize);
+	return FASTMAP_OK;
+}
+
+/* Expand the container of partition 'partition' of a roaring set into a bitmap of its chunk */
+static int _roaringbitmap(const fastmap_inhandle_t *ihandle, size_t partition, uint64_t *words)
+{
+	struct _roaringcontainer container;
+	const unsigned char *payload;
+	uint16_t v[2];
+	size_t i, w;
+	uint32_t k;
+	int rc;
+
+	/* each container is read in a lookup of its own, being copied out before the next */
+	_poolbegin(ihandle);
+	payload = _roaringcontainer(ihandle, partition, &container);
+	if ((rc = _poolerror(ihandle, payload ? FASTMAP_OK : EINVAL)) != FASTMAP_OK)
+		return rc;
+
+	switch (container.type)
+	{
+	case FASTMAP_ROARING_BITMAP:
+		for (w = 0; w < FASTMAP_ROARINGWORDS; w++)
+			words[w] = _getlittleendian(payload + (w * sizeof(uint64_t)));
+		break;
+	case FASTMAP_ROARING_ARRAY:
+		memset(words, 0, FASTMAP_ROARINGWORDS * sizeof(uint64_t));
+		for (i = 0; i < container.cardinality; i++)
+		{
+			memcpy(v, payload + (i * sizeof(uint16_t)), sizeof(uint16_t));
+			words[v[0] / 64] |= (uint64_t)1 << (v[0] % 64);
+		}
+		break;
+	default:
+		memset(words, 0, FASTMAP_ROARINGWORDS * sizeof(uint64_t));
+		for (i = 0; i < container.runs; i++)
+		{
+			memcpy(v, payload + (i * sizeof(v)), sizeof(v));
+			for (k = v[0]; k <= v[1]; k++)
+				words[k / 64] |= (uint64_t)1 << (k % 64);
+		}
+		break;
+	}
+
+	return FASTMAP_OK;
+}
+
+/* Combine two roaring sets a chunk at a time, counting the keys of the result into 'nkeys',
+ * and putting them to 'ohandle' unless it is NULL. Chunks are combined as bitmaps, in loops
+ * over whole words which the compiler is free to vectorize */
+static int _roaringcombine(const fastmap_inhandle_t *a, const fastmap_inhandle_t *b, fastmap_setop_t op, uint64_t *words, fastmap_outhandle_t *ohandle, size_t *nkeys)
+{
+	const unsigned char *adirectory = (unsigned char*)a->mmapaddr + a->handle.firstleafpageoffset;
+	const unsigned char *bdirectory = (unsigned char*)b->mmapaddr + b->handle.firstleafpageoffset;
+	uint64_t *x = words, *y = words + FASTMAP_ROARINGWORDS;
+	uint64_t achunk, bchunk, chunk, word;
+	unsigned char key[sizeof(uint32_t)];
+	fastmap_record_t record;
+	size_t i = 0, j = 0, w, count;
+	int rc;
+
+	*nkeys = 0;
+	record.atom.key = key;
+	while (i < a->handle.leafpages || j < b->handle.leafpages)
+	{
+		achunk = (i < a->handle.leafpages) ? _integerkey(adirectory + (i * sizeof(struct _atompartition)), sizeof(((struct _atompartition*)0)->firstkey)) : UINT64_MAX;
+		bchunk = (j < b->handle.leafpages) ? _integerkey(bdirectory + (j * sizeof(struct _atompartition)), sizeof(((struct _atompartition*)0)->firstkey)) : UINT64_MAX;
+		chunk = MIN(achunk, bchunk);
+
+		if (op == FASTMAP_SET_INTERSECTION && achunk != bchunk)
+		{
+			if (achunk < bchunk)
+				i++;
+			else
+				j++;
+			continue;
+		}
+
+		if (achunk == chunk)
+		{
+			if ((rc = _roaringbitmap(a, i++, x)) != FASTMAP_OK)
+				return rc;
+		}
+		else
+		{
+			memset(x, 0, FASTMAP_ROARINGWORDS * sizeof(uint64_t));
+		}
+		if (bchunk == chunk)
+		{
+			if ((rc = _roaringbitmap(b, j++, y)) != FASTMAP_OK)
+				return rc;
+		}
+		else
+		{
+			memset(y, 0, FASTMAP_ROARINGWORDS * sizeof(uint64_t));
+		}
+
+		if (op == FASTMAP_SET_INTERSECTION)
+		{
+			for (w = 0; w < FASTMAP_ROARINGWORDS; w++)
+				x[w] &= y[w];
+		}
+		else
+		{
+			for (w = 0; w < FASTMAP_ROARINGWORDS; w++)
+				x[w] |= y[w];
+		}
+
+		for (w = 0, count = 0; w < FASTMAP_ROARINGWORDS; w++)
+			count += (size_t)__builtin_popcountll(x[w]);
+		*nkeys += count;
+
+		if (ohandle == NULL || count == 0)
+			continue;
+
+		for (w = 0; w < FASTMAP_ROARINGWORDS; w++)
+		{
+			for (word = x[w]; word != 0; word &= word - 1)
+			{
+				_putbigendian(key, chunk | ((w * 64) + (size_t)__builtin_ctzll(word)), sizeof(key));
+				if ((rc = fastmap_outhandle_put(ohandle, &record)) != FASTMAP_OK)
+					return rc;
+			}
+		}
+	}
+
+	return FASTMAP_OK;
+}
+
+int fastmap_inhandle_combine(fastmap_inhandle_t *a, fastmap_inhandle_t *b, fastmap_setop_t op, const char *pathname, size_t *nkeys)
+{
+	fastmap_outhandle_t ohandle;
+	fastmap_attr_t attr;
+	uint64_t *words;
+	size_t count;
+	int rc = FASTMAP_OK;
+
+	if (a == NULL || b == NULL || !(a->handle.flags & FASTMAP_ROARING) || !(b->handle.flags & FASTMAP_ROARING) ||
+		(op != FASTMAP_SET_INTERSECTION && op != FASTMAP_SET_UNION))
+		return EINVAL;
+
+	words = malloc(2 * FASTMAP_ROARINGWORDS * sizeof(uint64_t));
+	if (words == NULL)
+		return ENOMEM;
+
+	/* the result is counted before it is written, as a map is created knowing its number of records */
+	if ((rc = _roaringcombine(a, b, op, words, NULL, &count)) != FASTMAP_OK)
+		goto fail;
+
+	if (pathname != NULL)
+	{
+		memcpy(&attr, &a->handle.attr, sizeof(attr));
+		attr.records = count;
+		if ((rc = fastmap_outhandle_init(&ohandle, &attr, pathname)) != FASTMAP_OK)
+			goto fail;
+		if ((rc = _roaringcombine(a, b, op, words, &ohandle, &count)) != FASTMAP_OK ||
+			(rc = fastmap_outhandle_destroy(&ohandle)) != FASTMAP_OK)
+		{
+			/* leave no partial map behind */
+			if (ohandle.fd != -1)
+			{
+				close(ohandle.fd);
+				_freepagebuffers(&ohandle);
+			}
+			unlink(pathname);
+			goto fail;
+		}
+	}
+
+	if (nkeys != NULL)
+		*nkeys = count;
+
+fail:
+	free(words);
+	return rc;
+}
+
+#define FASTMAP_CONTAINER_MAGIC	0x464D4354	/* "FMCT" */
+#define FASTMAP_CONTAINER_VERSION	1
+
+struct _containerinput
+{
+	const char *name;
+	const char *pathname;
+};
+
+static int _containerinput_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct _containerinput*)a)->name, ((const struct _containerinput*)b)->name);
+}
+
+static int _writeall(int fd, const void *buf, size_t len, off_t offset)
+{
+	ssize_t n;
+
+	while (len > 0)
+	{
+		n = pwrite(fd, buf, len, offset);
+		if (n == -1)
+			return errno;
+		buf = (const char*)buf + n;
+		len -= (size_t)n;
+		offset += n;
+	}
+
+	return FASTMAP_OK;
+}
+
+int fastmap_container_create(const char *pathname, const char *names[], const char *pathnames[], size_t nmaps)
+{
+	fastmap_container_header_t header;
+	fastmap_container_entry_t *directory = NULL;
+	struct _containerinput *inputs = NULL;
+	fastmap_inhandle_t ihandle;
+	size_t systempagesize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t i, offset, align;
+	int fd = -1;
+	int rc = FASTMAP_OK;
+
+	if (pathname == NULL || (nmaps > 0 && (names == NULL || pathnames == NULL)))
+		return EINVAL;
+
+	inputs = calloc(nmaps + 1, sizeof(*inputs));
+	directory = calloc(nmaps + 1, sizeof(*directory));
+	if (inputs == NULL || directory == NULL)
+	{
+		rc = ENOMEM;
+		goto fail;
+	}
+
+	for (i = 0; i < nmaps; i++)
+	{
+		if (names[i] == NULL || pathnames[i] == NULL || strlen(names[i]) >= FASTMAP_CONTAINER_NAMELEN)
+		{
+			rc = EINVAL;
+			goto fail;
+		}
+		inputs[i].name = names[i];
+		inputs[i].pathname = pathnames[i];
+	}
+
+	qsort(inputs, nmaps, sizeof(*inputs), _containerinput_cmp);
+	for (i = 1; i < nmaps; i++)
+	{
+		if (strcmp(inputs[i - 1].name, inputs[i].name) == 0)
+		{
+			rc = EINVAL;
+			goto fail;
+		}
+	}
+
+	fd = open(pathname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd == -1)
+	{
+		rc = errno;
+		goto fail;
+	}
+
+	offset = sizeof(header) + nmaps * sizeof(*directory);
+	align = systempagesize;
+	for (i = 0; i < nmaps; i++)
+	{
+		if ((rc = fastmap_inhandle_init(&ihandle, inputs[i].pathname)) != FASTMAP_OK)
+			goto fail;
+
+		/* keep each map at its own section alignment, so it maps as well as it would alone */
+		offset = ALIGN_TO_PAGE_OFFSET(offset, MAX(systempagesize, ihandle.handle.attr.sectionalign));
+		align = MAX(align, ihandle.handle.attr.sectionalign);
+
+		strcpy(directory[i].name, inputs[i].name);
+		directory[i].offset = offset;
+		directory[i].len = ihandle.mmaplen;
+
+		rc = _writeall(fd, ihandle.mmapaddr, ihandle.mmaplen, (off_t)offset);
+		fastmap_inhandle_destroy(&ihandle);
+		if (rc != FASTMAP_OK)
+			goto fail;
+
+		offset += directory[i].len;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.magic = FASTMAP_CONTAINER_MAGIC;
+	header.version = FASTMAP_CONTAINER_VERSION;
+	header.nmaps = nmaps;
+	header.align = align;
+
+	if ((rc = _writeall(fd, directory, nmaps * sizeof(*directory), sizeof(header))) != FASTMAP_OK ||
+		(rc = _writeall(fd, &header, sizeof(header), 0)) != FASTMAP_OK)
+		goto fail;
+
+	if (close(fd) == -1)
+	{
+		fd = -1;
+		rc = errno;
+		goto fail;
+	}
+	fd = -1;
+
+	goto success;
+fail:
+	if (fd != -1)
+	{
+		close(fd);
+		unlink(pathname);
+	}
+success:
+	free(inputs);
+	free(directory);
+	return rc;
+}
+
+int fastmap_container_init(fastmap_container_t *container, const char *pathname)
+{
+	const fastmap_container_header_t *header;
+	struct stat st;
+	size_t i;
+	int rc = FASTMAP_OK;
+
+	if (container == NULL || pathname == NULL)
+		return EINVAL;
+
+	memset(container, 0, sizeof(*container));
+
+	container->fd = open(pathname, O_RDONLY);
+	if (container->fd == -1)
+	{
+		rc = errno;
+		goto fail;
+	}
+
+	if (fstat(container->fd, &st) == -1)
+	{
+		rc = errno;
+		goto fail;
+	}
+
+	if ((uint64_t)st.st_size < sizeof(*header) || (sizeof(st.st_size) > sizeof(size_t) && st.st_size > SIZE_MAX))
+	{
+		rc = EINVAL;
+		goto fail;
+	}
+
+	{
+		fastmap_container_header_t h;
+
+		if (pread(container->fd, &h, sizeof(h), 0) != sizeof(h) || h.magic != FASTMAP_CONTAINER_MAGIC || h.version != FASTMAP_CONTAINER_VERSION ||
+			!IS_POWER_OF_TWO(h.align) || h.align > FASTMAP_HUGEPAGESIZE)
+		{
+			rc = EINVAL;
+			goto fail;
+		}
+
+		container->mmaplen = (size_t)st.st_size;
+		container->mmapaddr = _mmapaligned(container->mmaplen, container->fd, 0, (size_t)h.align, 0);
+		if (container->mmapaddr == MAP_FAILED)
+		{
+			rc = errno;
+			container->mmapaddr = NULL;
+			goto fail;
+		}
+	}
+
+	header = container->mmapaddr;
+	if (header->nmaps > (container->mmaplen - sizeof(*header)) / sizeof(fastmap_container_entry_t))
+	{
+		rc = EINVAL;
+		goto fail;
+	}
+
+	container->nmaps = (size_t)header->nmaps;
+	container->directory = (const fastmap_container_entry_t*)(header + 1);
+
+	/* the directory is trusted only once every entry lies in the file and the names are sorted */
+	for (i = 0; i < container->nmaps; i++)
+	{
+		const fastmap_container_entry_t *entry = &container->directory[i];
+
+		if (memchr(entry->name, '\0', sizeof(entry->name)) == NULL ||
+			entry->offset > container->mmaplen || entry->len > container->mmaplen - entry->offset ||
+			(i > 0 && strcmp(container->directory[i - 1].name, entry->name) >= 0))
+		{
+			rc = EINVAL;
+			goto fail;
 		}
 	}
 
-	recordindex = ((offset - ihandle->handle.firstleafpageoffset) / ihandle->handle.pagesize) * ihandle->handle.recordsperleafpage;
+	goto success;
+fail:
+	if (container->mmapaddr)
+		munmap(container->mmapaddr, container->mmaplen);
+	container->mmapaddr = NULL;
+	if (container->fd != -1 && close(container->fd) == -1)
+		rc = errno;
+	container->fd = -1;
+success:
+	return rc;
+}
+
+int fastmap_container_destroy(fastmap_container_t *container)
+{
+	if (container == NULL || container->mmapaddr == NULL)
+		return EINVAL;
+
+	munmap(container->mmapaddr, container->mmaplen);
+	container->mmapaddr = NULL;
+	container->directory = NULL;
+	container->nmaps = 0;
+
+	close(container->fd);
+	container->fd = -1;
+	return FASTMAP_OK;
+}
+
+int fastmap_container_get(fastmap_container_t *container, const char *name, fastmap_inhandle_t *ihandle)
+{
+	size_t lo, hi, mid;
+	int ord;
+
+	if (container == NULL || container->mmapaddr == NULL || name == NULL || ihandle == NULL)
+		return EINVAL;
+
+	lo = 0;
+	hi = container->nmaps;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		ord = strcmp(name, container->directory[mid].name);
+		if (ord == 0)
+			return fastmap_inhandle_initmem(ihandle, (char*)container->mmapaddr + container->directory[mid].offset, (size_t)container->directory[mid].len);
+		else if (ord < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return FASTMAP_NOT_FOUND;
+}
+
+int fastmap_container_getcount(fastmap_container_t *container, size_t *nmaps)
+{
+	if (container == NULL || nmaps == NULL)
+		return EINVAL;
+
+	*nmaps = container->nmaps;
+	return FASTMAP_OK;
+}
+
+int fastmap_container_getname(fastmap_container_t *container, size_t index, const char **name)
+{
+	if (container == NULL || name == NULL || index >= container->nmaps)
+		return EINVAL;
 
-	return _leafpage_get(ihandle, record, offset, recordindex);
+	*name = container->directory[index].name;
+	return FASTMAP_OK;
 }
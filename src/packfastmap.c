@@ -0,0 +1,154 @@
+#ifdef HAVE_CONFIG_H
+#include <fastmap_config.h>
+#endif
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <fastmap.h>
+
+static void usage(FILE *out)
+{
+	fprintf(out, "Usage: packfastmap [OPTION]... OUTPUT [NAME=]INPUT...\n");
+	fprintf(out, "  or:  packfastmap --list CONTAINER\n");
+	fprintf(out, "Pack the fastmap INPUTs into a single container file OUTPUT\n");
+	fprintf(out, "\n");
+	fprintf(out, "Each map is stored under NAME, or under the last component of INPUT when no NAME\n");
+	fprintf(out, "is given. Names must be unique and shorter than %d bytes.\n", FASTMAP_CONTAINER_NAMELEN);
+	fprintf(out, "\n");
+	fprintf(out, "  -l, --list    list the maps in CONTAINER\n");
+	fprintf(out, "      --help    display this help message\n");
+	fprintf(out, "\n");
+	fprintf(out, "Report bugs to " PACKAGE_BUGREPORT "\n");
+	fflush(out);
+}
+
+static int help;
+static int list;
+
+static int listcontainer(const char *pathname)
+{
+	fastmap_container_t container;
+	fastmap_inhandle_t ihandle;
+	const char *name;
+	size_t i, nmaps;
+	int rc;
+
+	if ((rc = fastmap_container_init(&container, pathname)) != FASTMAP_OK)
+	{
+		fprintf(stderr, "packfastmap: %s: %s\n", pathname, rc > 0 ? strerror(rc) : "invalid container");
+		return -1;
+	}
+
+	fastmap_container_getcount(&container, &nmaps);
+	for (i = 0; i < nmaps; i++)
+	{
+		fastmap_container_getname(&container, i, &name);
+		if (fastmap_container_get(&container, name, &ihandle) != FASTMAP_OK)
+		{
+			fprintf(stdout, "%s\tinvalid\n", name);
+			continue;
+		}
+		fprintf(stdout, "%s\t%zu records\t%zu bytes\n", name, ihandle.handle.attr.records, ihandle.mmaplen);
+		fastmap_inhandle_destroy(&ihandle);
+	}
+
+	fastmap_container_destroy(&container);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	const char **names, **pathnames;
+	char *sep;
+	int opt, i, nmaps, rc;
+
+	while (1)
+	{
+		static struct option longopts[] = {
+			{ "list", no_argument, NULL, 'l' },
+			{ "help", no_argument, &help, 1},
+			{ 0, 0, 0, 0}
+		};
+
+		int option_index;
+		if ((opt = getopt_long(argc, argv, "l", longopts, &option_index)) == -1)
+			break;
+
+		switch (opt)
+		{
+			case 'l':
+				list = 1;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (help == 1)
+	{
+		usage(stdout);
+		exit(EXIT_SUCCESS);
+	}
+
+	if (list == 1)
+	{
+		if (argc - optind != 1)
+		{
+			fprintf(stderr, "packfastmap: you must specify the CONTAINER\n");
+			fprintf(stderr, "Try 'packfastmap --help' for more information.\n");
+			exit(EXIT_FAILURE);
+		}
+		exit(listcontainer(argv[optind]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	if (argc - optind < 2)
+	{
+		fprintf(stderr, "packfastmap: you must specify the OUTPUT and at least one INPUT\n");
+		fprintf(stderr, "Try 'packfastmap --help' for more information.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	nmaps = argc - optind - 1;
+	names = calloc(nmaps, sizeof(*names));
+	pathnames = calloc(nmaps, sizeof(*pathnames));
+	if (names == NULL || pathnames == NULL)
+	{
+		fprintf(stderr, "packfastmap: %s\n", strerror(ENOMEM));
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < nmaps; i++)
+	{
+		char *arg = argv[optind + 1 + i];
+
+		if ((sep = strchr(arg, '=')) != NULL)
+		{
+			*sep = '\0';
+			names[i] = arg;
+			pathnames[i] = sep + 1;
+		}
+		else
+		{
+			names[i] = (sep = strrchr(arg, '/')) != NULL ? sep + 1 : arg;
+			pathnames[i] = arg;
+		}
+	}
+
+	rc = fastmap_container_create(argv[optind], names, pathnames, (size_t)nmaps);
+	if (rc != FASTMAP_OK)
+	{
+		fprintf(stderr, "packfastmap: %s: %s\n", argv[optind], rc > 0 ? strerror(rc) : "invalid input fastmap");
+		exit(EXIT_FAILURE);
+	}
+
+	free(names);
+	free(pathnames);
+	exit(EXIT_SUCCESS);
+}
@@ -25,6 +25,29 @@ static void usage(FILE *out)
 	fprintf(out, "  -I, --input-format={csv}        specify the format of INPUT (default: csv)\n");
 	fprintf(out, "  -O, --output-format={atom,pair,block,blob}\n");
 	fprintf(out, "                                  specify the format of OUTPUT (default blob)\n");
+	fprintf(out, "  -V, --inline-values=SIZE        store 'blob' values of at most SIZE bytes in the\n");
+	fprintf(out, "                                  leaf pages (default 0, max %d)\n", FASTMAP_MAXINLINEVSIZE);
+	fprintf(out, "  -P, --page-size=SIZE            use pages of SIZE bytes, a power of two from %d\n", FASTMAP_MINPAGESIZE);
+	fprintf(out, "                                  to %d (default: filesystem block size)\n", FASTMAP_MAXPAGESIZE);
+	fprintf(out, "  -H, --huge-align                align the leaf and value pages for huge pages\n");
+	fprintf(out, "  -F, --front-code=INTERVAL       front-code the keys of each leaf page, with a whole\n");
+	fprintf(out, "                                  key every INTERVAL keys (default 0, disabled)\n");
+	fprintf(out, "  -T, --truncate-separators       keep only the shortest distinguishing prefix of\n");
+	fprintf(out, "                                  each separator key in the search levels\n");
+	fprintf(out, "  -K, --key-schema=TYPE[,TYPE]... read each key as ':' separated fields of the given\n");
+	fprintf(out, "                                  types {u32,u64,i64,f64}, stored so as to sort in\n");
+	fprintf(out, "                                  numeric order\n");
+	fprintf(out, "  -A, --atom-encoding={sorted,eliasfano,roaring}\n");
+	fprintf(out, "                                  store the keys of an 'atom' OUTPUT of one integer\n");
+	fprintf(out, "                                  key field sorted, or compressed (default sorted);\n");
+	fprintf(out, "                                  roaring takes only u32 keys\n");
+	fprintf(out, "  -Z, --compress-values=SIZE      compress the values of a 'blob' OUTPUT in blocks\n");
+	fprintf(out, "                                  of SIZE bytes (default 0, disabled, max %d)\n", FASTMAP_MAXVALUEBLOCKSIZE);
+	fprintf(out, "  -D, --dictionary=FILE           prime the compression of each block with the\n");
+	fprintf(out, "                                  contents of FILE (max %d bytes)\n", FASTMAP_MAXDICTIONARYSIZE);
+	fprintf(out, "  -U, --dedup-values=ENTRIES      store each repeated 'blob' value once, looking\n");
+	fprintf(out, "                                  values up in a table of ENTRIES (default 0,\n");
+	fprintf(out, "                                  disabled, max %d)\n", FASTMAP_MAXDEDUPENTRIES);
 	fprintf(out, "\n");
 	fprintf(out, "When INPUT is -, read standard input.\n");
 	fprintf(out, "Report bugs to " PACKAGE_BUGREPORT "\n");
@@ -48,18 +71,77 @@ struct outputformat
 	fastmap_format_t format;
 };
 
-int fromcsv(fastmap_attr_t *attr, int infd, const char *pathname)
+/* Split the next 'sep' separated field off of '*text', which is left NULL after the last */
+static char *nextfield(char **text, int sep)
+{
+	char *field = *text, *end;
+
+	if (field == NULL)
+		return NULL;
+
+	end = strchr(field, sep);
+	if (end != NULL)
+		*end++ = '\0';
+	*text = end;
+	return field;
+}
+
+/* Parse the ':' separated fields of a typed key, and encode them as stored in the map */
+static int encodekey(const fastmap_attr_t *attr, char *text, char *key)
+{
+	fastmap_keyfield_t fields[FASTMAP_MAXKEYFIELDS];
+	fastmap_keytype_t types[FASTMAP_MAXKEYFIELDS];
+	size_t i, nfields;
+	char *field, *end;
+
+	fastmap_attr_getkeyschema((fastmap_attr_t*)attr, types, &nfields);
+	for (i = 0; i < nfields; i++)
+	{
+		field = nextfield(&text, ':');
+		if (field == NULL || *field == '\0')
+			return -1;
+
+		errno = 0;
+		switch (types[i])
+		{
+		case FASTMAP_KEY_U32:
+			fields[i].u64 = strtoull(field, &end, 0);
+			if (fields[i].u64 > UINT32_MAX)
+				return -1;
+			fields[i].u32 = (uint32_t)fields[i].u64;
+			break;
+		case FASTMAP_KEY_U64:
+			fields[i].u64 = strtoull(field, &end, 0);
+			break;
+		case FASTMAP_KEY_I64:
+			fields[i].i64 = strtoll(field, &end, 0);
+			break;
+		default:
+			fields[i].f64 = strtod(field, &end);
+			break;
+		}
+
+		if (errno != 0 || *end != '\0')
+			return -1;
+	}
+
+	return (text == NULL && fastmap_encodekey(attr, fields, key) == FASTMAP_OK) ? 0 : -1;
+}
+
+int fromcsv(fastmap_attr_t *attr, const void *dictionary, size_t dictionarysize, int infd, const char *pathname)
 {
 	char buffer[4096], key[4096], value[4096];
 	fastmap_record_t record;
 	fastmap_outhandle_t ohandle;	
 	FILE *f;
 	char *token;
-	size_t ksize = 0, vsize = 0, lineno;
+	size_t ksize = 0, vsize = 0, lineno = 0, nfields;
+	fastmap_keytype_t types[FASTMAP_MAXKEYFIELDS];
 	int rc = 0;
 	fastmap_format_t format;
 
 	fastmap_attr_getformat(attr, &format);
+	fastmap_attr_getkeyschema(attr, types, &nfields);
 
 	f = fdopen(infd, "r");
 	while (fgets(buffer, sizeof(buffer), f))
@@ -70,12 +152,28 @@ int fromcsv(fastmap_attr_t *attr, int infd, const char *pathname)
 		if (token == NULL)
 		{
 			fprintf(stderr, "tofastmap[fromcsv]: input line is out of spec:\n");
-			fprintf(stderr, "line %d: %s\n", lineno, buffer);
+			fprintf(stderr, "line %zu: %s\n", lineno, buffer);
 			rc = -1;
 			goto leave;
 		}
 
-		memcpy(key, token, strlen(token));
+		if (nfields == 0)
+		{
+			memcpy(key, token, strlen(token));
+		}
+		else
+		{
+			char field[4096];
+
+			strcpy(field, token);
+			if (encodekey(attr, field, key) == -1)
+			{
+				fprintf(stderr, "tofastmap[fromcsv]: key does not match the key schema:\n");
+				fprintf(stderr, "line %zu: %s\n", lineno, buffer);
+				rc = -1;
+				goto leave;
+			}
+		}
 
 		token = buffer + strlen(token) + 1;
 		while(*token && *token == ' ')
@@ -90,7 +188,7 @@ int fromcsv(fastmap_attr_t *attr, int infd, const char *pathname)
 			if (strlen(token) != ksize)
 			{
 				fprintf(stderr, "tofastmap[fromcsv]: 'pair' format requires keys and values be the same size\n");
-				fprintf(stderr, "line %d: %s\n", lineno, buffer);
+				fprintf(stderr, "line %zu: %s\n", lineno, buffer);
 				rc = -1;
 				goto leave;
 			}
@@ -106,7 +204,7 @@ int fromcsv(fastmap_attr_t *attr, int infd, const char *pathname)
 			if (vsize != 0 && strlen(token) != vsize)
 			{
 				fprintf(stderr, "tofastmap[fromcsv]: 'block' format requires all values to be the same size\n");
-				fprintf(stderr, "line: %d: %s\n", lineno, buffer);
+				fprintf(stderr, "line %zu: %s\n", lineno, buffer);
 				rc = -1;
 				goto leave;
 			}
@@ -124,9 +222,12 @@ int fromcsv(fastmap_attr_t *attr, int infd, const char *pathname)
 
 		if (ksize == 0)
 		{
-			ksize = strlen(key);
-			fastmap_attr_setksize(attr, ksize);
+			if (nfields == 0)
+				fastmap_attr_setksize(attr, strlen(key));
+			fastmap_attr_getksize(attr, &ksize);
 			fastmap_outhandle_init(&ohandle, attr, pathname);
+			if (dictionarysize > 0)
+				fastmap_outhandle_setdictionary(&ohandle, dictionary, dictionarysize);
 		}
 
 		fastmap_outhandle_put(&ohandle, &record);
@@ -134,6 +235,14 @@ int fromcsv(fastmap_attr_t *attr, int infd, const char *pathname)
 
 leave:
 	fastmap_outhandle_destroy(&ohandle);
+	if (attr->dedupentries > 0)
+	{
+		fastmap_dedupstats_t stats;
+
+		fastmap_outhandle_getdedupstats(&ohandle, &stats);
+		fprintf(stderr, "tofastmap: %zu of %zu values shared, %zu bytes saved, %zu of %zu table entries displaced\n",
+			stats.duplicates, stats.values, stats.savedbytes, stats.evictions, stats.tableentries);
+	}
 	return rc;
 }
 
@@ -155,11 +264,24 @@ int main(int argc, char *argv[])
 	};
 	char *inputformat = NULL;
 	char *outputformat = NULL;
+	size_t inlinevsize = 0;
+	size_t pagesize = 0;
+	size_t sectionalign = 0;
+	size_t restartinterval = 0;
+	int truncateseparators = 0;
+	char *keyschema = NULL;
+	char *atomencoding = NULL;
+	size_t valueblocksize = 0;
+	char *dictionarypathname = NULL;
+	static char dictionary[FASTMAP_MAXDICTIONARYSIZE];
+	ssize_t dictionarysize = 0;
+	size_t dedupentries = 0;
 	fastmap_attr_t attr;
 	char *inputpathname, *outputpathname;
 	size_t nrecords;
 	int iformat;
-	int i, opt, input, rc;
+	size_t i;
+	int opt, input, rc;
 	fastmap_format_t oformat;
 
 	while (1)
@@ -167,12 +289,22 @@ int main(int argc, char *argv[])
 		static struct option longopts[] = {
 			{ "input-format", required_argument, NULL, 'I' },
 			{ "output-format", required_argument, NULL, 'O' },
+			{ "inline-values", required_argument, NULL, 'V' },
+			{ "page-size", required_argument, NULL, 'P' },
+			{ "huge-align", no_argument, NULL, 'H' },
+			{ "front-code", required_argument, NULL, 'F' },
+			{ "truncate-separators", no_argument, NULL, 'T' },
+			{ "key-schema", required_argument, NULL, 'K' },
+			{ "atom-encoding", required_argument, NULL, 'A' },
+			{ "compress-values", required_argument, NULL, 'Z' },
+			{ "dictionary", required_argument, NULL, 'D' },
+			{ "dedup-values", required_argument, NULL, 'U' },
 			{ "help", no_argument, &help, 1},
 			{ 0, 0, 0, 0}
 		};
 
 		int option_index;
-		if ((opt = getopt_long(argc, argv, "I:O:", longopts, &option_index)) == -1)
+		if ((opt = getopt_long(argc, argv, "I:O:V:P:HF:TK:A:Z:D:U:", longopts, &option_index)) == -1)
 			break;
 
 		switch (opt)
@@ -183,6 +315,36 @@ int main(int argc, char *argv[])
 			case 'O':
 				outputformat = optarg;
 				break;
+			case 'V':
+				inlinevsize = (size_t)(atol(optarg));
+				break;
+			case 'P':
+				pagesize = (size_t)(atol(optarg));
+				break;
+			case 'H':
+				sectionalign = FASTMAP_HUGEPAGESIZE;
+				break;
+			case 'F':
+				restartinterval = (size_t)(atol(optarg));
+				break;
+			case 'T':
+				truncateseparators = 1;
+				break;
+			case 'K':
+				keyschema = optarg;
+				break;
+			case 'A':
+				atomencoding = optarg;
+				break;
+			case 'Z':
+				valueblocksize = (size_t)(atol(optarg));
+				break;
+			case 'D':
+				dictionarypathname = optarg;
+				break;
+			case 'U':
+				dedupentries = (size_t)(atol(optarg));
+				break;
 			default:
 				break;
 		}
@@ -257,6 +419,107 @@ int main(int argc, char *argv[])
 	fastmap_attr_setrecords(&attr, nrecords);
 	fastmap_attr_setformat(&attr, oformat);
 
+	if (fastmap_attr_setinlinevsize(&attr, inlinevsize) != FASTMAP_OK)
+	{
+		fprintf(stderr, "tofastmap: invalid inline value size '%zu'\n", inlinevsize);
+		fprintf(stderr, "Try 'tofastmap --help' for more information.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (fastmap_attr_setpagesize(&attr, pagesize) != FASTMAP_OK)
+	{
+		fprintf(stderr, "tofastmap: invalid page size '%zu'\n", pagesize);
+		fprintf(stderr, "Try 'tofastmap --help' for more information.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	fastmap_attr_setsectionalign(&attr, sectionalign);
+	fastmap_attr_setrestartinterval(&attr, restartinterval);
+	fastmap_attr_settruncateseparators(&attr, truncateseparators);
+
+	if (keyschema != NULL)
+	{
+		struct {
+			char *name;
+			fastmap_keytype_t type;
+		} keytypes[] = {
+			{ "u32", FASTMAP_KEY_U32 },
+			{ "u64", FASTMAP_KEY_U64 },
+			{ "i64", FASTMAP_KEY_I64 },
+			{ "f64", FASTMAP_KEY_F64 }
+		};
+		fastmap_keytype_t types[FASTMAP_MAXKEYFIELDS];
+		size_t nfields = 0;
+		char *type;
+
+		while ((type = nextfield(&keyschema, ',')) != NULL)
+		{
+			for (i = 0; i < (sizeof(keytypes) / sizeof(keytypes[0])); i++)
+			{
+				if (strcmp(type, keytypes[i].name) == 0)
+					break;
+			}
+
+			if (i == (sizeof(keytypes) / sizeof(keytypes[0])) || nfields == FASTMAP_MAXKEYFIELDS)
+			{
+				fprintf(stderr, "tofastmap: invalid key schema field '%s'\n", type);
+				fprintf(stderr, "Try 'tofastmap --help' for more information.\n");
+				exit(EXIT_FAILURE);
+			}
+			types[nfields++] = keytypes[i].type;
+		}
+
+		fastmap_attr_setkeyschema(&attr, types, nfields);
+	}
+
+	if (atomencoding != NULL)
+	{
+		if (strcmp(atomencoding, "sorted") == 0)
+		{
+			fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_SORTED);
+		}
+		else if (strcmp(atomencoding, "eliasfano") == 0)
+		{
+			fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_ELIASFANO);
+		}
+		else if (strcmp(atomencoding, "roaring") == 0)
+		{
+			fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_ROARING);
+		}
+		else
+		{
+			fprintf(stderr, "tofastmap: invalid atom encoding '%s'\n", atomencoding);
+			fprintf(stderr, "Try 'tofastmap --help' for more information.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (fastmap_attr_setvaluecompression(&attr, valueblocksize) != FASTMAP_OK)
+	{
+		fprintf(stderr, "tofastmap: invalid value block size '%zu'\n", valueblocksize);
+		fprintf(stderr, "Try 'tofastmap --help' for more information.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (fastmap_attr_setvaluededup(&attr, dedupentries) != FASTMAP_OK)
+	{
+		fprintf(stderr, "tofastmap: invalid value table size '%zu'\n", dedupentries);
+		fprintf(stderr, "Try 'tofastmap --help' for more information.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (dictionarypathname != NULL)
+	{
+		int fd = open(dictionarypathname, O_RDONLY);
+
+		if (fd == -1 || (dictionarysize = read(fd, dictionary, sizeof(dictionary))) == -1)
+		{
+			perror("tofastmap");
+			exit(EXIT_FAILURE);
+		}
+		close(fd);
+	}
+
 	inputpathname = (char*)(argv[optind + 1]);
 	outputpathname = (char*)(argv[optind + 2]);
 
@@ -277,7 +540,7 @@ int main(int argc, char *argv[])
 	switch (iformat)
 	{
 	case INPUT_CSV:
-		rc = fromcsv(&attr, input, outputpathname);
+		rc = fromcsv(&attr, dictionary, (size_t)dictionarysize, input, outputpathname);
 		break;
 	}
 
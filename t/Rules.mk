@@ -6,6 +6,31 @@ check_PROGRAMS += \
 	t/fastmap_block_t \
 	t/fastmap_block_inline_t \
 	t/fastmap_blob_t \
+	t/fastmap_blob_inline_t \
+	t/fastmap_valueptr_t \
+	t/fastmap_nonmultiple_t \
+	t/fastmap_pagesize_t \
+	t/fastmap_mappolicy_t \
+	t/fastmap_initmem_t \
+	t/fastmap_container_t \
+	t/fastmap_frontcoded_t \
+	t/fastmap_varkey_t \
+	t/fastmap_separators_t \
+	t/fastmap_keyschema_t \
+	t/fastmap_integerkeys_t \
+	t/fastmap_eliasfano_t \
+	t/fastmap_roaring_t \
+	t/fastmap_compress_t \
+	t/fastmap_dedup_t \
+	t/fastmap_bufferpool_t \
+	t/fastmap_async_t \
+	t/fastmap_prefetch_t \
+	t/fastmap_finger_t \
+	t/fastmap_mget_t \
+	t/fastmap_rank_t \
+	t/fastmap_scan_t \
+	t/fastmap_aggregate_t \
+	t/fastmap_quantile_t \
 	t/1M_atom_t \
 	t/1M_pair_t \
 	t/1M_block_t \
@@ -34,6 +59,81 @@ t_fastmap_block_inline_t_LDADD = libtap.a src/libfastmap.la
 t_fastmap_blob_t_SOURCES = t/fastmap_blob_t.c
 t_fastmap_blob_t_LDADD = libtap.a src/libfastmap.la
 
+t_fastmap_blob_inline_t_SOURCES = t/fastmap_blob_inline_t.c
+t_fastmap_blob_inline_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_valueptr_t_SOURCES = t/fastmap_valueptr_t.c
+t_fastmap_valueptr_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_nonmultiple_t_SOURCES = t/fastmap_nonmultiple_t.c
+t_fastmap_nonmultiple_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_pagesize_t_SOURCES = t/fastmap_pagesize_t.c
+t_fastmap_pagesize_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_mappolicy_t_SOURCES = t/fastmap_mappolicy_t.c
+t_fastmap_mappolicy_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_initmem_t_SOURCES = t/fastmap_initmem_t.c
+t_fastmap_initmem_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_container_t_SOURCES = t/fastmap_container_t.c
+t_fastmap_container_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_frontcoded_t_SOURCES = t/fastmap_frontcoded_t.c
+t_fastmap_frontcoded_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_varkey_t_SOURCES = t/fastmap_varkey_t.c
+t_fastmap_varkey_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_separators_t_SOURCES = t/fastmap_separators_t.c
+t_fastmap_separators_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_keyschema_t_SOURCES = t/fastmap_keyschema_t.c
+t_fastmap_keyschema_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_integerkeys_t_SOURCES = t/fastmap_integerkeys_t.c
+t_fastmap_integerkeys_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_eliasfano_t_SOURCES = t/fastmap_eliasfano_t.c
+t_fastmap_eliasfano_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_roaring_t_SOURCES = t/fastmap_roaring_t.c
+t_fastmap_roaring_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_compress_t_SOURCES = t/fastmap_compress_t.c
+t_fastmap_compress_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_dedup_t_SOURCES = t/fastmap_dedup_t.c
+t_fastmap_dedup_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_bufferpool_t_SOURCES = t/fastmap_bufferpool_t.c
+t_fastmap_bufferpool_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_async_t_SOURCES = t/fastmap_async_t.c
+t_fastmap_async_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_prefetch_t_SOURCES = t/fastmap_prefetch_t.c t/layout.c t/layout.h
+t_fastmap_prefetch_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_finger_t_SOURCES = t/fastmap_finger_t.c t/layout.c t/layout.h
+t_fastmap_finger_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_mget_t_SOURCES = t/fastmap_mget_t.c
+t_fastmap_mget_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_rank_t_SOURCES = t/fastmap_rank_t.c t/layout.c t/layout.h
+t_fastmap_rank_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_scan_t_SOURCES = t/fastmap_scan_t.c t/layout.c t/layout.h
+t_fastmap_scan_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_aggregate_t_SOURCES = t/fastmap_aggregate_t.c
+t_fastmap_aggregate_t_LDADD = libtap.a src/libfastmap.la
+
+t_fastmap_quantile_t_SOURCES = t/fastmap_quantile_t.c t/layout.c t/layout.h
+t_fastmap_quantile_t_LDADD = libtap.a src/libfastmap.la
+
 t_1M_atom_t_SOURCES = t/1M_atom_t.c
 t_1M_atom_t_LDADD = libtap.a src/libfastmap.la
 
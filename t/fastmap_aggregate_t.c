@@ -0,0 +1,229 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 30000
+
+/* the number held by the value of record 'i' */
+static int64_t number(size_t i)
+{
+	return (int64_t)((i * 7919) % 1000) - 500;
+}
+
+static void makevalue(fastmap_keytype_t type, size_t i, unsigned char *value)
+{
+	uint32_t u32 = (uint32_t)(number(i) + 500);
+	uint64_t u64 = (uint64_t)(number(i) + 500);
+	int64_t i64 = number(i);
+	double f64 = (double)number(i) / 4;
+
+	if (type == FASTMAP_KEY_U32)
+		memcpy(value, &u32, sizeof(u32));
+	else if (type == FASTMAP_KEY_U64)
+		memcpy(value, &u64, sizeof(u64));
+	else if (type == FASTMAP_KEY_I64)
+		memcpy(value, &i64, sizeof(i64));
+	else
+		memcpy(value, &f64, sizeof(f64));
+}
+
+static int build(const char *pathname, fastmap_keytype_t type, size_t vsize, int separators)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	char key[9];
+	unsigned char value[256] = {0};
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setvsize(&attr, vsize);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOCK);
+	fastmap_attr_setpagesize(&attr, 1024);
+	fastmap_attr_settruncateseparators(&attr, separators);
+	if (fastmap_attr_setvalueaggregate(&attr, type) != FASTMAP_OK)
+		return 0;
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	record.block.key = key;
+	record.block.value = value;
+	for (i = 0; i < NRECORDS; i++)
+	{
+		snprintf(key, sizeof(key), "%08zu", i * 2);
+		makevalue(type, i, value);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	return fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK;
+}
+
+/* aggregate the records from index 'first' up to index 'last' record by record */
+static void expect(fastmap_keytype_t type, size_t first, size_t last, fastmap_aggregate_t *aggregate)
+{
+	size_t i;
+	int64_t n;
+
+	memset(aggregate, 0, sizeof(*aggregate));
+	for (i = first; i < last && i < NRECORDS; i++)
+	{
+		n = number(i);
+		if (type == FASTMAP_KEY_I64)
+		{
+			aggregate->sum.i64 += n;
+			if (aggregate->count == 0 || n < aggregate->min.i64)
+				aggregate->min.i64 = n;
+			if (aggregate->count == 0 || n > aggregate->max.i64)
+				aggregate->max.i64 = n;
+		}
+		else if (type == FASTMAP_KEY_F64)
+		{
+			aggregate->sum.f64 += (double)n / 4;
+			if (aggregate->count == 0 || (double)n / 4 < aggregate->min.f64)
+				aggregate->min.f64 = (double)n / 4;
+			if (aggregate->count == 0 || (double)n / 4 > aggregate->max.f64)
+				aggregate->max.f64 = (double)n / 4;
+		}
+		else
+		{
+			aggregate->sum.u64 += (uint64_t)(n + 500);
+			if (aggregate->count == 0 || (uint64_t)(n + 500) < aggregate->min.u64)
+				aggregate->min.u64 = (uint64_t)(n + 500);
+			if (aggregate->count == 0 || (uint64_t)(n + 500) > aggregate->max.u64)
+				aggregate->max.u64 = (uint64_t)(n + 500);
+		}
+		aggregate->count++;
+	}
+}
+
+static int same(fastmap_keytype_t type, const fastmap_aggregate_t *a, const fastmap_aggregate_t *b)
+{
+	if (a->count != b->count)
+		return 0;
+	if (a->count == 0)
+		return 1;
+	if (type == FASTMAP_KEY_I64)
+		return a->sum.i64 == b->sum.i64 && a->min.i64 == b->min.i64 && a->max.i64 == b->max.i64;
+	/* the sums are of quarters, and so exact whatever the order they are added in */
+	if (type == FASTMAP_KEY_F64)
+		return a->sum.f64 == b->sum.f64 && a->min.f64 == b->min.f64 && a->max.f64 == b->max.f64;
+	return a->sum.u64 == b->sum.u64 && a->min.u64 == b->min.u64 && a->max.u64 == b->max.u64;
+}
+
+/* aggregate ranges between the keys of records, and keys between them, checking each against
+ * the records of the range; index 'i' names the key of record i / 2, or the one after it if odd */
+static int ranges(const char *pathname, fastmap_keytype_t type, int flags)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t first, last;
+	fastmap_aggregate_t aggregate, expected;
+	char firstkey[9], lastkey[9];
+	size_t i, a, b;
+	int rc = 1;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags) != FASTMAP_OK)
+		return 0;
+
+	first.block.key = firstkey;
+	last.block.key = lastkey;
+	for (i = 0; i < 2000 && rc; i++)
+	{
+		/* short ranges, ranges across a few pages, and ranges across most of the map */
+		a = (i * 7919) % (2 * NRECORDS + 2);
+		b = a + ((i % 3 == 0) ? i % 50 : (i % 3 == 1) ? (i * 31) % 2000 : (i * 104729) % (2 * NRECORDS));
+		snprintf(firstkey, sizeof(firstkey), "%08zu", a);
+		snprintf(lastkey, sizeof(lastkey), "%08zu", b);
+		expect(type, (a + 1) / 2, (b + 1) / 2, &expected);
+		if (fastmap_inhandle_aggregate(&ihandle, &first, &last, &aggregate) != FASTMAP_OK || !same(type, &aggregate, &expected))
+		{
+			diag("range [%s, %s) failed", firstkey, lastkey);
+			rc = 0;
+		}
+	}
+
+	/* open ended ranges, and the whole map */
+	expect(type, 0, NRECORDS, &expected);
+	if (fastmap_inhandle_aggregate(&ihandle, NULL, NULL, &aggregate) != FASTMAP_OK || !same(type, &aggregate, &expected))
+		rc = 0;
+	snprintf(firstkey, sizeof(firstkey), "%08d", 1001);
+	expect(type, 501, NRECORDS, &expected);
+	if (fastmap_inhandle_aggregate(&ihandle, &first, NULL, &aggregate) != FASTMAP_OK || !same(type, &aggregate, &expected))
+		rc = 0;
+	snprintf(lastkey, sizeof(lastkey), "%08d", 40000);
+	expect(type, 0, 20000, &expected);
+	if (fastmap_inhandle_aggregate(&ihandle, NULL, &last, &aggregate) != FASTMAP_OK || !same(type, &aggregate, &expected))
+		rc = 0;
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t first, last;
+	fastmap_aggregate_t aggregate;
+	fastmap_keytype_t type;
+	char *pathname = tempnam(NULL, "fmag");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(15);
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_setvalueaggregate(&attr, (fastmap_keytype_t)99) == EINVAL,
+		"fastmap_attr_setvalueaggregate(), not a number");
+	ok(fastmap_attr_setvalueaggregate(&attr, FASTMAP_KEY_I64) == FASTMAP_OK && fastmap_attr_getvalueaggregate(&attr, &type) == FASTMAP_OK &&
+		type == FASTMAP_KEY_I64, "fastmap_attr_getvalueaggregate()");
+
+	/* values too short for their numbers, values of blobs, and front-coded leaves keep no aggregates */
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setvsize(&attr, 4);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOCK);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "value smaller than its number");
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "blob values");
+	fastmap_attr_setvsize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOCK);
+	fastmap_attr_setrestartinterval(&attr, 16);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "front-coded leaves");
+
+	ok(build(pathname, FASTMAP_KEY_I64, 8, 0) && ranges(pathname, FASTMAP_KEY_I64, 0), "i64 values, inline");
+	ok(ranges(pathname, FASTMAP_KEY_I64, FASTMAP_MAP_BUFFERPOOL), "i64 values, FASTMAP_MAP_BUFFERPOOL");
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	first.block.key = "00001000";
+	last.block.key = "00001000";
+	ok(fastmap_inhandle_aggregate(&ihandle, &first, &last, &aggregate) == FASTMAP_OK && aggregate.count == 0, "empty range");
+	last.block.key = "00000010";
+	ok(fastmap_inhandle_aggregate(&ihandle, &first, &last, &aggregate) == FASTMAP_OK && aggregate.count == 0, "range ending before it starts");
+	ok(fastmap_inhandle_aggregate(&ihandle, &first, &last, NULL) == EINVAL, "fastmap_inhandle_aggregate(NULL)");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(build(pathname, FASTMAP_KEY_U64, 200, 0) && ranges(pathname, FASTMAP_KEY_U64, 0), "u64 values");
+	ok(build(pathname, FASTMAP_KEY_U32, 4, 1) && ranges(pathname, FASTMAP_KEY_U32, 0), "u32 values, truncated separators");
+	ok(build(pathname, FASTMAP_KEY_F64, 16, 0) && ranges(pathname, FASTMAP_KEY_F64, 0), "f64 values");
+
+	ok(build(pathname, 0, 8, 0) && fastmap_inhandle_init(&ihandle, pathname) == FASTMAP_OK &&
+		fastmap_inhandle_aggregate(&ihandle, NULL, NULL, &aggregate) == EINVAL, "map keeps no aggregates");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
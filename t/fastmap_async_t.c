@@ -0,0 +1,153 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 20000
+
+static fastmap_record_t records[NRECORDS];
+static char keys[NRECORDS][9];
+
+static size_t makevalue(size_t i, char *value)
+{
+	return (size_t)sprintf(value, "value of record %zu%.*s", i, (int)(i % 40), "........................................");
+}
+
+static int check(const fastmap_record_t *record, size_t i, int rc)
+{
+	char value[128];
+	size_t vsize = makevalue(i, value);
+
+	if (rc != FASTMAP_OK || record->blob.vsize != vsize || memcmp(record->blob.value, value, vsize) != 0)
+	{
+		diag("lookup of record %zu failed: %d", i, rc);
+		return 0;
+	}
+	return 1;
+}
+
+/* submit every key in a scattered order, checking lookups as they complete,
+ * counting those which completed at once into 'immediate' */
+static int lookups(fastmap_inhandle_t *ihandle, size_t *immediate)
+{
+	fastmap_completion_t completions[32];
+	size_t i, k, n, j, done = 0;
+	int rc;
+
+	*immediate = 0;
+	for (i = 0; i < NRECORDS; i++)
+	{
+		k = (i * 7919) % NRECORDS;
+		records[k].blob.key = keys[k];
+		rc = fastmap_inhandle_submit(ihandle, &records[k], (void*)(uintptr_t)k);
+		if (rc == FASTMAP_PENDING)
+			continue;
+		if (!check(&records[k], k, rc))
+			return 0;
+		(*immediate)++;
+		done++;
+	}
+
+	while (done < NRECORDS)
+	{
+		if (fastmap_inhandle_complete(ihandle, completions, 32, &n, 1) != FASTMAP_OK || n == 0)
+		{
+			diag("%zu lookups never completed", NRECORDS - done);
+			return 0;
+		}
+		for (j = 0; j < n; j++)
+		{
+			k = (size_t)(uintptr_t)completions[j].cookie;
+			if (completions[j].record != &records[k] || !check(completions[j].record, k, completions[j].rc))
+				return 0;
+		}
+		done += n;
+	}
+
+	return 1;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t ihandle;
+	fastmap_completion_t completion;
+	fastmap_record_t record;
+	fastmap_poolstats_t stats;
+	char value[128];
+	size_t i, n, immediate;
+	char *pathname = tempnam(NULL, "fmas");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(14);
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	fastmap_attr_setpagesize(&attr, 4096);
+
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	for (i = 0; i < NRECORDS; i++)
+	{
+		snprintf(keys[i], sizeof(keys[i]), "%08zu", i);
+		record.blob.key = keys[i];
+		record.blob.value = value;
+		record.blob.vsize = makevalue(i, value);
+		fastmap_outhandle_put(&ohandle, &record);
+	}
+	ok(fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK, "fastmap_outhandle_destroy()");
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	record.blob.key = keys[0];
+	ok(fastmap_inhandle_submit(&ihandle, &record, NULL) == EINVAL, "mapped handle has no buffer pool");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(fastmap_inhandle_initflags(&ihandle, pathname, FASTMAP_MAP_BUFFERPOOL) == FASTMAP_OK, "fastmap_inhandle_initflags(FASTMAP_MAP_BUFFERPOOL)");
+	ok(fastmap_inhandle_complete(&ihandle, &completion, 1, &n, 1) == FASTMAP_OK && n == 0, "nothing to complete");
+
+	ok(lookups(&ihandle, &immediate), "cold lookups");
+	ok(immediate < NRECORDS, "cold lookups wait on reads");
+	diag("%zu of %d lookups completed at once", immediate, NRECORDS);
+
+	ok(lookups(&ihandle, &immediate) && immediate == NRECORDS, "warm lookups complete at once");
+
+	record.blob.key = "99999999";
+	ok(fastmap_inhandle_submit(&ihandle, &record, NULL) == FASTMAP_NOT_FOUND, "missing key");
+
+	/* a pool too small to hold the map keeps evicting, and lookups still complete */
+	ok(fastmap_inhandle_setpoolframes(&ihandle, 8) == FASTMAP_OK && lookups(&ihandle, &immediate), "lookups, 8 frames");
+	fastmap_inhandle_getpoolstats(&ihandle, &stats);
+	ok(stats.evictions > 0, "lookups, 8 frames, frames evicted");
+	diag("%zu frames, %zu resident, %zu hits, %zu reads, %zu evictions", stats.frames, stats.resident, stats.hits, stats.reads, stats.evictions);
+
+	/* a blocking lookup waits for a read already in flight */
+	fastmap_inhandle_setpoolframes(&ihandle, 8);
+	records[1234].blob.key = keys[1234];
+	ok(fastmap_inhandle_submit(&ihandle, &records[1234], NULL) == FASTMAP_PENDING, "fastmap_inhandle_submit()");
+	record.blob.key = keys[1234];
+	ok(check(&record, 1234, fastmap_inhandle_get(&ihandle, &record)), "fastmap_inhandle_get() during a read");
+	ok(fastmap_inhandle_complete(&ihandle, &completion, 1, &n, 1) == FASTMAP_OK && n == 1 && check(completion.record, 1234, completion.rc), "fastmap_inhandle_complete()");
+
+	/* lookups still pending are dropped with the handle */
+	fastmap_inhandle_setpoolframes(&ihandle, 8);
+	for (i = 0; i < 100; i++)
+	{
+		records[i].blob.key = keys[i * 97];
+		fastmap_inhandle_submit(&ihandle, &records[i], NULL);
+	}
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
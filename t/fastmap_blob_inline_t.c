@@ -0,0 +1,67 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+int main(void)
+{
+	fastmap_blob_t blobs[] = {
+		{ "0001", "foo",    strlen("foo")    },
+		{ "0002", "",       strlen("")       },
+		{ "0003", "baz",    strlen("baz")    },
+		{ "0004", "quux",   strlen("quux")   },
+		{ "0005", "quorum", strlen("quorum") }
+	};
+	fastmap_blob_t blob;
+
+	fastmap_attr_t attr;
+	fastmap_inhandle_t ihandle;
+	fastmap_outhandle_t ohandle;
+	size_t i;
+	char buf[7] = {0}, *pathname = tempnam(NULL, "fmbli");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, 5);
+	fastmap_attr_setksize(&attr, 4);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+
+	plan(20);
+
+	ok(fastmap_attr_setinlinevsize(&attr, FASTMAP_MAXINLINEVSIZE + 1) == EINVAL, "fastmap_attr_setinlinevsize(MAX + 1)");
+	ok(fastmap_attr_setinlinevsize(&attr, 4) == FASTMAP_OK, "fastmap_attr_setinlinevsize()");
+
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+
+	ok(ohandle.handle.flags & 0x04, "INLINE_BLOB");
+
+	for (i = 0; i < (sizeof(blobs) / sizeof(blobs[0])); i++)
+		ok(fastmap_outhandle_put(&ohandle, (fastmap_record_t*)&blobs[i]) == FASTMAP_OK, "fastmap_outhandle_put(\"%s\")", blobs[i].key);
+	fastmap_outhandle_destroy(&ohandle);
+
+	fastmap_inhandle_init(&ihandle, pathname);
+
+	ok(ihandle.handle.flags & 0x04, "INLINE_BLOBS");
+
+	for (i = 0; i < (sizeof(blobs) / sizeof(blobs[0])); i++)
+	{
+		blob.key = blobs[i].key;
+		ok(fastmap_inhandle_get(&ihandle, (fastmap_record_t*)&blob) == FASTMAP_OK, "fastmap_inhandle_get(\"%s\")", blob.key);
+		strncpy(buf, blob.value, blob.vsize);
+		buf[blob.vsize] = '\0';
+		is(buf, blobs[i].value, "%s == %s", buf, blobs[i].value);
+	}	
+
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
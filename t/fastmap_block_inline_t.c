@@ -37,7 +37,7 @@ int main(void)
 
 	fastmap_outhandle_init(&ohandle, &attr, pathname);
 
-	ok(!(ohandle.handle.flags & 0x02), "INLINE_BLOCK");
+	ok(ohandle.handle.flags & 0x02, "INLINE_BLOCK");
 
 	for (i = 0; i < (sizeof(blocks) / sizeof(blocks[0])); i++)
 		ok(fastmap_outhandle_put(&ohandle, (fastmap_record_t*)&blocks[i]) == FASTMAP_OK, "fastmap_outhandle_put(\"%s\")", blocks[i].key);
@@ -45,7 +45,7 @@ int main(void)
 
 	fastmap_inhandle_init(&ihandle, pathname);
 
-	ok(!(ihandle.handle.flags & 0x02), "INLINE_BLOCKS");
+	ok(ihandle.handle.flags & 0x02, "INLINE_BLOCKS");
 
 	for (i = 0; i < (sizeof(blocks) / sizeof(blocks[0])); i++)
 	{
@@ -8,6 +8,11 @@
 #include <tap.h>
 #include <fastmap.h>
 
+/* values too large to share a page with their key are never inlined */
+#define VSIZE 65536
+
+static char values[5][VSIZE];
+
 int main(void)
 {
 	fastmap_block_t blocks[] = {
@@ -30,7 +35,13 @@ int main(void)
 	fastmap_attr_init(&attr);
 	fastmap_attr_setrecords(&attr, 5);
 	fastmap_attr_setksize(&attr, 4);
-	fastmap_attr_setvsize(&attr, 5);
+	fastmap_attr_setvsize(&attr, VSIZE);
+
+	for (i = 0; i < (sizeof(blocks) / sizeof(blocks[0])); i++)
+	{
+		memcpy(values[i], blocks[i].value, strlen(blocks[i].value));
+		blocks[i].value = values[i];
+	}
 	fastmap_attr_setformat(&attr, FASTMAP_BLOCK);
 
 	plan(18);
@@ -0,0 +1,180 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 50000
+
+static void makevalue(size_t i, char *value, size_t *vsize)
+{
+	*vsize = (i % 101 == 0) ? 0 : (size_t)sprintf(value, "value of record %zu, padded%.*s", i, (int)(i % 60), "............................................................");
+}
+
+/* build a blob map, front-coded if 'restartinterval' is set and with compressed values if 'blocksize' is */
+static int build(const char *pathname, size_t restartinterval, size_t blocksize)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	char key[9], value[128];
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	fastmap_attr_setpagesize(&attr, 4096);
+	fastmap_attr_setrestartinterval(&attr, restartinterval);
+	fastmap_attr_setvaluecompression(&attr, blocksize);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	record.blob.key = key;
+	record.blob.value = value;
+	for (i = 0; i < NRECORDS; i++)
+	{
+		snprintf(key, sizeof(key), "%08zu", i);
+		makevalue(i, value, &record.blob.vsize);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	return fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK;
+}
+
+/* look every key up in a scattered order, along with a key which is missing */
+static int lookups(fastmap_inhandle_t *ihandle)
+{
+	fastmap_record_t record;
+	char key[9], value[128];
+	size_t i, k, vsize;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		k = (i * 7919) % NRECORDS;
+		snprintf(key, sizeof(key), "%08zu", k);
+		makevalue(k, value, &vsize);
+		record.blob.key = key;
+		if (fastmap_inhandle_get(ihandle, &record) != FASTMAP_OK || record.blob.vsize != vsize || memcmp(record.blob.value, value, vsize) != 0)
+		{
+			diag("lookup failed for key: '%s'", key);
+			return 0;
+		}
+	}
+
+	record.blob.key = "99999999";
+	return fastmap_inhandle_get(ihandle, &record) == FASTMAP_NOT_FOUND;
+}
+
+static int poollookups(const char *pathname, int flags, size_t nframes)
+{
+	fastmap_inhandle_t ihandle;
+	int rc;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags | FASTMAP_MAP_BUFFERPOOL) != FASTMAP_OK)
+		return 0;
+	if (nframes > 0 && fastmap_inhandle_setpoolframes(&ihandle, nframes) != FASTMAP_OK)
+		return 0;
+
+	rc = lookups(&ihandle);
+	return fastmap_inhandle_destroy(&ihandle) == FASTMAP_OK && rc;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t ihandle;
+	fastmap_poolstats_t stats;
+	fastmap_record_t record;
+	fastmap_keytype_t type = FASTMAP_KEY_U64;
+	fastmap_keyfield_t field;
+	unsigned char key[8], successor[8], expected[8];
+	size_t i;
+	int fd, rc;
+	char *pathname = tempnam(NULL, "fmbp");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(19);
+
+	ok(build(pathname, 0, 0), "fastmap_outhandle_destroy()");
+
+	ok(fastmap_inhandle_initflags(&ihandle, pathname, FASTMAP_MAP_BUFFERPOOL | FASTMAP_MAP_LOADRAM) == EINVAL, "FASTMAP_MAP_BUFFERPOOL with FASTMAP_MAP_LOADRAM");
+	fastmap_inhandle_init(&ihandle, pathname);
+	ok(fastmap_inhandle_setpoolframes(&ihandle, 16) == EINVAL && fastmap_inhandle_getpoolstats(&ihandle, &stats) == EINVAL, "mapped handle has no buffer pool");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(fastmap_inhandle_initflags(&ihandle, pathname, FASTMAP_MAP_BUFFERPOOL) == FASTMAP_OK, "fastmap_inhandle_initflags(FASTMAP_MAP_BUFFERPOOL)");
+	ok(fastmap_inhandle_setpoolframes(&ihandle, 0) == EINVAL, "fastmap_inhandle_setpoolframes(0)");
+	ok(fastmap_inhandle_getpoolstats(&ihandle, &stats) == FASTMAP_OK && stats.frames == FASTMAP_DEFAULTPOOLFRAMES &&
+		stats.framesize >= 4096 && stats.pinned > 0 && stats.resident == 0, "fastmap_inhandle_getpoolstats()");
+	ok(lookups(&ihandle), "lookups");
+	fastmap_inhandle_getpoolstats(&ihandle, &stats);
+	ok(stats.reads > 0 && stats.hits > 0 && stats.resident <= stats.frames, "frames read and hit");
+	diag("%zu frames of %zu bytes, %zu resident, %zu pinned, %zu hits, %zu reads, %zu evictions",
+		stats.frames, stats.framesize, stats.resident, stats.pinned, stats.hits, stats.reads, stats.evictions);
+
+	/* a pool of a few frames evicts as it goes, and stays within its frames */
+	ok(fastmap_inhandle_setpoolframes(&ihandle, 4) == FASTMAP_OK && lookups(&ihandle), "lookups, 4 frames");
+	fastmap_inhandle_getpoolstats(&ihandle, &stats);
+	ok(stats.evictions > 0 && stats.resident <= 4 && stats.frames == 4, "frames evicted");
+	diag("%zu resident, %zu hits, %zu reads, %zu evictions", stats.resident, stats.hits, stats.reads, stats.evictions);
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(poollookups(pathname, FASTMAP_ADVISE_LEAF_WILLNEED | FASTMAP_ADVISE_VALUE_WILLNEED, 0), "willneed advice fills the pool");
+	ok(build(pathname, 16, 0) && poollookups(pathname, 0, 2), "front-coded, 2 frames");
+	ok(build(pathname, 0, 4096) && poollookups(pathname, 0, 2), "compressed values, 2 frames");
+
+	/* the handle keeps a descriptor of its own */
+	fd = open(pathname, O_RDONLY);
+	ok(fastmap_inhandle_initfd(&ihandle, fd, 0, 0, FASTMAP_MAP_BUFFERPOOL) == FASTMAP_OK && close(fd) == 0, "fastmap_inhandle_initfd(FASTMAP_MAP_BUFFERPOOL)");
+	ok(lookups(&ihandle) && fastmap_inhandle_destroy(&ihandle) == FASTMAP_OK, "fastmap_inhandle_initfd(), lookups");
+
+	/* an Elias-Fano coded set, whose partitions are read through the pool */
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setkeyschema(&attr, &type, 1);
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+	fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_ELIASFANO);
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	for (i = 0; i < NRECORDS; i++)
+	{
+		field.u64 = i * 3;
+		fastmap_encodekey(&attr, &field, key);
+		record.atom.key = key;
+		fastmap_outhandle_put(&ohandle, &record);
+	}
+	ok(fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK, "Elias-Fano coded set");
+
+	fastmap_inhandle_initflags(&ihandle, pathname, FASTMAP_MAP_BUFFERPOOL);
+	fastmap_inhandle_setpoolframes(&ihandle, 1);
+	for (i = 0; i < NRECORDS; i++)
+	{
+		field.u64 = (i + 1) * 3;
+		fastmap_encodekey(&attr, &field, expected);
+		field.u64 = i * 3 + 1;
+		fastmap_encodekey(&attr, &field, key);
+		rc = fastmap_inhandle_successor(&ihandle, key, successor);
+		if ((i + 1 < NRECORDS) ? (rc != FASTMAP_OK || memcmp(successor, expected, sizeof(key)) != 0) : rc != FASTMAP_NOT_FOUND)
+			break;
+	}
+	ok(i == NRECORDS, "Elias-Fano coded set, successors through 1 frame");
+	fastmap_inhandle_getpoolstats(&ihandle, &stats);
+	ok(stats.resident <= stats.frames && stats.evictions > 0, "Elias-Fano coded set, frames evicted");
+	diag("%zu frames, %zu resident, %zu pinned, %zu reads, %zu evictions", stats.frames, stats.resident, stats.pinned, stats.reads, stats.evictions);
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
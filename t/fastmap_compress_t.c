@@ -0,0 +1,213 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 20000
+
+static char values[NRECORDS][160];
+
+/* structured text values, alike in their field names and unlike in their field values */
+static void makevalues(void)
+{
+	static const char *colors[] = { "red", "green", "blue", "yellow", "purple" };
+	size_t i;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		if (i % 97 == 0)
+			values[i][0] = '\0';
+		else
+			snprintf(values[i], sizeof(values[i]), "{\"id\": %zu, \"name\": \"user%zu\", \"color\": \"%s\", \"score\": %zu, \"active\": %s}",
+				i, i * 7919 % 100003, colors[i % 5], i * 31 % 1000, (i % 3) ? "true" : "false");
+	}
+}
+
+/* build a blob map of the values, with a restart interval to front-code it and an inline size to inline the small values */
+static size_t build(const char *pathname, size_t blocksize, const void *dictionary, size_t dictionarysize, size_t restartinterval, size_t inlinevsize)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	char key[9];
+	struct stat st;
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	fastmap_attr_setpagesize(&attr, 4096);
+	fastmap_attr_setvaluecompression(&attr, blocksize);
+	fastmap_attr_setrestartinterval(&attr, restartinterval);
+	fastmap_attr_setinlinevsize(&attr, inlinevsize);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+	if (blocksize > 0 && fastmap_outhandle_setdictionary(&ohandle, dictionary, dictionarysize) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		snprintf(key, sizeof(key), "%08zu", i);
+		record.blob.key = key;
+		record.blob.value = values[i];
+		record.blob.vsize = strlen(values[i]);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK || stat(pathname, &st) == -1)
+		return 0;
+	return (size_t)st.st_size;
+}
+
+/* read every value back, in a scattered order so that blocks leave and return to the cache */
+static int verify(const char *pathname, size_t cacheblocks)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	char key[9];
+	size_t i, k;
+	int rc = 1;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+	if (cacheblocks > 0)
+		fastmap_inhandle_setcacheblocks(&ihandle, cacheblocks);
+
+	for (i = 0; i < NRECORDS && rc; i++)
+	{
+		k = (i * 7919) % NRECORDS;
+		snprintf(key, sizeof(key), "%08zu", k);
+		record.blob.key = key;
+		if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_OK || record.blob.vsize != strlen(values[k]) ||
+			memcmp(record.blob.value, values[k], record.blob.vsize) != 0)
+		{
+			diag("value %zu wrong", k);
+			rc = 0;
+		}
+	}
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	const void *samples[100];
+	size_t sizes[100];
+	unsigned char dictionary[4096];
+	const void *mapdictionary;
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	size_t raw, compressed, small, trained, size, i;
+	unsigned char garbage[64];
+	char key[9];
+	int fd;
+	char *pathname = tempnam(NULL, "fmcv");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(22);
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_setvaluecompression(&attr, FASTMAP_MAXVALUEBLOCKSIZE + 1) == EINVAL, "fastmap_attr_setvaluecompression(MAX + 1)");
+	ok(fastmap_attr_setvaluecompression(&attr, 65536) == FASTMAP_OK && fastmap_attr_getvaluecompression(&attr, &size) == FASTMAP_OK && size == 65536, "fastmap_attr_getvaluecompression()");
+
+	fastmap_attr_setrecords(&attr, 1);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_PAIR);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "blob format required");
+
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	ok(fastmap_outhandle_setdictionary(&ohandle, NULL, 10) == EINVAL, "fastmap_outhandle_setdictionary(NULL)");
+	snprintf(key, sizeof(key), "%08d", 0);
+	record.blob.key = key;
+	record.blob.value = key;
+	record.blob.vsize = strlen(key);
+	fastmap_outhandle_put(&ohandle, &record);
+	ok(fastmap_outhandle_setdictionary(&ohandle, key, strlen(key)) == EINVAL, "fastmap_outhandle_setdictionary() after a put");
+	fastmap_outhandle_destroy(&ohandle);
+
+	makevalues();
+	raw = build(pathname, 0, NULL, 0, 0, 0);
+	compressed = build(pathname, 65536, NULL, 0, 0, 0);
+	ok(compressed > 0, "compressed values");
+	ok(verify(pathname, 0), "compressed values, lookups");
+	ok(verify(pathname, 1), "compressed values, lookups through a single cached block");
+	ok(compressed * 2 < raw, "compressed values, less than half the size");
+	diag("%zu bytes raw, %zu bytes compressed", raw, compressed);
+
+	ok(build(pathname, 16384, NULL, 0, 0, 64) > 0 && verify(pathname, 0), "compressed values, inline small values");
+	ok(build(pathname, 16384, NULL, 0, 16, 0) > 0 && verify(pathname, 0), "compressed values, front-coded");
+
+	for (i = 0; i < 100; i++)
+	{
+		samples[i] = values[i * 173 + 1];
+		sizes[i] = strlen(values[i * 173 + 1]);
+	}
+	size = sizeof(dictionary) + FASTMAP_MAXDICTIONARYSIZE;
+	ok(fastmap_traindictionary(samples, sizes, 100, dictionary, &size) == EINVAL, "fastmap_traindictionary(MAX + 1)");
+	size = sizeof(dictionary);
+	ok(fastmap_traindictionary(samples, sizes, 100, dictionary, &size) == FASTMAP_OK && size > 0 && size <= sizeof(dictionary), "fastmap_traindictionary()");
+	diag("%zu byte dictionary", size);
+
+	small = build(pathname, 1024, NULL, 0, 0, 0);
+	trained = build(pathname, 1024, dictionary, size, 0, 0);
+	ok(trained > 0 && verify(pathname, 0), "dictionary, lookups");
+	ok(trained < small, "dictionary, smaller small blocks");
+	diag("%zu bytes in 1K blocks, %zu bytes with a dictionary", small, trained);
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	fastmap_inhandle_getdictionary(&ihandle, &mapdictionary, &i);
+	ok(i == size && mapdictionary != NULL && memcmp(mapdictionary, dictionary, size) == 0, "fastmap_inhandle_getdictionary()");
+	ok(fastmap_inhandle_setcacheblocks(&ihandle, 0) == EINVAL, "fastmap_inhandle_setcacheblocks(0)");
+	fastmap_inhandle_destroy(&ihandle);
+
+	/* values which do not compress are stored as they are */
+	for (i = 0; i < NRECORDS; i++)
+	{
+		size_t j;
+
+		for (j = 0; j < 40; j++)
+			values[i][j] = (char)('!' + (((i * 40 + j) * 2654435761U) >> 13) % 90);
+		values[i][40] = '\0';
+	}
+	raw = build(pathname, 0, NULL, 0, 0, 0);
+	compressed = build(pathname, 4096, NULL, 0, 0, 0);
+	ok(compressed > 0 && verify(pathname, 0), "incompressible values");
+	ok(compressed <= raw + 4096, "incompressible values, little overhead");
+
+	/* a block whose code runs past its end is reported rather than read */
+	makevalues();
+	build(pathname, 4096, NULL, 0, 0, 0);
+	fastmap_inhandle_init(&ihandle, pathname);
+	memset(garbage, 0xFF, sizeof(garbage));
+	fd = open(pathname, O_WRONLY);
+	ok(fd != -1 && pwrite(fd, garbage, sizeof(garbage), (off_t)ihandle.handle.firstvalueoffset) == (ssize_t)sizeof(garbage), "corrupt the first block");
+	close(fd);
+	fastmap_inhandle_destroy(&ihandle);
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	snprintf(key, sizeof(key), "%08d", 1);
+	record.blob.key = key;
+	ok(fastmap_inhandle_get(&ihandle, &record) == FASTMAP_CORRUPT_VALUE, "corrupt block");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NMAPS 3
+
+static int writemap(const char *pathname, size_t nrecords, int salt)
+{
+	fastmap_blob_t blob;
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	char key[17], value[33];
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, nrecords);
+	fastmap_attr_setksize(&attr, 16);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+	for (i = 0; i < nrecords; i++)
+	{
+		sprintf(key, "%016zu", i);
+		sprintf(value, "%d:%zu", salt, i);
+		blob.key = key;
+		blob.value = value;
+		blob.vsize = strlen(value);
+		fastmap_outhandle_put(&ohandle, (fastmap_record_t*)&blob);
+	}
+	return fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK;
+}
+
+static int lookups(fastmap_inhandle_t *ihandle, size_t nrecords, int salt)
+{
+	fastmap_blob_t blob;
+	char key[17], value[33];
+	size_t i;
+
+	for (i = 0; i < nrecords; i++)
+	{
+		sprintf(key, "%016zu", i);
+		sprintf(value, "%d:%zu", salt, i);
+		blob.key = key;
+		if (fastmap_inhandle_get(ihandle, (fastmap_record_t*)&blob) != FASTMAP_OK || blob.vsize != strlen(value) || memcmp(blob.value, value, blob.vsize) != 0)
+		{
+			diag("lookup failed for key: '%s'", key);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int main(void)
+{
+	const char *names[NMAPS] = { "users", "accounts", "sessions" };
+	const size_t nrecords[NMAPS] = { 1000, 20000, 1 };
+	const char *pathnames[NMAPS];
+	const char *dupnames[2] = { "same", "same" };
+	const char *longnames[1] = { "a-map-name-which-is-far-too-long-to-fit-in-the-directory" };
+	fastmap_container_t container;
+	fastmap_inhandle_t ihandle;
+	fastmap_blob_t blob;
+	const char *name;
+	size_t n;
+	int i, allok;
+	char *containername = tempnam(NULL, "fmcnt");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(15);
+
+	allok = 1;
+	for (i = 0; i < NMAPS; i++)
+	{
+		pathnames[i] = tempnam(NULL, "fmmap");
+		allok = allok && writemap(pathnames[i], nrecords[i], i);
+	}
+	ok(allok, "write maps");
+
+	ok(fastmap_container_create(containername, names, pathnames, NMAPS) == FASTMAP_OK, "fastmap_container_create()");
+	ok(fastmap_container_create(containername, dupnames, pathnames, 2) == EINVAL, "duplicate names");
+	ok(fastmap_container_create(containername, longnames, pathnames, 1) == EINVAL, "name too long");
+	ok(fastmap_container_create(containername, names, pathnames, NMAPS) == FASTMAP_OK, "fastmap_container_create() again");
+
+	ok(fastmap_container_init(&container, containername) == FASTMAP_OK, "fastmap_container_init()");
+	ok(fastmap_container_getcount(&container, &n) == FASTMAP_OK && n == NMAPS, "fastmap_container_getcount()");
+	ok(fastmap_container_getname(&container, 0, &name) == FASTMAP_OK && strcmp(name, "accounts") == 0 &&
+		fastmap_container_getname(&container, 2, &name) == FASTMAP_OK && strcmp(name, "users") == 0, "names are sorted");
+	ok(fastmap_container_getname(&container, NMAPS, &name) == EINVAL, "fastmap_container_getname() out of range");
+
+	allok = 1;
+	for (i = 0; i < NMAPS; i++)
+	{
+		if (fastmap_container_get(&container, names[i], &ihandle) != FASTMAP_OK)
+		{
+			diag("fastmap_container_get(\"%s\") failed", names[i]);
+			allok = 0;
+			continue;
+		}
+		allok = allok && lookups(&ihandle, nrecords[i], i);
+		allok = allok && (char*)ihandle.mmapaddr > (char*)container.mmapaddr && (char*)ihandle.mmapaddr + ihandle.mmaplen <= (char*)container.mmapaddr + container.mmaplen;
+		allok = allok && ((uintptr_t)ihandle.mmapaddr % sysconf(_SC_PAGESIZE)) == 0;
+		fastmap_inhandle_destroy(&ihandle);
+	}
+	ok(allok, "lookups in every map");
+
+	ok(fastmap_container_get(&container, "missing", &ihandle) == FASTMAP_NOT_FOUND, "missing map");
+
+	ok(fastmap_container_get(&container, "sessions", &ihandle) == FASTMAP_OK, "fastmap_container_get(\"sessions\")");
+	blob.key = "0000000000000001";
+	ok(fastmap_inhandle_get(&ihandle, (fastmap_record_t*)&blob) == FASTMAP_NOT_FOUND, "maps do not overlap");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(fastmap_container_destroy(&container) == FASTMAP_OK, "fastmap_container_destroy()");
+
+	allok = unlink(containername) == 0;
+	for (i = 0; i < NMAPS; i++)
+	{
+		allok = allok && unlink(pathnames[i]) == 0;
+		free((char*)pathnames[i]);
+	}
+	ok(allok, "unlink()");
+	free(containername);
+
+	done_testing();
+}
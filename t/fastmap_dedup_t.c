@@ -0,0 +1,148 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 50000
+#define NPAYLOADS 16
+
+static char payloads[NPAYLOADS][300];
+
+/* most records take one of a few payloads, every tenth a value of its own, and a few none */
+static size_t makevalue(size_t i, char *value)
+{
+	if (i % 1000 == 999)
+		return 0;
+	if (i % 10 == 0)
+		return (size_t)sprintf(value, "unique value of record %zu", i);
+	memcpy(value, payloads[(i * 7) % NPAYLOADS], strlen(payloads[(i * 7) % NPAYLOADS]));
+	return strlen(payloads[(i * 7) % NPAYLOADS]);
+}
+
+static size_t build(const char *pathname, size_t entries, size_t restartinterval, size_t inlinevsize, size_t blocksize, fastmap_dedupstats_t *stats)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	char key[9], value[300];
+	struct stat st;
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	fastmap_attr_setpagesize(&attr, 4096);
+	fastmap_attr_setvaluededup(&attr, entries);
+	fastmap_attr_setrestartinterval(&attr, restartinterval);
+	fastmap_attr_setinlinevsize(&attr, inlinevsize);
+	fastmap_attr_setvaluecompression(&attr, blocksize);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	record.blob.key = key;
+	record.blob.value = value;
+	for (i = 0; i < NRECORDS; i++)
+	{
+		snprintf(key, sizeof(key), "%08zu", i);
+		record.blob.vsize = makevalue(i, value);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK || stat(pathname, &st) == -1)
+		return 0;
+	fastmap_outhandle_getdedupstats(&ohandle, stats);
+	return (size_t)st.st_size;
+}
+
+static int verify(const char *pathname)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	char key[9], value[300];
+	size_t i, vsize;
+	int rc = 1;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+
+	record.blob.key = key;
+	for (i = 0; i < NRECORDS && rc; i++)
+	{
+		snprintf(key, sizeof(key), "%08zu", i);
+		vsize = makevalue(i, value);
+		if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_OK || record.blob.vsize != vsize || memcmp(record.blob.value, value, vsize) != 0)
+		{
+			diag("value %zu wrong", i);
+			rc = 0;
+		}
+	}
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_dedupstats_t stats;
+	size_t plain, deduped, entries, repeated = 0, i;
+	char *pathname = tempnam(NULL, "fmdd");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(17);
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_setvaluededup(&attr, FASTMAP_MAXDEDUPENTRIES + 1) == EINVAL, "fastmap_attr_setvaluededup(MAX + 1)");
+	ok(fastmap_attr_setvaluededup(&attr, 1000) == FASTMAP_OK && fastmap_attr_getvaluededup(&attr, &entries) == FASTMAP_OK && entries == 1000, "fastmap_attr_getvaluededup()");
+
+	fastmap_attr_setrecords(&attr, 1);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOCK);
+	fastmap_attr_setvsize(&attr, 8);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "blob format required");
+
+	for (i = 0; i < NPAYLOADS; i++)
+		snprintf(payloads[i], sizeof(payloads[i]), "{\"category\": %zu, \"defaults\": {\"retries\": 3, \"timeout\": %zu, \"region\": \"zone-%zu\", \"flags\": [\"a\", \"b\", \"c\"], "
+			"\"description\": \"a payload repeated across many records of the map, category %zu\"}}", i, i * 100, i % 4, i);
+	for (i = 0; i < NRECORDS; i++)
+		repeated += (i % 1000 != 999 && i % 10 != 0);
+
+	plain = build(pathname, 0, 0, 0, 0, &stats);
+	ok(plain > 0 && stats.values == 0 && stats.tableentries == 0, "no deduplication");
+
+	deduped = build(pathname, 1000, 0, 0, 0, &stats);
+	ok(deduped > 0 && verify(pathname), "deduplicated values, lookups");
+	ok(deduped * 4 < plain, "deduplicated values, less than a quarter of the size");
+	diag("%zu bytes, %zu bytes deduplicated", plain, deduped);
+	ok(stats.tableentries == 1024, "table rounded up to a power of two");
+	ok(stats.values == NRECORDS - NRECORDS / 1000, "every value looked up");
+	ok(stats.duplicates <= repeated - NPAYLOADS && stats.duplicates > (repeated - NPAYLOADS) * 9 / 10, "repeated values shared");
+	ok(stats.savedbytes > plain - deduped - (plain - deduped) / 10, "saved bytes counted");
+	diag("%zu values, %zu duplicates, %zu bytes saved, %zu evictions", stats.values, stats.duplicates, stats.savedbytes, stats.evictions);
+
+	ok(build(pathname, 1000, 0, 32, 0, &stats) > 0 && verify(pathname) && stats.duplicates > 0, "deduplicated values, inline small values");
+	ok(build(pathname, 1000, 16, 0, 0, &stats) > 0 && verify(pathname) && stats.duplicates > 0, "deduplicated values, front-coded");
+	ok(build(pathname, 1000, 0, 0, 4096, &stats) > 0 && verify(pathname) && stats.duplicates > 0, "deduplicated values, compressed");
+	ok(build(pathname, 1000, 16, 0, 1024, &stats) > 0 && verify(pathname) && stats.duplicates > 0, "deduplicated values, front-coded and compressed");
+
+	/* a table of one entry keeps only the last value, each other value displacing it */
+	ok(build(pathname, 1, 0, 0, 0, &stats) > 0 && verify(pathname), "single entry table, lookups");
+	ok(stats.evictions > 0 && stats.duplicates < repeated / 2, "single entry table, values displaced");
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,208 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 1000000
+
+static uint64_t keys[NRECORDS];
+
+/* ascending keys with pseudo-random gaps of 1 to 'maxgap' */
+static void makekeys(size_t n, uint64_t start, unsigned maxgap)
+{
+	uint64_t seed = 42;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		start += (i == 0) ? 0 : 1 + (seed >> 33) % maxgap;
+		keys[i] = start;
+	}
+}
+
+static size_t build(const char *pathname, fastmap_keytype_t type, fastmap_atomencoding_t encoding, size_t n)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	fastmap_keyfield_t field;
+	unsigned char key[8];
+	struct stat st;
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, n);
+	fastmap_attr_setkeyschema(&attr, &type, 1);
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+	fastmap_attr_setatomencoding(&attr, encoding);
+	fastmap_attr_setpagesize(&attr, 4096);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < n; i++)
+	{
+		if (type == FASTMAP_KEY_U32)
+			field.u32 = (uint32_t)keys[i];
+		else
+			field.u64 = keys[i];
+		fastmap_encodekey(&attr, &field, key);
+		record.atom.key = key;
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK || stat(pathname, &st) == -1)
+		return 0;
+	return (size_t)st.st_size;
+}
+
+static uint64_t getkey(const unsigned char *key, size_t ksize)
+{
+	uint64_t v = 0;
+	size_t i;
+
+	for (i = 0; i < ksize; i++)
+		v = (v << 8) | key[i];
+	return v;
+}
+
+static void putkey(unsigned char *key, size_t ksize, uint64_t v)
+{
+	while (ksize-- > 0)
+	{
+		key[ksize] = (unsigned char)(v & 0xFF);
+		v >>= 8;
+	}
+}
+
+/* check membership of every key and of the values between keys, and successors of both */
+static int verify(const char *pathname, size_t n, size_t ksize)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	unsigned char key[8], successor[8];
+	size_t i;
+	int rc = 1;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+
+	record.atom.key = key;
+	for (i = 0; i < n && rc; i++)
+	{
+		putkey(key, ksize, keys[i]);
+		if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_OK ||
+			fastmap_inhandle_successor(&ihandle, key, successor) != FASTMAP_OK || getkey(successor, ksize) != keys[i])
+		{
+			diag("key %zu not found", i);
+			rc = 0;
+		}
+
+		if (rc && i + 1 < n && keys[i + 1] > keys[i] + 1)
+		{
+			putkey(key, ksize, keys[i] + 1);
+			if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND ||
+				fastmap_inhandle_successor(&ihandle, key, successor) != FASTMAP_OK || getkey(successor, ksize) != keys[i + 1])
+			{
+				diag("value after key %zu wrong", i);
+				rc = 0;
+			}
+		}
+	}
+
+	if (rc && n > 0)
+	{
+		putkey(key, ksize, keys[n - 1] + 1);
+		rc = fastmap_inhandle_get(&ihandle, &record) == FASTMAP_NOT_FOUND && fastmap_inhandle_successor(&ihandle, key, successor) == FASTMAP_NOT_FOUND;
+		putkey(key, ksize, 0);
+		rc = rc && fastmap_inhandle_successor(&ihandle, key, successor) == FASTMAP_OK && getkey(successor, ksize) == keys[0];
+		if (keys[0] > 0)
+			rc = rc && fastmap_inhandle_get(&ihandle, &record) == FASTMAP_NOT_FOUND;
+	}
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	const fastmap_keytype_t u64 = FASTMAP_KEY_U64;
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	fastmap_atomencoding_t encoding;
+	unsigned char key[8];
+	size_t sorted, encoded;
+	char *pathname = tempnam(NULL, "fmef");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(17);
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_ELIASFANO) == FASTMAP_OK, "fastmap_attr_setatomencoding()");
+	ok(fastmap_attr_getatomencoding(&attr, &encoding) == FASTMAP_OK && encoding == FASTMAP_ATOM_ELIASFANO, "fastmap_attr_getatomencoding()");
+	ok(fastmap_attr_setatomencoding(&attr, (fastmap_atomencoding_t)-1) == EINVAL, "unknown encoding");
+
+	fastmap_attr_setrecords(&attr, 2);
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+	fastmap_attr_setksize(&attr, 8);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "integer keys required");
+	fastmap_attr_setkeyschema(&attr, &u64, 1);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "atom format required");
+
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	putkey(key, 8, 10);
+	record.atom.key = key;
+	fastmap_outhandle_put(&ohandle, &record);
+	putkey(key, 8, 9);
+	ok(fastmap_outhandle_put(&ohandle, &record) == EINVAL, "keys must ascend");
+	fastmap_outhandle_destroy(&ohandle);
+
+	makekeys(NRECORDS, 1000, 100);
+	sorted = build(pathname, FASTMAP_KEY_U64, FASTMAP_ATOM_SORTED, NRECORDS);
+	encoded = build(pathname, FASTMAP_KEY_U64, FASTMAP_ATOM_ELIASFANO, NRECORDS);
+	ok(encoded > 0, "u64 set, sparse");
+	ok(verify(pathname, NRECORDS, 8), "u64 set, sparse, lookups");
+	ok(encoded * 5 < sorted, "u64 set, sparse, a fifth of the size");
+	diag("%zu bytes sorted, %zu bytes encoded, %.2f bits per key", sorted, encoded, (double)encoded * 8 / NRECORDS);
+
+	ok(fastmap_inhandle_init(&ihandle, pathname) == FASTMAP_OK, "fastmap_inhandle_init()");
+	fastmap_inhandle_destroy(&ihandle);
+
+	makekeys(NRECORDS, (uint64_t)1 << 40, 1);
+	ok(build(pathname, FASTMAP_KEY_U64, FASTMAP_ATOM_ELIASFANO, NRECORDS) > 0 && verify(pathname, NRECORDS, 8), "u64 set, dense");
+
+	makekeys(NRECORDS, 0, 4000);
+	ok(build(pathname, FASTMAP_KEY_U32, FASTMAP_ATOM_ELIASFANO, NRECORDS) > 0 && verify(pathname, NRECORDS, 4), "u32 set, wide gaps");
+
+	makekeys(1000, 5, 3);
+	keys[500] = keys[499];
+	ok(build(pathname, FASTMAP_KEY_U64, FASTMAP_ATOM_ELIASFANO, 1000) > 0 && verify(pathname, 1000, 8), "repeated key");
+
+	makekeys(1, 77, 1);
+	ok(build(pathname, FASTMAP_KEY_U64, FASTMAP_ATOM_ELIASFANO, 1) > 0 && verify(pathname, 1, 8), "single key");
+
+	ok(build(pathname, FASTMAP_KEY_U64, FASTMAP_ATOM_ELIASFANO, 0) > 0 && verify(pathname, 0, 8), "empty set");
+
+	build(pathname, FASTMAP_KEY_U64, FASTMAP_ATOM_SORTED, 1);
+	fastmap_inhandle_init(&ihandle, pathname);
+	ok(fastmap_inhandle_successor(&ihandle, key, key) == EINVAL, "no successor queries on sorted atoms");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
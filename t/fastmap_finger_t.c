@@ -0,0 +1,127 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#include "layout.h"
+
+enum order { SORTED, NEARLYSORTED, SCATTERED, BACKWARDS };
+
+/* the lookup made 'i'th of 2 * NRECORDS, even lookups being of keys of the map and odd ones of keys in between */
+static size_t lookupat(enum order order, size_t i)
+{
+	switch (order)
+	{
+		case NEARLYSORTED:
+			/* swap neighbouring pairs of keys, with a step back every so often */
+			return (i % 997 == 0 && i >= 200) ? i - 200 : (i ^ 2);
+		case SCATTERED:
+			return (i * 7919) % (2 * NRECORDS);
+		case BACKWARDS:
+			return (2 * NRECORDS) - 1 - i;
+		default:
+			return i;
+	}
+}
+
+/* look every key, and every key in between, up through a finger, returning the descents from the root or SIZE_MAX on failure */
+static size_t lookups(const char *pathname, enum layout layout, const fastmap_attr_t *attr, enum order order, int flags)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_finger_t finger;
+	fastmap_record_t record;
+	unsigned char key[9];
+	char value[32];
+	size_t i, k, vsize, descents = SIZE_MAX;
+	int rc;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags) != FASTMAP_OK)
+		return SIZE_MAX;
+	if (fastmap_finger_init(&finger, &ihandle) != FASTMAP_OK)
+		goto done;
+
+	record.blob.key = key;
+	record.blob.ksize = 8;
+	for (i = 0; i < 2 * NRECORDS; i++)
+	{
+		k = lookupat(order, i);
+		makekey(layout, attr, k / 2, (int)(k % 2), key);
+		rc = fastmap_finger_get(&finger, &record);
+		if (k % 2 == 0)
+		{
+			vsize = makevalue(k / 2, value);
+			if (rc != FASTMAP_OK || record.blob.vsize != vsize || memcmp(record.blob.value, value, vsize) != 0)
+				break;
+		}
+		else if (rc != FASTMAP_NOT_FOUND)
+		{
+			break;
+		}
+	}
+
+	if (i == 2 * NRECORDS && finger.lookups == 2 * NRECORDS)
+		descents = finger.descents;
+	else
+		diag("lookup %zu failed", k);
+	diag("%zu lookups, %zu descents, %zu gallops", finger.lookups, finger.descents, finger.gallops);
+
+done:
+	fastmap_inhandle_destroy(&ihandle);
+	return descents;
+}
+
+/* lookups in every order find their keys, and sorted ones rarely search from the root */
+static int orders(const char *pathname, enum layout layout, const fastmap_attr_t *attr, int flags)
+{
+	size_t sorted = lookups(pathname, layout, attr, SORTED, flags);
+	size_t nearlysorted = lookups(pathname, layout, attr, NEARLYSORTED, flags);
+
+	return sorted < NRECORDS / 100 && nearlysorted < NRECORDS / 10 &&
+		lookups(pathname, layout, attr, SCATTERED, flags) != SIZE_MAX &&
+		lookups(pathname, layout, attr, BACKWARDS, flags) != SIZE_MAX;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_inhandle_t ihandle;
+	fastmap_finger_t finger;
+	fastmap_record_t record;
+	unsigned char key[9];
+	char *pathname = tempnam(NULL, "fmfg");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(11);
+
+	ok(build(pathname, PLAIN, &attr), "fastmap_outhandle_destroy()");
+	ok(orders(pathname, PLAIN, &attr, 0), "lookups through a finger");
+	ok(orders(pathname, PLAIN, &attr, FASTMAP_MAP_BUFFERPOOL), "lookups through a finger, FASTMAP_MAP_BUFFERPOOL");
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	ok(fastmap_finger_init(&finger, NULL) == EINVAL && fastmap_finger_init(NULL, &ihandle) == EINVAL, "fastmap_finger_init(NULL)");
+	fastmap_finger_init(&finger, &ihandle);
+	ok(fastmap_finger_get(&finger, NULL) == EINVAL, "fastmap_finger_get(NULL)");
+	record.blob.key = key;
+	makekey(PLAIN, &attr, NRECORDS - 1, 0, key);
+	fastmap_finger_get(&finger, &record);
+	memcpy(key, "99999999", 8);
+	ok(fastmap_finger_get(&finger, &record) == FASTMAP_NOT_FOUND && finger.descents == 1, "key after the last");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(build(pathname, FRONTCODED, &attr) && orders(pathname, FRONTCODED, &attr, 0), "front-coded, lookups through a finger");
+	ok(build(pathname, SEPARATORS, &attr) && orders(pathname, SEPARATORS, &attr, 0), "truncated separators, lookups through a finger");
+	ok(build(pathname, VARIABLEKEYS, &attr) && orders(pathname, VARIABLEKEYS, &attr, 0), "variable keys, lookups through a finger");
+	ok(build(pathname, INTEGERKEYS, &attr) && orders(pathname, INTEGERKEYS, &attr, 0), "integer keys, lookups through a finger");
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,198 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define KSIZE 48
+#define RESTARTINTERVAL 16
+
+static char vbuffer[8192];
+
+static void makekey(char *key, size_t i)
+{
+	char buffer[KSIZE + 16];
+
+	/* URL like keys, sharing long prefixes */
+	memset(key, '\0', KSIZE);
+	sprintf(buffer, "http://www.example.com/catalog/%04zu/item-%06zu", i / 1000, i * 2);
+	memcpy(key, buffer, strlen(buffer) < KSIZE ? strlen(buffer) : KSIZE);
+}
+
+static size_t makevalue(fastmap_format_t format, size_t vsize, size_t i)
+{
+	memset(vbuffer, 'a' + (int)(i % 26), sizeof(vbuffer));
+	sprintf(vbuffer, "%zu", i);
+	if (format == FASTMAP_BLOB)
+		return (i % 7) * (i % 5) * 3 + 1;
+	return vsize;
+}
+
+static size_t build(const char *pathname, fastmap_format_t format, size_t nrecords, size_t vsize, size_t inlinevsize, size_t restartinterval)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	char key[KSIZE];
+	struct stat st;
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, nrecords);
+	fastmap_attr_setksize(&attr, KSIZE);
+	fastmap_attr_setvsize(&attr, vsize);
+	fastmap_attr_setinlinevsize(&attr, inlinevsize);
+	fastmap_attr_setpagesize(&attr, 4096);
+	fastmap_attr_setformat(&attr, format);
+	fastmap_attr_setrestartinterval(&attr, restartinterval);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < nrecords; i++)
+	{
+		makekey(key, i);
+		record.blob.key = key;
+		record.blob.value = vbuffer;
+		record.blob.vsize = makevalue(format, vsize, i);
+		if (format == FASTMAP_PAIR)
+			record.pair.value = key;
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK || stat(pathname, &st) == -1)
+		return 0;
+
+	return (size_t)st.st_size;
+}
+
+static int verify(const char *pathname, fastmap_format_t format, size_t nrecords, size_t vsize)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	char key[KSIZE];
+	size_t i, size;
+	int rc = 1;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < nrecords && rc; i++)
+	{
+		makekey(key, i);
+		record.blob.key = key;
+		if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_OK)
+		{
+			diag("key %zu not found", i);
+			rc = 0;
+			break;
+		}
+
+		size = makevalue(format, vsize, i);
+		switch (format)
+		{
+		case FASTMAP_PAIR:
+			rc = memcmp(record.pair.value, key, KSIZE) == 0;
+			break;
+		case FASTMAP_BLOCK:
+			rc = memcmp(record.block.value, vbuffer, size) == 0;
+			break;
+		case FASTMAP_BLOB:
+			rc = record.blob.vsize == size && memcmp(record.blob.value, vbuffer, size) == 0;
+			break;
+		default:
+			break;
+		}
+		if (!rc)
+			diag("wrong value for key %zu", i);
+
+		/* odd numbered items fall between the stored keys */
+		key[KSIZE - 1] = '\xff';
+		record.blob.key = key;
+		if (rc && fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND)
+		{
+			diag("missing key after %zu found", i);
+			rc = 0;
+		}
+	}
+
+	memset(key, '\0', KSIZE);
+	record.blob.key = key;
+	if (rc && fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND)
+	{
+		diag("key before the first key found");
+		rc = 0;
+	}
+
+	memset(key, '\xff', KSIZE);
+	if (rc && fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND)
+	{
+		diag("key after the last key found");
+		rc = 0;
+	}
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+struct testcase
+{
+	const char *name;
+	fastmap_format_t format;
+	size_t nrecords;
+	size_t vsize;
+	size_t inlinevsize;
+};
+
+int main(void)
+{
+	const struct testcase cases[] = {
+		{ "atom", FASTMAP_ATOM, 50000, 0, 0 },
+		{ "pair", FASTMAP_PAIR, 20000, 0, 0 },
+		{ "block (inline)", FASTMAP_BLOCK, 20000, 8, 0 },
+		{ "block", FASTMAP_BLOCK, 2000, 8000, 0 },
+		{ "blob", FASTMAP_BLOB, 20000, 0, 0 },
+		{ "blob (inline)", FASTMAP_BLOB, 20000, 0, 32 },
+	};
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	size_t fixedsize, frontcodedsize, interval;
+	size_t i;
+	char *pathname = tempnam(NULL, "fmfcd");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(5 + 4 * (sizeof(cases) / sizeof(cases[0])));
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_setrestartinterval(&attr, RESTARTINTERVAL) == FASTMAP_OK, "fastmap_attr_setrestartinterval()");
+	ok(fastmap_attr_getrestartinterval(&attr, &interval) == FASTMAP_OK && interval == RESTARTINTERVAL, "fastmap_attr_getrestartinterval()");
+	fastmap_attr_setrecords(&attr, 1);
+	fastmap_attr_setksize(&attr, FASTMAP_MAXFRONTCODEDKSIZE + 1);
+	fastmap_attr_setpagesize(&attr, FASTMAP_MAXPAGESIZE);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "key too large to front-code");
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		fixedsize = build(pathname, cases[i].format, cases[i].nrecords, cases[i].vsize, cases[i].inlinevsize, 0);
+		ok(fixedsize > 0 && verify(pathname, cases[i].format, cases[i].nrecords, cases[i].vsize), "%s", cases[i].name);
+
+		frontcodedsize = build(pathname, cases[i].format, cases[i].nrecords, cases[i].vsize, cases[i].inlinevsize, RESTARTINTERVAL);
+		ok(frontcodedsize > 0, "%s, front-coded", cases[i].name);
+		ok(verify(pathname, cases[i].format, cases[i].nrecords, cases[i].vsize), "%s, front-coded lookups", cases[i].name);
+		ok(frontcodedsize < fixedsize, "%s, front-coded map is smaller", cases[i].name);
+		diag("%s: %zu bytes, %zu bytes front-coded", cases[i].name, fixedsize, frontcodedsize);
+	}
+
+	ok(build(pathname, FASTMAP_ATOM, 50000, 0, 0, 1) > 0 && verify(pathname, FASTMAP_ATOM, 50000, 0), "restart interval of 1");
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
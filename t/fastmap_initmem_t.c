@@ -0,0 +1,140 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 5000
+
+static int lookups(fastmap_inhandle_t *ihandle)
+{
+	fastmap_blob_t blob;
+	char key[17], value[17];
+	int i;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%016d", i);
+		sprintf(value, "%d", i);
+		blob.key = key;
+		if (fastmap_inhandle_get(ihandle, (fastmap_record_t*)&blob) != FASTMAP_OK || blob.vsize != strlen(value) || memcmp(blob.value, value, blob.vsize) != 0)
+		{
+			diag("lookup failed for key: '%s'", key);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int writebundle(const char *pathname, size_t offset, const char *map, size_t len)
+{
+	char pad[4096];
+	int fd;
+	int rc;
+
+	memset(pad, 0xA5, sizeof(pad));
+	fd = open(pathname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+	if (fd == -1)
+		return 0;
+	rc = write(fd, pad, offset) == (ssize_t)offset && write(fd, map, len) == (ssize_t)len && write(fd, pad, 100) == 100;
+	close(fd);
+	return rc;
+}
+
+int main(void)
+{
+	fastmap_blob_t blob;
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t ihandle;
+	struct stat st;
+	char key[17], value[17];
+	char *map;
+	size_t firstvalueoffset, corrupt;
+	int i, fd;
+	char *pathname = tempnam(NULL, "fmmem");
+	char *bundlename = tempnam(NULL, "fmbnd");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(21);
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 16);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%016d", i);
+		sprintf(value, "%d", i);
+		blob.key = key;
+		blob.value = value;
+		blob.vsize = strlen(value);
+		fastmap_outhandle_put(&ohandle, (fastmap_record_t*)&blob);
+	}
+	ok(fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK, "fastmap_outhandle_destroy()");
+
+	fd = open(pathname, O_RDONLY);
+	fstat(fd, &st);
+	map = malloc(st.st_size);
+	ok(read(fd, map, st.st_size) == st.st_size, "read()");
+	close(fd);
+
+	ok(fastmap_inhandle_initmem(&ihandle, map, st.st_size) == FASTMAP_OK, "fastmap_inhandle_initmem()");
+	ok((char*)ihandle.mmapaddr == map, "no copy");
+	ok(lookups(&ihandle), "lookups from memory");
+	ok(fastmap_inhandle_destroy(&ihandle) == FASTMAP_OK, "fastmap_inhandle_destroy()");
+
+	ok(fastmap_inhandle_initmem(&ihandle, map, st.st_size / 2) == EINVAL, "truncated buffer");
+	ok(fastmap_inhandle_initmem(&ihandle, map, 16) == EINVAL, "buffer shorter than header");
+	map[0] ^= 0xFF;
+	ok(fastmap_inhandle_initmem(&ihandle, map, st.st_size) == EINVAL, "bad magic");
+	map[0] ^= 0xFF;
+
+	/* value pages starting past the buffer, and value pointers that run past its end */
+	memcpy(&firstvalueoffset, map + offsetof(fastmap_handle_t, firstvalueoffset), sizeof(firstvalueoffset));
+	corrupt = st.st_size + 1;
+	memcpy(map + offsetof(fastmap_handle_t, firstvalueoffset), &corrupt, sizeof(corrupt));
+	ok(fastmap_inhandle_initmem(&ihandle, map, st.st_size) == EINVAL, "value pages past the buffer");
+	corrupt = st.st_size - 1;
+	memcpy(map + offsetof(fastmap_handle_t, firstvalueoffset), &corrupt, sizeof(corrupt));
+	sprintf(key, "%016d", NRECORDS - 1);
+	blob.key = key;
+	ok(fastmap_inhandle_initmem(&ihandle, map, st.st_size) == FASTMAP_OK &&
+		fastmap_inhandle_get(&ihandle, (fastmap_record_t*)&blob) == FASTMAP_CORRUPT_VALUE, "value past the buffer");
+	fastmap_inhandle_destroy(&ihandle);
+	memcpy(map + offsetof(fastmap_handle_t, firstvalueoffset), &firstvalueoffset, sizeof(firstvalueoffset));
+
+	ok(writebundle(bundlename, 100, map, st.st_size), "write unaligned bundle");
+	fd = open(bundlename, O_RDONLY);
+	ok(fastmap_inhandle_initfd(&ihandle, fd, 100, st.st_size, 0) == FASTMAP_OK, "fastmap_inhandle_initfd(unaligned)");
+	ok(lookups(&ihandle), "lookups from unaligned offset");
+	ok(fastmap_inhandle_destroy(&ihandle) == FASTMAP_OK && fcntl(fd, F_GETFD) != -1, "descriptor left open");
+	ok(fastmap_inhandle_initfd(&ihandle, fd, 100, st.st_size + 200, 0) == EINVAL, "range past end of file");
+	ok(fastmap_inhandle_initfd(&ihandle, fd, 0, st.st_size, 0) == EINVAL, "wrong offset");
+	close(fd);
+
+	ok(writebundle(bundlename, 4096, map, st.st_size), "write aligned bundle");
+	fd = open(bundlename, O_RDONLY);
+	ok(fastmap_inhandle_initfd(&ihandle, fd, 4096, st.st_size, FASTMAP_MAP_LOADRAM) == FASTMAP_OK, "fastmap_inhandle_initfd(aligned, FASTMAP_MAP_LOADRAM)");
+	close(fd);
+	ok(lookups(&ihandle), "lookups after closing descriptor");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0 && unlink(bundlename) == 0, "unlink()");
+	free(map);
+	free(pathname);
+	free(bundlename);
+
+	done_testing();
+}
@@ -0,0 +1,195 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 100000
+
+enum distribution
+{
+	UNIFORM,
+	SQUARES,
+	SIGNED
+};
+
+static fastmap_keyfield_t keyof(enum distribution distribution, size_t i)
+{
+	fastmap_keyfield_t field;
+
+	switch (distribution)
+	{
+	case UNIFORM:
+		field.u64 = (uint64_t)i * 7 + 3;
+		break;
+	case SQUARES:
+		field.u64 = (uint64_t)i * i * i + i;
+		break;
+	default:
+		field.i64 = ((int64_t)i - NRECORDS / 2) * 1000;
+		break;
+	}
+	return field;
+}
+
+static int bytecmp(const fastmap_attr_t *attr, const void *a, const void *b)
+{
+	size_t ksize;
+
+	fastmap_attr_getksize((fastmap_attr_t*)attr, &ksize);
+	return memcmp(a, b, ksize);
+}
+
+static void setrecord(fastmap_record_t *record, fastmap_format_t format, void *key, char *value)
+{
+	record->blob.key = key;
+	if (format == FASTMAP_BLOB)
+	{
+		record->blob.value = value;
+		record->blob.vsize = value ? strlen(value) : 0;
+	}
+	else if (format == FASTMAP_BLOCK)
+	{
+		record->block.value = value;
+	}
+}
+
+static int build(const char *pathname, fastmap_format_t format, fastmap_keytype_t type, enum distribution distribution)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	fastmap_keyfield_t field;
+	unsigned char key[8];
+	char value[16];
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setkeyschema(&attr, &type, 1);
+	fastmap_attr_setvsize(&attr, sizeof(value));
+	fastmap_attr_setpagesize(&attr, 512);
+	fastmap_attr_setformat(&attr, format);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		field = keyof(distribution, i);
+		if (type == FASTMAP_KEY_U32)
+			field.u32 = (uint32_t)field.u64;
+		fastmap_encodekey(&attr, &field, key);
+		memset(value, 0, sizeof(value));
+		sprintf(value, "%zu", i);
+		setrecord(&record, format, key, value);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	return fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK;
+}
+
+/* look up every key and the key after it, which is never in the map */
+static int verify(fastmap_inhandle_t *ihandle, fastmap_format_t format, enum distribution distribution)
+{
+	fastmap_attr_t attr;
+	fastmap_record_t record;
+	fastmap_keyfield_t field;
+	fastmap_keytype_t type;
+	unsigned char key[8];
+	char value[16];
+	size_t i, nfields;
+
+	fastmap_inhandle_getattr(ihandle, &attr);
+	fastmap_attr_getkeyschema(&attr, &type, &nfields);
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		field = keyof(distribution, i);
+		if (type == FASTMAP_KEY_U32)
+			field.u32 = (uint32_t)field.u64;
+		fastmap_encodekey(&attr, &field, key);
+		setrecord(&record, format, key, NULL);
+		if (fastmap_inhandle_get(ihandle, &record) != FASTMAP_OK)
+		{
+			diag("record %zu not found", i);
+			return 0;
+		}
+
+		sprintf(value, "%zu", i);
+		if ((format == FASTMAP_BLOB && (record.blob.vsize != strlen(value) || memcmp(record.blob.value, value, record.blob.vsize) != 0)) ||
+			(format == FASTMAP_BLOCK && strcmp(record.block.value, value) != 0))
+		{
+			diag("record %zu has the wrong value", i);
+			return 0;
+		}
+
+		if (type == FASTMAP_KEY_U32)
+			field.u32++;
+		else
+			field.u64++;
+		fastmap_encodekey(&attr, &field, key);
+		setrecord(&record, format, key, NULL);
+		if (fastmap_inhandle_get(ihandle, &record) != FASTMAP_NOT_FOUND)
+		{
+			diag("key after record %zu found", i);
+			return 0;
+		}
+	}
+
+	memset(key, 0, sizeof(key));
+	setrecord(&record, format, key, NULL);
+	if (distribution != SQUARES && fastmap_inhandle_get(ihandle, &record) != FASTMAP_NOT_FOUND)
+		return 0;
+	memset(key, 0xFF, sizeof(key));
+	return fastmap_inhandle_get(ihandle, &record) == FASTMAP_NOT_FOUND;
+}
+
+struct testcase
+{
+	const char *name;
+	fastmap_format_t format;
+	fastmap_keytype_t type;
+	enum distribution distribution;
+};
+
+int main(void)
+{
+	const struct testcase cases[] = {
+		{ "u64 atom, uniform keys", FASTMAP_ATOM, FASTMAP_KEY_U64, UNIFORM },
+		{ "u64 atom, skewed keys", FASTMAP_ATOM, FASTMAP_KEY_U64, SQUARES },
+		{ "u32 blob", FASTMAP_BLOB, FASTMAP_KEY_U32, UNIFORM },
+		{ "i64 block", FASTMAP_BLOCK, FASTMAP_KEY_I64, SIGNED },
+	};
+	fastmap_inhandle_t ihandle;
+	size_t i;
+	char *pathname = tempnam(NULL, "fmint");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(1 + 4 * (sizeof(cases) / sizeof(cases[0])));
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		ok(build(pathname, cases[i].format, cases[i].type, cases[i].distribution), "%s", cases[i].name);
+		fastmap_inhandle_init(&ihandle, pathname);
+		/* 0x40 flags a map of integer keys */
+		ok(ihandle.handle.flags & 0x40, "%s, integer keys", cases[i].name);
+		ok(verify(&ihandle, cases[i].format, cases[i].distribution), "%s, lookups", cases[i].name);
+
+		/* a comparison function of its own takes a lookup off of the integer path */
+		fastmap_inhandle_setcmpfunc(&ihandle, bytecmp);
+		ok(verify(&ihandle, cases[i].format, cases[i].distribution), "%s, lookups by comparison function", cases[i].name);
+		fastmap_inhandle_destroy(&ihandle);
+	}
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,175 @@
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 20000
+
+static int sign(int v)
+{
+	return (v > 0) - (v < 0);
+}
+
+/* check that encoded keys sort byte-wise in the order of 'values', which must be ascending */
+static int ordered(fastmap_keytype_t type, const fastmap_keyfield_t *values, size_t n)
+{
+	fastmap_attr_t attr;
+	fastmap_keyfield_t decoded;
+	unsigned char a[8], b[8];
+	size_t i, j, ksize;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setkeyschema(&attr, &type, 1);
+	fastmap_attr_getksize(&attr, &ksize);
+
+	for (i = 0; i < n; i++)
+	{
+		fastmap_encodekey(&attr, &values[i], a);
+		fastmap_decodekey(&attr, a, &decoded);
+		if (memcmp(&decoded, &values[i], ksize) != 0)
+		{
+			diag("value %zu does not decode", i);
+			return 0;
+		}
+
+		for (j = 0; j < n; j++)
+		{
+			fastmap_encodekey(&attr, &values[j], b);
+			if (sign(memcmp(a, b, ksize)) != sign((int)i - (int)j))
+			{
+				diag("values %zu and %zu are out of order", i, j);
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+static void makefields(fastmap_keyfield_t *fields, size_t i)
+{
+	/* a negative major field, and a minor float field which changes sign */
+	fields[0].i64 = (int64_t)(i / 100) - 100;
+	fields[1].f64 = ((double)(i % 100) - 50.0) / 4.0;
+}
+
+int main(void)
+{
+	const fastmap_keytype_t schema[] = { FASTMAP_KEY_I64, FASTMAP_KEY_F64 };
+	fastmap_keyfield_t u32s[] = { { .u32 = 0 }, { .u32 = 1 }, { .u32 = 255 }, { .u32 = 256 }, { .u32 = UINT32_MAX } };
+	fastmap_keyfield_t i64s[] = { { .i64 = INT64_MIN }, { .i64 = -65536 }, { .i64 = -1 }, { .i64 = 0 }, { .i64 = 1 }, { .i64 = 255 }, { .i64 = INT64_MAX } };
+	fastmap_keyfield_t f64s[] = { { .f64 = -INFINITY }, { .f64 = -1e300 }, { .f64 = -1.5 }, { .f64 = -1e-300 }, { .f64 = 0.0 }, { .f64 = 1e-300 }, { .f64 = 2.0 }, { .f64 = INFINITY } };
+	fastmap_keyfield_t fields[FASTMAP_MAXKEYFIELDS];
+	fastmap_keytype_t types[FASTMAP_MAXKEYFIELDS + 1];
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	unsigned char key[16], zero[16], nan[8], value[32];
+	size_t i, nfields, ksize;
+	int rc;
+	char *pathname = tempnam(NULL, "fmksc");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(20);
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_setkeyschema(&attr, schema, 2) == FASTMAP_OK, "fastmap_attr_setkeyschema()");
+	fastmap_attr_getksize(&attr, &ksize);
+	cmp_ok(ksize, "==", 16, "key size follows the schema");
+	ok(fastmap_attr_getkeyschema(&attr, types, &nfields) == FASTMAP_OK && nfields == 2 && types[0] == FASTMAP_KEY_I64 && types[1] == FASTMAP_KEY_F64, "fastmap_attr_getkeyschema()");
+
+	for (i = 0; i < FASTMAP_MAXKEYFIELDS + 1; i++)
+		types[i] = FASTMAP_KEY_U32;
+	ok(fastmap_attr_setkeyschema(&attr, types, FASTMAP_MAXKEYFIELDS + 1) == EINVAL, "too many fields");
+	types[0] = (fastmap_keytype_t)0;
+	ok(fastmap_attr_setkeyschema(&attr, types, 1) == EINVAL, "unknown field type");
+
+	ok(ordered(FASTMAP_KEY_U32, u32s, sizeof(u32s) / sizeof(u32s[0])), "u32 keys sort in numeric order");
+	ok(ordered(FASTMAP_KEY_I64, i64s, sizeof(i64s) / sizeof(i64s[0])), "i64 keys sort in numeric order");
+	ok(ordered(FASTMAP_KEY_F64, f64s, sizeof(f64s) / sizeof(f64s[0])), "f64 keys sort in numeric order");
+
+	fastmap_attr_setkeyschema(&attr, &schema[1], 1);
+	fields[0].f64 = -0.0;
+	fastmap_encodekey(&attr, fields, zero);
+	fields[0].f64 = 0.0;
+	fastmap_encodekey(&attr, fields, key);
+	ok(memcmp(zero, key, 8) == 0, "-0.0 encodes as 0.0");
+	fields[0].f64 = NAN;
+	fastmap_encodekey(&attr, fields, nan);
+	fields[0].f64 = INFINITY;
+	fastmap_encodekey(&attr, fields, key);
+	ok(memcmp(nan, key, 8) > 0, "NaN sorts after infinity");
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_encodekey(&attr, fields, key) == EINVAL, "fastmap_encodekey() without a schema");
+
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	fastmap_attr_setkeyschema(&attr, schema, 2);
+	fastmap_attr_setksize(&attr, 8);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "key size must match the schema");
+	fastmap_attr_setkeyschema(&attr, schema, 2);
+	fastmap_attr_setvariablekeys(&attr, 1);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "no schema with variable length keys");
+	fastmap_attr_setvariablekeys(&attr, 0);
+
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == FASTMAP_OK, "fastmap_outhandle_init()");
+	rc = FASTMAP_OK;
+	for (i = 0; i < NRECORDS && rc == FASTMAP_OK; i++)
+	{
+		makefields(fields, i);
+		fastmap_encodekey(&attr, fields, key);
+		sprintf((char*)value, "%lld/%g", (long long)fields[0].i64, fields[1].f64);
+		record.blob.key = key;
+		record.blob.value = value;
+		record.blob.vsize = strlen((char*)value);
+		rc = fastmap_outhandle_put(&ohandle, &record);
+	}
+	ok(rc == FASTMAP_OK && fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK, "typed keys put in numeric order");
+
+	ok(fastmap_inhandle_init(&ihandle, pathname) == FASTMAP_OK, "fastmap_inhandle_init()");
+	fastmap_attr_init(&attr);
+	fastmap_inhandle_getattr(&ihandle, &attr);
+	ok(fastmap_attr_getkeyschema(&attr, types, &nfields) == FASTMAP_OK && nfields == 2, "schema read back from the map");
+
+	rc = FASTMAP_OK;
+	for (i = 0; i < NRECORDS && rc == FASTMAP_OK; i++)
+	{
+		makefields(fields, i);
+		fastmap_encodekey(&attr, fields, key);
+		record.blob.key = key;
+		rc = fastmap_inhandle_get(&ihandle, &record);
+		sprintf((char*)value, "%lld/%g", (long long)fields[0].i64, fields[1].f64);
+		if (rc == FASTMAP_OK && (record.blob.vsize != strlen((char*)value) || memcmp(record.blob.value, value, record.blob.vsize) != 0))
+			rc = FASTMAP_NOT_FOUND;
+		if (rc == FASTMAP_OK)
+		{
+			fastmap_decodekey(&attr, key, fields);
+			fields[1].f64 += 0.125;
+			fastmap_encodekey(&attr, fields, key);
+			if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND)
+				rc = EINVAL;
+		}
+	}
+	ok(rc == FASTMAP_OK, "typed keys found with the default comparison");
+
+	fields[0].i64 = -100;
+	fields[1].f64 = -0.0;
+	fastmap_encodekey(&attr, fields, key);
+	record.blob.key = key;
+	ok(fastmap_inhandle_get(&ihandle, &record) == FASTMAP_OK && record.blob.vsize == 6 && memcmp(record.blob.value, "-100/0", 6) == 0, "-0.0 finds 0.0");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 20000
+
+static int build(const char *pathname)
+{
+	fastmap_blob_t blob;
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	char key[17], value[17];
+	int i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 16);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%016d", i);
+		sprintf(value, "%d", i);
+		blob.key = key;
+		blob.value = value;
+		blob.vsize = strlen(value);
+		fastmap_outhandle_put(&ohandle, (fastmap_record_t*)&blob);
+	}
+	return fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK;
+}
+
+static int lookupall(fastmap_inhandle_t *ihandle)
+{
+	fastmap_blob_t blob;
+	char key[17], value[17];
+	int i;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%016d", i);
+		sprintf(value, "%d", i);
+		blob.key = key;
+		if (fastmap_inhandle_get(ihandle, (fastmap_record_t*)&blob) != FASTMAP_OK || blob.vsize != strlen(value) || memcmp(blob.value, value, blob.vsize) != 0)
+		{
+			diag("lookup failed for key: '%s'", key);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int lookups(const char *pathname, int flags)
+{
+	fastmap_inhandle_t ihandle;
+	int rc;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags) != FASTMAP_OK)
+		return 0;
+
+	rc = lookupall(&ihandle);
+	return fastmap_inhandle_destroy(&ihandle) == FASTMAP_OK && rc;
+}
+
+/* whether every page of the map between two offsets is resident */
+static int resident(const fastmap_inhandle_t *ihandle, size_t start, size_t end)
+{
+	size_t systempagesize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t i, pages = (end - start + systempagesize - 1) / systempagesize;
+	unsigned char *vec;
+	int rc = 1;
+
+	if ((vec = malloc(pages)) == NULL || mincore((char*)ihandle->mmapaddr + start, end - start, vec) == -1)
+		rc = 0;
+	for (i = 0; rc && i < pages; i++)
+		rc = vec[i] & 1;
+
+	free(vec);
+	return rc;
+}
+
+/* the memory locked by the process in kB, or -1 where it cannot be read */
+static long lockedkb(void)
+{
+	char line[256];
+	long kb = -1;
+	FILE *status = fopen("/proc/self/status", "r");
+
+	if (status == NULL)
+		return -1;
+	while (fgets(line, sizeof(line), status) != NULL)
+	{
+		if (sscanf(line, "VmLck: %ld kB", &kb) == 1)
+			break;
+	}
+	fclose(status);
+	return kb;
+}
+
+/* open the map with 'flags' and check the effect the policy has on its mapping */
+static int policy(const char *pathname, int flags)
+{
+	fastmap_inhandle_t ihandle;
+	long kb;
+	int rc = 1;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags) != FASTMAP_OK)
+		return 0;
+
+	if (ihandle.mapflags != flags)
+	{
+		diag("flags 0x%x reported as 0x%x", flags, ihandle.mapflags);
+		rc = 0;
+	}
+	if ((flags & (FASTMAP_MAP_POPULATE | FASTMAP_MAP_LOADRAM)) && !resident(&ihandle, 0, ihandle.mmaplen))
+	{
+		diag("map not resident");
+		rc = 0;
+	}
+	if ((flags & FASTMAP_MAP_LOADRAM) && ((uintptr_t)ihandle.mmapaddr % FASTMAP_HUGEPAGESIZE) != 0)
+	{
+		diag("map not loaded at a huge page boundary");
+		rc = 0;
+	}
+	if (flags & FASTMAP_MAP_LOCKSEARCH)
+	{
+		kb = lockedkb();
+		if (!resident(&ihandle, 0, ihandle.handle.firstleafpageoffset) || kb == 0)
+		{
+			diag("search levels not locked, %ld kB locked", kb);
+			rc = 0;
+		}
+	}
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	fastmap_inhandle_t ihandle;
+	char *pathname = tempnam(NULL, "fmmpl");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(16);
+
+	ok(build(pathname), "fastmap_outhandle_destroy()");
+
+	ok(lookups(pathname, 0), "no policy");
+	ok(lookups(pathname, FASTMAP_MAP_POPULATE), "FASTMAP_MAP_POPULATE");
+	ok(policy(pathname, FASTMAP_MAP_POPULATE), "FASTMAP_MAP_POPULATE, map resident");
+	ok(lookups(pathname, FASTMAP_MAP_LOCKSEARCH), "FASTMAP_MAP_LOCKSEARCH");
+	ok(policy(pathname, FASTMAP_MAP_LOCKSEARCH), "FASTMAP_MAP_LOCKSEARCH, search levels locked");
+	ok(lookups(pathname, FASTMAP_MAP_HUGEPAGE), "FASTMAP_MAP_HUGEPAGE");
+	ok(lookups(pathname, FASTMAP_MAP_LOADRAM), "FASTMAP_MAP_LOADRAM");
+	ok(policy(pathname, FASTMAP_MAP_LOADRAM), "FASTMAP_MAP_LOADRAM, map resident and huge page aligned");
+
+	/* a map loaded into memory no longer reads the file */
+	fastmap_inhandle_initflags(&ihandle, pathname, FASTMAP_MAP_LOADRAM);
+	ok(truncate(pathname, 0) == 0 && lookupall(&ihandle), "FASTMAP_MAP_LOADRAM, lookups after the file is truncated");
+	fastmap_inhandle_destroy(&ihandle);
+	ok(build(pathname), "fastmap_outhandle_destroy(), again");
+	ok(lookups(pathname, FASTMAP_ADVISE_SEARCH_WILLNEED | FASTMAP_ADVISE_LEAF_RANDOM | FASTMAP_ADVISE_VALUE_RANDOM), "random advice");
+	ok(policy(pathname, FASTMAP_ADVISE_SEARCH_WILLNEED | FASTMAP_ADVISE_LEAF_RANDOM | FASTMAP_ADVISE_VALUE_RANDOM), "random advice, flags kept");
+	ok(lookups(pathname, FASTMAP_ADVISE_SEARCH_WILLNEED | FASTMAP_ADVISE_LEAF_WILLNEED | FASTMAP_ADVISE_VALUE_WILLNEED), "willneed advice");
+	ok(lookups(pathname, FASTMAP_MAP_LOADRAM | FASTMAP_MAP_LOCKSEARCH | FASTMAP_ADVISE_LEAF_RANDOM), "FASTMAP_MAP_LOADRAM, locked, random advice");
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,137 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 100000
+#define NLOOKUPS (2 * NRECORDS)
+
+static fastmap_record_t records[NLOOKUPS];
+static fastmap_record_t *batch[NLOOKUPS];
+static char keys[NLOOKUPS][9];
+
+static size_t makevalue(size_t i, char *value)
+{
+	return (size_t)sprintf(value, "value of record %zu", i);
+}
+
+/* build a blob map of every other key, with variable length keys or compressed values if set */
+static int build(const char *pathname, int variablekeys, size_t blocksize)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	char key[9], value[32];
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	fastmap_attr_setpagesize(&attr, 4096);
+	fastmap_attr_setvariablekeys(&attr, variablekeys);
+	fastmap_attr_setvaluecompression(&attr, blocksize);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	record.blob.key = key;
+	record.blob.ksize = 8;
+	record.blob.value = value;
+	for (i = 0; i < NRECORDS; i++)
+	{
+		snprintf(key, sizeof(key), "%08zu", i * 2);
+		record.blob.vsize = makevalue(i, value);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	return fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK;
+}
+
+/* look up every key and every key in between in one batch, sorted unless 'stride' is set,
+ * and check that the keys of the map are found in place and the others are left NULL */
+static int lookups(fastmap_inhandle_t *ihandle, size_t stride)
+{
+	char value[32];
+	size_t i, k, vsize;
+
+	for (i = 0; i < NLOOKUPS; i++)
+	{
+		k = stride ? (i * stride) % NLOOKUPS : i;
+		snprintf(keys[i], sizeof(keys[i]), "%08zu", k);
+		records[i].blob.key = keys[i];
+		records[i].blob.ksize = 8;
+		batch[i] = &records[i];
+	}
+	batch[7] = NULL;
+
+	if (fastmap_inhandle_mget(ihandle, batch, NLOOKUPS) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NLOOKUPS; i++)
+	{
+		k = stride ? (i * stride) % NLOOKUPS : i;
+		if (i == 7 || k % 2 == 1)
+		{
+			if (batch[i] != NULL)
+				break;
+			continue;
+		}
+		vsize = makevalue(k / 2, value);
+		if (batch[i] != &records[i] || records[i].blob.vsize != vsize || memcmp(records[i].blob.value, value, vsize) != 0)
+			break;
+	}
+	if (i < NLOOKUPS)
+		diag("lookup %zu of key '%s' failed", i, keys[i]);
+
+	return i == NLOOKUPS;
+}
+
+int main(void)
+{
+	fastmap_inhandle_t ihandle;
+	char *pathname = tempnam(NULL, "fmmg");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(13);
+
+	ok(build(pathname, 0, 0), "fastmap_outhandle_destroy()");
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	ok(fastmap_inhandle_setthreads(&ihandle, 0) == EINVAL && fastmap_inhandle_setthreads(NULL, 4) == EINVAL, "fastmap_inhandle_setthreads(0)");
+	ok(fastmap_inhandle_mget(&ihandle, NULL, 1) == EINVAL, "fastmap_inhandle_mget(NULL)");
+	ok(fastmap_inhandle_mget(&ihandle, batch, 0) == FASTMAP_OK, "empty batch");
+	ok(lookups(&ihandle, 0), "sorted batch, 1 thread");
+	ok(lookups(&ihandle, 7919), "scattered batch, 1 thread");
+	ok(fastmap_inhandle_setthreads(&ihandle, 4) == FASTMAP_OK, "fastmap_inhandle_setthreads(4)");
+	ok(lookups(&ihandle, 0), "sorted batch, 4 threads");
+	ok(lookups(&ihandle, 7919), "scattered batch, 4 threads");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(build(pathname, 1, 0) && fastmap_inhandle_init(&ihandle, pathname) == FASTMAP_OK && fastmap_inhandle_setthreads(&ihandle, 3) == FASTMAP_OK &&
+		lookups(&ihandle, 0) && lookups(&ihandle, 7919), "variable keys, 3 threads");
+	fastmap_inhandle_destroy(&ihandle);
+
+	/* these are looked up on the calling thread, into a cache and a pool large enough to keep every value of the batch */
+	ok(build(pathname, 0, 0) && fastmap_inhandle_initflags(&ihandle, pathname, FASTMAP_MAP_BUFFERPOOL) == FASTMAP_OK &&
+		fastmap_inhandle_setpoolframes(&ihandle, 4096) == FASTMAP_OK && fastmap_inhandle_setthreads(&ihandle, 4) == FASTMAP_OK &&
+		lookups(&ihandle, 7919), "buffer pool, 4 threads");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(build(pathname, 0, 4096) && fastmap_inhandle_init(&ihandle, pathname) == FASTMAP_OK && fastmap_inhandle_setcacheblocks(&ihandle, 4096) == FASTMAP_OK &&
+		fastmap_inhandle_setthreads(&ihandle, 4) == FASTMAP_OK && lookups(&ihandle, 0), "compressed values, 4 threads");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
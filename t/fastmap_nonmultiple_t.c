@@ -0,0 +1,118 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 100000
+
+static int roundtrip(fastmap_attr_t *attr, const char *pathname, int *inlined)
+{
+	fastmap_record_t record;
+	fastmap_inhandle_t ihandle;
+	fastmap_outhandle_t ohandle;
+	fastmap_format_t format;
+	size_t ksize, vsize;
+	char key[64], value[64];
+	int i;
+
+	fastmap_attr_getformat(attr, &format);
+	fastmap_attr_getksize(attr, &ksize);
+	fastmap_attr_getvsize(attr, &vsize);
+
+	if (format == FASTMAP_ATOM)
+		vsize = 0;
+	else if (format == FASTMAP_PAIR)
+		vsize = ksize;
+
+	if (fastmap_outhandle_init(&ohandle, attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	*inlined = (ohandle.handle.flags & 0x02) != 0;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%0*d", (int)ksize, i);
+		sprintf(value, "%0*d", (int)vsize, NRECORDS - i);
+		record.blob.key = key;
+		record.blob.value = value;
+		record.blob.vsize = vsize;
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK)
+		return 0;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%0*d", (int)ksize, i);
+		sprintf(value, "%0*d", (int)vsize, NRECORDS - i);
+		record.blob.key = key;
+		if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_OK || (vsize > 0 && memcmp(record.blob.value, value, vsize) != 0))
+		{
+			diag("lookup failed for key: '%s'", key);
+			return 0;
+		}
+	}
+
+	sprintf(key, "%0*d", (int)ksize, NRECORDS);
+	record.blob.key = key;
+	if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND)
+		return 0;
+
+	return fastmap_inhandle_destroy(&ihandle) == FASTMAP_OK;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	int inlined;
+	char *pathname = tempnam(NULL, "fmnmt");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(9);
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+
+	fastmap_attr_setksize(&attr, 0);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "fastmap_outhandle_init(ksize = 0)");
+
+	fastmap_attr_setksize(&attr, 24);
+	ok(roundtrip(&attr, pathname, &inlined), "atom, 24 byte keys");
+
+	fastmap_attr_setksize(&attr, 13);
+	fastmap_attr_setformat(&attr, FASTMAP_PAIR);
+	ok(roundtrip(&attr, pathname, &inlined), "pair, 13 byte keys");
+
+	fastmap_attr_setksize(&attr, 12);
+	fastmap_attr_setvsize(&attr, 20);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOCK);
+	ok(roundtrip(&attr, pathname, &inlined), "block, 12 byte keys, 20 byte values");
+	ok(inlined, "INLINE_BLOCK");
+
+	fastmap_attr_setksize(&attr, 24);
+	fastmap_attr_setvsize(&attr, 7);
+	ok(roundtrip(&attr, pathname, &inlined), "block, 24 byte keys, 7 byte values");
+	ok(inlined, "INLINE_BLOCK");
+
+	fastmap_attr_setksize(&attr, 40);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+	ok(roundtrip(&attr, pathname, &inlined), "blob, 40 byte keys");
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,110 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 50000
+
+static int roundtrip(fastmap_attr_t *attr, const char *pathname, int aligned)
+{
+	fastmap_blob_t blob;
+	fastmap_inhandle_t ihandle;
+	fastmap_outhandle_t ohandle;
+	char key[17], value[17];
+	int i;
+
+	if (fastmap_outhandle_init(&ohandle, attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%016d", i);
+		sprintf(value, "%d", i);
+		blob.key = key;
+		blob.value = value;
+		blob.vsize = strlen(value);
+		if (fastmap_outhandle_put(&ohandle, (fastmap_record_t*)&blob) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK)
+		return 0;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+
+	if (aligned)
+	{
+		if (ihandle.handle.firstleafpageoffset % FASTMAP_HUGEPAGESIZE != 0 || ihandle.handle.firstvalueoffset % FASTMAP_HUGEPAGESIZE != 0)
+		{
+			diag("sections are not aligned");
+			return 0;
+		}
+
+		if ((uintptr_t)ihandle.mmapaddr % FASTMAP_HUGEPAGESIZE != 0)
+		{
+			diag("mapping is not aligned");
+			return 0;
+		}
+	}
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%016d", i);
+		sprintf(value, "%d", i);
+		blob.key = key;
+		if (fastmap_inhandle_get(&ihandle, (fastmap_record_t*)&blob) != FASTMAP_OK || blob.vsize != strlen(value) || memcmp(blob.value, value, blob.vsize) != 0)
+		{
+			diag("lookup failed for key: '%s'", key);
+			return 0;
+		}
+	}
+
+	return fastmap_inhandle_destroy(&ihandle) == FASTMAP_OK;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	size_t x;
+	char *pathname = tempnam(NULL, "fmpgs");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(13);
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 16);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+
+	ok(fastmap_attr_setpagesize(&attr, 256) == EINVAL, "fastmap_attr_setpagesize(256)");
+	ok(fastmap_attr_setpagesize(&attr, 3000) == EINVAL, "fastmap_attr_setpagesize(3000)");
+	ok(fastmap_attr_setpagesize(&attr, 4 * 1024 * 1024) == EINVAL, "fastmap_attr_setpagesize(4M)");
+	ok(fastmap_attr_setsectionalign(&attr, 3000) == EINVAL, "fastmap_attr_setsectionalign(3000)");
+
+	ok(fastmap_attr_setpagesize(&attr, 512) == FASTMAP_OK, "fastmap_attr_setpagesize(512)");
+	ok(fastmap_attr_getpagesize(&attr, &x) == FASTMAP_OK && x == 512, "fastmap_attr_getpagesize()");
+	ok(roundtrip(&attr, pathname, 0), "512 byte pages");
+
+	fastmap_attr_setpagesize(&attr, 65536);
+	ok(roundtrip(&attr, pathname, 0), "64K pages");
+
+	fastmap_attr_setpagesize(&attr, FASTMAP_MAXPAGESIZE);
+	ok(roundtrip(&attr, pathname, 0), "2M pages");
+
+	fastmap_attr_setpagesize(&attr, 4096);
+	ok(fastmap_attr_setsectionalign(&attr, FASTMAP_HUGEPAGESIZE) == FASTMAP_OK, "fastmap_attr_setsectionalign(2M)");
+	ok(fastmap_attr_getsectionalign(&attr, &x) == FASTMAP_OK && x == FASTMAP_HUGEPAGESIZE, "fastmap_attr_getsectionalign()");
+	ok(roundtrip(&attr, pathname, 1), "4K pages, 2M aligned sections");
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,104 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#include "layout.h"
+
+#define DEPTH 8
+
+/* look up every key, and every key in between, prefetching DEPTH lookups ahead */
+static int pipelined(const char *pathname, enum layout layout, const fastmap_attr_t *attr, int flags)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t records[DEPTH];
+	fastmap_prefetch_t tokens[DEPTH];
+	unsigned char keys[DEPTH][9];
+	char value[32];
+	size_t i, k, vsize;
+	int rc = 1;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < 2 * NRECORDS + DEPTH && rc; i++)
+	{
+		if (i >= DEPTH)
+		{
+			k = i - DEPTH;
+			if (k % 2 == 0)
+			{
+				vsize = makevalue(k / 2, value);
+				if (fastmap_inhandle_getprefetched(&ihandle, &records[k % DEPTH], &tokens[k % DEPTH]) != FASTMAP_OK ||
+					records[k % DEPTH].blob.vsize != vsize || memcmp(records[k % DEPTH].blob.value, value, vsize) != 0)
+					rc = 0;
+			}
+			else if (fastmap_inhandle_getprefetched(&ihandle, &records[k % DEPTH], &tokens[k % DEPTH]) != FASTMAP_NOT_FOUND)
+			{
+				rc = 0;
+			}
+			if (!rc)
+				diag("lookup %zu failed", k);
+		}
+
+		/* odd lookups are of keys between those of the map */
+		if (i < 2 * NRECORDS)
+		{
+			makekey(layout, attr, i / 2, (int)(i % 2), keys[i % DEPTH]);
+			records[i % DEPTH].blob.key = keys[i % DEPTH];
+			records[i % DEPTH].blob.ksize = 8;
+			if (fastmap_inhandle_prefetch(&ihandle, &records[i % DEPTH], &tokens[i % DEPTH]) != FASTMAP_OK)
+				rc = 0;
+		}
+	}
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	fastmap_prefetch_t token;
+	unsigned char key[9];
+	char *pathname = tempnam(NULL, "fmpf");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(12);
+
+	ok(build(pathname, PLAIN, &attr), "fastmap_outhandle_destroy()");
+	ok(pipelined(pathname, PLAIN, &attr, 0), "pipelined lookups");
+	ok(pipelined(pathname, PLAIN, &attr, FASTMAP_MAP_LOADRAM), "pipelined lookups, FASTMAP_MAP_LOADRAM");
+	ok(pipelined(pathname, PLAIN, &attr, FASTMAP_MAP_BUFFERPOOL), "pipelined lookups, FASTMAP_MAP_BUFFERPOOL");
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	makekey(PLAIN, &attr, 10, 0, key);
+	record.blob.key = key;
+	ok(fastmap_inhandle_prefetch(&ihandle, NULL, &token) == EINVAL, "fastmap_inhandle_prefetch(NULL)");
+	fastmap_inhandle_prefetch(&ihandle, &record, &token);
+	token.pageoffset += 1;
+	ok(fastmap_inhandle_getprefetched(&ihandle, &record, &token) == EINVAL, "token naming no leaf page");
+	memcpy(key, "99999999", 8);
+	ok(fastmap_inhandle_prefetch(&ihandle, &record, &token) == FASTMAP_OK && fastmap_inhandle_getprefetched(&ihandle, &record, &token) == FASTMAP_NOT_FOUND,
+		"key after the last");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(build(pathname, FRONTCODED, &attr) && pipelined(pathname, FRONTCODED, &attr, 0), "front-coded, pipelined lookups");
+	ok(build(pathname, SEPARATORS, &attr) && pipelined(pathname, SEPARATORS, &attr, 0), "truncated separators, pipelined lookups");
+	ok(build(pathname, VARIABLEKEYS, &attr) && pipelined(pathname, VARIABLEKEYS, &attr, 0), "variable keys, pipelined lookups");
+	ok(build(pathname, INTEGERKEYS, &attr) && pipelined(pathname, INTEGERKEYS, &attr, 0), "integer keys, pipelined lookups");
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,171 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#include "layout.h"
+
+/* the distance between two ranks */
+static size_t distance(size_t a, size_t b)
+{
+	return (a > b) ? a - b : b - a;
+}
+
+/* the records an estimate may be off by at either end, a leaf page of records, or for packed
+ * leaf pages, whose records are taken to be spread evenly, two pages of them on average */
+static size_t tolerance(const fastmap_inhandle_t *ihandle, enum layout layout)
+{
+	if (layout == FRONTCODED || layout == VARIABLEKEYS)
+		return (2 * NRECORDS) / ihandle->handle.leafpages;
+	return ihandle->handle.recordsperleafpage;
+}
+
+/* check quantiles, the boundaries of equal ranges and estimated range counts against exact ranks */
+static int quantiles(const char *pathname, enum layout layout, const fastmap_attr_t *attr, int flags)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record, first, last, boundaries[9];
+	unsigned char key[9], firstkey[9], lastkey[9], keys[9][9];
+	size_t i, a, b, rank, begin, end, count, tol;
+	int rc = 1;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags) != FASTMAP_OK)
+		return 0;
+	tol = tolerance(&ihandle, layout);
+
+	for (i = 0; i <= 20 && rc; i++)
+	{
+		record.blob.key = key;
+		record.blob.ksize = 0;
+		if (fastmap_inhandle_quantile(&ihandle, (double)i / 20, &record) != FASTMAP_OK || record.blob.key != key ||
+			(layout != VARIABLEKEYS && record.blob.ksize != 0) || (layout == VARIABLEKEYS && (record.blob.ksize == 0 || record.blob.ksize > 8)))
+		{
+			diag("quantile %zu / 20 failed", i);
+			rc = 0;
+			break;
+		}
+		if (layout != VARIABLEKEYS)
+			record.blob.ksize = 8;
+		fastmap_inhandle_rank(&ihandle, &record, &rank);
+		if (distance(rank, (NRECORDS * i) / 20) > tol)
+		{
+			diag("quantile %zu / 20 has rank %zu", i, rank);
+			rc = 0;
+		}
+	}
+
+	for (i = 0; i < 9; i++)
+	{
+		boundaries[i].blob.key = keys[i];
+		boundaries[i].blob.ksize = 0;
+	}
+	if (rc && fastmap_inhandle_boundaries(&ihandle, boundaries, 10) != FASTMAP_OK)
+		rc = 0;
+	for (i = 0; i < 9 && rc; i++)
+	{
+		if (layout != VARIABLEKEYS)
+			boundaries[i].blob.ksize = 8;
+		fastmap_inhandle_rank(&ihandle, &boundaries[i], &rank);
+		if (distance(rank, (NRECORDS * (i + 1)) / 10) > tol)
+		{
+			diag("boundary %zu has rank %zu", i, rank);
+			rc = 0;
+		}
+	}
+
+	/* estimated counts of ranges between keys of the map, and keys between them */
+	first.blob.key = firstkey;
+	first.blob.ksize = 8;
+	last.blob.key = lastkey;
+	last.blob.ksize = 8;
+	for (i = 0; i < 1000 && rc; i++)
+	{
+		a = (i * 7919) % NRECORDS;
+		b = a + ((i % 2 == 0) ? (i * 31) % 500 : (i * 104729) % NRECORDS);
+		makekey(layout, attr, a, (int)(i % 3 == 0), firstkey);
+		makekey(layout, attr, (b < NRECORDS) ? b : NRECORDS - 1, (int)(i % 5 == 0), lastkey);
+		fastmap_inhandle_rank(&ihandle, &first, &begin);
+		fastmap_inhandle_rank(&ihandle, &last, &end);
+		if (fastmap_inhandle_estimate(&ihandle, &first, &last, &count) != FASTMAP_OK || distance(count, (end > begin) ? end - begin : 0) > 2 * tol)
+		{
+			diag("range of records %zu to %zu estimated at %zu, not %zu", a, b, count, end - begin);
+			rc = 0;
+		}
+	}
+
+	if (rc && (fastmap_inhandle_estimate(&ihandle, NULL, NULL, &count) != FASTMAP_OK || count != NRECORDS))
+		rc = 0;
+	makekey(layout, attr, NRECORDS / 2, 0, firstkey);
+	if (rc && (fastmap_inhandle_estimate(&ihandle, &first, NULL, &count) != FASTMAP_OK || distance(count, NRECORDS / 2) > tol))
+		rc = 0;
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	fastmap_keytype_t type = FASTMAP_KEY_U64;
+	fastmap_keyfield_t field;
+	unsigned char key[9];
+	size_t i, count;
+	char *pathname = tempnam(NULL, "fmqt");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(13);
+
+	ok(build(pathname, PLAIN, &attr), "fastmap_outhandle_destroy()");
+	ok(quantiles(pathname, PLAIN, &attr, 0), "quantiles, boundaries and estimates");
+	ok(quantiles(pathname, PLAIN, &attr, FASTMAP_MAP_BUFFERPOOL), "quantiles, boundaries and estimates, FASTMAP_MAP_BUFFERPOOL");
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	record.blob.key = key;
+	ok(fastmap_inhandle_quantile(&ihandle, -0.5, &record) == EINVAL && fastmap_inhandle_quantile(&ihandle, 1.5, &record) == EINVAL &&
+		fastmap_inhandle_quantile(&ihandle, 0.5, NULL) == EINVAL, "fastmap_inhandle_quantile(), invalid quantile");
+	ok(fastmap_inhandle_boundaries(&ihandle, &record, 0) == EINVAL && fastmap_inhandle_boundaries(&ihandle, &record, 1) == FASTMAP_OK,
+		"fastmap_inhandle_boundaries(), no boundaries");
+	ok(fastmap_inhandle_estimate(&ihandle, NULL, NULL, NULL) == EINVAL, "fastmap_inhandle_estimate(NULL)");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(build(pathname, FRONTCODED, &attr) && quantiles(pathname, FRONTCODED, &attr, 0), "front-coded, quantiles, boundaries and estimates");
+	ok(build(pathname, SEPARATORS, &attr) && quantiles(pathname, SEPARATORS, &attr, 0), "truncated separators, quantiles, boundaries and estimates");
+	ok(build(pathname, VARIABLEKEYS, &attr) && quantiles(pathname, VARIABLEKEYS, &attr, 0), "variable keys, quantiles, boundaries and estimates");
+	ok(quantiles(pathname, VARIABLEKEYS, &attr, FASTMAP_MAP_BUFFERPOOL), "variable keys, quantiles, boundaries and estimates, FASTMAP_MAP_BUFFERPOOL");
+	ok(build(pathname, INTEGERKEYS, &attr) && quantiles(pathname, INTEGERKEYS, &attr, 0), "integer keys, quantiles, boundaries and estimates");
+
+	/* encoded sets keep no search levels */
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, 1000);
+	fastmap_attr_setkeyschema(&attr, &type, 1);
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+	fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_ELIASFANO);
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	for (i = 0; i < 1000; i++)
+	{
+		field.u64 = i * 3;
+		fastmap_encodekey(&attr, &field, key);
+		record.atom.key = key;
+		fastmap_outhandle_put(&ohandle, &record);
+	}
+	fastmap_outhandle_destroy(&ohandle);
+	fastmap_inhandle_init(&ihandle, pathname);
+	ok(fastmap_inhandle_quantile(&ihandle, 0.5, &record) == EINVAL && fastmap_inhandle_estimate(&ihandle, NULL, NULL, &count) == EINVAL,
+		"Elias-Fano coded set");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
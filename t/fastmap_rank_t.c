@@ -0,0 +1,94 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#include "layout.h"
+
+/* rank every key and every key in between, and select every record by its rank */
+static int ranks(const char *pathname, enum layout layout, const fastmap_attr_t *attr, int flags)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	unsigned char key[9], selected[9];
+	char value[32];
+	size_t i, rank, vsize;
+	int rc = 1;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NRECORDS && rc; i++)
+	{
+		makekey(layout, attr, i, 0, key);
+		record.blob.key = key;
+		record.blob.ksize = 8;
+		if (fastmap_inhandle_rank(&ihandle, &record, &rank) != FASTMAP_OK || rank != i)
+			rc = 0;
+
+		makekey(layout, attr, i, 1, key);
+		if (fastmap_inhandle_rank(&ihandle, &record, &rank) != FASTMAP_NOT_FOUND || rank != i + 1)
+			rc = 0;
+
+		makekey(layout, attr, i, 0, key);
+		vsize = makevalue(i, value);
+		record.blob.key = selected;
+		record.blob.ksize = 0;
+		if (fastmap_inhandle_select(&ihandle, i, &record) != FASTMAP_OK || record.blob.ksize != 8 || memcmp(record.blob.key, key, 8) != 0 ||
+			record.blob.vsize != vsize || memcmp(record.blob.value, value, vsize) != 0)
+			rc = 0;
+
+		if (!rc)
+			diag("rank or select of record %zu failed", i);
+	}
+
+	record.blob.key = selected;
+	if (rc && fastmap_inhandle_select(&ihandle, NRECORDS, &record) != FASTMAP_NOT_FOUND)
+		rc = 0;
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	unsigned char key[9];
+	size_t rank;
+	char *pathname = tempnam(NULL, "fmrk");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(12);
+
+	ok(build(pathname, PLAIN, &attr), "fastmap_outhandle_destroy()");
+	ok(ranks(pathname, PLAIN, &attr, 0), "rank and select");
+	ok(ranks(pathname, PLAIN, &attr, FASTMAP_MAP_BUFFERPOOL), "rank and select, FASTMAP_MAP_BUFFERPOOL");
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	record.blob.key = key;
+	ok(fastmap_inhandle_rank(&ihandle, NULL, &rank) == EINVAL && fastmap_inhandle_rank(&ihandle, &record, NULL) == EINVAL, "fastmap_inhandle_rank(NULL)");
+	ok(fastmap_inhandle_select(&ihandle, 0, NULL) == EINVAL, "fastmap_inhandle_select(NULL)");
+	memcpy(key, "99999999", 8);
+	ok(fastmap_inhandle_rank(&ihandle, &record, &rank) == FASTMAP_NOT_FOUND && rank == NRECORDS, "key after the last");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(build(pathname, FRONTCODED, &attr) && ranks(pathname, FRONTCODED, &attr, 0), "front-coded, rank and select");
+	ok(build(pathname, SEPARATORS, &attr) && ranks(pathname, SEPARATORS, &attr, 0), "truncated separators, rank and select");
+	ok(build(pathname, VARIABLEKEYS, &attr) && ranks(pathname, VARIABLEKEYS, &attr, 0), "variable keys, rank and select");
+	ok(ranks(pathname, VARIABLEKEYS, &attr, FASTMAP_MAP_BUFFERPOOL), "variable keys, rank and select, FASTMAP_MAP_BUFFERPOOL");
+	ok(build(pathname, INTEGERKEYS, &attr) && ranks(pathname, INTEGERKEYS, &attr, 0), "integer keys, rank and select");
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,238 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+/* keys fall within the first 'NCHUNKS' chunks of 2^16 keys */
+#define NCHUNKS 12
+#define RANGE (NCHUNKS * 65536)
+
+static unsigned char inset[2][RANGE];
+static uint32_t keys[RANGE];
+
+static void putkey(unsigned char *key, uint32_t v)
+{
+	key[0] = (unsigned char)(v >> 24);
+	key[1] = (unsigned char)(v >> 16);
+	key[2] = (unsigned char)(v >> 8);
+	key[3] = (unsigned char)v;
+}
+
+static uint32_t getkey(const unsigned char *key)
+{
+	return ((uint32_t)key[0] << 24) | ((uint32_t)key[1] << 16) | ((uint32_t)key[2] << 8) | key[3];
+}
+
+/* set 's' mixes a long run, sparse keys and a dense pseudo-random chunk, at offsets chosen per set */
+static void makeset(int s)
+{
+	uint64_t seed = 42 + (uint64_t)s;
+	uint32_t k;
+
+	memset(inset[s], 0, RANGE);
+	for (k = 1000 * (uint32_t)s; k < 100000 + 5000 * (uint32_t)s; k++)
+		inset[s][k] = 1;
+	for (k = 5 * 65536; k < 6 * 65536; k += 997 + (uint32_t)s * 3)
+		inset[s][k] = 1;
+	for (k = (10 + (uint32_t)s) * 65536 - 30000; k < (11 + (uint32_t)s) * 65536 - 30000; k++)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		inset[s][k] = (seed >> 62) != 0;
+	}
+	inset[s][RANGE - 1] = 1;
+}
+
+static size_t build(const char *pathname, int s)
+{
+	const fastmap_keytype_t u32 = FASTMAP_KEY_U32;
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	unsigned char key[4];
+	struct stat st;
+	size_t i, n = 0;
+
+	for (i = 0; i < RANGE; i++)
+	{
+		if (inset[s][i])
+			keys[n++] = (uint32_t)i;
+	}
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, n + 1);
+	fastmap_attr_setkeyschema(&attr, &u32, 1);
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+	fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_ROARING);
+	fastmap_attr_setpagesize(&attr, 4096);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	/* the first key is put twice, and stored once */
+	record.atom.key = key;
+	putkey(key, keys[0]);
+	if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+		return 0;
+	for (i = 0; i < n; i++)
+	{
+		putkey(key, keys[i]);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK || stat(pathname, &st) == -1)
+		return 0;
+	return (size_t)st.st_size;
+}
+
+/* the number of records a map holds, as written in its header */
+static size_t records(const char *pathname)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_attr_t attr;
+	size_t nrecords = 0;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+	if (fastmap_inhandle_getattr(&ihandle, &attr) != FASTMAP_OK || fastmap_attr_getrecords(&attr, &nrecords) != FASTMAP_OK)
+		nrecords = 0;
+	fastmap_inhandle_destroy(&ihandle);
+	return nrecords;
+}
+
+/* check membership and successor of every key in the range against the expected set */
+static int verify(const char *pathname, const unsigned char *expected)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	unsigned char key[4], successor[4];
+	uint32_t k, next = RANGE;
+	int rc = 1, found;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+
+	record.atom.key = key;
+	for (k = RANGE; k-- > 0 && rc; )
+	{
+		if (expected[k])
+			next = k;
+		putkey(key, k);
+		found = fastmap_inhandle_get(&ihandle, &record) == FASTMAP_OK;
+		if (found != expected[k])
+		{
+			diag("key %u %s", k, found ? "found" : "not found");
+			rc = 0;
+		}
+		if (fastmap_inhandle_successor(&ihandle, key, successor) != FASTMAP_OK || getkey(successor) != next)
+		{
+			diag("successor of %u not %u", k, next);
+			rc = 0;
+		}
+	}
+
+	putkey(key, RANGE);
+	rc = rc && fastmap_inhandle_successor(&ihandle, key, successor) == FASTMAP_NOT_FOUND;
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+int main(void)
+{
+	const fastmap_keytype_t u64 = FASTMAP_KEY_U64, u32 = FASTMAP_KEY_U32;
+	static unsigned char expected[RANGE];
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_inhandle_t a, b;
+	fastmap_record_t record;
+	fastmap_atomencoding_t encoding;
+	unsigned char key[8];
+	size_t size, nkeys, intersection = 0, both = 0, first = 0, i;
+	char *pathname = tempnam(NULL, "fmrr");
+	char *bpathname = tempnam(NULL, "fmrr");
+	char *rpathname = tempnam(NULL, "fmrr");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(20);
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_ROARING) == FASTMAP_OK, "fastmap_attr_setatomencoding()");
+	ok(fastmap_attr_getatomencoding(&attr, &encoding) == FASTMAP_OK && encoding == FASTMAP_ATOM_ROARING, "fastmap_attr_getatomencoding()");
+
+	fastmap_attr_setrecords(&attr, 2);
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+	fastmap_attr_setkeyschema(&attr, &u64, 1);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "u32 keys required");
+
+	fastmap_attr_setkeyschema(&attr, &u32, 1);
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	putkey(key, 70000);
+	record.atom.key = key;
+	fastmap_outhandle_put(&ohandle, &record);
+	putkey(key, 69999);
+	ok(fastmap_outhandle_put(&ohandle, &record) == EINVAL, "keys must ascend");
+	fastmap_outhandle_destroy(&ohandle);
+
+	makeset(0);
+	size = build(pathname, 0);
+	ok(size > 0, "set of runs, sparse and dense chunks");
+	ok(verify(pathname, inset[0]), "lookups and successors");
+	ok(size < 16 * 4096, "smaller than its bitmaps");
+	for (i = 0; i < RANGE; i++)
+		first += inset[0][i];
+	ok(records(pathname) == first, "key put twice recorded once");
+	diag("%zu bytes for %zu chunks", size, (size_t)NCHUNKS);
+
+	makeset(1);
+	ok(build(bpathname, 1) > 0, "second set");
+	ok(fastmap_inhandle_init(&a, pathname) == FASTMAP_OK && fastmap_inhandle_init(&b, bpathname) == FASTMAP_OK, "fastmap_inhandle_init()");
+
+	for (i = 0; i < RANGE; i++)
+	{
+		intersection += inset[0][i] && inset[1][i];
+		both += inset[0][i] || inset[1][i];
+	}
+
+	ok(fastmap_inhandle_combine(&a, &b, FASTMAP_SET_INTERSECTION, NULL, &nkeys) == FASTMAP_OK && nkeys == intersection, "count of intersection");
+	ok(fastmap_inhandle_combine(&a, &b, FASTMAP_SET_UNION, NULL, &nkeys) == FASTMAP_OK && nkeys == both, "count of union");
+
+	ok(fastmap_inhandle_combine(&a, &b, FASTMAP_SET_INTERSECTION, rpathname, &nkeys) == FASTMAP_OK, "intersection");
+	for (i = 0; i < RANGE; i++)
+		expected[i] = inset[0][i] && inset[1][i];
+	ok(verify(rpathname, expected), "intersection, lookups");
+
+	ok(fastmap_inhandle_combine(&a, &b, FASTMAP_SET_UNION, rpathname, &nkeys) == FASTMAP_OK, "union");
+	for (i = 0; i < RANGE; i++)
+		expected[i] = inset[0][i] || inset[1][i];
+	ok(verify(rpathname, expected), "union, lookups");
+	ok(records(rpathname) == both && nkeys == both, "union, records");
+
+	ok(fastmap_inhandle_combine(&a, &b, (fastmap_setop_t)0, NULL, &nkeys) == EINVAL, "unknown operation");
+	fastmap_inhandle_destroy(&b);
+
+	fastmap_attr_setatomencoding(&attr, FASTMAP_ATOM_ELIASFANO);
+	fastmap_attr_setrecords(&attr, 1);
+	fastmap_outhandle_init(&ohandle, &attr, bpathname);
+	fastmap_outhandle_put(&ohandle, &record);
+	fastmap_outhandle_destroy(&ohandle);
+	fastmap_inhandle_init(&b, bpathname);
+	ok(fastmap_inhandle_combine(&a, &b, FASTMAP_SET_UNION, NULL, &nkeys) == EINVAL, "roaring sets required");
+	fastmap_inhandle_destroy(&b);
+	fastmap_inhandle_destroy(&a);
+
+	ok(unlink(pathname) == 0 && unlink(bpathname) == 0 && unlink(rpathname) == 0, "unlink()");
+
+	free(pathname);
+	free(bpathname);
+	free(rpathname);
+
+	done_testing();
+}
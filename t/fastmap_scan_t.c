@@ -0,0 +1,145 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#include "layout.h"
+
+#define NPARTITIONS 8
+
+/* what a scan of each partition saw, and the record it should fail on if any */
+struct scan
+{
+	enum layout layout;
+	const fastmap_attr_t *attr;
+	size_t records[NPARTITIONS];
+	int ordered[NPARTITIONS];
+	size_t failat;
+};
+
+/* read a cursor to its end, checking that it yields record after record from its first */
+static int readcursor(fastmap_cursor_t *cursor, enum layout layout, const fastmap_attr_t *attr, size_t *nread)
+{
+	fastmap_record_t record;
+	unsigned char key[9];
+	char value[32];
+	size_t i = cursor->next, vsize;
+	int rc;
+
+	for (*nread = 0; (rc = fastmap_cursor_next(cursor, &record)) == FASTMAP_OK; i++, (*nread)++)
+	{
+		makekey(layout, attr, i, 0, key);
+		vsize = makevalue(i, value);
+		if (record.blob.ksize != 8 || memcmp(record.blob.key, key, 8) != 0 || record.blob.vsize != vsize || memcmp(record.blob.value, value, vsize) != 0)
+		{
+			diag("record %zu of the cursor is wrong", i);
+			return 0;
+		}
+	}
+
+	return rc == FASTMAP_NOT_FOUND;
+}
+
+static int scanpartition(fastmap_cursor_t *cursor, size_t partition, void *arg)
+{
+	struct scan *scan = arg;
+
+	if (cursor->next <= scan->failat && scan->failat < cursor->end)
+		return FASTMAP_EXPECTATION_FAILED;
+	scan->ordered[partition] = readcursor(cursor, scan->layout, scan->attr, &scan->records[partition]);
+	return FASTMAP_OK;
+}
+
+/* scan the whole map, checking every partition was read in full, and that partitions hold about as many records each */
+static int scanall(const char *pathname, enum layout layout, const fastmap_attr_t *attr, int flags, size_t nthreads)
+{
+	fastmap_inhandle_t ihandle;
+	struct scan scan;
+	size_t i, total = 0;
+	int rc = 1;
+
+	if (fastmap_inhandle_initflags(&ihandle, pathname, flags) != FASTMAP_OK || fastmap_inhandle_setthreads(&ihandle, nthreads) != FASTMAP_OK)
+		return 0;
+
+	memset(&scan, 0, sizeof(scan));
+	scan.layout = layout;
+	scan.attr = attr;
+	scan.failat = SIZE_MAX;
+	if (fastmap_inhandle_scan(&ihandle, NULL, NULL, NPARTITIONS, scanpartition, &scan) != FASTMAP_OK)
+		rc = 0;
+
+	for (i = 0; i < NPARTITIONS; i++)
+	{
+		if (!scan.ordered[i] || scan.records[i] + 200 < NRECORDS / NPARTITIONS || scan.records[i] > NRECORDS / NPARTITIONS + 200)
+		{
+			diag("partition %zu read %zu records", i, scan.records[i]);
+			rc = 0;
+		}
+		total += scan.records[i];
+	}
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc && total == NRECORDS;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_inhandle_t ihandle;
+	fastmap_cursor_t cursor, cursors[3];
+	fastmap_record_t first, last;
+	struct scan scan;
+	unsigned char firstkey[9], lastkey[9];
+	size_t n, i;
+	char *pathname = tempnam(NULL, "fmsc");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(16);
+
+	ok(build(pathname, PLAIN, &attr), "fastmap_outhandle_destroy()");
+
+	fastmap_inhandle_init(&ihandle, pathname);
+	ok(fastmap_cursor_init(&cursor, &ihandle, 10, 5) == EINVAL && fastmap_cursor_init(NULL, &ihandle, 0, 1) == EINVAL, "fastmap_cursor_init() of a reversed run");
+	ok(fastmap_cursor_init(&cursor, &ihandle, 0, SIZE_MAX) == FASTMAP_OK && readcursor(&cursor, PLAIN, &attr, &n) && n == NRECORDS, "cursor over every record");
+	ok(fastmap_cursor_init(&cursor, &ihandle, NRECORDS - 5, NRECORDS + 5) == FASTMAP_OK && readcursor(&cursor, PLAIN, &attr, &n) && n == 5, "cursor past the last record");
+	ok(fastmap_inhandle_partition(&ihandle, NULL, NULL, cursors, 0) == EINVAL, "fastmap_inhandle_partition(0)");
+
+	/* a key range starting on a key of the map and ending between two */
+	makekey(PLAIN, &attr, 100, 0, firstkey);
+	makekey(PLAIN, &attr, 20000, 1, lastkey);
+	first.blob.key = firstkey;
+	last.blob.key = lastkey;
+	ok(fastmap_inhandle_partition(&ihandle, &first, &last, cursors, 3) == FASTMAP_OK && cursors[0].next == 100 && cursors[2].end == 20001 &&
+		cursors[0].end == cursors[1].next && cursors[1].end == cursors[2].next, "fastmap_inhandle_partition() of a key range");
+	for (i = 0, n = 0; i < 3 && readcursor(&cursors[i], PLAIN, &attr, &n); i++)
+		;
+	ok(i == 3, "key range partitions read");
+
+	memset(&scan, 0, sizeof(scan));
+	scan.layout = PLAIN;
+	scan.attr = &attr;
+	scan.failat = 12345;
+	ok(fastmap_inhandle_scan(&ihandle, NULL, NULL, NPARTITIONS, scanpartition, &scan) == FASTMAP_EXPECTATION_FAILED, "failing callback");
+	ok(fastmap_inhandle_scan(&ihandle, NULL, NULL, 0, scanpartition, &scan) == EINVAL, "fastmap_inhandle_scan(0)");
+	fastmap_inhandle_destroy(&ihandle);
+
+	ok(scanall(pathname, PLAIN, &attr, 0, 1), "scan, 1 thread");
+	ok(scanall(pathname, PLAIN, &attr, 0, 4), "scan, 4 threads");
+	ok(scanall(pathname, PLAIN, &attr, FASTMAP_MAP_BUFFERPOOL, 4), "scan, FASTMAP_MAP_BUFFERPOOL");
+
+	ok(build(pathname, FRONTCODED, &attr) && scanall(pathname, FRONTCODED, &attr, 0, 4), "front-coded, scan");
+	ok(build(pathname, VARIABLEKEYS, &attr) && scanall(pathname, VARIABLEKEYS, &attr, 0, 4), "variable keys, scan");
+	ok(build(pathname, INTEGERKEYS, &attr) && scanall(pathname, INTEGERKEYS, &attr, 0, 4), "integer keys, scan");
+
+	ok(unlink(pathname) == 0, "unlink()");
+
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,183 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define KSIZE 128
+#define NRECORDS 100000
+
+static char vbuffer[64];
+
+/* keys either differ early, after a short counter, or only in their last bytes */
+static void makekey(char *key, size_t i, int sharedprefix)
+{
+	char counter[16];
+
+	sprintf(counter, "%08zu", i);
+	memset(key, 'x', KSIZE);
+	memcpy(sharedprefix ? key + KSIZE - 8 : key, counter, 8);
+}
+
+static void setrecord(fastmap_record_t *record, fastmap_format_t format, char *key, size_t ksize, size_t i)
+{
+	sprintf(vbuffer, "value %zu", i);
+	if (format == FASTMAP_ATOM)
+	{
+		record->atom.key = key;
+		record->atom.ksize = ksize;
+	}
+	else
+	{
+		record->blob.key = key;
+		record->blob.value = vbuffer;
+		record->blob.vsize = strlen(vbuffer);
+		record->blob.ksize = ksize;
+	}
+}
+
+static int build(const char *pathname, fastmap_format_t format, int truncate, size_t restartinterval, int variablekeys, int sharedprefix)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	char key[KSIZE];
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, KSIZE);
+	fastmap_attr_setpagesize(&attr, 4096);
+	fastmap_attr_setformat(&attr, format);
+	fastmap_attr_settruncateseparators(&attr, truncate);
+	fastmap_attr_setrestartinterval(&attr, restartinterval);
+	fastmap_attr_setvariablekeys(&attr, variablekeys);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		makekey(key, i, sharedprefix);
+		setrecord(&record, format, key, KSIZE, i);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	return fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK;
+}
+
+/* look up every key, a key just after each of them, and keys before and after the map,
+ * returning the number of search levels, or -1 on a wrong answer */
+static int verify(const char *pathname, fastmap_format_t format, int sharedprefix)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	char key[KSIZE];
+	size_t i;
+	int levels;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return -1;
+	levels = ihandle.handle.numlevels;
+
+	for (i = 0; i < NRECORDS && levels >= 0; i++)
+	{
+		makekey(key, i, sharedprefix);
+		setrecord(&record, format, key, KSIZE, i);
+		if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_OK)
+		{
+			diag("record %zu not found", i);
+			levels = -1;
+			break;
+		}
+
+		if (format == FASTMAP_BLOB)
+		{
+			sprintf(vbuffer, "value %zu", i);
+			if (record.blob.vsize != strlen(vbuffer) || memcmp(record.blob.value, vbuffer, record.blob.vsize) != 0)
+			{
+				diag("record %zu has the wrong value", i);
+				levels = -1;
+				break;
+			}
+		}
+
+		key[sharedprefix ? 0 : KSIZE - 1] = 'y';
+		setrecord(&record, format, key, KSIZE, i);
+		if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND)
+		{
+			diag("key after record %zu found", i);
+			levels = -1;
+		}
+	}
+
+	memset(key, ' ', KSIZE);
+	setrecord(&record, format, key, KSIZE, 0);
+	if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND)
+		levels = -1;
+	memset(key, 'z', KSIZE);
+	setrecord(&record, format, key, KSIZE, 0);
+	if (fastmap_inhandle_get(&ihandle, &record) != FASTMAP_NOT_FOUND)
+		levels = -1;
+
+	fastmap_inhandle_destroy(&ihandle);
+	return levels;
+}
+
+struct testcase
+{
+	const char *name;
+	fastmap_format_t format;
+	size_t restartinterval;
+	int variablekeys;
+	int sharedprefix;
+};
+
+int main(void)
+{
+	const struct testcase cases[] = {
+		{ "atom", FASTMAP_ATOM, 0, 0, 0 },
+		{ "blob", FASTMAP_BLOB, 0, 0, 0 },
+		{ "atom, front-coded", FASTMAP_ATOM, 16, 0, 0 },
+		{ "atom, variable length keys", FASTMAP_ATOM, 0, 1, 0 },
+		{ "atom, shared prefix", FASTMAP_ATOM, 0, 0, 1 },
+	};
+	fastmap_attr_t attr;
+	int enable, full, truncated;
+	size_t i;
+	char *pathname = tempnam(NULL, "fmsep");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(3 + 3 * (sizeof(cases) / sizeof(cases[0])));
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_settruncateseparators(&attr, 1) == FASTMAP_OK, "fastmap_attr_settruncateseparators()");
+	ok(fastmap_attr_gettruncateseparators(&attr, &enable) == FASTMAP_OK && enable == 1, "fastmap_attr_gettruncateseparators()");
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		/* variable length keys always truncate their separators */
+		full = (build(pathname, cases[i].format, 0, cases[i].restartinterval, cases[i].variablekeys, cases[i].sharedprefix)) ? verify(pathname, cases[i].format, cases[i].sharedprefix) : -1;
+		ok(full >= 0, "%s", cases[i].name);
+		truncated = (build(pathname, cases[i].format, 1, cases[i].restartinterval, cases[i].variablekeys, cases[i].sharedprefix)) ? verify(pathname, cases[i].format, cases[i].sharedprefix) : -1;
+		ok(truncated >= 0, "%s, truncated separators", cases[i].name);
+
+		/* only keys which differ early make for short separators */
+		if (cases[i].sharedprefix || cases[i].variablekeys)
+			ok(truncated <= full, "%s, no more search levels", cases[i].name);
+		else
+			ok(truncated < full, "%s, fewer search levels", cases[i].name);
+		diag("%s: %d search levels, %d with truncated separators", cases[i].name, full, truncated);
+	}
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
@@ -0,0 +1,103 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define NRECORDS 20000
+
+static size_t makevalue(char *buf, int i)
+{
+	size_t vsize = (size_t)(i % 23);
+
+	memset(buf, 'a' + (i % 26), vsize);
+	return vsize;
+}
+
+static int roundtrip(fastmap_attr_t *attr, const char *pathname)
+{
+	fastmap_blob_t blob;
+	fastmap_inhandle_t ihandle;
+	fastmap_outhandle_t ohandle;
+	char key[9], value[23];
+	size_t vsize;
+	int i;
+
+	if (fastmap_outhandle_init(&ohandle, attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%08d", i);
+		blob.key = key;
+		blob.value = value;
+		blob.vsize = makevalue(value, i);
+		if (fastmap_outhandle_put(&ohandle, (fastmap_record_t*)&blob) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK)
+		return 0;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < NRECORDS; i++)
+	{
+		sprintf(key, "%08d", i);
+		blob.key = key;
+		vsize = makevalue(value, i);
+		if (fastmap_inhandle_get(&ihandle, (fastmap_record_t*)&blob) != FASTMAP_OK || blob.vsize != vsize || memcmp(blob.value, value, vsize) != 0)
+		{
+			diag("value mismatch for key: '%s'", key);
+			return 0;
+		}
+	}
+
+	return fastmap_inhandle_destroy(&ihandle) == FASTMAP_OK;
+}
+
+int main(void)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	char *pathname = tempnam(NULL, "fmvpt");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(7);
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, NRECORDS);
+	fastmap_attr_setksize(&attr, 8);
+	fastmap_attr_setformat(&attr, FASTMAP_BLOB);
+
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	cmp_ok(ohandle.handle.valueptrsize, "==", 5, "default value pointer: 5 bytes");
+	fastmap_outhandle_destroy(&ohandle);
+
+	fastmap_attr_setvaluebytes(&attr, (size_t)NRECORDS * 23);
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	cmp_ok(ohandle.handle.valueptrsize, "==", 4, "small map value pointer: 4 bytes");
+	fastmap_outhandle_destroy(&ohandle);
+
+	ok(roundtrip(&attr, pathname), "4 byte value pointers");
+
+	fastmap_attr_setvaluebytes(&attr, 0);
+	ok(roundtrip(&attr, pathname), "5 byte value pointers");
+
+	fastmap_attr_setinlinevsize(&attr, 8);
+	ok(roundtrip(&attr, pathname), "5 byte value pointers, inline values");
+
+	fastmap_attr_setvaluebytes(&attr, (size_t)NRECORDS * 23);
+	ok(roundtrip(&attr, pathname), "4 byte value pointers, inline values");
+
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
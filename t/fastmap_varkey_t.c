@@ -0,0 +1,212 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <tap.h>
+#include <fastmap.h>
+
+#define MAXKSIZE 32
+#define NRECORDS 30000
+
+static char keys[NRECORDS][MAXKSIZE];
+static char vbuffer[8192];
+
+static int cmpkeys(const void *a, const void *b)
+{
+	/* for strings, strcmp() collates a prefix before any longer key, as fastmap does */
+	return strcmp((const char*)a, (const char*)b);
+}
+
+static size_t valuesize(fastmap_format_t format, size_t vsize, size_t i)
+{
+	memset(vbuffer, 'a' + (int)(i % 26), sizeof(vbuffer));
+	sprintf(vbuffer, "%zu", i);
+	if (format == FASTMAP_BLOB)
+		return (i % 11) * 7 + 1;
+	return vsize;
+}
+
+static void setrecord(fastmap_record_t *record, fastmap_format_t format, const char *key, void *value, size_t vsize)
+{
+	switch (format)
+	{
+	case FASTMAP_ATOM:
+		record->atom.key = (void*)key;
+		record->atom.ksize = strlen(key);
+		break;
+	case FASTMAP_BLOCK:
+		record->block.key = (void*)key;
+		record->block.value = value;
+		record->block.ksize = strlen(key);
+		break;
+	default:
+		record->blob.key = (void*)key;
+		record->blob.value = value;
+		record->blob.vsize = vsize;
+		record->blob.ksize = strlen(key);
+		break;
+	}
+}
+
+static size_t build(const char *pathname, fastmap_format_t format, size_t nrecords, size_t vsize, size_t inlinevsize, int variablekeys)
+{
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	char key[MAXKSIZE];
+	struct stat st;
+	size_t i;
+
+	fastmap_attr_init(&attr);
+	fastmap_attr_setrecords(&attr, nrecords);
+	fastmap_attr_setksize(&attr, MAXKSIZE);
+	fastmap_attr_setvsize(&attr, vsize);
+	fastmap_attr_setinlinevsize(&attr, inlinevsize);
+	fastmap_attr_setpagesize(&attr, 512);
+	fastmap_attr_setformat(&attr, format);
+	fastmap_attr_setvariablekeys(&attr, variablekeys);
+
+	if (fastmap_outhandle_init(&ohandle, &attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < nrecords; i++)
+	{
+		/* fixed size keys are padded with NULs, which keeps them in the same order */
+		memset(key, '\0', sizeof(key));
+		strcpy(key, keys[i]);
+		setrecord(&record, format, key, vbuffer, valuesize(format, vsize, i));
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	if (fastmap_outhandle_destroy(&ohandle) != FASTMAP_OK || stat(pathname, &st) == -1)
+		return 0;
+
+	return (size_t)st.st_size;
+}
+
+static int lookup(fastmap_inhandle_t *ihandle, fastmap_format_t format, const char *key, fastmap_record_t *record)
+{
+	setrecord(record, format, key, NULL, 0);
+	return fastmap_inhandle_get(ihandle, record);
+}
+
+static int verify(const char *pathname, fastmap_format_t format, size_t nrecords, size_t vsize)
+{
+	fastmap_inhandle_t ihandle;
+	fastmap_record_t record;
+	char key[MAXKSIZE + 2];
+	size_t i, size;
+	int rc = 1;
+
+	if (fastmap_inhandle_init(&ihandle, pathname) != FASTMAP_OK)
+		return 0;
+
+	for (i = 0; i < nrecords && rc; i++)
+	{
+		if (lookup(&ihandle, format, keys[i], &record) != FASTMAP_OK)
+		{
+			diag("key '%s' not found", keys[i]);
+			rc = 0;
+			break;
+		}
+
+		size = valuesize(format, vsize, i);
+		if (format == FASTMAP_BLOCK)
+			rc = memcmp(record.block.value, vbuffer, size) == 0;
+		else if (format == FASTMAP_BLOB)
+			rc = record.blob.vsize == size && memcmp(record.blob.value, vbuffer, size) == 0;
+		if (!rc)
+			diag("wrong value for key '%s'", keys[i]);
+
+		/* extending a key gives one which sorts right after it, and is not in the map */
+		sprintf(key, "%s~", keys[i]);
+		if (rc && lookup(&ihandle, format, key, &record) != FASTMAP_NOT_FOUND)
+		{
+			diag("key '%s' found", key);
+			rc = 0;
+		}
+	}
+
+	if (rc && (lookup(&ihandle, format, "", &record) != FASTMAP_NOT_FOUND || lookup(&ihandle, format, "p", &record) != FASTMAP_NOT_FOUND ||
+		lookup(&ihandle, format, "q", &record) != FASTMAP_NOT_FOUND))
+	{
+		diag("key outside of the map found");
+		rc = 0;
+	}
+
+	fastmap_inhandle_destroy(&ihandle);
+	return rc;
+}
+
+struct testcase
+{
+	const char *name;
+	fastmap_format_t format;
+	size_t nrecords;
+	size_t vsize;
+	size_t inlinevsize;
+};
+
+int main(void)
+{
+	const struct testcase cases[] = {
+		{ "atom", FASTMAP_ATOM, NRECORDS, 0, 0 },
+		{ "block (inline)", FASTMAP_BLOCK, NRECORDS, 8, 0 },
+		{ "block", FASTMAP_BLOCK, 2000, 600, 0 },
+		{ "blob", FASTMAP_BLOB, NRECORDS, 0, 0 },
+		{ "blob (inline)", FASTMAP_BLOB, NRECORDS, 0, 40 },
+	};
+	fastmap_attr_t attr;
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	size_t fixedsize, variablesize;
+	size_t i;
+	int enable;
+	char *pathname = tempnam(NULL, "fmvar");
+
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	plan(6 + 3 * (sizeof(cases) / sizeof(cases[0])));
+
+	/* keys of 3 to 7 bytes, many of them prefixes of others */
+	for (i = 0; i < NRECORDS; i++)
+		sprintf(keys[i], "p/%zx", i);
+	qsort(keys, NRECORDS, MAXKSIZE, cmpkeys);
+
+	fastmap_attr_init(&attr);
+	ok(fastmap_attr_setvariablekeys(&attr, 1) == FASTMAP_OK, "fastmap_attr_setvariablekeys()");
+	ok(fastmap_attr_getvariablekeys(&attr, &enable) == FASTMAP_OK && enable == 1, "fastmap_attr_getvariablekeys()");
+
+	fastmap_attr_setrecords(&attr, 1);
+	fastmap_attr_setksize(&attr, MAXKSIZE);
+	fastmap_attr_setformat(&attr, FASTMAP_PAIR);
+	ok(fastmap_outhandle_init(&ohandle, &attr, pathname) == EINVAL, "no variable length keys for pair");
+
+	fastmap_attr_setformat(&attr, FASTMAP_ATOM);
+	fastmap_outhandle_init(&ohandle, &attr, pathname);
+	record.atom.key = "a key longer than the maximum key size";
+	record.atom.ksize = strlen(record.atom.key);
+	ok(fastmap_outhandle_put(&ohandle, &record) == EINVAL, "key longer than the maximum");
+	fastmap_outhandle_destroy(&ohandle);
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		fixedsize = build(pathname, cases[i].format, cases[i].nrecords, cases[i].vsize, cases[i].inlinevsize, 0);
+		variablesize = build(pathname, cases[i].format, cases[i].nrecords, cases[i].vsize, cases[i].inlinevsize, 1);
+		ok(variablesize > 0, "%s, variable length keys", cases[i].name);
+		ok(verify(pathname, cases[i].format, cases[i].nrecords, cases[i].vsize), "%s, lookups", cases[i].name);
+		ok(variablesize < fixedsize, "%s, smaller than padded keys", cases[i].name);
+		diag("%s: %zu bytes padded, %zu bytes variable", cases[i].name, fixedsize, variablesize);
+	}
+
+	ok(build(pathname, FASTMAP_ATOM, 1, 0, 0, 1) > 0 && verify(pathname, FASTMAP_ATOM, 1, 0), "single record");
+	ok(unlink(pathname) == 0, "unlink()");
+	free(pathname);
+
+	done_testing();
+}
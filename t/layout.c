@@ -0,0 +1,63 @@
+#include <stdio.h>
+
+#include "layout.h"
+
+void makekey(enum layout layout, const fastmap_attr_t *attr, size_t i, int between, unsigned char *key)
+{
+	fastmap_keyfield_t field;
+
+	if (layout == INTEGERKEYS)
+	{
+		field.u64 = (i * 5) + (between ? 2 : 0);
+		fastmap_encodekey(attr, &field, key);
+	}
+	else
+	{
+		snprintf((char*)key, 9, "%08zu", (i * 5) + (between ? 2 : 0));
+	}
+}
+
+size_t makevalue(size_t i, char *value)
+{
+	return (size_t)sprintf(value, "value %zu", i);
+}
+
+int build(const char *pathname, enum layout layout, fastmap_attr_t *attr)
+{
+	fastmap_outhandle_t ohandle;
+	fastmap_record_t record;
+	fastmap_keytype_t type = FASTMAP_KEY_U64;
+	unsigned char key[9];
+	char value[32];
+	size_t i;
+
+	fastmap_attr_init(attr);
+	fastmap_attr_setrecords(attr, NRECORDS);
+	fastmap_attr_setksize(attr, 8);
+	fastmap_attr_setformat(attr, FASTMAP_BLOB);
+	fastmap_attr_setpagesize(attr, 1024);
+	if (layout == FRONTCODED)
+		fastmap_attr_setrestartinterval(attr, 16);
+	if (layout == SEPARATORS)
+		fastmap_attr_settruncateseparators(attr, 1);
+	if (layout == VARIABLEKEYS)
+		fastmap_attr_setvariablekeys(attr, 1);
+	if (layout == INTEGERKEYS)
+		fastmap_attr_setkeyschema(attr, &type, 1);
+
+	if (fastmap_outhandle_init(&ohandle, attr, pathname) != FASTMAP_OK)
+		return 0;
+
+	record.blob.key = key;
+	record.blob.ksize = 8;
+	record.blob.value = value;
+	for (i = 0; i < NRECORDS; i++)
+	{
+		makekey(layout, attr, i, 0, key);
+		record.blob.vsize = makevalue(i, value);
+		if (fastmap_outhandle_put(&ohandle, &record) != FASTMAP_OK)
+			return 0;
+	}
+
+	return fastmap_outhandle_destroy(&ohandle) == FASTMAP_OK;
+}
@@ -0,0 +1,24 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stddef.h>
+
+#include <fastmap.h>
+
+/* Maps of NRECORDS blob records in each leaf layout, shared by the tests of lookups that
+ * must behave alike whatever the layout. Record 'i' has the key i * 5, as 8 digits or as a
+ * u64 field, so that there is a key between any two of the map */
+#define NRECORDS 30000
+
+enum layout { PLAIN, FRONTCODED, SEPARATORS, VARIABLEKEYS, INTEGERKEYS };
+
+/* the key of record 'i', or if 'between' is set a key between it and the next */
+void makekey(enum layout layout, const fastmap_attr_t *attr, size_t i, int between, unsigned char *key);
+
+/* the value of record 'i', returning its size */
+size_t makevalue(size_t i, char *value);
+
+/* build the map at 'pathname' in 'layout', leaving its attributes in 'attr' */
+int build(const char *pathname, enum layout layout, fastmap_attr_t *attr);
+
+#endif
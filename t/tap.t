@@ -1,7 +1,7 @@
 #!/usr/bin/env perl
 use strict;
 use warnings;
-use Test::More tests => 13;
+use Test::More tests => 38;
 use Test::Differences;
 
 eq_or_diff ~~ `t/fastmap_attr_t 2>&1`, <<'END', "fastmap_attr_t";
@@ -145,6 +145,565 @@ ok 15 - quorum == quorum
 ok 16 - unlink()
 END
 
+eq_or_diff ~~ `t/fastmap_blob_inline_t 2>&1`, <<'END', "fastmap_blob_inline_t";
+1..20
+ok 1 - fastmap_attr_setinlinevsize(MAX + 1)
+ok 2 - fastmap_attr_setinlinevsize()
+ok 3 - INLINE_BLOB
+ok 4 - fastmap_outhandle_put("0001")
+ok 5 - fastmap_outhandle_put("0002")
+ok 6 - fastmap_outhandle_put("0003")
+ok 7 - fastmap_outhandle_put("0004")
+ok 8 - fastmap_outhandle_put("0005")
+ok 9 - INLINE_BLOBS
+ok 10 - fastmap_inhandle_get("0001")
+ok 11 - foo == foo
+ok 12 - fastmap_inhandle_get("0002")
+ok 13 -  == 
+ok 14 - fastmap_inhandle_get("0003")
+ok 15 - baz == baz
+ok 16 - fastmap_inhandle_get("0004")
+ok 17 - quux == quux
+ok 18 - fastmap_inhandle_get("0005")
+ok 19 - quorum == quorum
+ok 20 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_valueptr_t 2>&1`, <<'END', "fastmap_valueptr_t";
+1..7
+ok 1 - default value pointer: 5 bytes
+ok 2 - small map value pointer: 4 bytes
+ok 3 - 4 byte value pointers
+ok 4 - 5 byte value pointers
+ok 5 - 5 byte value pointers, inline values
+ok 6 - 4 byte value pointers, inline values
+ok 7 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_nonmultiple_t 2>&1`, <<'END', "fastmap_nonmultiple_t";
+1..9
+ok 1 - fastmap_outhandle_init(ksize = 0)
+ok 2 - atom, 24 byte keys
+ok 3 - pair, 13 byte keys
+ok 4 - block, 12 byte keys, 20 byte values
+ok 5 - INLINE_BLOCK
+ok 6 - block, 24 byte keys, 7 byte values
+ok 7 - INLINE_BLOCK
+ok 8 - blob, 40 byte keys
+ok 9 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_pagesize_t 2>&1`, <<'END', "fastmap_pagesize_t";
+1..13
+ok 1 - fastmap_attr_setpagesize(256)
+ok 2 - fastmap_attr_setpagesize(3000)
+ok 3 - fastmap_attr_setpagesize(4M)
+ok 4 - fastmap_attr_setsectionalign(3000)
+ok 5 - fastmap_attr_setpagesize(512)
+ok 6 - fastmap_attr_getpagesize()
+ok 7 - 512 byte pages
+ok 8 - 64K pages
+ok 9 - 2M pages
+ok 10 - fastmap_attr_setsectionalign(2M)
+ok 11 - fastmap_attr_getsectionalign()
+ok 12 - 4K pages, 2M aligned sections
+ok 13 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_mappolicy_t 2>&1`, <<'END', "fastmap_mappolicy_t";
+1..16
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - no policy
+ok 3 - FASTMAP_MAP_POPULATE
+ok 4 - FASTMAP_MAP_POPULATE, map resident
+ok 5 - FASTMAP_MAP_LOCKSEARCH
+ok 6 - FASTMAP_MAP_LOCKSEARCH, search levels locked
+ok 7 - FASTMAP_MAP_HUGEPAGE
+ok 8 - FASTMAP_MAP_LOADRAM
+ok 9 - FASTMAP_MAP_LOADRAM, map resident and huge page aligned
+ok 10 - FASTMAP_MAP_LOADRAM, lookups after the file is truncated
+ok 11 - fastmap_outhandle_destroy(), again
+ok 12 - random advice
+ok 13 - random advice, flags kept
+ok 14 - willneed advice
+ok 15 - FASTMAP_MAP_LOADRAM, locked, random advice
+ok 16 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_initmem_t 2>&1`, <<'END', "fastmap_initmem_t";
+1..21
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - read()
+ok 3 - fastmap_inhandle_initmem()
+ok 4 - no copy
+ok 5 - lookups from memory
+ok 6 - fastmap_inhandle_destroy()
+ok 7 - truncated buffer
+ok 8 - buffer shorter than header
+ok 9 - bad magic
+ok 10 - value pages past the buffer
+ok 11 - value past the buffer
+ok 12 - write unaligned bundle
+ok 13 - fastmap_inhandle_initfd(unaligned)
+ok 14 - lookups from unaligned offset
+ok 15 - descriptor left open
+ok 16 - range past end of file
+ok 17 - wrong offset
+ok 18 - write aligned bundle
+ok 19 - fastmap_inhandle_initfd(aligned, FASTMAP_MAP_LOADRAM)
+ok 20 - lookups after closing descriptor
+ok 21 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_container_t 2>&1`, <<'END', "fastmap_container_t";
+1..15
+ok 1 - write maps
+ok 2 - fastmap_container_create()
+ok 3 - duplicate names
+ok 4 - name too long
+ok 5 - fastmap_container_create() again
+ok 6 - fastmap_container_init()
+ok 7 - fastmap_container_getcount()
+ok 8 - names are sorted
+ok 9 - fastmap_container_getname() out of range
+ok 10 - lookups in every map
+ok 11 - missing map
+ok 12 - fastmap_container_get("sessions")
+ok 13 - maps do not overlap
+ok 14 - fastmap_container_destroy()
+ok 15 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_frontcoded_t 2>&1`, <<'END', "fastmap_frontcoded_t";
+1..29
+ok 1 - fastmap_attr_setrestartinterval()
+ok 2 - fastmap_attr_getrestartinterval()
+ok 3 - key too large to front-code
+ok 4 - atom
+ok 5 - atom, front-coded
+ok 6 - atom, front-coded lookups
+ok 7 - atom, front-coded map is smaller
+# atom: 2450368 bytes, 417792 bytes front-coded
+ok 8 - pair
+ok 9 - pair, front-coded
+ok 10 - pair, front-coded lookups
+ok 11 - pair, front-coded map is smaller
+# pair: 1987328 bytes, 1159168 bytes front-coded
+ok 12 - block (inline)
+ok 13 - block (inline), front-coded
+ok 14 - block (inline), front-coded lookups
+ok 15 - block (inline), front-coded map is smaller
+# block (inline): 1150856 bytes, 339968 bytes front-coded
+ok 16 - block
+ok 17 - block, front-coded
+ok 18 - block, front-coded lookups
+ok 19 - block, front-coded map is smaller
+# block: 16110592 bytes, 16028672 bytes front-coded
+ok 20 - blob
+ok 21 - blob, front-coded
+ok 22 - blob, front-coded lookups
+ok 23 - blob, front-coded map is smaller
+# blob: 1473599 bytes, 758495 bytes front-coded
+ok 24 - blob (inline)
+ok 25 - blob (inline), front-coded
+ok 26 - blob (inline), front-coded lookups
+ok 27 - blob (inline), front-coded map is smaller
+# blob (inline): 1919667 bytes, 633523 bytes front-coded
+ok 28 - restart interval of 1
+ok 29 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_varkey_t 2>&1`, <<'END', "fastmap_varkey_t";
+1..21
+ok 1 - fastmap_attr_setvariablekeys()
+ok 2 - fastmap_attr_getvariablekeys()
+ok 3 - no variable length keys for pair
+ok 4 - key longer than the maximum
+ok 5 - atom, variable length keys
+ok 6 - atom, lookups
+ok 7 - atom, smaller than padded keys
+# atom: 1026560 bytes padded, 555520 bytes variable
+ok 8 - block (inline), variable length keys
+ok 9 - block (inline), lookups
+ok 10 - block (inline), smaller than padded keys
+# block (inline): 1367520 bytes padded, 837632 bytes variable
+ok 11 - block, variable length keys
+ok 12 - block, lookups
+ok 13 - block, smaller than padded keys
+# block: 1270144 bytes padded, 1239936 bytes variable
+ok 14 - blob, variable length keys
+ok 15 - blob, lookups
+ok 16 - blob, smaller than padded keys
+# blob: 2342508 bytes padded, 1948764 bytes variable
+ok 17 - blob (inline), variable length keys
+ok 18 - blob (inline), lookups
+ok 19 - blob (inline), smaller than padded keys
+# blob (inline): 3187770 bytes padded, 1950266 bytes variable
+ok 20 - single record
+ok 21 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_separators_t 2>&1`, <<'END', "fastmap_separators_t";
+1..18
+ok 1 - fastmap_attr_settruncateseparators()
+ok 2 - fastmap_attr_gettruncateseparators()
+ok 3 - atom
+ok 4 - atom, truncated separators
+ok 5 - atom, fewer search levels
+# atom: 3 search levels, 2 with truncated separators
+ok 6 - blob
+ok 7 - blob, truncated separators
+ok 8 - blob, fewer search levels
+# blob: 3 search levels, 2 with truncated separators
+ok 9 - atom, front-coded
+ok 10 - atom, front-coded, truncated separators
+ok 11 - atom, front-coded, fewer search levels
+# atom, front-coded: 3 search levels, 2 with truncated separators
+ok 12 - atom, variable length keys
+ok 13 - atom, variable length keys, truncated separators
+ok 14 - atom, variable length keys, no more search levels
+# atom, variable length keys: 2 search levels, 2 with truncated separators
+ok 15 - atom, shared prefix
+ok 16 - atom, shared prefix, truncated separators
+ok 17 - atom, shared prefix, no more search levels
+# atom, shared prefix: 3 search levels, 3 with truncated separators
+ok 18 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_keyschema_t 2>&1`, <<'END', "fastmap_keyschema_t";
+1..20
+ok 1 - fastmap_attr_setkeyschema()
+ok 2 - key size follows the schema
+ok 3 - fastmap_attr_getkeyschema()
+ok 4 - too many fields
+ok 5 - unknown field type
+ok 6 - u32 keys sort in numeric order
+ok 7 - i64 keys sort in numeric order
+ok 8 - f64 keys sort in numeric order
+ok 9 - -0.0 encodes as 0.0
+ok 10 - NaN sorts after infinity
+ok 11 - fastmap_encodekey() without a schema
+ok 12 - key size must match the schema
+ok 13 - no schema with variable length keys
+ok 14 - fastmap_outhandle_init()
+ok 15 - typed keys put in numeric order
+ok 16 - fastmap_inhandle_init()
+ok 17 - schema read back from the map
+ok 18 - typed keys found with the default comparison
+ok 19 - -0.0 finds 0.0
+ok 20 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_integerkeys_t 2>&1`, <<'END', "fastmap_integerkeys_t";
+1..17
+ok 1 - u64 atom, uniform keys
+ok 2 - u64 atom, uniform keys, integer keys
+ok 3 - u64 atom, uniform keys, lookups
+ok 4 - u64 atom, uniform keys, lookups by comparison function
+ok 5 - u64 atom, skewed keys
+ok 6 - u64 atom, skewed keys, integer keys
+ok 7 - u64 atom, skewed keys, lookups
+ok 8 - u64 atom, skewed keys, lookups by comparison function
+ok 9 - u32 blob
+ok 10 - u32 blob, integer keys
+ok 11 - u32 blob, lookups
+ok 12 - u32 blob, lookups by comparison function
+ok 13 - i64 block
+ok 14 - i64 block, integer keys
+ok 15 - i64 block, lookups
+ok 16 - i64 block, lookups by comparison function
+ok 17 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_eliasfano_t 2>&1`, <<'END', "fastmap_eliasfano_t";
+1..17
+ok 1 - fastmap_attr_setatomencoding()
+ok 2 - fastmap_attr_getatomencoding()
+ok 3 - unknown encoding
+ok 4 - integer keys required
+ok 5 - atom format required
+ok 6 - keys must ascend
+ok 7 - u64 set, sparse
+ok 8 - u64 set, sparse, lookups
+ok 9 - u64 set, sparse, a fifth of the size
+# 8028672 bytes sorted, 1038163 bytes encoded, 8.31 bits per key
+ok 10 - fastmap_inhandle_init()
+ok 11 - u64 set, dense
+ok 12 - u32 set, wide gaps
+ok 13 - repeated key
+ok 14 - single key
+ok 15 - empty set
+ok 16 - no successor queries on sorted atoms
+ok 17 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_roaring_t 2>&1`, <<'END', "fastmap_roaring_t";
+1..20
+ok 1 - fastmap_attr_setatomencoding()
+ok 2 - fastmap_attr_getatomencoding()
+ok 3 - u32 keys required
+ok 4 - keys must ascend
+ok 5 - set of runs, sparse and dense chunks
+ok 6 - lookups and successors
+ok 7 - smaller than its bitmaps
+ok 8 - key put twice recorded once
+# 24672 bytes for 12 chunks
+ok 9 - second set
+ok 10 - fastmap_inhandle_init()
+ok 11 - count of intersection
+ok 12 - count of union
+ok 13 - intersection
+ok 14 - intersection, lookups
+ok 15 - union
+ok 16 - union, lookups
+ok 17 - union, records
+ok 18 - unknown operation
+ok 19 - roaring sets required
+ok 20 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_compress_t 2>&1`, <<'END', "fastmap_compress_t";
+1..22
+ok 1 - fastmap_attr_setvaluecompression(MAX + 1)
+ok 2 - fastmap_attr_getvaluecompression()
+ok 3 - blob format required
+ok 4 - fastmap_outhandle_setdictionary(NULL)
+ok 5 - fastmap_outhandle_setdictionary() after a put
+ok 6 - compressed values
+ok 7 - compressed values, lookups
+ok 8 - compressed values, lookups through a single cached block
+ok 9 - compressed values, less than half the size
+# 1884750 bytes raw, 691479 bytes compressed
+ok 10 - compressed values, inline small values
+ok 11 - compressed values, front-coded
+ok 12 - fastmap_traindictionary(MAX + 1)
+ok 13 - fastmap_traindictionary()
+# 423 byte dictionary
+ok 14 - dictionary, lookups
+ok 15 - dictionary, smaller small blocks
+# 981318 bytes in 1K blocks, 834654 bytes with a dictionary
+ok 16 - fastmap_inhandle_getdictionary()
+ok 17 - fastmap_inhandle_setcacheblocks(0)
+ok 18 - incompressible values
+ok 19 - incompressible values, little overhead
+ok 20 - corrupt the first block
+ok 21 - corrupt block
+ok 22 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_dedup_t 2>&1`, <<'END', "fastmap_dedup_t";
+1..17
+ok 1 - fastmap_attr_setvaluededup(MAX + 1)
+ok 2 - fastmap_attr_getvaluededup()
+ok 3 - blob format required
+ok 4 - no deduplication
+ok 5 - deduplicated values, lookups
+ok 6 - deduplicated values, less than a quarter of the size
+# 9167912 bytes, 848582 bytes deduplicated
+ok 7 - table rounded up to a power of two
+ok 8 - every value looked up
+ok 9 - repeated values shared
+ok 10 - saved bytes counted
+# 49950 values, 44862 duplicates, 8569330 bytes saved, 4070 evictions
+ok 11 - deduplicated values, inline small values
+ok 12 - deduplicated values, front-coded
+ok 13 - deduplicated values, compressed
+ok 14 - deduplicated values, front-coded and compressed
+ok 15 - single entry table, lookups
+ok 16 - single entry table, values displaced
+ok 17 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_bufferpool_t 2>&1`, <<'END', "fastmap_bufferpool_t";
+1..19
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - FASTMAP_MAP_BUFFERPOOL with FASTMAP_MAP_LOADRAM
+ok 3 - mapped handle has no buffer pool
+ok 4 - fastmap_inhandle_initflags(FASTMAP_MAP_BUFFERPOOL)
+ok 5 - fastmap_inhandle_setpoolframes(0)
+ok 6 - fastmap_inhandle_getpoolstats()
+ok 7 - lookups
+ok 8 - frames read and hit
+# 1024 frames of 4096 bytes, 865 resident, 3 pinned, 99334 hits, 868 reads, 0 evictions
+ok 9 - lookups, 4 frames
+ok 10 - frames evicted
+# 4 resident, 99334 hits, 101067 reads, 100195 evictions
+ok 11 - willneed advice fills the pool
+ok 12 - front-coded, 2 frames
+ok 13 - compressed values, 2 frames
+ok 14 - fastmap_inhandle_initfd(FASTMAP_MAP_BUFFERPOOL)
+ok 15 - fastmap_inhandle_initfd(), lookups
+ok 16 - Elias-Fano coded set
+ok 17 - Elias-Fano coded set, successors through 1 frame
+ok 18 - Elias-Fano coded set, frames evicted
+# 2 frames, 2 resident, 1 pinned, 7 reads, 4 evictions
+ok 19 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_async_t 2>&1`, <<'END', "fastmap_async_t";
+1..14
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - mapped handle has no buffer pool
+ok 3 - fastmap_inhandle_initflags(FASTMAP_MAP_BUFFERPOOL)
+ok 4 - nothing to complete
+ok 5 - cold lookups
+ok 6 - cold lookups wait on reads
+# 0 of 20000 lookups completed at once
+ok 7 - warm lookups complete at once
+ok 8 - missing key
+ok 9 - lookups, 8 frames
+ok 10 - lookups, 8 frames, frames evicted
+# 128 frames, 128 resident, 163136 hits, 7575 reads, 7184 evictions
+ok 11 - fastmap_inhandle_submit()
+ok 12 - fastmap_inhandle_get() during a read
+ok 13 - fastmap_inhandle_complete()
+ok 14 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_prefetch_t 2>&1`, <<'END', "fastmap_prefetch_t";
+1..12
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - pipelined lookups
+ok 3 - pipelined lookups, FASTMAP_MAP_LOADRAM
+ok 4 - pipelined lookups, FASTMAP_MAP_BUFFERPOOL
+ok 5 - fastmap_inhandle_prefetch(NULL)
+ok 6 - token naming no leaf page
+ok 7 - key after the last
+ok 8 - front-coded, pipelined lookups
+ok 9 - truncated separators, pipelined lookups
+ok 10 - variable keys, pipelined lookups
+ok 11 - integer keys, pipelined lookups
+ok 12 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_finger_t 2>&1`, <<'END', "fastmap_finger_t";
+1..11
+ok 1 - fastmap_outhandle_destroy()
+# 60000 lookups, 1 descents, 384 gallops
+# 60000 lookups, 61 descents, 443 gallops
+# 60000 lookups, 7919 descents, 52081 gallops
+# 60000 lookups, 385 descents, 0 gallops
+ok 2 - lookups through a finger
+# 60000 lookups, 1 descents, 384 gallops
+# 60000 lookups, 61 descents, 443 gallops
+# 60000 lookups, 7919 descents, 52081 gallops
+# 60000 lookups, 385 descents, 0 gallops
+ok 3 - lookups through a finger, FASTMAP_MAP_BUFFERPOOL
+ok 4 - fastmap_finger_init(NULL)
+ok 5 - fastmap_finger_get(NULL)
+ok 6 - key after the last
+# 60000 lookups, 1 descents, 275 gallops
+# 60000 lookups, 221 descents, 495 gallops
+# 60000 lookups, 7919 descents, 52081 gallops
+# 60000 lookups, 276 descents, 0 gallops
+ok 7 - front-coded, lookups through a finger
+# 60000 lookups, 1 descents, 384 gallops
+# 60000 lookups, 61 descents, 443 gallops
+# 60000 lookups, 8015 descents, 51985 gallops
+# 60000 lookups, 385 descents, 0 gallops
+ok 8 - truncated separators, lookups through a finger
+# 60000 lookups, 1 descents, 624 gallops
+# 60000 lookups, 61 descents, 684 gallops
+# 60000 lookups, 19576 descents, 40424 gallops
+# 60000 lookups, 625 descents, 0 gallops
+ok 9 - variable keys, lookups through a finger
+# 60000 lookups, 1 descents, 384 gallops
+# 60000 lookups, 61 descents, 443 gallops
+# 60000 lookups, 7919 descents, 52081 gallops
+# 60000 lookups, 385 descents, 0 gallops
+ok 10 - integer keys, lookups through a finger
+ok 11 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_mget_t 2>&1`, <<'END', "fastmap_mget_t";
+1..13
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - fastmap_inhandle_setthreads(0)
+ok 3 - fastmap_inhandle_mget(NULL)
+ok 4 - empty batch
+ok 5 - sorted batch, 1 thread
+ok 6 - scattered batch, 1 thread
+ok 7 - fastmap_inhandle_setthreads(4)
+ok 8 - sorted batch, 4 threads
+ok 9 - scattered batch, 4 threads
+ok 10 - variable keys, 3 threads
+ok 11 - buffer pool, 4 threads
+ok 12 - compressed values, 4 threads
+ok 13 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_rank_t 2>&1`, <<'END', "fastmap_rank_t";
+1..12
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - rank and select
+ok 3 - rank and select, FASTMAP_MAP_BUFFERPOOL
+ok 4 - fastmap_inhandle_rank(NULL)
+ok 5 - fastmap_inhandle_select(NULL)
+ok 6 - key after the last
+ok 7 - front-coded, rank and select
+ok 8 - truncated separators, rank and select
+ok 9 - variable keys, rank and select
+ok 10 - variable keys, rank and select, FASTMAP_MAP_BUFFERPOOL
+ok 11 - integer keys, rank and select
+ok 12 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_scan_t 2>&1`, <<'END', "fastmap_scan_t";
+1..16
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - fastmap_cursor_init() of a reversed run
+ok 3 - cursor over every record
+ok 4 - cursor past the last record
+ok 5 - fastmap_inhandle_partition(0)
+ok 6 - fastmap_inhandle_partition() of a key range
+ok 7 - key range partitions read
+ok 8 - failing callback
+ok 9 - fastmap_inhandle_scan(0)
+ok 10 - scan, 1 thread
+ok 11 - scan, 4 threads
+ok 12 - scan, FASTMAP_MAP_BUFFERPOOL
+ok 13 - front-coded, scan
+ok 14 - variable keys, scan
+ok 15 - integer keys, scan
+ok 16 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_aggregate_t 2>&1`, <<'END', "fastmap_aggregate_t";
+1..15
+ok 1 - fastmap_attr_setvalueaggregate(), not a number
+ok 2 - fastmap_attr_getvalueaggregate()
+ok 3 - value smaller than its number
+ok 4 - blob values
+ok 5 - front-coded leaves
+ok 6 - i64 values, inline
+ok 7 - i64 values, FASTMAP_MAP_BUFFERPOOL
+ok 8 - empty range
+ok 9 - range ending before it starts
+ok 10 - fastmap_inhandle_aggregate(NULL)
+ok 11 - u64 values
+ok 12 - u32 values, truncated separators
+ok 13 - f64 values
+ok 14 - map keeps no aggregates
+ok 15 - unlink()
+END
+
+eq_or_diff ~~ `t/fastmap_quantile_t 2>&1`, <<'END', "fastmap_quantile_t";
+1..13
+ok 1 - fastmap_outhandle_destroy()
+ok 2 - quantiles, boundaries and estimates
+ok 3 - quantiles, boundaries and estimates, FASTMAP_MAP_BUFFERPOOL
+ok 4 - fastmap_inhandle_quantile(), invalid quantile
+ok 5 - fastmap_inhandle_boundaries(), no boundaries
+ok 6 - fastmap_inhandle_estimate(NULL)
+ok 7 - front-coded, quantiles, boundaries and estimates
+ok 8 - truncated separators, quantiles, boundaries and estimates
+ok 9 - variable keys, quantiles, boundaries and estimates
+ok 10 - variable keys, quantiles, boundaries and estimates, FASTMAP_MAP_BUFFERPOOL
+ok 11 - integer keys, quantiles, boundaries and estimates
+ok 12 - Elias-Fano coded set
+ok 13 - unlink()
+END
+
 eq_or_diff ~~ `t/1M_atom_t 2>&1`, <<'END', "1M_atom_t";
 1..26
 ok 1 - created fastmap